@@ -42,7 +42,8 @@ class Camera{
   enum ModelType{
     RADTAN,    //!< Radial tangential distortion model.
     EQUIDIST,  //!< Equidistant distortion model.
-    DS         //!< Double sphere distortion model.
+    DS,        //!< Double sphere distortion model.
+    PINHOLE    //!< Undistorted pinhole model (pre-rectified images), uses closed-form projection.
   } type_;
 
   Eigen::Matrix3d K_; //!< Intrinsic parameter matrix.
@@ -94,11 +95,20 @@ class Camera{
   void loadDoubleSphere(const std::string& filename);
 
   /** \brief Loads and sets the distortion model and the corresponding distortion coefficients from yaml-file.
+   *         The distortion model "none", as well as the radtan and double sphere models with all coefficients equal to
+   *         zero, selects the undistorted pinhole model. The equidistant model is always kept.
    *
    *   @param filename - Path to the yaml-file, containing the distortion model and distortion coefficient data.
    */
   void load(const std::string& filename);
 
+  /** \brief Checks whether the set distortion model reduces to the undistorted pinhole model (radtan with k1=k2=k3=p1=p2=0,
+   *         double sphere with xi=alpha=0). Never true for the equidistant model, which maps the radius through atan.
+   *
+   *   @return True, if the camera behaves as an undistorted pinhole camera.
+   */
+  bool hasZeroDistortion() const;
+
   /** \brief Distorts a point on the unit plane (in camera coordinates) according to the Radtan distortion model.
    *
    *   @param in  - Undistorted point coordinates on the unit plane (in camera coordinates).
@@ -219,8 +229,10 @@ class Camera{
   bool pixelToBearing(const cv::Point2f& c,LWF::NormalVectorElement& n) const;
 
   /** \brief Function testing the camera model by randomly mapping bearing vectors to pixel coordinates and vice versa.
+   *
+   *   @return false, if the closed form pinhole model disagrees with the radtan model with zero coefficients.
    */
-  void testCameraModel();
+  bool testCameraModel();
 };
 
 }
@@ -0,0 +1,260 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_COLUMNARWRITER_HPP_
+#define ROVIO_COLUMNARWRITER_HPP_
+
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rovio{
+
+/** \brief Appends tables of numeric columns to a binary file in self-contained chunks, written by a separate thread.
+ *
+ *  Layout (native little endian):
+ *    - Header: "ROVIOCOL" | uint32 version | uint32 nTables | per table: string name | uint32 nColumns |
+ *      per column: string name | uint32 type (0: float64, 1: int32). Strings are stored as uint32 length + characters.
+ *    - Chunks until the end of the file: uint32 table | uint32 nRows | per column: nRows consecutive values.
+ *
+ *  Every column of a chunk can be loaded with a single copy (e.g. numpy.frombuffer). A file cut off after any
+ *  chunk remains readable.
+ */
+class ColumnarWriter{
+ public:
+  enum ColumnType{
+    FLOAT64 = 0,
+    INT32 = 1
+  };
+  int chunkRows_;  /**<Number of rows collected before a chunk is handed to the writer thread.*/
+
+  /** \brief Constructor
+   */
+  ColumnarWriter(): chunkRows_(256), isOpen_(false), stop_(false){};
+
+  /** \brief Destructor, writes the pending rows.
+   */
+  virtual ~ColumnarWriter(){
+    close();
+  }
+
+  /** \brief Adds a table, only possible before open().
+   *
+   *  @param name    - Name of the table.
+   *  @param columns - Names of the columns.
+   *  @param types   - Types of the columns (FLOAT64 if empty).
+   *  @return the index of the table.
+   */
+  int addTable(const std::string& name, const std::vector<std::string>& columns, const std::vector<ColumnType>& types = std::vector<ColumnType>()){
+    assert(!isOpen_);
+    assert(types.empty() || types.size() == columns.size());
+    tables_.emplace_back();
+    Table& table = tables_.back();
+    table.name_ = name;
+    table.columns_ = columns;
+    table.types_ = types.empty() ? std::vector<ColumnType>(columns.size(),FLOAT64) : types;
+    return tables_.size()-1;
+  }
+
+  /** \brief Writes the header and starts the writer thread.
+   *
+   *  @param filename - Output file.
+   *  @return true, if successful.
+   */
+  bool open(const std::string& filename){
+    close();
+    filename_ = filename;
+    file_.open(filename_, std::ios::binary | std::ios::trunc);
+    if(!file_.good()){
+      std::cout << "\033[31mERROR: Could not open " << filename_ << " for writing!\033[0m" << std::endl;
+      return false;
+    }
+    file_.write("ROVIOCOL",8);
+    writeValue<uint32_t>(1);
+    writeValue<uint32_t>(tables_.size());
+    for(const Table& table : tables_){
+      writeString(table.name_);
+      writeValue<uint32_t>(table.columns_.size());
+      for(unsigned int c=0;c<table.columns_.size();c++){
+        writeString(table.columns_[c]);
+        writeValue<uint32_t>(table.types_[c]);
+      }
+    }
+    for(Table& table : tables_){
+      table.chunk_ = Chunk();
+      table.rowCount_ = 0;
+    }
+    stop_ = false;
+    isOpen_ = true;
+    thread_ = std::thread(&ColumnarWriter::run,this);
+    return true;
+  }
+
+  /** \brief Writes all pending rows and stops the writer thread.
+   */
+  void close(){
+    if(!isOpen_) return;
+    for(unsigned int i=0;i<tables_.size();i++){
+      flush(i);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+    file_.close();
+    isOpen_ = false;
+    std::cout << "Columnar writer: wrote";
+    for(const Table& table : tables_){
+      std::cout << " " << table.rowCount_ << " " << table.name_;
+    }
+    std::cout << " rows to " << filename_ << std::endl;
+  }
+
+  /** \brief Appends a row to a table (values of INT32 columns are truncated).
+   *
+   *  @param tableID - Index of the table.
+   *  @param values  - One value per column.
+   */
+  void appendRow(const int tableID, const double* values){
+    if(!isOpen_) return;
+    Table& table = tables_[tableID];
+    if(table.chunk_.data_.empty()){
+      table.chunk_.table_ = tableID;
+      table.chunk_.nRows_ = 0;
+      table.chunk_.stride_ = chunkRows_;
+      table.chunk_.data_.resize(table.columns_.size()*chunkRows_);
+    }
+    for(unsigned int c=0;c<table.columns_.size();c++){
+      table.chunk_.data_[c*table.chunk_.stride_+table.chunk_.nRows_] = values[c];
+    }
+    table.chunk_.nRows_++;
+    table.rowCount_++;
+    if(table.chunk_.nRows_ == table.chunk_.stride_){
+      flush(tableID);
+    }
+  }
+
+  bool isOpen() const{
+    return isOpen_;
+  }
+
+ private:
+  /** \brief Rows of a table, stored column by column.
+   */
+  struct Chunk{
+    int table_ = 0;
+    int nRows_ = 0;
+    int stride_ = 0;
+    std::vector<double> data_;
+  };
+  struct Table{
+    std::string name_;
+    std::vector<std::string> columns_;
+    std::vector<ColumnType> types_;
+    Chunk chunk_;
+    int rowCount_ = 0;
+  };
+
+  /** \brief Hands the current chunk of a table to the writer thread.
+   */
+  void flush(const int tableID){
+    Chunk& chunk = tables_[tableID].chunk_;
+    if(chunk.nRows_ == 0) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.emplace_back(std::move(chunk));
+    }
+    condition_.notify_one();
+    chunk = Chunk();
+  }
+
+  /** \brief Writer thread.
+   */
+  void run(){
+    Chunk chunk;
+    std::vector<int32_t> intColumn;
+    while(true){
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock,[this]{return stop_ || !queue_.empty();});
+        if(queue_.empty()) return; // stop_ and everything written
+        chunk = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      const Table& table = tables_[chunk.table_];
+      writeValue<uint32_t>(chunk.table_);
+      writeValue<uint32_t>(chunk.nRows_);
+      for(unsigned int c=0;c<table.columns_.size();c++){
+        const double* column = &chunk.data_[c*chunk.stride_];
+        if(table.types_[c] == INT32){
+          intColumn.resize(chunk.nRows_);
+          for(int r=0;r<chunk.nRows_;r++){
+            intColumn[r] = static_cast<int32_t>(column[r]);
+          }
+          file_.write(reinterpret_cast<const char*>(intColumn.data()),chunk.nRows_*sizeof(int32_t));
+        } else {
+          file_.write(reinterpret_cast<const char*>(column),chunk.nRows_*sizeof(double));
+        }
+      }
+    }
+  }
+
+  template<typename T>
+  void writeValue(const T value){
+    file_.write(reinterpret_cast<const char*>(&value),sizeof(T));
+  }
+
+  void writeString(const std::string& s){
+    writeValue<uint32_t>(s.size());
+    file_.write(s.data(),s.size());
+  }
+
+  std::string filename_;
+  bool isOpen_;
+  bool stop_;
+  std::vector<Table> tables_;
+  std::ofstream file_;
+  std::deque<Chunk> queue_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+};
+
+}
+
+
+#endif /* ROVIO_COLUMNARWRITER_HPP_ */
@@ -0,0 +1,210 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_COMPUTEBUDGETCONTROLLER_HPP_
+#define ROVIO_COMPUTEBUDGETCONTROLLER_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <opencv2/core/core.hpp>
+
+namespace rovio{
+
+/** \brief Decisions and timings of the \ref ComputeBudgetController for the last image update.
+ */
+struct ComputeBudgetMetrics{
+  double frameDuration_;  /**<Duration of the last image update [s].*/
+  double load_;  /**<Low-pass filtered ratio between the frame duration and the budget.*/
+  int alignMaxUniSample_;  /**<Number of alignment seeds on one side used at the start of the frame.*/
+  int maxNumIteration_;  /**<Maximal number of IEKF iterations used for the frame.*/
+  int processedFeatures_;  /**<Number of features which were processed.*/
+  int skippedFeatures_;  /**<Number of features which were skipped because the budget was exceeded.*/
+  bool detectionDeferred_;  /**<True if the detection of new features was deferred.*/
+  int consecutiveDeferrals_;  /**<Number of consecutive frames with deferred detection.*/
+  int overBudgetFrameCount_;  /**<Total number of frames which exceeded the budget.*/
+
+  /** \brief Constructor
+   */
+  ComputeBudgetMetrics(){
+    frameDuration_ = 0.0;
+    load_ = 0.0;
+    alignMaxUniSample_ = 0;
+    maxNumIteration_ = 0;
+    processedFeatures_ = 0;
+    skippedFeatures_ = 0;
+    detectionDeferred_ = false;
+    consecutiveDeferrals_ = 0;
+    overBudgetFrameCount_ = 0;
+  }
+
+  /** \brief Prints the metrics.
+   */
+  void print() const{
+    std::cout << "Budget: duration " << frameDuration_*1000 << " ms, load " << load_ << ", seeds " << alignMaxUniSample_ << ", iterations " << maxNumIteration_
+        << ", features " << processedFeatures_ << "/" << processedFeatures_+skippedFeatures_ << ", detection " << (detectionDeferred_ ? "deferred" : "done")
+        << ", over budget " << overBudgetFrameCount_ << std::endl;
+  }
+};
+
+/** \brief Controls the computational effort of the image update, such that it remains within a per-frame time budget.
+ *
+ *  At the start of each frame the number of alignment seeds and IEKF iterations is scaled down with the filtered load of the previous frames.
+ *  Within a frame, once the budget is exceeded, only the highest priority features are processed further (with the minimal number of seeds),
+ *  and the detection of new features is deferred if a given fraction of the budget is used up (for a bounded number of consecutive frames).
+ */
+class ComputeBudgetController{
+ public:
+  double frameBudget_;  /**<Time budget for one image update [s]. The controller is disabled if <= 0.0.*/
+  double detectionBudgetRatio_;  /**<Fraction of the budget after which the detection of new features is deferred.*/
+  int maxConsecutiveDeferrals_;  /**<Maximal number of consecutive frames for which the detection can be deferred.*/
+  int minAlignMaxUniSample_;  /**<Lower limit for the number of alignment seeds on one side.*/
+  int minNumIteration_;  /**<Lower limit for the number of IEKF iterations.*/
+  int minFeaturesOverBudget_;  /**<Number of highest priority features which are processed even if the budget is exceeded.*/
+  double loadFilterConstant_;  /**<Low-pass filter constant for the load (0: no filtering, 1: constant).*/
+  ComputeBudgetMetrics metrics_;  /**<Metrics of the current/last frame.*/
+  int64 startTick_;  /**<Tick count at the start of the current frame.*/
+
+  /** \brief Constructor
+   */
+  ComputeBudgetController(){
+    frameBudget_ = 0.0;
+    detectionBudgetRatio_ = 0.7;
+    maxConsecutiveDeferrals_ = 3;
+    minAlignMaxUniSample_ = 0;
+    minNumIteration_ = 1;
+    minFeaturesOverBudget_ = 10;
+    loadFilterConstant_ = 0.5;
+    startTick_ = 0;
+  }
+
+  /** \brief Destructor
+   */
+  virtual ~ComputeBudgetController(){};
+
+  /** \brief Returns true if a positive budget is set.
+   */
+  bool isEnabled() const{
+    return frameBudget_ > 0.0;
+  }
+
+  /** \brief Starts the timing of a frame and sets the effort levels from the filtered load.
+   *
+   *  @param nominalAlignMaxUniSample - Configured number of alignment seeds on one side.
+   *  @param nominalMaxNumIteration   - Configured maximal number of IEKF iterations.
+   */
+  void startFrame(const int nominalAlignMaxUniSample, const int nominalMaxNumIteration){
+    startTick_ = cv::getTickCount();
+    metrics_.processedFeatures_ = 0;
+    metrics_.skippedFeatures_ = 0;
+    metrics_.detectionDeferred_ = false;
+    const double scale = (isEnabled() && metrics_.load_ > 1.0) ? 1.0/metrics_.load_ : 1.0;
+    metrics_.alignMaxUniSample_ = std::min(nominalAlignMaxUniSample,std::max(minAlignMaxUniSample_,static_cast<int>(std::floor(scale*nominalAlignMaxUniSample))));
+    metrics_.maxNumIteration_ = std::min(nominalMaxNumIteration,std::max(minNumIteration_,static_cast<int>(std::ceil(scale*nominalMaxNumIteration))));
+  }
+
+  /** \brief Ends the timing of a frame and updates the filtered load.
+   */
+  void endFrame(){
+    metrics_.frameDuration_ = elapsed();
+    if(isEnabled()){
+      metrics_.load_ = loadFilterConstant_*metrics_.load_ + (1.0-loadFilterConstant_)*metrics_.frameDuration_/frameBudget_;
+      if(metrics_.frameDuration_ > frameBudget_) metrics_.overBudgetFrameCount_++;
+    }
+  }
+
+  /** \brief Returns the elapsed time since the start of the frame [s].
+   */
+  double elapsed() const{
+    return (cv::getTickCount()-startTick_)/cv::getTickFrequency();
+  }
+
+  /** \brief Returns true if the given fraction of the budget is used up.
+   *
+   *  @param ratio - Fraction of the budget.
+   */
+  bool isOverBudget(const double ratio = 1.0) const{
+    return isEnabled() && elapsed() > ratio*frameBudget_;
+  }
+
+  /** \brief Returns the number of alignment seeds on one side, which should currently be used.
+   */
+  int getAlignMaxUniSample() const{
+    return isOverBudget() ? std::min(minAlignMaxUniSample_,metrics_.alignMaxUniSample_) : metrics_.alignMaxUniSample_;
+  }
+
+  /** \brief Decides whether a feature should still be processed and counts the decision.
+   *
+   *  @param priorityRank - Rank of the feature (0 for the highest priority).
+   *  @return true, if the feature should be processed.
+   */
+  bool processFeature(const int priorityRank){
+    if(priorityRank >= minFeaturesOverBudget_ && isOverBudget()){
+      metrics_.skippedFeatures_++;
+      return false;
+    }
+    metrics_.processedFeatures_++;
+    return true;
+  }
+
+  /** \brief Decides whether the detection of new features should be deferred and counts the decision.
+   *
+   *  @return true, if the detection should be deferred.
+   */
+  bool deferDetection(){
+    metrics_.detectionDeferred_ = metrics_.consecutiveDeferrals_ < maxConsecutiveDeferrals_ && isOverBudget(detectionBudgetRatio_);
+    if(metrics_.detectionDeferred_){
+      metrics_.consecutiveDeferrals_++;
+    } else {
+      metrics_.consecutiveDeferrals_ = 0;
+    }
+    return metrics_.detectionDeferred_;
+  }
+
+  /** \brief Computes the priority ranks of a set of entries (rank 0 for the highest score).
+   *
+   *  @param scores  - Scores of the entries (higher is more important).
+   *  @param isValid - Validity flags of the entries, invalid entries are ranked last.
+   *  @param n       - Number of entries.
+   *  @param order   - Temporary of size n.
+   *  @param ranks   - Computed ranks.
+   */
+  static void computeRanks(const double* scores, const bool* isValid, const int n, int* order, int* ranks){
+    for(int i=0;i<n;i++) order[i] = i;
+    std::sort(order,order+n,[scores,isValid](const int a, const int b){
+      if(isValid[a] != isValid[b]) return isValid[a];
+      return scores[a] > scores[b];
+    });
+    for(int i=0;i<n;i++) ranks[order[i]] = i;
+  }
+};
+
+}
+
+
+#endif /* ROVIO_COMPUTEBUDGETCONTROLLER_HPP_ */
@@ -31,6 +31,7 @@
 
 #include "lightweight_filtering/common.hpp"
 #include "lightweight_filtering/CoordinateTransform.hpp"
+#include "rovio/CoordinateTransform/SparseCovariance.hpp"
 
 namespace rovio {
 
@@ -120,31 +121,52 @@ class CameraOutputCT:public LWF::CoordinateTransform<STATE,StandardOutput>{
   }
   void jacTransform(MXD& J, const mtInput& input) const{
     J.setZero();
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_pos>(),mtInput::template getId<mtInput::_pos>()) = M3D::Identity();
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_pos>(),mtInput::template getId<mtInput::_att>()) =
+    DenseJacobian D(J);
+    jacTransformBlocks(D,input);
+  }
+  /** \brief Assembles the Jacobian of the transform block by block (see SparseCovariance).
+   *
+   *  @param J     - Dense or compact Jacobian.
+   *  @param input - Linearization point.
+   */
+  template<typename JACOBIAN>
+  void jacTransformBlocks(JACOBIAN& J, const mtInput& input) const{
+    const M3D mCM = MPD(input.qCM(camID_)).matrix();
+    const V3D MwWM = input.aux().MwWMmeas_-input.gyb();
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_pos>(),mtInput::template getId<mtInput::_pos>()) = M3D::Identity();
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_pos>(),mtInput::template getId<mtInput::_att>()) =
         -gSM(input.qWM().rotate(input.MrMC(camID_)));
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_att>(),mtInput::template getId<mtInput::_att>()) =
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_att>(),mtInput::template getId<mtInput::_att>()) =
         -MPD(input.qCM(camID_)*input.qWM().inverted()).matrix();
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_vel>()) = -MPD(input.qCM(camID_)).matrix();
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_gyb>()) = MPD(input.qCM(camID_)).matrix()
-        * gSM(input.MrMC(camID_));
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_ror>(),mtInput::template getId<mtInput::_gyb>()) = -MPD(input.qCM(camID_)).matrix();
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_vel>()) = -mCM;
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_gyb>()) = mCM*gSM(input.MrMC(camID_));
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_ror>(),mtInput::template getId<mtInput::_gyb>()) = -mCM;
     if(input.aux().doVECalibration_){
-      J.template block<3,3>(mtOutput::template getId<mtOutput::_pos>(),mtInput::template getId<mtInput::_vep>(camID_)) =
+      J.template jac<3,3>(mtOutput::template getId<mtOutput::_pos>(),mtInput::template getId<mtInput::_vep>(camID_)) =
           MPD(input.qWM()).matrix();
-      J.template block<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_vep>(camID_)) =
-          MPD(input.qCM(camID_)).matrix()*gSM(V3D(input.aux().MwWMmeas_-input.gyb()));
-      J.template block<3,3>(mtOutput::template getId<mtOutput::_ror>(),mtInput::template getId<mtInput::_vea>(camID_)) =
-          -gSM(input.qCM(camID_).rotate(V3D(input.aux().MwWMmeas_-input.gyb())));
-      J.template block<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_vea>(camID_)) =
-          -gSM(input.qCM(camID_).rotate(V3D(-input.MvM() + gSM(V3D(input.aux().MwWMmeas_-input.gyb()))*input.MrMC())));
-      J.template block<3,3>(mtOutput::template getId<mtOutput::_att>(),mtInput::template getId<mtInput::_vea>(camID_)) =
+      J.template jac<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_vep>(camID_)) = mCM*gSM(MwWM);
+      J.template jac<3,3>(mtOutput::template getId<mtOutput::_ror>(),mtInput::template getId<mtInput::_vea>(camID_)) =
+          -gSM(input.qCM(camID_).rotate(MwWM));
+      J.template jac<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_vea>(camID_)) =
+          -gSM(input.qCM(camID_).rotate(V3D(-input.MvM() + gSM(MwWM)*input.MrMC(camID_))));
+      J.template jac<3,3>(mtOutput::template getId<mtOutput::_att>(),mtInput::template getId<mtInput::_vea>(camID_)) =
           M3D::Identity();
     }
   }
+  /** \brief Computes the output covariance like transformCovMat, but only from the pose, velocity, bias and
+   *         extrinsics blocks of the state covariance.
+   */
+  void transformCovMatSparse(const mtInput& input,const MXD& cov,MXD& outputCov){
+    sparseCov_.reset();
+    jacTransformBlocks(sparseCov_,input);
+    sparseCov_.transform(cov,outputCov);
+    postProcess(outputCov,input);
+  }
   void postProcess(MXD& cov,const mtInput& input){
     cov.template block<3,3>(mtOutput::template getId<mtOutput::_ror>(),mtOutput::template getId<mtOutput::_ror>()) += input.aux().wMeasCov_;
   }
+ private:
+  SparseCovariance<StandardOutput::D_,18> sparseCov_;
 };
 
 template<typename STATE>
@@ -167,16 +189,60 @@ class ImuOutputCT:public LWF::CoordinateTransform<STATE,StandardOutput>{
   }
   void jacTransform(MXD& J, const mtInput& input) const{
     J.setZero();
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_pos>(),mtInput::template getId<mtInput::_pos>()) = M3D::Identity();
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_att>(),mtInput::template getId<mtInput::_att>()) = -MPD(input.qWM().inverted()).matrix();
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_vel>()) = -M3D::Identity();
-    J.template block<3,3>(mtOutput::template getId<mtOutput::_ror>(),mtInput::template getId<mtInput::_gyb>()) = -M3D::Identity();
+    DenseJacobian D(J);
+    jacTransformBlocks(D,input);
+  }
+  /** \brief Assembles the Jacobian of the transform block by block (see SparseCovariance).
+   *
+   *  @param J     - Dense or compact Jacobian.
+   *  @param input - Linearization point.
+   */
+  template<typename JACOBIAN>
+  void jacTransformBlocks(JACOBIAN& J, const mtInput& input) const{
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_pos>(),mtInput::template getId<mtInput::_pos>()) = M3D::Identity();
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_att>(),mtInput::template getId<mtInput::_att>()) = -MPD(input.qWM().inverted()).matrix();
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_vel>(),mtInput::template getId<mtInput::_vel>()) = -M3D::Identity();
+    J.template jac<3,3>(mtOutput::template getId<mtOutput::_ror>(),mtInput::template getId<mtInput::_gyb>()) = -M3D::Identity();
+  }
+  /** \brief Computes the output covariance like transformCovMat, but only from the pose, velocity and gyroscope
+   *         bias blocks of the state covariance.
+   */
+  void transformCovMatSparse(const mtInput& input,const MXD& cov,MXD& outputCov){
+    sparseCov_.reset();
+    jacTransformBlocks(sparseCov_,input);
+    sparseCov_.transform(cov,outputCov);
+    postProcess(outputCov,input);
   }
   void postProcess(MXD& cov,const mtInput& input){
     cov.template block<3,3>(mtOutput::template getId<mtOutput::_ror>(),mtOutput::template getId<mtOutput::_ror>()) += input.aux().wMeasCov_;
   }
+ private:
+  SparseCovariance<StandardOutput::D_,12> sparseCov_;
 };
 
+/** \brief Compares the sparse and the full covariance transformation of an output coordinate transform.
+ *
+ *  @param ct    - Coordinate transform providing transformCovMat and transformCovMatSparse.
+ *  @param input - Linearization point.
+ *  @param cov   - Covariance of the input.
+ *  @param th    - Threshold on the largest absolute difference.
+ *  @return true if the difference is below th.
+ */
+template<typename CT>
+bool testSparseCovMat(CT& ct,const typename CT::mtInput& input,const MXD& cov,const double th){
+  MXD outputCov((int)(CT::mtOutput::D_),(int)(CT::mtOutput::D_));
+  MXD outputCovSparse((int)(CT::mtOutput::D_),(int)(CT::mtOutput::D_));
+  ct.transformCovMat(input,cov,outputCov);
+  ct.transformCovMatSparse(input,cov,outputCovSparse);
+  const double error = (outputCov-outputCovSparse).array().abs().maxCoeff();
+  if(error > th){
+    std::cout << "\033[31m==== Sparse covariance transformation differs (" << error << ") ====\033[0m" << std::endl;
+    return false;
+  }
+  std::cout << "\033[32m==== Sparse covariance transformation is consistent (" << error << ") ====\033[0m" << std::endl;
+  return true;
+}
+
 }
 
 
@@ -0,0 +1,159 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_SPARSECOVARIANCE_HPP_
+#define ROVIO_SPARSECOVARIANCE_HPP_
+
+#include "lightweight_filtering/common.hpp"
+
+namespace rovio {
+
+/** \brief Propagates a covariance through a Jacobian which is only nonzero on a few blocks of the state.
+ *
+ *  The Jacobian is assembled in compact form, with one column block per involved state block. The transformed
+ *  covariance is then computed from the corresponding sub-blocks of the full covariance, such that the cost
+ *  does not depend on the dimension of the state.
+ *
+ *  @tparam nOut     - Dimension of the output.
+ *  @tparam nColsMax - Maximal number of involved state coordinates.
+ */
+template<int nOut, int nColsMax>
+class SparseCovariance{
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef Eigen::Matrix<double,nOut,nColsMax> mtJacobian;
+  SparseCovariance(){
+    reset();
+  }
+
+  /** \brief Removes all state blocks and zeros the Jacobian.
+   */
+  void reset(){
+    nBlocks_ = 0;
+    nCols_ = 0;
+    J_.setZero();
+  }
+
+  /** \brief Returns the part of the Jacobian w.r.t. a given state block, the block is added if not yet involved.
+   *
+   *  @param outputId - Index of the first output coordinate.
+   *  @param stateId  - Index of the first state coordinate.
+   *  @return the nRows x nCols block of the compact Jacobian.
+   */
+  template<int nRows, int nCols>
+  Eigen::Block<mtJacobian,nRows,nCols> jac(const int outputId, const int stateId){
+    int col = -1;
+    for(int i=0;i<nBlocks_;i++){
+      if(blockIds_[i] == stateId){
+        assert(blockSizes_[i] == nCols);
+        col = blockCols_[i];
+        break;
+      }
+    }
+    if(col < 0){
+      assert(nCols_+nCols <= nColsMax);
+      col = nCols_;
+      blockIds_[nBlocks_] = stateId;
+      blockSizes_[nBlocks_] = nCols;
+      blockCols_[nBlocks_] = col;
+      nBlocks_++;
+      for(int j=0;j<nCols;j++){
+        ids_[nCols_++] = stateId+j;
+      }
+    }
+    return J_.template block<nRows,nCols>(outputId,col);
+  }
+
+  /** \brief Returns the compact Jacobian (only the first cols() columns are used).
+   */
+  const mtJacobian& jacobian() const{
+    return J_;
+  }
+
+  /** \brief Returns the number of involved state coordinates.
+   */
+  int cols() const{
+    return nCols_;
+  }
+
+  /** \brief Returns the state index corresponding to a column of the compact Jacobian.
+   */
+  int stateId(const int col) const{
+    return ids_[col];
+  }
+
+  /** \brief Computes J*P*J^T using only the involved blocks of the covariance P.
+   *
+   *  @param cov       - Full covariance of the state.
+   *  @param outputCov - Covariance of the output (nOut x nOut).
+   */
+  template<typename OUTPUTCOV>
+  void transform(const MXD& cov, OUTPUTCOV& outputCov){
+    for(int r=0;r<nCols_;r++){
+      for(int c=0;c<nCols_;c++){
+        P_(r,c) = cov(ids_[r],ids_[c]);
+      }
+    }
+    outputCov = J_.leftCols(nCols_)*P_.topLeftCorner(nCols_,nCols_)*J_.leftCols(nCols_).transpose();
+  }
+
+ private:
+  mtJacobian J_;  /**<Compact Jacobian.*/
+  Eigen::Matrix<double,nColsMax,nColsMax> P_;  /**<Gathered covariance.*/
+  int ids_[nColsMax];  /**<State index of each column of the compact Jacobian.*/
+  int blockIds_[nColsMax];  /**<First state index of each involved block.*/
+  int blockSizes_[nColsMax];  /**<Size of each involved block.*/
+  int blockCols_[nColsMax];  /**<First column of each involved block.*/
+  int nBlocks_;  /**<Number of involved blocks.*/
+  int nCols_;  /**<Number of used columns.*/
+};
+
+/** \brief Provides the block interface of SparseCovariance for a dense Jacobian.
+ */
+class DenseJacobian{
+ public:
+  DenseJacobian(MXD& J): J_(J){};
+
+  /** \brief Returns a block of the Jacobian.
+   *
+   *  @param outputId - Index of the first output coordinate.
+   *  @param stateId  - Index of the first state coordinate.
+   */
+  template<int nRows, int nCols>
+  Eigen::Block<MXD,nRows,nCols> jac(const int outputId, const int stateId){
+    return J_.template block<nRows,nCols>(outputId,stateId);
+  }
+
+ private:
+  MXD& J_;
+};
+
+}
+
+
+#endif /* ROVIO_SPARSECOVARIANCE_HPP_ */
@@ -29,6 +29,8 @@
 #ifndef FEATUREDISTANCE_HPP_
 #define FEATUREDISTANCE_HPP_
 
+#include <cmath>
+
 namespace rovio {
 
 /** \brief Class allowing the computation of some distance. Different parametrizations are implemented.
@@ -246,6 +248,126 @@ class FeatureDistance{
   double getParameterDerivativeCombinedHyperbolic() const;
 };
 
+/** \brief Distance parametrization selected at compile time.
+ *
+ *  Loops over features which share one \ref FeatureDistance::Type can select the policy once and then evaluate the
+ *  parametrization without branching on the type (see ImuPrediction::setFeatureBatch).
+ *
+ *  @tparam TYPE - Parametrization type.
+ */
+template<FeatureDistance::Type TYPE>
+struct FeatureDistancePolicy;
+
+template<>
+struct FeatureDistancePolicy<FeatureDistance::REGULAR>{
+  static double getParameter(const double d){ return d; }
+  static double getDistance(const double p){ return p; }
+  static double getDistanceDerivative(const double /*p*/){ return 1.0; }
+  static double getParameterDerivative(const double /*p*/){ return 1.0; }
+  static double getParameterDerivativeCombined(const double /*p*/){ return 0.0; }
+};
+
+template<>
+struct FeatureDistancePolicy<FeatureDistance::INVERSE>{
+  static double makeNonZero(const double p){
+    if(p < 1e-6){
+      if(p >= 0){
+        return 1e-6;
+      } else if (p > -1e-6){
+        return -1e-6;
+      }
+    }
+    return p;
+  }
+  static double getParameter(const double d){ return 1/makeNonZero(d); }
+  static double getDistance(const double p){ return 1/makeNonZero(p); }
+  static double getDistanceDerivative(const double p){
+    const double p_temp = makeNonZero(p);
+    return -1.0/(p_temp*p_temp);
+  }
+  static double getParameterDerivative(const double p){
+    const double p_temp = makeNonZero(p);
+    return -p_temp*p_temp;
+  }
+  static double getParameterDerivativeCombined(const double p){ return -2*makeNonZero(p); }
+};
+
+template<>
+struct FeatureDistancePolicy<FeatureDistance::LOG>{
+  static double getParameter(const double d){ return std::log(d); }
+  static double getDistance(const double p){ return std::exp(p); }
+  static double getDistanceDerivative(const double p){ return std::exp(p); }
+  static double getParameterDerivative(const double p){ return std::exp(-p); }
+  static double getParameterDerivativeCombined(const double p){ return -std::exp(-p); }
+};
+
+template<>
+struct FeatureDistancePolicy<FeatureDistance::HYPERBOLIC>{
+  static double getParameter(const double d){ return std::asinh(d); }
+  static double getDistance(const double p){ return std::sinh(p); }
+  static double getDistanceDerivative(const double p){ return std::cosh(p); }
+  static double getParameterDerivative(const double p){
+    return 1/std::sqrt(std::pow(std::sinh(p),2)+1); // p = asinh(d)
+  }
+  static double getParameterDerivativeCombined(const double p){
+    return -std::sinh(p)/std::pow(std::pow(std::sinh(p),2)+1,1.5)*std::cosh(p);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline double FeatureDistance::getDistance() const{
+  switch(type_){
+    case INVERSE:
+      return FeatureDistancePolicy<INVERSE>::getDistance(p_);
+    case LOG:
+      return FeatureDistancePolicy<LOG>::getDistance(p_);
+    case HYPERBOLIC:
+      return FeatureDistancePolicy<HYPERBOLIC>::getDistance(p_);
+    default:
+      return FeatureDistancePolicy<REGULAR>::getDistance(p_);
+  }
+}
+
+inline double FeatureDistance::getDistanceDerivative() const{
+  switch(type_){
+    case INVERSE:
+      return FeatureDistancePolicy<INVERSE>::getDistanceDerivative(p_);
+    case LOG:
+      return FeatureDistancePolicy<LOG>::getDistanceDerivative(p_);
+    case HYPERBOLIC:
+      return FeatureDistancePolicy<HYPERBOLIC>::getDistanceDerivative(p_);
+    default:
+      return FeatureDistancePolicy<REGULAR>::getDistanceDerivative(p_);
+  }
+}
+
+inline double FeatureDistance::getParameterDerivative() const{
+  switch(type_){
+    case INVERSE:
+      return FeatureDistancePolicy<INVERSE>::getParameterDerivative(p_);
+    case LOG:
+      return FeatureDistancePolicy<LOG>::getParameterDerivative(p_);
+    case HYPERBOLIC:
+      return FeatureDistancePolicy<HYPERBOLIC>::getParameterDerivative(p_);
+    default:
+      return FeatureDistancePolicy<REGULAR>::getParameterDerivative(p_);
+  }
+}
+
+inline double FeatureDistance::getParameterDerivativeCombined() const{
+  switch(type_){
+    case INVERSE:
+      return FeatureDistancePolicy<INVERSE>::getParameterDerivativeCombined(p_);
+    case LOG:
+      return FeatureDistancePolicy<LOG>::getParameterDerivativeCombined(p_);
+    case HYPERBOLIC:
+      return FeatureDistancePolicy<HYPERBOLIC>::getParameterDerivativeCombined(p_);
+    default:
+      return FeatureDistancePolicy<REGULAR>::getParameterDerivativeCombined(p_);
+  }
+}
+
 }
 
 
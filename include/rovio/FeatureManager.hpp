@@ -400,8 +400,9 @@ class FeatureSetManager{
       std::list<std::tuple<const FeatureCoordinates*,MultilevelPatch<nLevels,patchSize>,int>> multilevelPatches;
 
       const int cellSize = 10;
-      const int nCellX = (pyr.imgs_[0].cols-1)/cellSize+1;
-      const int nCellY = (pyr.imgs_[0].rows-1)/cellSize+1;
+      const cv::Size levelZeroSize = pyr.getLevelZeroSize();
+      const int nCellX = (levelZeroSize.width-1)/cellSize+1;
+      const int nCellY = (levelZeroSize.height-1)/cellSize+1;
       const int nCell = nCellX*nCellY;
       const int nRange = penaltyDistance/cellSize;
 
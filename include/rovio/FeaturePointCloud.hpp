@@ -0,0 +1,205 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_FEATUREPOINTCLOUD_HPP_
+#define ROVIO_FEATUREPOINTCLOUD_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <geometry_msgs/Point.h>
+#include <sensor_msgs/PointCloud2.h>
+#include "lightweight_filtering/common.hpp"
+#include "rovio/MultiCamera.hpp"
+#include "rovio/CoordinateTransform/SparseCovariance.hpp"
+
+namespace rovio{
+
+/** \brief Packed layout of a point of the feature point cloud (one PointCloud2 point per feature slot).
+ */
+struct FeaturePoint{
+  int32_t id_;  /**<Feature index, -1 for invalid slots.*/
+  int32_t camId_;  /**<Camera in which the feature is parametrized.*/
+  uint32_t rgb_;  /**<Packed color.*/
+  uint32_t status_;  /**<Tracking status in camera 0.*/
+  float x_, y_, z_;  /**<Landmark position in the IMU frame.*/
+  float b_x_, b_y_, b_z_;  /**<Bearing vector in the camera frame.*/
+  float d_;  /**<Distance.*/
+  float c_[6];  /**<Upper triangular part of the landmark covariance (c_00,c_01,c_02,c_11,c_12,c_22).*/
+  float c_d_;  /**<Distance variance.*/
+};
+static_assert(sizeof(FeaturePoint) == 18*4, "FeaturePoint must be packed");
+
+/** \brief Builds the feature point cloud in place.
+ *
+ *  The fields of the PointCloud2 message are generated from the FeaturePoint layout, such that the points can be
+ *  written directly into the message data. The landmark covariances are computed from the few covariance blocks
+ *  involved (feature, camera extrinsics) instead of transforming the full filter covariance for every feature.
+ */
+class FeaturePointCloud{
+ public:
+  /** \brief Sets up the fields and allocates the data of the message.
+   *
+   *  @param msg - Point cloud message.
+   *  @param n   - Number of points (feature slots).
+   */
+  static void initMessage(sensor_msgs::PointCloud2& msg, const int n){
+    msg.height = 1;  // Unordered point cloud.
+    msg.width  = n;  // Number of features/points.
+    const char* names[] = {"id","camId","rgb","status","x","y","z","b_x","b_y","b_z","d","c_00","c_01","c_02","c_11","c_12","c_22","c_d"};
+    msg.fields.resize(18);
+    for(int i=0;i<18;i++){
+      msg.fields[i].name     = names[i];
+      msg.fields[i].offset   = 4*i;
+      msg.fields[i].count    = 1;
+      msg.fields[i].datatype = i<2 ? sensor_msgs::PointField::INT32 : (i<4 ? sensor_msgs::PointField::UINT32 : sensor_msgs::PointField::FLOAT32);
+    }
+    static_assert(offsetof(FeaturePoint,x_) == 4*4 && offsetof(FeaturePoint,d_) == 10*4 && offsetof(FeaturePoint,c_d_) == 17*4, "Field offsets do not match");
+    msg.point_step = sizeof(FeaturePoint);
+    msg.row_step = msg.point_step * msg.width;
+    msg.data.resize(msg.row_step * msg.height);
+    msg.is_dense = false;
+  }
+
+  /** \brief Returns the points stored in the message data.
+   */
+  static FeaturePoint* getPoints(sensor_msgs::PointCloud2& msg){
+    return reinterpret_cast<FeaturePoint*>(msg.data.data());
+  }
+
+  /** \brief Writes all feature slots of a filter state into the message and computes the uncertainty rays.
+   *
+   *  @param msg          - Point cloud message, initialized with initMessage().
+   *  @param markerPoints - If not nullptr, filled with the end points (camera frame) of the 3 sigma distance interval of every valid feature.
+   *  @param filterState  - Filter state.
+   *  @param multiCamera  - Cameras, with extrinsics corresponding to the filter state.
+   */
+  template<typename FILTERSTATE>
+  void write(sensor_msgs::PointCloud2& msg, std::vector<geometry_msgs::Point>* markerPoints, const FILTERSTATE& filterState, const MultiCamera<FILTERSTATE::mtState::nCam_>& multiCamera){
+    typedef typename FILTERSTATE::mtState mtState;
+    const mtState& state = filterState.state_;
+    const MXD& cov = filterState.cov_;
+    const bool doVECalibration = state.aux().doVECalibration_;
+    FeaturePoint* points = getPoints(msg);
+    int markerCount = 0;
+    for(unsigned int i=0;i<mtState::nMax_;i++){
+      FeaturePoint& p = points[i];
+      if(!filterState.fsm_.isValid_[i]){
+        p = getInvalidPoint();
+        continue;
+      }
+      const int camID = filterState.fsm_.features_[i].mpCoordinates_->camID_;
+      const int feaId = mtState::template getId<mtState::_fea>(i);
+      const FeatureDistance& distance = state.dep(i);
+      const double d = distance.getDistance();
+      const double dd = distance.getDistanceDerivative();
+      const LWF::NormalVectorElement& nor = state.CfP(i).get_nor();
+      const V3D bearing = nor.getVec();
+      const V3D CrCP = d*bearing;
+      const M3D mBC = MPD(multiCamera.qCB_[camID].inverted()).matrix();
+      const V3D MrMP = multiCamera.BrBC_[camID] + mBC*CrCP;
+
+      // Landmark covariance from the feature block and, if estimated, the extrinsics blocks
+      sparseCov_.reset();
+      sparseCov_.jac<3,2>(0,feaId) = mBC*d*nor.getM();
+      sparseCov_.jac<3,1>(0,feaId+2) = mBC*bearing*dd;
+      if(doVECalibration){
+        sparseCov_.jac<3,3>(0,mtState::template getId<mtState::_vep>(camID)) = M3D::Identity();
+        sparseCov_.jac<3,3>(0,mtState::template getId<mtState::_vea>(camID)) = mBC*gSM(CrCP);
+      }
+      sparseCov_.transform(cov,landmarkCov_);
+
+      p.id_ = filterState.fsm_.features_[i].idx_;
+      p.camId_ = camID;
+      p.rgb_ = (255 << 16) | (255 << 8) | 255;
+      p.status_ = filterState.fsm_.features_[i].mpStatistics_->status_[0];
+      p.x_ = MrMP(0); p.y_ = MrMP(1); p.z_ = MrMP(2);
+      p.b_x_ = bearing(0); p.b_y_ = bearing(1); p.b_z_ = bearing(2);
+      p.d_ = d;
+      int k = 0;
+      for(int row=0;row<3;row++){
+        for(int col=row;col<3;col++){
+          p.c_[k++] = landmarkCov_(row,col);
+        }
+      }
+      p.c_d_ = dd*dd*cov(feaId+2,feaId+2);
+
+      // Uncertainty rays (3 sigma)
+      if(markerPoints != nullptr){
+        const double stretchFactor = 3;
+        const double sigma = sqrt(cov(feaId+2,feaId+2));
+        FeatureDistance distanceBound = distance;
+        distanceBound.p_ -= stretchFactor*sigma;
+        const double d_minus = std::min(std::max(distanceBound.getDistance(),0.0),1000.0);
+        distanceBound.p_ += 2*stretchFactor*sigma;
+        const double d_plus = std::min(std::max(distanceBound.getDistance(),0.0),1000.0);
+        if((int)markerPoints->size() < markerCount+2){
+          markerPoints->resize(markerCount+2);
+        }
+        setPoint((*markerPoints)[markerCount++],bearing*d_plus);
+        setPoint((*markerPoints)[markerCount++],bearing*d_minus);
+      }
+    }
+    if(markerPoints != nullptr){
+      markerPoints->resize(markerCount); // Keeps the capacity
+    }
+  }
+
+ private:
+  /** \brief Point written for invalid feature slots (id -1, all other fields NaN).
+   */
+  static const FeaturePoint& getInvalidPoint(){
+    static const FeaturePoint invalidPoint = [](){
+      FeaturePoint p;
+      const float badPoint = std::numeric_limits<float>::quiet_NaN();
+      unsigned char* data = reinterpret_cast<unsigned char*>(&p);
+      for(int j=1;j<18;j++){
+        std::memcpy(data+4*j,&badPoint,sizeof(float));
+      }
+      p.id_ = -1;
+      return p;
+    }();
+    return invalidPoint;
+  }
+
+  static void setPoint(geometry_msgs::Point& point, const V3D& vec){
+    point.x = float(vec(0));
+    point.y = float(vec(1));
+    point.z = float(vec(2));
+  }
+
+  SparseCovariance<3,9> sparseCov_;  /**<Landmark covariance w.r.t. feature and extrinsics.*/
+  M3D landmarkCov_;  /**<Landmark covariance in the IMU frame.*/
+};
+
+}
+
+
+#endif /* ROVIO_FEATUREPOINTCLOUD_HPP_ */
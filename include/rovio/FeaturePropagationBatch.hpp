@@ -0,0 +1,146 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_FEATUREPROPAGATIONBATCH_HPP_
+#define ROVIO_FEATUREPROPAGATIONBATCH_HPP_
+
+#include "lightweight_filtering/common.hpp"
+
+namespace rovio {
+
+/** \brief Noise free propagation of all features in structure-of-arrays layout.
+ *
+ *  Bearing vectors, depth parameters and the camera motion of each feature are stored in one array per component, such
+ *  that the rotation increment of the bearing vector, the rotation angle terms and the new depth parameter are evaluated
+ *  with Eigen array expressions over all features at once (vectorized with the SSE/AVX/NEON packets enabled for the
+ *  build). Only the quaternion composition remains per feature.
+ *
+ *  @tparam nMax - Maximal number of features.
+ */
+template<int nMax>
+class FeaturePropagationBatch{
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef Eigen::Array<double,nMax,1> mtArray;
+
+  FeaturePropagationBatch(){
+    for(int i=0;i<nMax;i++){
+      setInvalid(i);
+    }
+  };
+  virtual ~FeaturePropagationBatch(){};
+
+  /** \brief Sets the input of a feature.
+   *
+   *  @param i        - Feature index.
+   *  @param n        - Bearing vector.
+   *  @param camVel   - Velocity of the camera of the feature, in camera coordinates.
+   *  @param camRor   - Rotational rate of the camera of the feature, in camera coordinates.
+   *  @param distance - Distance of the feature.
+   *  @param parDer   - Derivative of the depth parameter w.r.t. the distance.
+   *  @param p        - Depth parameter.
+   */
+  void setFeature(const int i, const V3D& n, const V3D& camVel, const V3D& camRor, const double distance, const double parDer, const double p){
+    nx_(i) = n(0); ny_(i) = n(1); nz_(i) = n(2);
+    vx_(i) = camVel(0); vy_(i) = camVel(1); vz_(i) = camVel(2);
+    rx_(i) = camRor(0); ry_(i) = camRor(1); rz_(i) = camRor(2);
+    invDistance_(i) = 1.0/distance;
+    parDer_(i) = parDer;
+    p_(i) = p;
+  }
+
+  /** \brief Sets neutral input for an unused feature slot.
+   */
+  void setInvalid(const int i){
+    setFeature(i,V3D(0,0,1),V3D::Zero(),V3D::Zero(),1.0,0.0,0.0);
+  }
+
+  /** \brief Propagates all features.
+   *
+   *  dm = -dt*(n x camVel/d + (I-n*n^T)*camRor), qm = exp(dm), p' = p - dt*dp/dd*n^T*camVel
+   *
+   *  @param dt - Time step.
+   */
+  void propagate(const double dt){
+    nr_ = nx_*rx_+ny_*ry_+nz_*rz_;
+    dmx_ = -dt*((ny_*vz_-nz_*vy_)*invDistance_ + rx_ - nx_*nr_);
+    dmy_ = -dt*((nz_*vx_-nx_*vz_)*invDistance_ + ry_ - ny_*nr_);
+    dmz_ = -dt*((nx_*vy_-ny_*vx_)*invDistance_ + rz_ - nz_*nr_);
+    halfAngle_ = 0.5*(dmx_.square()+dmy_.square()+dmz_.square()).sqrt();
+    qw_ = halfAngle_.cos();
+    qs_ = (halfAngle_ > 1e-12).select(0.5*halfAngle_.sin()/halfAngle_.max(1e-12),0.5); // sin(|dm|/2)/|dm|
+    pOut_ = p_-dt*parDer_*(nx_*vx_+ny_*vy_+nz_*vz_);
+  }
+
+  /** \brief Returns the rotation increment of the bearing vector of feature i.
+   */
+  V3D dm(const int i) const{
+    return V3D(dmx_(i),dmy_(i),dmz_(i));
+  }
+
+  /** \brief Returns the quaternion exp(dm) of feature i.
+   *
+   *  @param i    - Feature index.
+   *  @param sign - Sign of the vector part (convention of QPD::exponentialMap, see expMapSign()).
+   */
+  QPD qm(const int i, const double sign) const{
+    return QPD(qw_(i),sign*qs_(i)*dmx_(i),sign*qs_(i)*dmy_(i),sign*qs_(i)*dmz_(i));
+  }
+
+  /** \brief Returns the propagated depth parameter of feature i.
+   */
+  double depthParameter(const int i) const{
+    return pOut_(i);
+  }
+
+  /** \brief Returns the sign of the vector part of QPD::exponentialMap for a positive rotation vector.
+   */
+  static double expMapSign(){
+    QPD q;
+    q = q.exponentialMap(V3D(0.1,0.0,0.0));
+    return q.toImplementation().x() > 0 ? 1.0 : -1.0;
+  }
+
+ private:
+  mtArray nx_, ny_, nz_;
+  mtArray vx_, vy_, vz_;
+  mtArray rx_, ry_, rz_;
+  mtArray invDistance_;
+  mtArray parDer_;
+  mtArray p_;
+  mtArray nr_;
+  mtArray dmx_, dmy_, dmz_;
+  mtArray halfAngle_;
+  mtArray qw_, qs_;
+  mtArray pOut_;
+};
+
+}
+
+
+#endif /* ROVIO_FEATUREPROPAGATIONBATCH_HPP_ */
@@ -0,0 +1,168 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_FEATURETRIANGULATION_HPP_
+#define ROVIO_FEATURETRIANGULATION_HPP_
+
+#include "lightweight_filtering/common.hpp"
+#include "rovio/FeatureCoordinates.hpp"
+#include "rovio/FeatureDistance.hpp"
+
+namespace rovio{
+
+/** \brief Two-view triangulation of a feature with closed-form depth uncertainty.
+ *
+ *  The feature is observed along the bearing vector C1fP in a reference frame C1 and along C2fP in a partner frame C2.
+ *  The partner frame can either be another camera (stereo) or the same camera at another time (temporal baseline).
+ *  The distance d along C1fP is the least squares intersection of the two rays. Its variance follows from the law of sines
+ *  d = b*sin(beta)/sin(alpha+beta), where b is the baseline length, alpha the angle between C1fP and the baseline at C1 and beta the angle
+ *  between C2fP and the baseline at C2, by propagating an angular uncertainty of both bearing vectors:
+ *  \f$\sigma_d^2 = (\partial d/\partial \alpha)^2\sigma_1^2 + (\partial d/\partial \beta)^2\sigma_2^2\f$.
+ */
+class FeatureTriangulation{
+ public:
+  double minParallaxAngle_;  /**<Minimal angle between the two rays [rad], below which no triangulation is performed.*/
+  double minDistance_;  /**<Minimal valid distance [m].*/
+
+  /** \brief Constructor
+   */
+  FeatureTriangulation(){
+    minParallaxAngle_ = 1e-3;
+    minDistance_ = 0.0;
+  }
+
+  /** \brief Destructor
+   */
+  virtual ~FeatureTriangulation(){};
+
+  /** \brief Triangulates the distance along C1fP and computes its variance.
+   *
+   *  @param C1fP        - Bearing vector in the reference frame C1 (unit length).
+   *  @param C2fP        - Bearing vector in the partner frame C2 (unit length).
+   *  @param C2rC2C1     - Position vector, pointing from C2 to C1, expressed in coordinates of C2.
+   *  @param qC2C1       - Quaternion, expressing the orientation of C1 in C2.
+   *  @param sigmaAngle1 - Angular standard deviation of C1fP [rad].
+   *  @param sigmaAngle2 - Angular standard deviation of C2fP [rad].
+   *  @param distance    - Triangulated distance along C1fP.
+   *  @param distanceVariance - Variance of the triangulated distance.
+   *  @return true, if the triangulation was successful (sufficient parallax, positive distance above \ref minDistance_).
+   */
+  bool triangulate(const V3D& C1fP, const V3D& C2fP, const V3D& C2rC2C1, const QPD& qC2C1, const double sigmaAngle1, const double sigmaAngle2,
+                   double& distance, double& distanceVariance) const{
+    const V3D C2v1 = qC2C1.rotate(C1fP);
+    const double cosParallax = C2v1.dot(C2fP);
+    const double a = 1.0-cosParallax*cosParallax; // sin^2 of the parallax angle
+    const double sinMinParallax = std::sin(minParallaxAngle_);
+    if(a < sinMinParallax*sinMinParallax){
+      return false;
+    }
+    distance = -C2v1.dot(C2rC2C1 - C2fP*C2fP.dot(C2rC2C1)) / a;
+    if(distance < minDistance_ || distance <= 0){
+      return false;
+    }
+
+    // Angles of the triangle C1-C2-P
+    const double b = C2rC2C1.norm();
+    if(b < 1e-12){
+      return false;
+    }
+    const V3D C2eC2C1 = C2rC2C1/b;
+    const double cosAlpha = -C2v1.dot(C2eC2C1);  // Angle at C1 between ray and direction to C2
+    const double cosBeta = C2fP.dot(C2eC2C1);  // Angle at C2 between ray and direction to C1
+    const double sinAlpha = std::sqrt(std::max(1.0-cosAlpha*cosAlpha,0.0));
+    const double sinBeta = std::sqrt(std::max(1.0-cosBeta*cosBeta,0.0));
+    const double cosGamma = cosParallax;  // gamma = pi-alpha-beta is the parallax angle, sin^2(gamma) = a
+    const double dd_dalpha = b*sinBeta*cosGamma/a;
+    const double dd_dbeta = b*sinAlpha/a;
+    distanceVariance = dd_dalpha*dd_dalpha*sigmaAngle1*sigmaAngle1 + dd_dbeta*dd_dbeta*sigmaAngle2*sigmaAngle2;
+    return true;
+  }
+
+  /** \brief Triangulates a feature and sets its distance parameter, returns the variance of the distance parameter.
+   *
+   *  @param c1      - Feature coordinates in the reference frame C1.
+   *  @param c2      - Feature coordinates in the partner frame C2.
+   *  @param C2rC2C1 - Position vector, pointing from C2 to C1, expressed in coordinates of C2.
+   *  @param qC2C1   - Quaternion, expressing the orientation of C1 in C2.
+   *  @param sigmaAngle1 - Angular standard deviation of c1 [rad].
+   *  @param sigmaAngle2 - Angular standard deviation of c2 [rad].
+   *  @param d       - Distance of the feature (along c1), only modified on success.
+   *  @param parameterVariance - Variance of the distance parameter of d (depends on the parametrization of d).
+   *  @return true, if the triangulation was successful.
+   */
+  bool triangulate(const FeatureCoordinates& c1, const FeatureCoordinates& c2, const V3D& C2rC2C1, const QPD& qC2C1,
+                   const double sigmaAngle1, const double sigmaAngle2, FeatureDistance& d, double& parameterVariance) const{
+    if(!c1.com_nor() || !c2.com_nor()){
+      return false;
+    }
+    double distance, distanceVariance;
+    if(!triangulate(c1.get_nor().getVec(),c2.get_nor().getVec(),C2rC2C1,qC2C1,sigmaAngle1,sigmaAngle2,distance,distanceVariance)){
+      return false;
+    }
+    d.setParameter(distance);
+    const double dp_dd = d.getParameterDerivative();
+    parameterVariance = dp_dd*dp_dd*distanceVariance;
+    return true;
+  }
+
+  /** \brief Triangulates a feature observed in one camera at two different times (temporal two-view initialization).
+   *
+   *  @param c1      - Feature coordinates at the current time (frame C1).
+   *  @param c2      - Feature coordinates at a previous time (frame C2).
+   *  @param WrWC1   - Position of C1 in the world frame.
+   *  @param qC1W    - Orientation of the world frame in C1.
+   *  @param WrWC2   - Position of C2 in the world frame.
+   *  @param qC2W    - Orientation of the world frame in C2.
+   *  @param sigmaAngle1 - Angular standard deviation of c1 [rad].
+   *  @param sigmaAngle2 - Angular standard deviation of c2 [rad].
+   *  @param d       - Distance of the feature (along c1), only modified on success.
+   *  @param parameterVariance - Variance of the distance parameter of d.
+   *  @return true, if the triangulation was successful.
+   */
+  bool triangulateFromPoses(const FeatureCoordinates& c1, const FeatureCoordinates& c2, const V3D& WrWC1, const QPD& qC1W, const V3D& WrWC2, const QPD& qC2W,
+                            const double sigmaAngle1, const double sigmaAngle2, FeatureDistance& d, double& parameterVariance) const{
+    const QPD qC2C1 = qC2W*qC1W.inverted();
+    const V3D C2rC2C1 = qC2W.rotate(V3D(WrWC1-WrWC2));
+    return triangulate(c1,c2,C2rC2C1,qC2C1,sigmaAngle1,sigmaAngle2,d,parameterVariance);
+  }
+
+  /** \brief Converts a pixel standard deviation into an angular standard deviation.
+   *
+   *  @param camera     - Camera model (focal length from Camera::K_).
+   *  @param pixelSigma - Pixel standard deviation.
+   *  @return the angular standard deviation [rad].
+   */
+  static double pixelToAngleSigma(const Camera& camera, const double pixelSigma){
+    return std::atan(pixelSigma/std::max(camera.K_(0,0),1e-6));
+  }
+};
+
+}
+
+
+#endif /* ROVIO_FEATURETRIANGULATION_HPP_ */
@@ -37,6 +37,7 @@
 #include "rovio/RobocentricFeatureElement.hpp"
 #include "rovio/FeatureManager.hpp"
 #include "rovio/MultiCamera.hpp"
+#include "rovio/MedianDepthEstimator.hpp"
 
 namespace rovio {
 
@@ -547,6 +548,11 @@ class FilterState: public LWF::FilterState<State<nMax,nLevels,patchSize,nCam,nPo
   ImagePyramid<nLevels> prevPyr_[nCam]; /**<Previous image pyramid.*/
   bool plotPoseMeas_; /**<Should the pose measurement be plotted.*/
   mutable MultilevelPatch<nLevels,patchSize> mlpErrorLog_[nMax];  /**<Multilevel patch containing log of error.*/
+  MedianDepthEstimator<nMax,nCam> medianDepthEstimator_;  /**<Incrementally maintained distance parameters of the features, used for initializing new features.*/
+  bool isTemporalInitPending_[nMax];  /**<True, if the feature waits for its temporal two-view initialization.*/
+  FeatureCoordinates temporalInitCoordinates_[nMax];  /**<Feature coordinates at detection, reference view of the temporal two-view initialization.*/
+  V3D temporalInitWrWC_[nMax];  /**<Camera position at the detection of the feature.*/
+  QPD temporalInitqCW_[nMax];  /**<Camera orientation at the detection of the feature.*/
 
   /** \brief Constructor
    */
@@ -559,6 +565,9 @@ class FilterState: public LWF::FilterState<State<nMax,nLevels,patchSize,nCam,nPo
     fsm_.allocateMissing();
     drawPB_ = 1;
     drawPS_ = mtState::patchSize_*pow(2,mtState::nLevels_-1)+2*drawPB_;
+    for(unsigned int i=0;i<nMax;i++){
+      isTemporalInitPending_[i] = false;
+    }
   }
 
   /** \brief Destructor
@@ -613,7 +622,78 @@ class FilterState: public LWF::FilterState<State<nMax,nLevels,patchSize,nCam,nPo
     cov_.template block<2,2>(mtState::template getId<mtState::_fea>(i),mtState::template getId<mtState::_fea>(i)) = initCov.block<2,2>(1,1);
   }
 
+  /** \brief Removes a feature from the filter state (sets it invalid, resets its covariance and clears its median depth slots).
+   *
+   *  @param i       - Feature index.
+   */
+  void removeFeature(unsigned int i){
+    fsm_.isValid_[i] = false;
+    isTemporalInitPending_[i] = false;
+    resetFeatureCovariance(i,Eigen::Matrix3d::Identity());
+    medianDepthEstimator_.remove(i);
+  }
+
+  /** \brief Refreshes the slots of a feature in \ref medianDepthEstimator_ for every camera frame.
+   *
+   *  Uses the same criteria as getMedianDepthParameters(): the feature must be in front of the camera and its relative
+   *  distance uncertainty in that camera frame must be below maxUncertaintyToDistanceRatio. The uncertainty is computed
+   *  from the feature and extrinsics blocks of the covariance only (TransformFeatureOutputCT::transformCovMatSparse).
+   *  @param i                              - Feature index.
+   *  @param maxUncertaintyToDistanceRatio  - Maximal uncertainty where feature gets considered
+   */
+  void updateMedianDepth(unsigned int i, const float maxUncertaintyToDistanceRatio){
+    for(int camID = 0;camID<nCam;camID++){
+      transformFeatureOutputCT_.setFeatureID(i);
+      transformFeatureOutputCT_.setOutputCameraID(camID);
+      transformFeatureOutputCT_.transformState(state_, featureOutput_);
+      bool valid = false;
+      if(featureOutput_.c().isInFront()){
+        transformFeatureOutputCT_.transformCovMatSparse(state_, cov_, featureOutputCov_);
+        const double uncertainty = std::fabs(sqrt(featureOutputCov_(2,2))*featureOutput_.d().getDistanceDerivative());
+        valid = uncertainty/featureOutput_.d().getDistance() < maxUncertaintyToDistanceRatio;
+      }
+      if(valid){
+        medianDepthEstimator_.update(camID,i,fsm_.features_[i].idx_,featureOutput_.d().p_);
+      } else {
+        medianDepthEstimator_.remove(camID,i);
+      }
+    }
+  }
+
+  /** \brief Checks the incrementally maintained median depth against the full pass getMedianDepthParameters().
+   *
+   *  Refreshes all valid features in \ref medianDepthEstimator_ first, both results must then be identical.
+   *  @param initDistanceParameter          - Depth parameter value which is set, if no median can be computed.
+   *  @param maxUncertaintyToDistanceRatio  - Maximal uncertainty where feature gets considered
+   *  @return true, if consistent.
+   */
+  bool testMedianDepthParameters(double initDistanceParameter, const float maxUncertaintyToDistanceRatio){
+    std::array<double,nCam> medianBaseline, medianIncremental;
+    getMedianDepthParameters(initDistanceParameter,&medianBaseline,maxUncertaintyToDistanceRatio);
+    medianDepthEstimator_.reset();
+    for(unsigned int i = 0; i < nMax; i++){
+      if(fsm_.isValid_[i]){
+        updateMedianDepth(i,maxUncertaintyToDistanceRatio);
+      }
+    }
+    medianDepthEstimator_.getMedianDepthParameters(initDistanceParameter,&medianIncremental,fsm_);
+    bool success = true;
+    for(int camID = 0;camID<nCam;camID++){
+      if(medianBaseline[camID] != medianIncremental[camID]){
+        std::cout << "\033[31m==== Median depth of camera " << camID << " is inconsistent (" << medianIncremental[camID] << " vs " << medianBaseline[camID] << ") ====\033[0m" << std::endl;
+        success = false;
+      }
+    }
+    if(success){
+      std::cout << "\033[32m==== Median depth is consistent ====\033[0m" << std::endl;
+    }
+    return success;
+  }
+
   /** \brief Get the median distance parameter values of the state features for each camera.
+   *
+   *  Performs a full pass over all features, including the transformation of their covariances. The image update uses the
+   *  incrementally maintained \ref medianDepthEstimator_ instead.
    *
    *  \note The distance parameter type depends on the set \ref DepthType.
    *  @param initDistanceParameter     - Depth parameter value which is set, if no median distance parameter could be
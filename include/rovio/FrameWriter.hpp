@@ -0,0 +1,231 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_FRAMEWRITER_HPP_
+#define ROVIO_FRAMEWRITER_HPP_
+
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+namespace rovio{
+
+/** \brief Writes rendered frames asynchronously to an image sequence or a raw video file.
+ *
+ *  Frames are copied into a bounded queue and written by a separate thread, such that the renderer never waits for
+ *  the disk. If the queue is full the frame is dropped.
+ *  If the filename contains a printf-style integer pattern (e.g. "/tmp/rovio/frame_%06d.png") every frame is written
+ *  as a separate image. Only a single "%d", "%<width>d" or "%0<width>d" conversion is accepted ("%%" stands for '%'), the
+ *  filename itself is never used as a format string. Otherwise all frames are appended as raw 8-bit BGR data to a single file (e.g. playable with
+ *  "ffplay -f rawvideo -pixel_format bgr24 -video_size <width>x<height> <file>").
+ */
+class FrameWriter{
+ public:
+  int maxQueueSize_;  /**<Maximal number of frames waiting to be written.*/
+
+  /** \brief Constructor
+   */
+  FrameWriter(): maxQueueSize_(30), isOpen_(false), stop_(false), isSequence_(false), sequenceWidth_(0), sequenceZeroFill_(false),
+      writtenCount_(0), droppedCount_(0){};
+
+  /** \brief Destructor, writes the pending frames.
+   */
+  virtual ~FrameWriter(){
+    close();
+  }
+
+  /** \brief Starts the writer thread.
+   *
+   *  @param filename - Image sequence pattern or raw video file.
+   *  @return true, if successful.
+   */
+  bool open(const std::string& filename){
+    close();
+    filename_ = filename;
+    isSequence_ = filename_.find('%') != std::string::npos;
+    if(isSequence_ && !parseSequencePattern(filename_)){
+      std::cout << "\033[31mERROR: Invalid image sequence pattern " << filename_ << " (requires exactly one integer conversion, e.g. %06d)!\033[0m" << std::endl;
+      return false;
+    }
+    if(!isSequence_){
+      rawFile_.open(filename_, std::ios::binary | std::ios::trunc);
+      if(!rawFile_.good()){
+        std::cout << "\033[31mERROR: Could not open " << filename_ << " for writing frames!\033[0m" << std::endl;
+        return false;
+      }
+    }
+    writtenCount_ = 0;
+    droppedCount_ = 0;
+    stop_ = false;
+    isOpen_ = true;
+    thread_ = std::thread(&FrameWriter::run,this);
+    return true;
+  }
+
+  /** \brief Writes all pending frames and stops the writer thread.
+   */
+  void close(){
+    if(!isOpen_) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+    if(rawFile_.is_open()) rawFile_.close();
+    isOpen_ = false;
+    std::cout << "Frame writer: wrote " << writtenCount_.load() << " frames to " << filename_ << " (" << droppedCount_.load() << " dropped";
+    if(!isSequence_) std::cout << ", raw bgr24 " << frameSize_.width << "x" << frameSize_.height;
+    std::cout << ")" << std::endl;
+  }
+
+  /** \brief Queues a copy of a frame (8-bit BGR).
+   *
+   *  @param frame - Frame to be written.
+   *  @return false, if the frame was dropped.
+   */
+  bool push(const cv::Mat& frame){
+    if(!isOpen_) return false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if((int)queue_.size() >= maxQueueSize_){
+        ++droppedCount_;
+        return false;
+      }
+      queue_.emplace_back(frame.clone());
+    }
+    condition_.notify_one();
+    return true;
+  }
+
+ private:
+  /** \brief Splits an image sequence pattern at its integer conversion into \ref sequencePrefix_ and \ref sequenceSuffix_.
+   *
+   *  @param pattern - Image sequence pattern.
+   *  @return false, if the pattern does not contain exactly one "%d", "%<width>d" or "%0<width>d" conversion.
+   */
+  bool parseSequencePattern(const std::string& pattern){
+    sequencePrefix_.clear();
+    sequenceSuffix_.clear();
+    std::string* part = &sequencePrefix_;
+    int conversionCount = 0;
+    for(size_t i=0;i<pattern.size();i++){
+      if(pattern[i] != '%'){
+        part->push_back(pattern[i]);
+        continue;
+      }
+      if(i+1 < pattern.size() && pattern[i+1] == '%'){
+        part->push_back('%');
+        i++;
+        continue;
+      }
+      size_t j = i+1;
+      sequenceZeroFill_ = j < pattern.size() && pattern[j] == '0';
+      if(sequenceZeroFill_) j++;
+      sequenceWidth_ = 0;
+      while(j < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[j]))){
+        sequenceWidth_ = 10*sequenceWidth_+(pattern[j]-'0');
+        if(sequenceWidth_ > 64) return false;
+        j++;
+      }
+      if(j >= pattern.size() || pattern[j] != 'd' || ++conversionCount > 1) return false;
+      part = &sequenceSuffix_;
+      i = j;
+    }
+    return conversionCount == 1;
+  }
+
+  /** \brief Writer thread.
+   */
+  void run(){
+    cv::Mat frame;
+    while(true){
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock,[this]{return stop_ || !queue_.empty();});
+        if(queue_.empty()) return; // stop_ and everything written
+        frame = queue_.front();
+        queue_.pop_front();
+      }
+      write(frame);
+    }
+  }
+
+  /** \brief Writes a single frame.
+   */
+  void write(const cv::Mat& frame){
+    if(isSequence_){
+      std::ostringstream name;
+      name << sequencePrefix_ << std::setfill(sequenceZeroFill_ ? '0' : ' ') << std::setw(sequenceWidth_) << writtenCount_.load() << sequenceSuffix_;
+      cv::imwrite(name.str(),frame);
+    } else {
+      if(writtenCount_ == 0){
+        frameSize_ = frame.size();
+      } else if(frame.size() != frameSize_){
+        ++droppedCount_; // Raw video requires a constant frame size
+        return;
+      }
+      for(int r=0;r<frame.rows;r++){
+        rawFile_.write(reinterpret_cast<const char*>(frame.ptr(r)),frame.cols*frame.elemSize());
+      }
+    }
+    ++writtenCount_;
+  }
+
+  std::string filename_;
+  bool isOpen_;
+  bool stop_;
+  bool isSequence_;
+  std::string sequencePrefix_;  /**<Part of the image sequence pattern before the integer conversion.*/
+  std::string sequenceSuffix_;  /**<Part of the image sequence pattern after the integer conversion.*/
+  int sequenceWidth_;  /**<Minimal width of the frame number.*/
+  bool sequenceZeroFill_;  /**<Pad the frame number with zeros instead of spaces.*/
+  std::atomic<int> writtenCount_;
+  std::atomic<int> droppedCount_;
+  cv::Size frameSize_;
+  std::ofstream rawFile_;
+  std::deque<cv::Mat> queue_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+};
+
+}
+
+
+#endif /* ROVIO_FRAMEWRITER_HPP_ */
@@ -0,0 +1,154 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_IMAGEINGESTIONPOLICY_HPP_
+#define ROVIO_IMAGEINGESTIONPOLICY_HPP_
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace rovio{
+
+/** \brief Policy for bounding the number of image measurements which wait for processing.
+ *
+ *  Decides for every new image frame (before its pyramid is computed) whether it is queued into the update timeline.
+ *  If the timeline already holds \ref maxQueueDepth_ image measurements the filter is lagging and either the oldest queued
+ *  measurements are erased (freeing their pyramids immediately), or every n-th incoming frame is dropped.
+ *  Image updates can also be skipped entirely, in which case the filter only integrates the IMU.
+ */
+class ImageIngestionPolicy{
+ public:
+  enum DropPolicy{
+    DROP_OLDEST, /**<Erase the oldest queued image measurement.*/
+    DROP_EVERY_NTH /**<Drop every n-th incoming frame while lagging, erase the oldest otherwise.*/
+  };
+
+  int maxQueueDepth_;  /**<Maximal number of queued image measurements, unbounded if <= 0.*/
+  DropPolicy dropPolicy_;  /**<Policy applied if the queue is full.*/
+  int dropEveryNth_;  /**<Drop interval for \ref DROP_EVERY_NTH.*/
+  bool skipImageUpdates_;  /**<If true, no image is queued (IMU-only integration).*/
+
+  int receivedCount_;  /**<Number of received frames.*/
+  int acceptedCount_;  /**<Number of frames which were queued.*/
+  int droppedIncomingCount_;  /**<Number of incoming frames which were dropped.*/
+  int droppedQueuedCount_;  /**<Number of queued measurements which were erased.*/
+  int skippedCount_;  /**<Number of frames which were skipped because of \ref skipImageUpdates_.*/
+  int laggingCount_;  /**<Number of consecutive frames received while the queue was full.*/
+
+  /** \brief Constructor
+   */
+  ImageIngestionPolicy(){
+    maxQueueDepth_ = 0;
+    dropPolicy_ = DROP_OLDEST;
+    dropEveryNth_ = 2;
+    skipImageUpdates_ = false;
+    resetCounters();
+  }
+
+  /** \brief Destructor
+   */
+  virtual ~ImageIngestionPolicy(){};
+
+  /** \brief Resets all counters.
+   */
+  void resetCounters(){
+    receivedCount_ = 0;
+    acceptedCount_ = 0;
+    droppedIncomingCount_ = 0;
+    droppedQueuedCount_ = 0;
+    skippedCount_ = 0;
+    laggingCount_ = 0;
+  }
+
+  /** \brief Sets the drop policy from its name ("oldest" or "every_nth").
+   *
+   *  @param name - Name of the policy.
+   *  @return false, if the name is unknown (the policy is not changed).
+   */
+  bool setDropPolicy(const std::string& name){
+    if(name == "oldest"){
+      dropPolicy_ = DROP_OLDEST;
+    } else if(name == "every_nth"){
+      dropPolicy_ = DROP_EVERY_NTH;
+    } else {
+      std::cout << "    \033[31mERROR: Unknown image drop policy " << name << "!\033[0m" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /** \brief Decides whether a new frame should be queued and makes room in the timeline if necessary.
+   *
+   *  @param timeline - Update timeline holding the queued image measurements (requires a std::map measMap_).
+   *  @return true, if the frame should be processed and queued.
+   */
+  template<typename TIMELINE>
+  bool acceptFrame(TIMELINE& timeline){
+    receivedCount_++;
+    if(skipImageUpdates_){
+      skippedCount_++;
+      return false;
+    }
+    if(maxQueueDepth_ > 0){
+      if(static_cast<int>(timeline.measMap_.size()) >= maxQueueDepth_){
+        laggingCount_++;
+        if(dropPolicy_ == DROP_EVERY_NTH && laggingCount_ % std::max(dropEveryNth_,1) == 0){
+          droppedIncomingCount_++;
+          return false;
+        }
+        while(static_cast<int>(timeline.measMap_.size()) >= maxQueueDepth_){
+          timeline.measMap_.erase(timeline.measMap_.begin());
+          droppedQueuedCount_++;
+        }
+      } else {
+        laggingCount_ = 0;
+      }
+    }
+    acceptedCount_++;
+    return true;
+  }
+
+  /** \brief Returns the total number of frames which were not processed.
+   */
+  int getDroppedCount() const{
+    return droppedIncomingCount_ + droppedQueuedCount_ + skippedCount_;
+  }
+
+  /** \brief Prints the counters.
+   */
+  void print() const{
+    std::cout << "Image ingestion: received " << receivedCount_ << ", accepted " << acceptedCount_ << ", dropped incoming " << droppedIncomingCount_
+        << ", dropped queued " << droppedQueuedCount_ << ", skipped " << skippedCount_ << std::endl;
+  }
+};
+
+}
+
+
+#endif /* ROVIO_IMAGEINGESTIONPOLICY_HPP_ */
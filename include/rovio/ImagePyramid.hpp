@@ -33,6 +33,7 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include "rovio/FeatureCoordinates.hpp"
+#include "rovio/PixelCoordinates.hpp"
 
 namespace rovio{
 
@@ -59,6 +60,80 @@ void halfSample(const cv::Mat& imgIn,cv::Mat& imgOut){
   }
 }
 
+/** \brief Scale factor 0.5^l between pyramid level 0 and pyramid level l (compile-time).
+ *
+ *   @param l - Pyramid level (non-negative).
+ *   @return 0.5^l
+ */
+constexpr float levelScaleDown(const int l){
+  return l <= 0 ? 1.0f : 0.5f*levelScaleDown(l-1);
+}
+
+/** \brief Scale factor 2^l between pyramid level l and pyramid level 0 (compile-time).
+ *
+ *   @param l - Pyramid level (non-negative).
+ *   @return 2^l
+ */
+constexpr float levelScaleUp(const int l){
+  return l <= 0 ? 1.0f : 2.0f*levelScaleUp(l-1);
+}
+
+/** \brief Compile-time tables of the pyramid level scale factors.
+ *
+ *   @tparam Is - Pyramid levels covered by the table.
+ */
+template<int... Is>
+struct LevelScaleTable{
+  static constexpr float down_[sizeof...(Is)] = {levelScaleDown(Is)...};  /**<0.5^l, scaling from level 0 to level l.*/
+  static constexpr float up_[sizeof...(Is)] = {levelScaleUp(Is)...};  /**<2^l, scaling from level l to level 0.*/
+  static constexpr float squaredDown_[sizeof...(Is)] = {levelScaleDown(2*Is)...};  /**<0.25^l, scaling of squared quantities (e.g. Hessians) from level l to level 0.*/
+};
+template<int... Is> constexpr float LevelScaleTable<Is...>::down_[sizeof...(Is)];
+template<int... Is> constexpr float LevelScaleTable<Is...>::up_[sizeof...(Is)];
+template<int... Is> constexpr float LevelScaleTable<Is...>::squaredDown_[sizeof...(Is)];
+
+/** \brief Generates a LevelScaleTable for the levels 0..N-1.
+ */
+template<int N, int... Is>
+struct MakeLevelScaleTable: MakeLevelScaleTable<N-1,N-1,Is...>{};
+template<int... Is>
+struct MakeLevelScaleTable<0,Is...>{
+  typedef LevelScaleTable<Is...> type;
+};
+
+/** \brief Access to the level scale factors of a pyramid with n_levels levels.
+ *
+ *   The tables have one additional entry (level n_levels) such that expressions like 2^(l+1) stay within the table.
+ *   @tparam n_levels - Number of pyramid levels.
+ */
+template<int n_levels>
+struct LevelScales{
+  typedef typename MakeLevelScaleTable<n_levels+1>::type mtTable;
+
+  /** \brief Returns 0.5^l. */
+  static float down(const int l){
+    assert(l>=0 && l<=n_levels);
+    return mtTable::down_[l];
+  }
+
+  /** \brief Returns 2^l. */
+  static float up(const int l){
+    assert(l>=0 && l<=n_levels);
+    return mtTable::up_[l];
+  }
+
+  /** \brief Returns 0.25^l. */
+  static float squaredDown(const int l){
+    assert(l>=0 && l<=n_levels);
+    return mtTable::squaredDown_[l];
+  }
+
+  /** \brief Returns the factor 0.5^(l2-l1) for transforming pixel distances from level l1 to level l2. */
+  static float transform(const int l1, const int l2){
+    return l2 >= l1 ? down(l2-l1) : up(l1-l2);
+  }
+};
+
 /** \brief Image pyramid with selectable number of levels.
  *
  *   @tparam n_levels - Number of pyramid levels.
@@ -67,33 +142,77 @@ void halfSample(const cv::Mat& imgIn,cv::Mat& imgOut){
 template<int n_levels>
 class ImagePyramid{
  public:
-  ImagePyramid(){};
+  ImagePyramid(): baseLevel_(0){};
   virtual ~ImagePyramid(){};
   cv::Mat imgs_[n_levels]; /**<Array, containing the pyramid images.*/
   cv::Point2f centers_[n_levels]; /**<Array, containing the image center coordinates (in pixel), defined in an
                                       image centered coordinate system of the image at level 0.*/
+  int baseLevel_; /**<Lowest pyramid level which holds an image. The images below are not stored (empty).*/
 
   /** \brief Initializes the image pyramid from an input image (level 0).
    *
-   *   @param img   - Input image (level 0).
-   *   @param useCv - Set to true, if opencv (cv::pyrDown) should be used for the pyramid creation.
+   *   @param img       - Input image (level 0).
+   *   @param useCv     - Set to true, if opencv (cv::pyrDown) should be used for the pyramid creation.
+   *   @param baseLevel - Lowest level which is stored. Lower levels are only computed as intermediate results.
    */
-  void computeFromImage(const cv::Mat& img, const bool useCv = false){
-    img.copyTo(imgs_[0]);
+  void computeFromImage(const cv::Mat& img, const bool useCv = false, const int baseLevel = 0){
+    assert(baseLevel>=0 && baseLevel<n_levels);
+    baseLevel_ = baseLevel;
     centers_[0] = cv::Point2f(0,0);
+    if(baseLevel_ == 0){
+      img.copyTo(imgs_[0]);
+    } else {
+      imgs_[0].release();
+    }
     for(int i=1; i<n_levels; ++i){
-      if(!useCv){
-        halfSample(imgs_[i-1],imgs_[i]);
-        centers_[i].x = centers_[i-1].x-pow(0.5,2-i)*(float)(imgs_[i-1].rows%2);
-        centers_[i].y = centers_[i-1].y-pow(0.5,2-i)*(float)(imgs_[i-1].cols%2);
-      } else {
-        cv::pyrDown(imgs_[i-1],imgs_[i],cv::Size(imgs_[i-1].cols/2, imgs_[i-1].rows/2));
-        centers_[i].x = centers_[i-1].x-pow(0.5,2-i)*(float)((imgs_[i-1].rows%2)+1);
-        centers_[i].y = centers_[i-1].y-pow(0.5,2-i)*(float)((imgs_[i-1].cols%2)+1);
+      computeLevel(i == 1 ? img : imgs_[i-1],i,useCv);
+      if(i-1 > 0 && i-1 < baseLevel_){
+        imgs_[i-1].release();
       }
     }
   }
 
+  /** \brief Initializes the image pyramid from an already downscaled input image (e.g. by hardware binning).
+   *
+   *   The pixel coordinates remain defined on level 0, such that the camera model of the full resolution camera stays valid.
+   *   The level 0 image is assumed to have an extent which is a multiple of 2^inputLevel (no center offset down to inputLevel).
+   *   @param img        - Input image, corresponding to pyramid level inputLevel.
+   *   @param inputLevel - Pyramid level of the input image.
+   *   @param useCv      - Set to true, if opencv (cv::pyrDown) should be used for the pyramid creation.
+   */
+  void computeFromDownscaledImage(const cv::Mat& img, const int inputLevel, const bool useCv = false){
+    assert(inputLevel>=0 && inputLevel<n_levels);
+    baseLevel_ = inputLevel;
+    for(int i=0; i<inputLevel; ++i){
+      imgs_[i].release();
+      centers_[i] = cv::Point2f(0,0);
+    }
+    img.copyTo(imgs_[inputLevel]);
+    centers_[inputLevel] = cv::Point2f(0,0);
+    for(int i=inputLevel+1; i<n_levels; ++i){
+      computeLevel(imgs_[i-1],i,useCv);
+    }
+  }
+
+  /** \brief Returns the image size at level 0 (also if level 0 is not stored).
+   */
+  cv::Size getLevelZeroSize() const{
+    const int s = static_cast<int>(LevelScales<n_levels>::up(baseLevel_));
+    return cv::Size(imgs_[baseLevel_].cols*s,imgs_[baseLevel_].rows*s);
+  }
+
+  /** \brief Returns the level 0 image, or an upsampled version of the base level image if level 0 is not stored (e.g. for drawing).
+   *
+   *   @param img - Output image.
+   */
+  void getLevelZeroImage(cv::Mat& img) const{
+    if(baseLevel_ == 0){
+      img = imgs_[0];
+    } else {
+      cv::resize(imgs_[baseLevel_],img,getLevelZeroSize(),0,0,cv::INTER_NEAREST);
+    }
+  }
+
   /** \brief Copies the image pyramid.
    */
   ImagePyramid<n_levels>& operator=(const ImagePyramid<n_levels> &rhs) {
@@ -101,6 +220,7 @@ class ImagePyramid{
       rhs.imgs_[i].copyTo(imgs_[i]);
       centers_[i] = rhs.centers_[i];
     }
+    baseLevel_ = rhs.baseLevel_;
     return *this;
   }
 
@@ -117,7 +237,7 @@ class ImagePyramid{
     assert(l1<n_levels && l2<n_levels && l1>=0 && l2>=0);
 
     FeatureCoordinates cOut;
-    cOut.set_c((centers_[l1]-centers_[l2])*pow(0.5,l2)+cIn.get_c()*pow(0.5,l2-l1));
+    cOut.set_c((centers_[l1]-centers_[l2])*LevelScales<n_levels>::down(l2)+cIn.get_c()*LevelScales<n_levels>::transform(l1,l2));
     if(cIn.mpCamera_ != nullptr){
       if(cIn.com_warp_c()){
         cOut.set_warp_c(cIn.get_warp_c());
@@ -128,6 +248,24 @@ class ImagePyramid{
     return cOut;
   }
 
+  /** \brief Transforms pixel coordinates between two pyramid levels (lightweight version).
+   *
+   * @param cIn        - Input coordinates
+   * @param l1         - Input pyramid level.
+   * @param l2         - Output pyramid level.
+   * @return the corresponding pixel coordinates on pyramid level l2, the warping is kept.
+   */
+  PixelCoordinates levelTranformCoordinates(const PixelCoordinates& cIn, const int l1, const int l2) const{
+    assert(l1<n_levels && l2<n_levels && l1>=0 && l2>=0);
+
+    const float s2 = LevelScales<n_levels>::down(l2);
+    const float s12 = LevelScales<n_levels>::transform(l1,l2);
+    PixelCoordinates cOut = cIn;
+    cOut.x_ = (centers_[l1].x-centers_[l2].x)*s2 + cIn.x_*s12;
+    cOut.y_ = (centers_[l1].y-centers_[l2].y)*s2 + cIn.y_*s12;
+    return cOut;
+  }
+
   /** \brief Extract FastCorner coordinates
    *
    * @param candidates         - List of the extracted corner coordinates (defined on pyramid level 0).
@@ -161,6 +299,25 @@ class ImagePyramid{
               levelTranformCoordinates(FeatureCoordinates(cv::Point2f(it->pt.x, it->pt.y)),l,0));
     }
   }
+
+ private:
+  /** \brief Computes the image and center of level i from the image of level i-1.
+   *
+   *   @param imgIn - Image of level i-1.
+   *   @param i     - Pyramid level to compute.
+   *   @param useCv - Set to true, if opencv (cv::pyrDown) should be used.
+   */
+  void computeLevel(const cv::Mat& imgIn, const int i, const bool useCv){
+    if(!useCv){
+      halfSample(imgIn,imgs_[i]);
+      centers_[i].x = centers_[i-1].x-0.25f*LevelScales<n_levels>::up(i)*(float)(imgIn.rows%2);
+      centers_[i].y = centers_[i-1].y-0.25f*LevelScales<n_levels>::up(i)*(float)(imgIn.cols%2);
+    } else {
+      cv::pyrDown(imgIn,imgs_[i],cv::Size(imgIn.cols/2, imgIn.rows/2));
+      centers_[i].x = centers_[i-1].x-0.25f*LevelScales<n_levels>::up(i)*(float)((imgIn.rows%2)+1);
+      centers_[i].y = centers_[i-1].y-0.25f*LevelScales<n_levels>::up(i)*(float)((imgIn.cols%2)+1);
+    }
+  }
 };
 
 }
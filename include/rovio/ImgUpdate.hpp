@@ -39,6 +39,9 @@
 #include "rovio/CoordinateTransform/PixelOutput.hpp"
 #include "rovio/ZeroVelocityUpdate.hpp"
 #include "rovio/MultilevelPatchAlignment.hpp"
+#include "rovio/QuantizedPatch.hpp"
+#include "rovio/FeatureTriangulation.hpp"
+#include "rovio/ComputeBudgetController.hpp"
 
 namespace rovio {
 
@@ -174,6 +177,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   using Base::successfulUpdate_;
   using Base::cancelIteration_;
   using Base::candidateCounter_;
+  using Base::maxNumIteration_;
   typedef typename Base::mtState mtState;
   typedef typename Base::mtFilterState mtFilterState;
   typedef typename Base::mtInnovation mtInnovation;
@@ -189,6 +193,8 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   double initDepth_;
   int startLevel_;
   int endLevel_;
+  int pyramidBaseLevel_; /**<Lowest pyramid level which is stored, levels below are only computed as intermediate results.*/
+  int inputDownscaleLevel_; /**<Pyramid level of the input images if they are already downscaled (e.g. by hardware binning), 0 for full resolution.*/
   double startDetectionTh_;
   int nDetectionBuckets_;
   int fastDetectionThreshold_;
@@ -204,6 +210,12 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   double rateOfMovingFeaturesTh_; /**<What percentage of feature must be moving for image motion detection*/
   double pixelCoordinateMotionTh_; /**<Threshold for detecting feature motion*/
   int minFeatureCountForNoMotionDetection_; /**<Minimum amount of feature for detecting NO image motion*/
+  bool useQuantizedPatchesForMotionDetection_; /**<Compare the feature patches of the previous and current image in fixed point*/
+  bool doStaticPrePass_; /**<Detect static frames on the coarsest pyramid level before the per-feature processing*/
+  double staticPrePassTh_; /**<Threshold on the mean absolute intensity difference of the coarsest level for static frames*/
+  int staticPrePassStep_; /**<Pixel step of the sampling grid on the coarsest level*/
+  bool isStaticFrame_; /**<Whether the current frame was detected as static by the pre-pass*/
+  bool skipFeatureUpdates_; /**<Whether the feature updates of the current frame are skipped (static frame with zero velocity update)*/
   double removalFactor_; /**<Factor for enforcing feature removal if not enough free*/
   double patchRejectionTh_;
   bool useDirectMethod_;  /**<If true, the innovation term is based directly on pixel intensity errors.
@@ -224,6 +236,13 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   int alignMaxUniSample_;
   bool useCrossCameraMeasurements_; /**<Should features be matched across cameras.*/
   bool doStereoInitialization_; /**<Should a stereo match be used for feature initialization.*/
+  double triangulationPixelSigma_; /**<Pixel standard deviation used for computing the depth uncertainty of triangulated features.*/
+  bool doTemporalInitialization_; /**<Should features, which could not be initialized by stereo, be triangulated between their detection and a later frame.*/
+  ComputeBudgetController budgetController_; /**<Keeps the image update within a per-frame time budget.*/
+  int configuredMaxNumIteration_; /**<Configured maximal number of IEKF iterations (registered as "maxNumIteration"), maxNumIteration_ holds the per-frame limit.*/
+  double featurePriority_[mtState::nMax_]; /**<Priority of the features for the current frame (bearing uncertainty).*/
+  int featurePriorityRank_[mtState::nMax_]; /**<Rank of the features for the current frame (0 for highest priority).*/
+  int featureOrder_[mtState::nMax_]; /**<Temporary for computing the ranks.*/
   double alignmentHuberNormThreshold_; /**<Intensity error threshold for Huber norm.*/
   double alignmentGaussianWeightingSigma_; /**<Width of Gaussian which is used for pixel error weighting.*/
   double alignmentGradientExponent_; /**<Exponent used for gradient based weighting of residuals.*/
@@ -241,6 +260,8 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   mutable MXD featureOutputJac_;
   mutable MultilevelPatch<mtState::nLevels_,mtState::patchSize_> mlpTemp1_;
   mutable MultilevelPatch<mtState::nLevels_,mtState::patchSize_> mlpTemp2_;
+  mutable QuantizedMultilevelPatch<mtState::nLevels_,mtState::patchSize_> qmlpTemp1_;
+  mutable QuantizedMultilevelPatch<mtState::nLevels_,mtState::patchSize_> qmlpTemp2_;
   mutable FeatureCoordinates alignedCoordinates_;
   mutable FeatureCoordinates tempCoordinates_;
   mutable FeatureCoordinatesVec candidates_;
@@ -255,116 +276,14 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   mutable Eigen::EigenSolver<Eigen::MatrixXd> candidateGenerationES_;
 
   mutable MultilevelPatchAlignment<mtState::nLevels_,mtState::patchSize_> alignment_; /**<Patch aligner*/
+  FeatureTriangulation triangulation_; /**<Two-view triangulation with depth uncertainty*/
   mutable cv::Mat drawImg_; /**<Image currently used for drawing*/
 
   /** \brief Constructor.
    *
    *   Loads and sets the needed parameters.
    */
-  ImgUpdate(): transformFeatureOutputCT_(nullptr),
-      pixelOutputCov_((int)(PixelOutput::D_),(int)(PixelOutput::D_)),
-      featureOutputCov_((int)(FeatureOutput::D_),(int)(FeatureOutput::D_)),
-      featureOutputJac_((int)(FeatureOutput::D_),(int)(mtState::D_)),
-      canditateGenerationH_(2,(int)(mtState::D_)),
-      canditateGenerationDifVec_((int)(mtState::D_),1),
-      canditateGenerationPy_(2,2){
-    mpMultiCamera_ = nullptr;
-    initCovFeature_.setIdentity();
-    initDepth_ = 0.5;
-    startLevel_ = 3;
-    endLevel_ = 1;
-    startDetectionTh_ = 0.9;
-    nDetectionBuckets_ = 100;
-    fastDetectionThreshold_ = 10;
-    scoreDetectionExponent_ = 0.5;
-    penaltyDistance_ = 20;
-    zeroDistancePenalty_ = nDetectionBuckets_*1.0;
-    useDirectMethod_ = true;
-    doFrameVisualisation_ = true;
-    visualizePatches_ = false;
-    verbose_ = false;
-    trackingUpperBound_ = 0.9;
-    trackingLowerBound_ = 0.1;
-    minTrackedAndFreeFeatures_ = 0.5;
-    minRelativeSTScore_ = 0.2;
-    minAbsoluteSTScore_ = 0.2;
-    minTimeBetweenPatchUpdate_ = 1.0;
-    patchRejectionTh_ = 10.0;
-    removeNegativeFeatureAfterUpdate_ = true;
-    doVisualMotionDetection_ = false;
-    rateOfMovingFeaturesTh_ = 0.5;
-    pixelCoordinateMotionTh_ = 1.0;
-    minFeatureCountForNoMotionDetection_ = 5;
-    minTimeForZeroVelocityUpdate_ = 1.0;
-    maxUncertaintyToDepthRatioForDepthInitialization_ = 0.3;
-    updateNoisePix_ = 2;
-    updateNoiseInt_ = 10000;
-    noiseGainForOffCamera_ = 4.0;
-    alignConvergencePixelRange_ = 1.0;
-    alignCoverageRatio_ = 2.0;
-    alignMaxUniSample_ = 5;
-    useCrossCameraMeasurements_ = true;
-    doStereoInitialization_ = true;
-    removalFactor_ = 1.1;
-    alignmentGaussianWeightingSigma_ = 2.0;
-    discriminativeSamplingDistance_ = 0.0;
-    discriminativeSamplingGain_ = 0.0;
-    doubleRegister_.registerDiagonalMatrix("initCovFeature",initCovFeature_);
-    doubleRegister_.registerScalar("initDepth",initDepth_);
-    doubleRegister_.registerScalar("startDetectionTh",startDetectionTh_);
-    doubleRegister_.registerScalar("scoreDetectionExponent",scoreDetectionExponent_);
-    doubleRegister_.registerScalar("penaltyDistance",penaltyDistance_);
-    doubleRegister_.registerScalar("zeroDistancePenalty",zeroDistancePenalty_);
-    doubleRegister_.registerScalar("trackingUpperBound",trackingUpperBound_);
-    doubleRegister_.registerScalar("trackingLowerBound",trackingLowerBound_);
-    doubleRegister_.registerScalar("minTrackedAndFreeFeatures",minTrackedAndFreeFeatures_);
-    doubleRegister_.registerScalar("minRelativeSTScore",minRelativeSTScore_);
-    doubleRegister_.registerScalar("minAbsoluteSTScore",minAbsoluteSTScore_);
-    doubleRegister_.registerScalar("minTimeBetweenPatchUpdate",minTimeBetweenPatchUpdate_);
-    doubleRegister_.registerScalar("patchRejectionTh",patchRejectionTh_);
-    doubleRegister_.registerScalar("MotionDetection.rateOfMovingFeaturesTh",rateOfMovingFeaturesTh_);
-    doubleRegister_.registerScalar("MotionDetection.pixelCoordinateMotionTh",pixelCoordinateMotionTh_);
-    doubleRegister_.registerScalar("maxUncertaintyToDepthRatioForDepthInitialization",maxUncertaintyToDepthRatioForDepthInitialization_);
-    doubleRegister_.registerScalar("alignConvergencePixelRange",alignConvergencePixelRange_);
-    doubleRegister_.registerScalar("alignCoverageRatio",alignCoverageRatio_);
-    doubleRegister_.registerScalar("removalFactor",removalFactor_);
-    doubleRegister_.registerScalar("discriminativeSamplingDistance",discriminativeSamplingDistance_);
-    doubleRegister_.registerScalar("discriminativeSamplingGain",discriminativeSamplingGain_);
-    intRegister_.registerScalar("fastDetectionThreshold",fastDetectionThreshold_);
-    intRegister_.registerScalar("startLevel",startLevel_);
-    intRegister_.registerScalar("endLevel",endLevel_);
-    intRegister_.registerScalar("nDetectionBuckets",nDetectionBuckets_);
-    intRegister_.registerScalar("MotionDetection.minFeatureCountForNoMotionDetection",minFeatureCountForNoMotionDetection_);
-    intRegister_.registerScalar("alignMaxUniSample",alignMaxUniSample_);
-    boolRegister_.registerScalar("MotionDetection.isEnabled",doVisualMotionDetection_);
-    boolRegister_.registerScalar("useDirectMethod",useDirectMethod_);
-    boolRegister_.registerScalar("doFrameVisualisation",doFrameVisualisation_);
-    boolRegister_.registerScalar("visualizePatches",visualizePatches_);
-    boolRegister_.registerScalar("removeNegativeFeatureAfterUpdate",removeNegativeFeatureAfterUpdate_);
-    boolRegister_.registerScalar("useCrossCameraMeasurements",useCrossCameraMeasurements_);
-    boolRegister_.registerScalar("doStereoInitialization",doStereoInitialization_);
-    boolRegister_.registerScalar("useIntensityOffsetForAlignment",alignment_.useIntensityOffset_);
-    boolRegister_.registerScalar("useIntensitySqewForAlignment",alignment_.useIntensitySqew_);
-    doubleRegister_.removeScalarByVar(updnoiP_(0,0));
-    doubleRegister_.removeScalarByVar(updnoiP_(1,1));
-    doubleRegister_.registerScalar("UpdateNoise.pix",updateNoisePix_);
-    doubleRegister_.registerScalar("UpdateNoise.int",updateNoiseInt_);
-    doubleRegister_.registerScalar("noiseGainForOffCamera",noiseGainForOffCamera_);
-    useImprovedJacobian_ = false; // TODO: adapt/test
-    isZeroVelocityUpdateEnabled_ = false;
-    Base::PropertyHandler::registerSubHandler("ZeroVelocityUpdate",zeroVelocityUpdate_);
-    zeroVelocityUpdate_.outlierDetection_.registerToPropertyHandler(&zeroVelocityUpdate_,"MahalanobisTh");
-    zeroVelocityUpdate_.doubleRegister_.registerScalar("minNoMotionTime",minTimeForZeroVelocityUpdate_);
-    zeroVelocityUpdate_.boolRegister_.registerScalar("isEnabled",isZeroVelocityUpdateEnabled_);
-    doubleRegister_.removeScalarByStr("alpha");
-    doubleRegister_.removeScalarByStr("beta");
-    doubleRegister_.removeScalarByStr("kappa");
-    alignmentHuberNormThreshold_ = static_cast<double>(alignment_.huberNormThreshold_);
-    doubleRegister_.registerScalar("alignmentHuberNormThreshold",alignmentHuberNormThreshold_);
-    doubleRegister_.registerScalar("alignmentGaussianWeightingSigma",alignmentGaussianWeightingSigma_);
-    alignmentGradientExponent_ = static_cast<double>(alignment_.gradientExponent_);
-    doubleRegister_.registerScalar("alignmentGradientExponent",alignmentGradientExponent_);
-  };
+  ImgUpdate();
 
   /** \brief Destructor
    */
@@ -372,19 +291,26 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
 
   /** \brief Refresh the properties of the property handler
    */
-  void refreshProperties(){
-    if(isZeroVelocityUpdateEnabled_) assert(doVisualMotionDetection_);
-    if(useDirectMethod_){
-      updnoiP_.setIdentity();
-      updnoiP_ = updnoiP_*updateNoiseInt_;
+  void refreshProperties();
+
+  /** \brief Returns the lowest pyramid level which holds an image (maximum of \ref pyramidBaseLevel_ and \ref inputDownscaleLevel_).
+   */
+  int getPyramidBaseLevel() const{
+    return std::max(pyramidBaseLevel_,inputDownscaleLevel_);
+  }
+
+  /** \brief Computes the image pyramid of an input image, according to \ref pyramidBaseLevel_ and \ref inputDownscaleLevel_.
+   *
+   *  @param pyr - Image pyramid.
+   *  @param img - Input image.
+   */
+  void computePyramid(ImagePyramid<mtState::nLevels_>& pyr, const cv::Mat& img) const{
+    if(inputDownscaleLevel_ > 0){
+      pyr.computeFromDownscaledImage(img,inputDownscaleLevel_,true);
     } else {
-      updnoiP_.setIdentity();
-      updnoiP_ = updnoiP_*updateNoisePix_;
+      pyr.computeFromImage(img,true,pyramidBaseLevel_);
     }
-    alignment_.huberNormThreshold_ = static_cast<float>(alignmentHuberNormThreshold_);
-    alignment_.computeWeightings(alignmentGaussianWeightingSigma_);
-    alignment_.gradientExponent_ = static_cast<float>(alignmentGradientExponent_);
-  };
+  }
 
   /** \brief Sets the multicamera pointer
    *
@@ -403,138 +329,11 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
    *  @param state        - Filter %State.
    *  @param noise        - Additive discrete Gaussian noise.
    */
-  void evalInnovation(mtInnovation& y, const mtState& state, const mtNoise& noise) const{
-    const int& ID = state.aux().activeFeature_;
-    const int& camID = state.CfP(ID).camID_;
-    const int activeCamID = (state.aux().activeCameraCounter_ + camID)%mtState::nCam_;
-    transformFeatureOutputCT_.setFeatureID(ID);
-    transformFeatureOutputCT_.setOutputCameraID(activeCamID);
-    transformFeatureOutputCT_.transformState(state,featureOutput_);
-
-    if(useDirectMethod_){
-      if(doFrameVisualisation_ && featureOutput_.c().com_c()){
-        if(activeCamID==camID){
-          featureOutput_.c().drawPoint(drawImg_, cv::Scalar(0,175,175));
-        } else {
-          featureOutput_.c().drawPoint(drawImg_, cv::Scalar(175,175,0));
-        }
-      }
-      if(alignment_.getLinearAlignEquationsReduced(meas_.aux().pyr_[activeCamID],*state.aux().mpCurrentFeature_->mpMultilevelPatch_,featureOutput_.c(),endLevel_,startLevel_,A_red_,b_red_)){
-        y.template get<mtInnovation::_pix>() = b_red_ + noise.template get<mtNoise::_pix>();
-        if(verbose_){
-          std::cout << "    \033[32mMaking update with feature " << ID << " from camera " << camID << " in camera " << activeCamID << "\033[0m" << std::endl;
-        }
-      } else {
-        y.template get<mtInnovation::_pix>() = noise.template get<mtNoise::_pix>();
-        if(verbose_){
-          std::cout << "    \033[31mFailed Construction of Alignment Equations with feature " << ID << " from camera " << camID << " in camera " << activeCamID << "\033[0m" << std::endl;
-        }
-        cancelIteration_ = true;
-      }
-    } else {
-      Eigen::Vector2d pixError;
-      pixError(0) = static_cast<double>(state.aux().feaCoorMeas_[ID].get_c().x - featureOutput_.c().get_c().x);
-      pixError(1) = static_cast<double>(state.aux().feaCoorMeas_[ID].get_c().y - featureOutput_.c().get_c().y);
-      y.template get<mtInnovation::_pix>() = pixError+noise.template get<mtNoise::_pix>();
-    }
-  }
-
-  bool generateCandidates(const mtFilterState& filterState, mtState& candidate) const{
-    candidate = filterState.state_;
+  void evalInnovation(mtInnovation& y, const mtState& state, const mtNoise& noise) const;
 
-    if(candidateCounter_ == 0){
-      const int& ID = candidate.aux().activeFeature_;
-      const int& camID = candidate.CfP(ID).camID_;
-      const int activeCamID = (candidate.aux().activeCameraCounter_ + camID)%mtState::nCam_;
-      transformFeatureOutputCT_.setFeatureID(ID);
-      transformFeatureOutputCT_.setOutputCameraID(activeCamID);
-      transformFeatureOutputCT_.transformState(candidate,featureOutput_);
-      transformFeatureOutputCT_.jacTransform(featureOutputJac_,candidate);
-      mpMultiCamera_->cameras_[activeCamID].bearingToPixel(featureOutput_.c().get_nor(),c_temp_,c_J_);
+  bool generateCandidates(const mtFilterState& filterState, mtState& candidate) const;
 
-      canditateGenerationH_  = -c_J_*featureOutputJac_.template block<2,mtState::D_>(0,0);
-      canditateGenerationPy_ = canditateGenerationH_*filterState.cov_*canditateGenerationH_.transpose();
-      candidateGenerationES_.compute(canditateGenerationPy_);
-    }
-
-    while(++candidateCounter_){
-      int u = (candidateCounter_-1)/(2*alignMaxUniSample_+1)-alignMaxUniSample_;
-      if(u>alignMaxUniSample_)
-        break;
-      int v = (candidateCounter_-1)%(2*alignMaxUniSample_+1)-alignMaxUniSample_;
-      if(pow(u*alignConvergencePixelRange_,2)/candidateGenerationES_.eigenvalues()(0).real()
-          + pow(v*alignConvergencePixelRange_,2)/candidateGenerationES_.eigenvalues()(1).real() < pow(alignCoverageRatio_,2)){
-        Eigen::Vector2d dy = u*alignConvergencePixelRange_*candidateGenerationES_.eigenvectors().col(0).real()
-            + v*alignConvergencePixelRange_*candidateGenerationES_.eigenvectors().col(1).real();
-        canditateGenerationDifVec_ = -filterState.cov_*canditateGenerationH_.transpose()*canditateGenerationPy_.inverse()*dy;
-        candidate.boxPlus(canditateGenerationDifVec_,candidate);
-        return true;
-      }
-    }
-    return false;
-  }
-
-  bool extraOutlierCheck(const mtState& state) const{
-    const int& ID = state.aux().activeFeature_;
-    const int& camID = state.CfP(ID).camID_;
-    const int activeCamID = (state.aux().activeCameraCounter_ + camID)%mtState::nCam_;
-    transformFeatureOutputCT_.setFeatureID(ID);
-    transformFeatureOutputCT_.setOutputCameraID(activeCamID);
-    transformFeatureOutputCT_.transformState(state,featureOutput_);
-
-    if(!hasConverged_){
-      if(verbose_) std::cout << "    \033[31mREJECTED (iterations did no converge)\033[0m" << std::endl;
-      if(mlpTemp1_.isMultilevelPatchInFrame(meas_.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false)){
-        featureOutput_.c().drawPoint(drawImg_, cv::Scalar(255,0,0),1.0);
-      }
-      return false;
-    }
-
-    if(patchRejectionTh_ >= 0){
-      if(!mlpTemp1_.isMultilevelPatchInFrame(meas_.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false)){
-        if(verbose_) std::cout << "    \033[31mREJECTED (not in frame)\033[0m" << std::endl;
-        return false;
-      }
-      mlpTemp1_.extractMultilevelPatchFromImage(meas_.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false);
-      const float avgError = mlpTemp1_.computeAverageDifference(*state.aux().mpCurrentFeature_->mpMultilevelPatch_,endLevel_,startLevel_);
-      if(avgError > patchRejectionTh_){
-        if(verbose_) std::cout << "    \033[31mREJECTED (error too large: " << avgError << ")\033[0m" << std::endl;
-        featureOutput_.c().drawPoint(drawImg_, cv::Scalar(255,255,0),1.0);
-        return false;
-      }
-
-      // Use 4 sample around feature, at least two should be above the treshold
-      if(discriminativeSamplingDistance_ > 0.0){
-        FeatureOutput sample;
-        V3D d;
-        int countAboveThreshold = 0;
-        for(int i=0;i<4;i++){
-          d.setZero();
-          d(i%2) = (i/2*2-1)*discriminativeSamplingDistance_;
-          featureOutput_.boxPlus(d,sample);
-          if(mlpTemp1_.isMultilevelPatchInFrame(meas_.aux().pyr_[activeCamID],sample.c(),startLevel_,false)){
-            mlpTemp1_.extractMultilevelPatchFromImage(meas_.aux().pyr_[activeCamID],sample.c(),startLevel_,false);
-            const float sampleError = mlpTemp1_.computeAverageDifference(*state.aux().mpCurrentFeature_->mpMultilevelPatch_,endLevel_,startLevel_);
-            const bool isAboveThreshold = (discriminativeSamplingGain_ <= 1.0 & sampleError > patchRejectionTh_)
-                | (discriminativeSamplingGain_ > 1.0 & sampleError > discriminativeSamplingGain_*avgError);
-            countAboveThreshold += isAboveThreshold;
-            if(isAboveThreshold){
-              sample.c().drawPoint(drawImg_, cv::Scalar(0,255,0),2.0);
-            } else {
-              sample.c().drawPoint(drawImg_, cv::Scalar(0,0,255),2.0);
-            }
-          }
-        }
-        if(countAboveThreshold < 2){
-          if(verbose_) std::cout << "    \033[31mREJECTED (feature location not discriminative enough)\033[0m" << std::endl;
-          return false;
-        }
-      }
-    }
-
-    featureOutput_.c().drawPoint(drawImg_, cv::Scalar(0,0,255),1.0);
-    return true;
-  }
+  bool extraOutlierCheck(const mtState& state) const;
 
   /** \brief Computes the Jacobian for the update step of the filter.
    *
@@ -543,29 +342,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
    *  @param F     - Jacobian for the update step of the filter.
    *  @param state - Filter state.
    */
-  void jacState(MXD& F, const mtState& state) const{
-    const int& ID = state.aux().activeFeature_;
-    const int& camID = state.CfP(ID).camID_;
-    const int activeCamID = (state.aux().activeCameraCounter_ + camID)%mtState::nCam_;
-    transformFeatureOutputCT_.setFeatureID(ID);
-    transformFeatureOutputCT_.setOutputCameraID(activeCamID);
-    transformFeatureOutputCT_.transformState(state,featureOutput_);
-
-    if(useDirectMethod_){
-      if(alignment_.getLinearAlignEquationsReduced(meas_.aux().pyr_[activeCamID],*state.aux().mpCurrentFeature_->mpMultilevelPatch_,featureOutput_.c(),endLevel_,startLevel_,A_red_,b_red_)){
-        transformFeatureOutputCT_.jacTransform(featureOutputJac_,state);
-        mpMultiCamera_->cameras_[activeCamID].bearingToPixel(featureOutput_.c().get_nor(),c_temp_,c_J_);
-        F = -A_red_*c_J_*featureOutputJac_.template block<2,mtState::D_>(0,0);
-      } else {
-        F.setZero();
-        cancelIteration_ = true;
-      }
-    } else {
-      transformFeatureOutputCT_.jacTransform(featureOutputJac_,state);
-      mpMultiCamera_->cameras_[activeCamID].bearingToPixel(featureOutput_.c().get_nor(),c_temp_,c_J_);
-      F = -c_J_*featureOutputJac_.template block<2,mtState::D_>(0,0);
-    }
-  }
+  void jacState(MXD& F, const mtState& state) const;
 
   /** \brief Computes the Jacobian for the update step of the filter.
    *
@@ -583,50 +360,15 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
    *   @param meas        - Update measurement.
    *   @todo sort feature by covariance and use more accurate ones first
    */
-  void commonPreProcess(mtFilterState& filterState, const mtMeas& meas){
-    assert(filterState.t_ == meas.aux().imgTime_);
-    for(int i=0;i<mtState::nCam_;i++){
-      if(doFrameVisualisation_){
-        cvtColor(meas.aux().pyr_[i].imgs_[0], filterState.img_[i], CV_GRAY2RGB);
-      }
-    }
-    filterState.imgTime_ = filterState.t_;
-    filterState.imageCounter_++;
-    if(visualizePatches_){
-      filterState.patchDrawing_ = cv::Mat::zeros(mtState::nMax_*filterState.drawPS_,(1+2*mtState::nCam_)*filterState.drawPS_,CV_8UC3);
-    }
-    filterState.state_.aux().activeFeature_ = 0;
-    filterState.state_.aux().activeCameraCounter_ = 0;
-
-
-    /* Detect Image changes by looking at the feature patches between current and previous image (both at the current feature location)
-     * The maximum change of intensity is obtained if the pixel is moved along the strongest gradient.
-     * The maximal singularvalue, which is equivalent to the root of the larger eigenvalue of the Hessian,
-     * gives us range in which intensity change is allowed to be.
-     */
-    if(doVisualMotionDetection_ && filterState.imageCounter_>1){
-      int totCountInFrame = 0;
-      int totCountInMotion = 0;
-      for(unsigned int i=0;i<mtState::nMax_;i++){
-        if(filterState.fsm_.isValid_[i]){
-          const int& camID = filterState.state_.CfP(i).camID_;   // Camera ID of the feature.
-          tempCoordinates_ = *filterState.fsm_.features_[i].mpCoordinates_;
-          tempCoordinates_.set_warp_identity();
-          if(mlpTemp1_.isMultilevelPatchInFrame(filterState.prevPyr_[camID],tempCoordinates_,startLevel_,true)){
-            mlpTemp1_.extractMultilevelPatchFromImage(filterState.prevPyr_[camID],tempCoordinates_,startLevel_,true);
-            mlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
-            mlpTemp2_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true);
-            const float avgError = mlpTemp1_.computeAverageDifference(mlpTemp2_,endLevel_,startLevel_);
-            if(avgError/std::sqrt(mlpTemp1_.e1_) > static_cast<float>(pixelCoordinateMotionTh_)) totCountInMotion++;
-            totCountInFrame++;
-          }
-        }
-      }
-      if(rateOfMovingFeaturesTh_/totCountInMotion*totCountInFrame < 1.0 || totCountInFrame < minFeatureCountForNoMotionDetection_){
-        filterState.state_.aux().timeSinceLastImageMotion_ = 0.0;
-      }
-    }
-  }
+  void commonPreProcess(mtFilterState& filterState, const mtMeas& meas);
+
+  /** \brief Computes the mean absolute intensity difference between two image pyramids on a sparse grid of the coarsest level.
+   *
+   *  @param pyr1 - First image pyramid.
+   *  @param pyr2 - Second image pyramid.
+   *  @return the mean absolute difference, negative if the images can not be compared.
+   */
+  float computeCoarseImageDifference(const ImagePyramid<mtState::nLevels_>& pyr1, const ImagePyramid<mtState::nLevels_>& pyr2) const;
 
   /** \brief Pre-Processing for the image update.
    *
@@ -642,130 +384,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
    *  @param isFinished  - True, if process has finished.
    *  @todo split into methods
    */
-  void preProcess(mtFilterState& filterState, const mtMeas& meas, bool& isFinished){
-    if(isFinished){ // gets called if this is the first call
-      commonPreProcess(filterState,meas);
-      isFinished = false;
-    }
-    bool foundValidMeasurement = false;
-    typename mtFilterState::mtState& state = filterState.state_;
-    MXD& cov = filterState.cov_;
-    int& ID = filterState.state_.aux().activeFeature_;   // ID of the current updated feature!!! Initially set to 0.
-    int& activeCamCounter = filterState.state_.aux().activeCameraCounter_;
-
-    // Actualize camera extrinsics (gets also update in calls to TransformFeatureOutputCT)
-    state.updateMultiCameraExtrinsics(mpMultiCamera_);
-
-    while(ID < mtState::nMax_ && foundValidMeasurement == false){
-      if(filterState.fsm_.isValid_[ID]){
-        // Data handling stuff
-        FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[ID];
-        const int camID = f.mpCoordinates_->camID_;
-        const int activeCamID = (activeCamCounter + camID)%mtState::nCam_;
-        drawImg_ = filterState.img_[activeCamID];
-        if(activeCamCounter==0){
-          f.mpStatistics_->increaseStatistics(filterState.t_);
-          if(verbose_){
-            std::cout << "=========== Feature " << f.idx_ << " ==================================================== " << std::endl;
-          }
-          // Visualize patch tracking
-          if(visualizePatches_){
-            f.mpMultilevelPatch_->drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(2,filterState.drawPB_+ID*filterState.drawPS_),1,false);
-            cv::putText(filterState.patchDrawing_,std::to_string(f.idx_),cv::Point2i(2,10+ID*filterState.drawPS_),cv::FONT_HERSHEY_SIMPLEX, 0.4, cv::Scalar(255,255,255));
-          }
-          f.log_prediction_ = *f.mpCoordinates_;
-        }
-        if(verbose_){
-          std::cout << "  ========== Camera  " << activeCamID << " ================= " << std::endl;
-          std::cout << "  Normal in feature frame: " << f.mpCoordinates_->get_nor().getVec().transpose() << std::endl;
-          std::cout << "  with depth: " << f.mpDistance_->getDistance() << std::endl;
-        }
-
-        // Get coordinates in target frame
-        transformFeatureOutputCT_.setFeatureID(ID);
-        transformFeatureOutputCT_.setOutputCameraID(activeCamID);
-        transformFeatureOutputCT_.transformState(state,featureOutput_);
-        transformFeatureOutputCT_.transformCovMat(state,cov,featureOutputCov_);
-        if(verbose_) std::cout << "    Normal in camera frame: " << featureOutput_.c().get_nor().getVec().transpose() << std::endl;
-
-        // Check if feature in target frame
-        if(!mlpTemp1_.isMultilevelPatchInFrame(filterState.prevPyr_[camID],featureOutput_.c(),startLevel_,false)){
-          f.mpStatistics_->status_[activeCamID] = NOT_IN_FRAME;
-          if(verbose_) std::cout << "    NOT in frame" << std::endl;
-        } else {
-          pixelOutputCT_.transformState(featureOutput_,pixelOutput_);
-          pixelOutputCT_.transformCovMat(featureOutput_,featureOutputCov_,pixelOutputCov_);
-          featureOutput_.c().setPixelCov(pixelOutputCov_);
-
-          // Visualization
-          if(doFrameVisualisation_){
-            if(activeCamID==camID){
-              featureOutput_.c().drawEllipse(drawImg_, cv::Scalar(0,175,175), 2.0, true);
-              featureOutput_.c().drawText(drawImg_,std::to_string(f.idx_),cv::Scalar(0,175,175));
-            } else {
-              featureOutput_.c().drawEllipse(drawImg_, cv::Scalar(175,175,0), 2.0, true);
-              featureOutput_.c().drawText(drawImg_,std::to_string(f.idx_),cv::Scalar(175,175,0));
-            }
-          }
-          if(visualizePatches_){
-            if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false)){
-              mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false);
-              mlpTemp1_.drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(filterState.drawPB_+(1+2*activeCamID)*filterState.drawPS_,filterState.drawPB_+ID*filterState.drawPS_),1,false);
-            }
-          }
-
-          if(useDirectMethod_){
-            if(verbose_) std::cout << "    Do direct update (without alignment)" << std::endl;
-            state.aux().mpCurrentFeature_ = &filterState.fsm_.features_[ID];
-            if(activeCamCounter==0){
-              updnoiP_.setIdentity();
-              updnoiP_ = updnoiP_*updateNoiseInt_;
-            } else {
-              updnoiP_.setIdentity();
-              updnoiP_ = updnoiP_*updateNoiseInt_*noiseGainForOffCamera_;
-            }
-            foundValidMeasurement = true;
-          } else {
-            if(alignment_.align2DAdaptive(alignedCoordinates_,meas.aux().pyr_[activeCamID],*f.mpMultilevelPatch_,featureOutput_.c(),startLevel_,endLevel_,
-                                          alignConvergencePixelRange_,alignCoverageRatio_,alignMaxUniSample_)){
-              if(verbose_) std::cout << "    Found match: " << alignedCoordinates_.get_nor().getVec().transpose() << std::endl;
-              if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],alignedCoordinates_,startLevel_,false)){
-                float avgError = 0.0;
-                if(patchRejectionTh_ >= 0){
-                  mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[activeCamID],alignedCoordinates_,startLevel_,false);
-                  avgError = mlpTemp1_.computeAverageDifference(*f.mpMultilevelPatch_,endLevel_,startLevel_);
-                }
-                if(patchRejectionTh_ >= 0 && avgError > patchRejectionTh_){
-                  f.mpStatistics_->status_[activeCamID] = FAILED_ALIGNEMENT;
-                  if(verbose_) std::cout << "    \033[31mREJECTED (error too large)\033[0m" << std::endl;
-                } else {
-                  if(doFrameVisualisation_) alignedCoordinates_.drawPoint(drawImg_, cv::Scalar(255,0,255));
-                  state.aux().feaCoorMeas_[ID] = alignedCoordinates_;
-                  foundValidMeasurement = true;
-                }
-              } else {
-                f.mpStatistics_->status_[activeCamID] = FAILED_ALIGNEMENT;
-                if(verbose_) std::cout << "    \033[31mNot in frame after alignment\033[0m" << std::endl;
-              }
-            } else {
-              f.mpStatistics_->status_[activeCamID] = FAILED_ALIGNEMENT;
-              if(verbose_) std::cout << "    \033[31mNOT FOUND (matching failed)\033[0m" << std::endl;
-            }
-          }
-        }
-      }
-      if(foundValidMeasurement == false){
-        activeCamCounter++;
-        if(activeCamCounter == mtState::nCam_ || !useCrossCameraMeasurements_){
-          activeCamCounter = 0;
-          ID++;
-        }
-      }
-    }  // while end
-    if(ID >= mtState::nMax_){
-      isFinished = true;
-    }
-  };
+  void preProcess(mtFilterState& filterState, const mtMeas& meas, bool& isFinished);
 
   /** \brief Post-Processing for the image update.
    *
@@ -778,347 +397,977 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
    *  @param outlierDetection - Outlier detection.
    *  @param isFinished       - True, if process has finished.
    */
-  void postProcess(mtFilterState& filterState, const mtMeas& meas, const mtOutlierDetection& outlierDetection, bool& isFinished){
-    int& ID = filterState.state_.aux().activeFeature_;  // Get the ID of the updated feature.
-    int& activeCamCounter = filterState.state_.aux().activeCameraCounter_;
+  void postProcess(mtFilterState& filterState, const mtMeas& meas, const mtOutlierDetection& outlierDetection, bool& isFinished);
+
+  /** \brief Final Post-Processing step for the image update.
+   *
+   *  Summary:
+   *  1. For each feature in the state: Extract patches and compute Shi-Tomasi Score.
+   *  2. Removal of bad features from the state.
+   *  3. Get new features and add them to the state.
+   *
+   *  @param filterState      - Filter state.
+   *  @param meas             - Update measurement.
+   */
+  void commonPostProcess(mtFilterState& filterState, const mtMeas& meas);
+
+  /** \brief Performs the zero velocity update if the image and the IMU did not show motion for long enough.
+   *
+   *  @param filterState - Filter state.
+   */
+  void performZeroVelocityUpdate(mtFilterState& filterState){
+    if(isZeroVelocityUpdateEnabled_
+        && doVisualMotionDetection_ && filterState.state_.aux().timeSinceLastImageMotion_ > minTimeForZeroVelocityUpdate_
+        && filterState.state_.aux().timeSinceLastInertialMotion_ > minTimeForZeroVelocityUpdate_){
+      cv::putText(filterState.img_[0],"Performing Zero Velocity Updates!",cv::Point2f(150,25),cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0,255,255));
+      zeroVelocityUpdate_.performUpdateEKF(filterState,ZeroVelocityUpdateMeas<mtState>());
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  /** \brief Draws a virtual horizon into the current image of the camera with ID camID
+   *
+   *  @param filterState - Filter state.
+   *  @param camID       - ID of the camera, in which image the horizon should be drawn.
+   */
+  void drawVirtualHorizon(mtFilterState& filterState, const int camID = 0);
+};
 
-    if(isFinished){
-      commonPostProcess(filterState,meas);
+template<typename FILTERSTATE>
+ImgUpdate<FILTERSTATE>::ImgUpdate(): transformFeatureOutputCT_(nullptr),
+    pixelOutputCov_((int)(PixelOutput::D_),(int)(PixelOutput::D_)),
+    featureOutputCov_((int)(FeatureOutput::D_),(int)(FeatureOutput::D_)),
+    featureOutputJac_((int)(FeatureOutput::D_),(int)(mtState::D_)),
+    canditateGenerationH_(2,(int)(mtState::D_)),
+    canditateGenerationDifVec_((int)(mtState::D_),1),
+    canditateGenerationPy_(2,2){
+  mpMultiCamera_ = nullptr;
+  initCovFeature_.setIdentity();
+  initDepth_ = 0.5;
+  startLevel_ = 3;
+  endLevel_ = 1;
+  startDetectionTh_ = 0.9;
+  nDetectionBuckets_ = 100;
+  fastDetectionThreshold_ = 10;
+  scoreDetectionExponent_ = 0.5;
+  penaltyDistance_ = 20;
+  zeroDistancePenalty_ = nDetectionBuckets_*1.0;
+  useDirectMethod_ = true;
+  doFrameVisualisation_ = true;
+  visualizePatches_ = false;
+  verbose_ = false;
+  trackingUpperBound_ = 0.9;
+  trackingLowerBound_ = 0.1;
+  minTrackedAndFreeFeatures_ = 0.5;
+  minRelativeSTScore_ = 0.2;
+  minAbsoluteSTScore_ = 0.2;
+  minTimeBetweenPatchUpdate_ = 1.0;
+  patchRejectionTh_ = 10.0;
+  removeNegativeFeatureAfterUpdate_ = true;
+  doVisualMotionDetection_ = false;
+  rateOfMovingFeaturesTh_ = 0.5;
+  pixelCoordinateMotionTh_ = 1.0;
+  minFeatureCountForNoMotionDetection_ = 5;
+  useQuantizedPatchesForMotionDetection_ = false;
+  doStaticPrePass_ = false;
+  staticPrePassTh_ = 2.0;
+  staticPrePassStep_ = 2;
+  isStaticFrame_ = false;
+  skipFeatureUpdates_ = false;
+  minTimeForZeroVelocityUpdate_ = 1.0;
+  maxUncertaintyToDepthRatioForDepthInitialization_ = 0.3;
+  updateNoisePix_ = 2;
+  updateNoiseInt_ = 10000;
+  noiseGainForOffCamera_ = 4.0;
+  alignConvergencePixelRange_ = 1.0;
+  alignCoverageRatio_ = 2.0;
+  alignMaxUniSample_ = 5;
+  useCrossCameraMeasurements_ = true;
+  doStereoInitialization_ = true;
+  triangulationPixelSigma_ = 1.0;
+  doTemporalInitialization_ = false;
+  triangulation_.minDistance_ = 0.01;
+  configuredMaxNumIteration_ = maxNumIteration_;
+  pyramidBaseLevel_ = 0;
+  inputDownscaleLevel_ = 0;
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    featurePriority_[i] = 0.0;
+    featurePriorityRank_[i] = 0;
+  }
+  removalFactor_ = 1.1;
+  alignmentGaussianWeightingSigma_ = 2.0;
+  discriminativeSamplingDistance_ = 0.0;
+  discriminativeSamplingGain_ = 0.0;
+  doubleRegister_.registerDiagonalMatrix("initCovFeature",initCovFeature_);
+  doubleRegister_.registerScalar("initDepth",initDepth_);
+  doubleRegister_.registerScalar("startDetectionTh",startDetectionTh_);
+  doubleRegister_.registerScalar("scoreDetectionExponent",scoreDetectionExponent_);
+  doubleRegister_.registerScalar("penaltyDistance",penaltyDistance_);
+  doubleRegister_.registerScalar("zeroDistancePenalty",zeroDistancePenalty_);
+  doubleRegister_.registerScalar("trackingUpperBound",trackingUpperBound_);
+  doubleRegister_.registerScalar("trackingLowerBound",trackingLowerBound_);
+  doubleRegister_.registerScalar("minTrackedAndFreeFeatures",minTrackedAndFreeFeatures_);
+  doubleRegister_.registerScalar("minRelativeSTScore",minRelativeSTScore_);
+  doubleRegister_.registerScalar("minAbsoluteSTScore",minAbsoluteSTScore_);
+  doubleRegister_.registerScalar("minTimeBetweenPatchUpdate",minTimeBetweenPatchUpdate_);
+  doubleRegister_.registerScalar("patchRejectionTh",patchRejectionTh_);
+  doubleRegister_.registerScalar("MotionDetection.rateOfMovingFeaturesTh",rateOfMovingFeaturesTh_);
+  doubleRegister_.registerScalar("MotionDetection.pixelCoordinateMotionTh",pixelCoordinateMotionTh_);
+  doubleRegister_.registerScalar("MotionDetection.staticPrePassTh",staticPrePassTh_);
+  doubleRegister_.registerScalar("maxUncertaintyToDepthRatioForDepthInitialization",maxUncertaintyToDepthRatioForDepthInitialization_);
+  doubleRegister_.registerScalar("alignConvergencePixelRange",alignConvergencePixelRange_);
+  doubleRegister_.registerScalar("alignCoverageRatio",alignCoverageRatio_);
+  doubleRegister_.registerScalar("removalFactor",removalFactor_);
+  doubleRegister_.registerScalar("discriminativeSamplingDistance",discriminativeSamplingDistance_);
+  doubleRegister_.registerScalar("discriminativeSamplingGain",discriminativeSamplingGain_);
+  doubleRegister_.registerScalar("triangulationPixelSigma",triangulationPixelSigma_);
+  doubleRegister_.registerScalar("ComputeBudget.frameBudget",budgetController_.frameBudget_);
+  doubleRegister_.registerScalar("ComputeBudget.detectionBudgetRatio",budgetController_.detectionBudgetRatio_);
+  doubleRegister_.registerScalar("ComputeBudget.loadFilterConstant",budgetController_.loadFilterConstant_);
+  intRegister_.registerScalar("ComputeBudget.maxConsecutiveDeferrals",budgetController_.maxConsecutiveDeferrals_);
+  intRegister_.registerScalar("ComputeBudget.minAlignMaxUniSample",budgetController_.minAlignMaxUniSample_);
+  intRegister_.registerScalar("ComputeBudget.minNumIteration",budgetController_.minNumIteration_);
+  intRegister_.registerScalar("ComputeBudget.minFeaturesOverBudget",budgetController_.minFeaturesOverBudget_);
+  intRegister_.registerScalar("fastDetectionThreshold",fastDetectionThreshold_);
+  intRegister_.registerScalar("startLevel",startLevel_);
+  intRegister_.registerScalar("endLevel",endLevel_);
+  intRegister_.registerScalar("pyramidBaseLevel",pyramidBaseLevel_);
+  intRegister_.registerScalar("inputDownscaleLevel",inputDownscaleLevel_);
+  intRegister_.registerScalar("nDetectionBuckets",nDetectionBuckets_);
+  intRegister_.registerScalar("MotionDetection.minFeatureCountForNoMotionDetection",minFeatureCountForNoMotionDetection_);
+  intRegister_.registerScalar("MotionDetection.staticPrePassStep",staticPrePassStep_);
+  intRegister_.registerScalar("alignMaxUniSample",alignMaxUniSample_);
+  intRegister_.removeScalarByStr("maxNumIteration");
+  intRegister_.registerScalar("maxNumIteration",configuredMaxNumIteration_);
+  boolRegister_.registerScalar("MotionDetection.isEnabled",doVisualMotionDetection_);
+  boolRegister_.registerScalar("MotionDetection.doStaticPrePass",doStaticPrePass_);
+  boolRegister_.registerScalar("MotionDetection.useQuantizedPatches",useQuantizedPatchesForMotionDetection_);
+  boolRegister_.registerScalar("useDirectMethod",useDirectMethod_);
+  boolRegister_.registerScalar("doFrameVisualisation",doFrameVisualisation_);
+  boolRegister_.registerScalar("visualizePatches",visualizePatches_);
+  boolRegister_.registerScalar("removeNegativeFeatureAfterUpdate",removeNegativeFeatureAfterUpdate_);
+  boolRegister_.registerScalar("useCrossCameraMeasurements",useCrossCameraMeasurements_);
+  boolRegister_.registerScalar("doStereoInitialization",doStereoInitialization_);
+  boolRegister_.registerScalar("doTemporalInitialization",doTemporalInitialization_);
+  boolRegister_.registerScalar("useIntensityOffsetForAlignment",alignment_.useIntensityOffset_);
+  boolRegister_.registerScalar("useIntensitySqewForAlignment",alignment_.useIntensitySqew_);
+  doubleRegister_.removeScalarByVar(updnoiP_(0,0));
+  doubleRegister_.removeScalarByVar(updnoiP_(1,1));
+  doubleRegister_.registerScalar("UpdateNoise.pix",updateNoisePix_);
+  doubleRegister_.registerScalar("UpdateNoise.int",updateNoiseInt_);
+  doubleRegister_.registerScalar("noiseGainForOffCamera",noiseGainForOffCamera_);
+  useImprovedJacobian_ = false; // TODO: adapt/test
+  isZeroVelocityUpdateEnabled_ = false;
+  Base::PropertyHandler::registerSubHandler("ZeroVelocityUpdate",zeroVelocityUpdate_);
+  zeroVelocityUpdate_.outlierDetection_.registerToPropertyHandler(&zeroVelocityUpdate_,"MahalanobisTh");
+  zeroVelocityUpdate_.doubleRegister_.registerScalar("minNoMotionTime",minTimeForZeroVelocityUpdate_);
+  zeroVelocityUpdate_.boolRegister_.registerScalar("isEnabled",isZeroVelocityUpdateEnabled_);
+  doubleRegister_.removeScalarByStr("alpha");
+  doubleRegister_.removeScalarByStr("beta");
+  doubleRegister_.removeScalarByStr("kappa");
+  alignmentHuberNormThreshold_ = static_cast<double>(alignment_.huberNormThreshold_);
+  doubleRegister_.registerScalar("alignmentHuberNormThreshold",alignmentHuberNormThreshold_);
+  doubleRegister_.registerScalar("alignmentGaussianWeightingSigma",alignmentGaussianWeightingSigma_);
+  alignmentGradientExponent_ = static_cast<double>(alignment_.gradientExponent_);
+  doubleRegister_.registerScalar("alignmentGradientExponent",alignmentGradientExponent_);
+}
+
+template<typename FILTERSTATE>
+void ImgUpdate<FILTERSTATE>::refreshProperties(){
+  if(isZeroVelocityUpdateEnabled_) assert(doVisualMotionDetection_);
+  if(useDirectMethod_){
+    updnoiP_.setIdentity();
+    updnoiP_ = updnoiP_*updateNoiseInt_;
+  } else {
+    updnoiP_.setIdentity();
+    updnoiP_ = updnoiP_*updateNoisePix_;
+  }
+  alignment_.huberNormThreshold_ = static_cast<float>(alignmentHuberNormThreshold_);
+  alignment_.computeWeightings(alignmentGaussianWeightingSigma_);
+  alignment_.gradientExponent_ = static_cast<float>(alignmentGradientExponent_);
+  maxNumIteration_ = configuredMaxNumIteration_;
+  if(endLevel_ < getPyramidBaseLevel()){
+    std::cout << "\033[31mERROR: endLevel (" << endLevel_ << ") is below the lowest stored pyramid level, setting it to " << getPyramidBaseLevel() << "!\033[0m" << std::endl;
+    endLevel_ = getPyramidBaseLevel();
+    startLevel_ = std::max(startLevel_,endLevel_);
+  }
+}
+
+template<typename FILTERSTATE>
+void ImgUpdate<FILTERSTATE>::evalInnovation(mtInnovation& y, const mtState& state, const mtNoise& noise) const{
+  const int& ID = state.aux().activeFeature_;
+  const int& camID = state.CfP(ID).camID_;
+  const int activeCamID = (state.aux().activeCameraCounter_ + camID)%mtState::nCam_;
+  transformFeatureOutputCT_.setFeatureID(ID);
+  transformFeatureOutputCT_.setOutputCameraID(activeCamID);
+  transformFeatureOutputCT_.transformState(state,featureOutput_);
+
+  if(useDirectMethod_){
+    if(doFrameVisualisation_ && featureOutput_.c().com_c()){
+      if(activeCamID==camID){
+        featureOutput_.c().drawPoint(drawImg_, cv::Scalar(0,175,175));
+      } else {
+        featureOutput_.c().drawPoint(drawImg_, cv::Scalar(175,175,0));
+      }
+    }
+    if(alignment_.getLinearAlignEquationsReduced(meas_.aux().pyr_[activeCamID],*state.aux().mpCurrentFeature_->mpMultilevelPatch_,featureOutput_.c(),endLevel_,startLevel_,A_red_,b_red_)){
+      y.template get<mtInnovation::_pix>() = b_red_ + noise.template get<mtNoise::_pix>();
+      if(verbose_){
+        std::cout << "    \033[32mMaking update with feature " << ID << " from camera " << camID << " in camera " << activeCamID << "\033[0m" << std::endl;
+      }
     } else {
-      FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[ID];
-      const int camID = f.mpCoordinates_->camID_;
-      const int activeCamID = (activeCamCounter + camID)%mtState::nCam_;
+      y.template get<mtInnovation::_pix>() = noise.template get<mtNoise::_pix>();
+      if(verbose_){
+        std::cout << "    \033[31mFailed Construction of Alignment Equations with feature " << ID << " from camera " << camID << " in camera " << activeCamID << "\033[0m" << std::endl;
+      }
+      cancelIteration_ = true;
+    }
+  } else {
+    Eigen::Vector2d pixError;
+    pixError(0) = static_cast<double>(state.aux().feaCoorMeas_[ID].get_c().x - featureOutput_.c().get_c().x);
+    pixError(1) = static_cast<double>(state.aux().feaCoorMeas_[ID].get_c().y - featureOutput_.c().get_c().y);
+    y.template get<mtInnovation::_pix>() = pixError+noise.template get<mtNoise::_pix>();
+  }
+}
 
-      // Remove negative feature
-      if(removeNegativeFeatureAfterUpdate_){
-        for(unsigned int i=0;i<mtState::nMax_;i++){
-          if(filterState.fsm_.isValid_[i]){
-            if(filterState.state_.dep(i).getDistance() < 1e-8){
-              if(verbose_) std::cout << "    \033[33mRemoved feature " << filterState.fsm_.features_[i].idx_ << " with invalid distance parameter " << filterState.state_.dep(i).p_ << "!\033[0m" << std::endl;
-              filterState.fsm_.isValid_[i] = false;
-              filterState.resetFeatureCovariance(i,Eigen::Matrix3d::Identity());
-            }
+template<typename FILTERSTATE>
+bool ImgUpdate<FILTERSTATE>::generateCandidates(const mtFilterState& filterState, mtState& candidate) const{
+  candidate = filterState.state_;
+
+  if(candidateCounter_ == 0){
+    const int& ID = candidate.aux().activeFeature_;
+    const int& camID = candidate.CfP(ID).camID_;
+    const int activeCamID = (candidate.aux().activeCameraCounter_ + camID)%mtState::nCam_;
+    transformFeatureOutputCT_.setFeatureID(ID);
+    transformFeatureOutputCT_.setOutputCameraID(activeCamID);
+    transformFeatureOutputCT_.transformState(candidate,featureOutput_);
+    transformFeatureOutputCT_.jacTransform(featureOutputJac_,candidate);
+    mpMultiCamera_->cameras_[activeCamID].bearingToPixel(featureOutput_.c().get_nor(),c_temp_,c_J_);
+
+    canditateGenerationH_  = -c_J_*featureOutputJac_.template block<2,mtState::D_>(0,0);
+    canditateGenerationPy_ = canditateGenerationH_*filterState.cov_*canditateGenerationH_.transpose();
+    candidateGenerationES_.compute(canditateGenerationPy_);
+  }
+
+  const int maxUniSample = budgetController_.metrics_.alignMaxUniSample_;
+  while(++candidateCounter_){
+    int u = (candidateCounter_-1)/(2*maxUniSample+1)-maxUniSample;
+    if(u>maxUniSample)
+      break;
+    int v = (candidateCounter_-1)%(2*maxUniSample+1)-maxUniSample;
+    if(pow(u*alignConvergencePixelRange_,2)/candidateGenerationES_.eigenvalues()(0).real()
+        + pow(v*alignConvergencePixelRange_,2)/candidateGenerationES_.eigenvalues()(1).real() < pow(alignCoverageRatio_,2)){
+      Eigen::Vector2d dy = u*alignConvergencePixelRange_*candidateGenerationES_.eigenvectors().col(0).real()
+          + v*alignConvergencePixelRange_*candidateGenerationES_.eigenvectors().col(1).real();
+      canditateGenerationDifVec_ = -filterState.cov_*canditateGenerationH_.transpose()*canditateGenerationPy_.inverse()*dy;
+      candidate.boxPlus(canditateGenerationDifVec_,candidate);
+      return true;
+    }
+  }
+  return false;
+}
+
+template<typename FILTERSTATE>
+bool ImgUpdate<FILTERSTATE>::extraOutlierCheck(const mtState& state) const{
+  const int& ID = state.aux().activeFeature_;
+  const int& camID = state.CfP(ID).camID_;
+  const int activeCamID = (state.aux().activeCameraCounter_ + camID)%mtState::nCam_;
+  transformFeatureOutputCT_.setFeatureID(ID);
+  transformFeatureOutputCT_.setOutputCameraID(activeCamID);
+  transformFeatureOutputCT_.transformState(state,featureOutput_);
+
+  if(!hasConverged_){
+    if(verbose_) std::cout << "    \033[31mREJECTED (iterations did no converge)\033[0m" << std::endl;
+    if(mlpTemp1_.isMultilevelPatchInFrame(meas_.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false)){
+      featureOutput_.c().drawPoint(drawImg_, cv::Scalar(255,0,0),1.0);
+    }
+    return false;
+  }
+
+  if(patchRejectionTh_ >= 0){
+    if(!mlpTemp1_.isMultilevelPatchInFrame(meas_.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false)){
+      if(verbose_) std::cout << "    \033[31mREJECTED (not in frame)\033[0m" << std::endl;
+      return false;
+    }
+    mlpTemp1_.extractMultilevelPatchFromImage(meas_.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false);
+    const float avgError = mlpTemp1_.computeAverageDifference(*state.aux().mpCurrentFeature_->mpMultilevelPatch_,endLevel_,startLevel_);
+    if(avgError > patchRejectionTh_){
+      if(verbose_) std::cout << "    \033[31mREJECTED (error too large: " << avgError << ")\033[0m" << std::endl;
+      featureOutput_.c().drawPoint(drawImg_, cv::Scalar(255,255,0),1.0);
+      return false;
+    }
+
+    // Use 4 sample around feature, at least two should be above the treshold
+    if(discriminativeSamplingDistance_ > 0.0){
+      FeatureOutput sample;
+      V3D d;
+      int countAboveThreshold = 0;
+      for(int i=0;i<4;i++){
+        d.setZero();
+        d(i%2) = (i/2*2-1)*discriminativeSamplingDistance_;
+        featureOutput_.boxPlus(d,sample);
+        if(mlpTemp1_.isMultilevelPatchInFrame(meas_.aux().pyr_[activeCamID],sample.c(),startLevel_,false)){
+          mlpTemp1_.extractMultilevelPatchFromImage(meas_.aux().pyr_[activeCamID],sample.c(),startLevel_,false);
+          const float sampleError = mlpTemp1_.computeAverageDifference(*state.aux().mpCurrentFeature_->mpMultilevelPatch_,endLevel_,startLevel_);
+          const bool isAboveThreshold = (discriminativeSamplingGain_ <= 1.0 & sampleError > patchRejectionTh_)
+              | (discriminativeSamplingGain_ > 1.0 & sampleError > discriminativeSamplingGain_*avgError);
+          countAboveThreshold += isAboveThreshold;
+          if(isAboveThreshold){
+            sample.c().drawPoint(drawImg_, cv::Scalar(0,255,0),2.0);
+          } else {
+            sample.c().drawPoint(drawImg_, cv::Scalar(0,0,255),2.0);
           }
         }
       }
+      if(countAboveThreshold < 2){
+        if(verbose_) std::cout << "    \033[31mREJECTED (feature location not discriminative enough)\033[0m" << std::endl;
+        return false;
+      }
+    }
+  }
 
-      if(filterState.fsm_.isValid_[ID]){
-        // Update status and visualization
-        transformFeatureOutputCT_.setFeatureID(ID);
-        transformFeatureOutputCT_.setOutputCameraID(activeCamID);
-        transformFeatureOutputCT_.transformState(filterState.state_,featureOutput_);
-
-        // Draw information ellipse
-        bool doInformationGainVizualization = false;
-        if(doFrameVisualisation_ && doInformationGainVizualization){
-          MXD F(2,2);
-          F = A_red_;
-          F = F.transpose()*F*1.0/updateNoiseInt_;
-          featureOutput_.c().setPixelCov(F);
-          featureOutput_.c().drawEllipse(drawImg_, cv::Scalar(0,255,0), 10, false);
-          F.setIdentity();
-          F = F.transpose()*F*1.0/updateNoisePix_;
-          featureOutput_.c().setPixelCov(F);
-          featureOutput_.c().drawEllipse(drawImg_, cv::Scalar(0,0,255), 10, false);
-        }
-        filterState.mlpErrorLog_[ID] = alignment_.mlpError_;
+  featureOutput_.c().drawPoint(drawImg_, cv::Scalar(0,0,255),1.0);
+  return true;
+}
 
-        if((filterState.mode_ == LWF::ModeIEKF && successfulUpdate_) || (filterState.mode_ == LWF::ModeEKF && !outlierDetection.isOutlier(0))){
-          if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[camID],featureOutput_.c(),startLevel_,false)){
-            f.mpStatistics_->status_[activeCamID] = TRACKED;
-            if(doFrameVisualisation_) mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,150+(activeCamID == camID)*105,0));
-          } else {
-            f.mpStatistics_->status_[activeCamID] = FAILED_TRACKING;
-            if(doFrameVisualisation_){
-              mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
-              featureOutput_.c().drawText(drawImg_,"NIF",cv::Scalar(0,0,150+(activeCamID == camID)*105));
-            }
-            if(verbose_) std::cout << "    \033[31mNot in frame after update!\033[0m" << std::endl;
-          }
-        } else {
-          f.mpStatistics_->status_[activeCamID] = FAILED_TRACKING;
-          if(outlierDetection.isOutlier(0)){
-            if(doFrameVisualisation_){
-              mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
-              featureOutput_.c().drawText(drawImg_,"MD: " + std::to_string(outlierDetection.getMahalDistance(0)),cv::Scalar(0,0,150+(activeCamID == camID)*105));
-            }
-            if(verbose_) std::cout << "    \033[31mRecognized as outlier by filter: " << outlierDetection.getMahalDistance(0) << "\033[0m" << std::endl;
-          } else if(!hasConverged_){
-            if(doFrameVisualisation_){
-              mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
-              featureOutput_.c().drawText(drawImg_,"INC",cv::Scalar(0,0,150+(activeCamID == camID)*105));
-            }
-            if(verbose_) std::cout << "    \033[31mIterations not converged!\033[0m" << std::endl;
+template<typename FILTERSTATE>
+void ImgUpdate<FILTERSTATE>::jacState(MXD& F, const mtState& state) const{
+  const int& ID = state.aux().activeFeature_;
+  const int& camID = state.CfP(ID).camID_;
+  const int activeCamID = (state.aux().activeCameraCounter_ + camID)%mtState::nCam_;
+  transformFeatureOutputCT_.setFeatureID(ID);
+  transformFeatureOutputCT_.setOutputCameraID(activeCamID);
+  transformFeatureOutputCT_.transformState(state,featureOutput_);
+
+  if(useDirectMethod_){
+    if(alignment_.getLinearAlignEquationsReduced(meas_.aux().pyr_[activeCamID],*state.aux().mpCurrentFeature_->mpMultilevelPatch_,featureOutput_.c(),endLevel_,startLevel_,A_red_,b_red_)){
+      transformFeatureOutputCT_.jacTransform(featureOutputJac_,state);
+      mpMultiCamera_->cameras_[activeCamID].bearingToPixel(featureOutput_.c().get_nor(),c_temp_,c_J_);
+      F = -A_red_*c_J_*featureOutputJac_.template block<2,mtState::D_>(0,0);
+    } else {
+      F.setZero();
+      cancelIteration_ = true;
+    }
+  } else {
+    transformFeatureOutputCT_.jacTransform(featureOutputJac_,state);
+    mpMultiCamera_->cameras_[activeCamID].bearingToPixel(featureOutput_.c().get_nor(),c_temp_,c_J_);
+    F = -c_J_*featureOutputJac_.template block<2,mtState::D_>(0,0);
+  }
+}
+
+template<typename FILTERSTATE>
+void ImgUpdate<FILTERSTATE>::commonPreProcess(mtFilterState& filterState, const mtMeas& meas){
+  assert(filterState.t_ == meas.aux().imgTime_);
+  for(int i=0;i<mtState::nCam_;i++){
+    if(doFrameVisualisation_){
+      cv::Mat levelZeroImg;
+      meas.aux().pyr_[i].getLevelZeroImage(levelZeroImg);
+      cvtColor(levelZeroImg, filterState.img_[i], CV_GRAY2RGB);
+    }
+  }
+  filterState.imgTime_ = filterState.t_;
+  filterState.imageCounter_++;
+  if(visualizePatches_){
+    filterState.patchDrawing_ = cv::Mat::zeros(mtState::nMax_*filterState.drawPS_,(1+2*mtState::nCam_)*filterState.drawPS_,CV_8UC3);
+  }
+  filterState.state_.aux().activeFeature_ = 0;
+  filterState.state_.aux().activeCameraCounter_ = 0;
+
+  // Set the effort levels for this frame and prioritize the features by their bearing uncertainty
+  budgetController_.startFrame(alignMaxUniSample_,configuredMaxNumIteration_);
+  maxNumIteration_ = budgetController_.metrics_.maxNumIteration_;
+  if(budgetController_.isEnabled()){
+    for(unsigned int i=0;i<mtState::nMax_;i++){
+      const int id = mtState::template getId<mtState::_fea>(i);
+      featurePriority_[i] = filterState.fsm_.isValid_[i] ? filterState.cov_(id,id) + filterState.cov_(id+1,id+1) : 0.0;
+    }
+    ComputeBudgetController::computeRanks(featurePriority_,filterState.fsm_.isValid_,mtState::nMax_,featureOrder_,featurePriorityRank_);
+  }
+
+
+  /* Cheap static check by comparing the coarsest pyramid level with the one of the previous image. A static frame counts as
+   * no image motion. If in addition the zero velocity update is active, the feature alignment and updates are skipped.
+   */
+  isStaticFrame_ = false;
+  if(doVisualMotionDetection_ && doStaticPrePass_ && filterState.imageCounter_>1){
+    isStaticFrame_ = true;
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      const float diff = computeCoarseImageDifference(filterState.prevPyr_[camID],meas.aux().pyr_[camID]);
+      if(diff < 0.0 || diff > static_cast<float>(staticPrePassTh_)) isStaticFrame_ = false;
+    }
+  }
+  skipFeatureUpdates_ = isStaticFrame_ && isZeroVelocityUpdateEnabled_
+      && filterState.state_.aux().timeSinceLastImageMotion_ > minTimeForZeroVelocityUpdate_
+      && filterState.state_.aux().timeSinceLastInertialMotion_ > minTimeForZeroVelocityUpdate_;
+  if(verbose_ && skipFeatureUpdates_) std::cout << "Static frame, skipping feature updates" << std::endl;
+
+  /* Detect Image changes by looking at the feature patches between current and previous image (both at the current feature location)
+   * The maximum change of intensity is obtained if the pixel is moved along the strongest gradient.
+   * The maximal singularvalue, which is equivalent to the root of the larger eigenvalue of the Hessian,
+   * gives us range in which intensity change is allowed to be.
+   */
+  if(doVisualMotionDetection_ && !isStaticFrame_ && filterState.imageCounter_>1){
+    int totCountInFrame = 0;
+    int totCountInMotion = 0;
+    for(unsigned int i=0;i<mtState::nMax_;i++){
+      if(filterState.fsm_.isValid_[i]){
+        const int& camID = filterState.state_.CfP(i).camID_;   // Camera ID of the feature.
+        tempCoordinates_ = *filterState.fsm_.features_[i].mpCoordinates_;
+        tempCoordinates_.set_warp_identity();
+        if(mlpTemp1_.isMultilevelPatchInFrame(filterState.prevPyr_[camID],tempCoordinates_,startLevel_,true)){
+          float avgError;
+          float e1;
+          if(useQuantizedPatchesForMotionDetection_){ // Fixed-point patches only, gradients are computed on demand from the intensities
+            PixelCoordinates pc;
+            pc.fromFeatureCoordinates(tempCoordinates_);
+            qmlpTemp1_.extractMultilevelPatchFromImage(filterState.prevPyr_[camID],pc,startLevel_);
+            qmlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
+            qmlpTemp2_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],pc,startLevel_);
+            avgError = qmlpTemp1_.computeAverageDifference(qmlpTemp2_,endLevel_,startLevel_);
+            e1 = qmlpTemp1_.e1_;
           } else {
-            if(doFrameVisualisation_){
-              mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
-              featureOutput_.c().drawText(drawImg_,"PE",cv::Scalar(0,0,150+(activeCamID == camID)*105));
-            }
-            if(verbose_) std::cout << "    \033[31mToo large pixel intesity error!\033[0m" << std::endl;
+            mlpTemp1_.extractMultilevelPatchFromImage(filterState.prevPyr_[camID],tempCoordinates_,startLevel_,true);
+            mlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
+            mlpTemp2_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true);
+            avgError = mlpTemp1_.computeAverageDifference(mlpTemp2_,endLevel_,startLevel_);
+            e1 = mlpTemp1_.e1_;
           }
+          if(avgError/std::sqrt(e1) > static_cast<float>(pixelCoordinateMotionTh_)) totCountInMotion++;
+          totCountInFrame++;
         }
+      }
+    }
+    if(rateOfMovingFeaturesTh_/totCountInMotion*totCountInFrame < 1.0 || totCountInFrame < minFeatureCountForNoMotionDetection_){
+      filterState.state_.aux().timeSinceLastImageMotion_ = 0.0;
+    }
+  }
+}
+
+template<typename FILTERSTATE>
+float ImgUpdate<FILTERSTATE>::computeCoarseImageDifference(const ImagePyramid<mtState::nLevels_>& pyr1, const ImagePyramid<mtState::nLevels_>& pyr2) const{
+  const cv::Mat& img1 = pyr1.imgs_[mtState::nLevels_-1];
+  const cv::Mat& img2 = pyr2.imgs_[mtState::nLevels_-1];
+  if(img1.empty() || img1.size() != img2.size()) return -1.0;
+  const int step = std::max(staticPrePassStep_,1);
+  int sum = 0;
+  int count = 0;
+  for(int y=0;y<img1.rows;y+=step){
+    const uint8_t* row1 = img1.ptr<uint8_t>(y);
+    const uint8_t* row2 = img2.ptr<uint8_t>(y);
+    for(int x=0;x<img1.cols;x+=step){
+      sum += std::abs(row1[x]-row2[x]);
+      count++;
+    }
+  }
+  return static_cast<float>(sum)/count;
+}
 
+template<typename FILTERSTATE>
+void ImgUpdate<FILTERSTATE>::preProcess(mtFilterState& filterState, const mtMeas& meas, bool& isFinished){
+  if(isFinished){ // gets called if this is the first call
+    commonPreProcess(filterState,meas);
+    isFinished = false;
+  }
+  bool foundValidMeasurement = false;
+  typename mtFilterState::mtState& state = filterState.state_;
+  MXD& cov = filterState.cov_;
+  int& ID = filterState.state_.aux().activeFeature_;   // ID of the current updated feature!!! Initially set to 0.
+  int& activeCamCounter = filterState.state_.aux().activeCameraCounter_;
+  if(skipFeatureUpdates_) ID = mtState::nMax_; // Static frame, only the zero velocity update is performed
+
+  // Actualize camera extrinsics (gets also update in calls to TransformFeatureOutputCT)
+  state.updateMultiCameraExtrinsics(mpMultiCamera_);
+
+  while(ID < mtState::nMax_ && foundValidMeasurement == false){
+    if(filterState.fsm_.isValid_[ID] && activeCamCounter==0 && !budgetController_.processFeature(featurePriorityRank_[ID])){
+      // Over budget: skip low priority feature in all cameras (status remains UNKNOWN)
+      filterState.fsm_.features_[ID].mpStatistics_->increaseStatistics(filterState.t_);
+      if(verbose_) std::cout << "    \033[33mSkipped feature " << filterState.fsm_.features_[ID].idx_ << " (over budget)\033[0m" << std::endl;
+      ID++;
+      continue;
+    }
+    if(filterState.fsm_.isValid_[ID]){
+      // Data handling stuff
+      FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[ID];
+      const int camID = f.mpCoordinates_->camID_;
+      const int activeCamID = (activeCamCounter + camID)%mtState::nCam_;
+      drawImg_ = filterState.img_[activeCamID];
+      if(activeCamCounter==0){
+        f.mpStatistics_->increaseStatistics(filterState.t_);
+        if(verbose_){
+          std::cout << "=========== Feature " << f.idx_ << " ==================================================== " << std::endl;
+        }
         // Visualize patch tracking
         if(visualizePatches_){
-          if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],featureOutput_.c(),mtState::nLevels_-1,false)){
-            mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[activeCamID],featureOutput_.c(),mtState::nLevels_-1,false);
-            mlpTemp1_.drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(filterState.drawPB_+(2+2*activeCamID)*filterState.drawPS_,filterState.drawPB_+ID*filterState.drawPS_),1,false);
+          f.mpMultilevelPatch_->drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(2,filterState.drawPB_+ID*filterState.drawPS_),1,false);
+          cv::putText(filterState.patchDrawing_,std::to_string(f.idx_),cv::Point2i(2,10+ID*filterState.drawPS_),cv::FONT_HERSHEY_SIMPLEX, 0.4, cv::Scalar(255,255,255));
+        }
+        f.log_prediction_ = *f.mpCoordinates_;
+      }
+      if(verbose_){
+        std::cout << "  ========== Camera  " << activeCamID << " ================= " << std::endl;
+        std::cout << "  Normal in feature frame: " << f.mpCoordinates_->get_nor().getVec().transpose() << std::endl;
+        std::cout << "  with depth: " << f.mpDistance_->getDistance() << std::endl;
+      }
+
+      // Get coordinates in target frame
+      transformFeatureOutputCT_.setFeatureID(ID);
+      transformFeatureOutputCT_.setOutputCameraID(activeCamID);
+      transformFeatureOutputCT_.transformState(state,featureOutput_);
+      transformFeatureOutputCT_.transformCovMat(state,cov,featureOutputCov_);
+      if(verbose_) std::cout << "    Normal in camera frame: " << featureOutput_.c().get_nor().getVec().transpose() << std::endl;
+
+      // Check if feature in target frame
+      if(!mlpTemp1_.isMultilevelPatchInFrame(filterState.prevPyr_[camID],featureOutput_.c(),startLevel_,false)){
+        f.mpStatistics_->status_[activeCamID] = NOT_IN_FRAME;
+        if(verbose_) std::cout << "    NOT in frame" << std::endl;
+      } else {
+        pixelOutputCT_.transformState(featureOutput_,pixelOutput_);
+        pixelOutputCT_.transformCovMat(featureOutput_,featureOutputCov_,pixelOutputCov_);
+        featureOutput_.c().setPixelCov(pixelOutputCov_);
+
+        // Visualization
+        if(doFrameVisualisation_){
+          if(activeCamID==camID){
+            featureOutput_.c().drawEllipse(drawImg_, cv::Scalar(0,175,175), 2.0, true);
+            featureOutput_.c().drawText(drawImg_,std::to_string(f.idx_),cv::Scalar(0,175,175));
+          } else {
+            featureOutput_.c().drawEllipse(drawImg_, cv::Scalar(175,175,0), 2.0, true);
+            featureOutput_.c().drawText(drawImg_,std::to_string(f.idx_),cv::Scalar(175,175,0));
+          }
+        }
+        if(visualizePatches_){
+          if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false)){
+            mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[activeCamID],featureOutput_.c(),startLevel_,false);
+            mlpTemp1_.drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(filterState.drawPB_+(1+2*activeCamID)*filterState.drawPS_,filterState.drawPB_+ID*filterState.drawPS_),1,false);
           }
-          if(f.mpStatistics_->status_[activeCamID] == TRACKED){
-            cv::rectangle(filterState.patchDrawing_,cv::Point2i((2+2*activeCamID)*filterState.drawPS_,ID*filterState.drawPS_),cv::Point2i((3+2*activeCamID)*filterState.drawPS_-1,(ID+1)*filterState.drawPS_-1),cv::Scalar(0,255,0),1,8,0);
+        }
+
+        if(useDirectMethod_){
+          if(verbose_) std::cout << "    Do direct update (without alignment)" << std::endl;
+          state.aux().mpCurrentFeature_ = &filterState.fsm_.features_[ID];
+          if(activeCamCounter==0){
+            updnoiP_.setIdentity();
+            updnoiP_ = updnoiP_*updateNoiseInt_;
           } else {
-            cv::rectangle(filterState.patchDrawing_,cv::Point2i((2+2*activeCamID)*filterState.drawPS_,ID*filterState.drawPS_),cv::Point2i((3+2*activeCamID)*filterState.drawPS_-1,(ID+1)*filterState.drawPS_-1),cv::Scalar(0,0,255),1,8,0);
+            updnoiP_.setIdentity();
+            updnoiP_ = updnoiP_*updateNoiseInt_*noiseGainForOffCamera_;
+          }
+          foundValidMeasurement = true;
+        } else {
+          if(alignment_.align2DAdaptive(alignedCoordinates_,meas.aux().pyr_[activeCamID],*f.mpMultilevelPatch_,featureOutput_.c(),startLevel_,endLevel_,
+                                        alignConvergencePixelRange_,alignCoverageRatio_,budgetController_.getAlignMaxUniSample())){
+            if(verbose_) std::cout << "    Found match: " << alignedCoordinates_.get_nor().getVec().transpose() << std::endl;
+            if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],alignedCoordinates_,startLevel_,false)){
+              float avgError = 0.0;
+              if(patchRejectionTh_ >= 0){
+                mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[activeCamID],alignedCoordinates_,startLevel_,false);
+                avgError = mlpTemp1_.computeAverageDifference(*f.mpMultilevelPatch_,endLevel_,startLevel_);
+              }
+              if(patchRejectionTh_ >= 0 && avgError > patchRejectionTh_){
+                f.mpStatistics_->status_[activeCamID] = FAILED_ALIGNEMENT;
+                if(verbose_) std::cout << "    \033[31mREJECTED (error too large)\033[0m" << std::endl;
+              } else {
+                if(doFrameVisualisation_) alignedCoordinates_.drawPoint(drawImg_, cv::Scalar(255,0,255));
+                state.aux().feaCoorMeas_[ID] = alignedCoordinates_;
+                foundValidMeasurement = true;
+              }
+            } else {
+              f.mpStatistics_->status_[activeCamID] = FAILED_ALIGNEMENT;
+              if(verbose_) std::cout << "    \033[31mNot in frame after alignment\033[0m" << std::endl;
+            }
+          } else {
+            f.mpStatistics_->status_[activeCamID] = FAILED_ALIGNEMENT;
+            if(verbose_) std::cout << "    \033[31mNOT FOUND (matching failed)\033[0m" << std::endl;
           }
         }
       }
+    }
+    if(foundValidMeasurement == false){
       activeCamCounter++;
       if(activeCamCounter == mtState::nCam_ || !useCrossCameraMeasurements_){
+        // No measurement in the last camera of the feature, refresh its cached distance parameters here instead of in postProcess
+        if(maxUncertaintyToDepthRatioForDepthInitialization_>0 && filterState.fsm_.isValid_[ID]){
+          filterState.updateMedianDepth(ID,maxUncertaintyToDepthRatioForDepthInitialization_);
+        }
         activeCamCounter = 0;
         ID++;
       }
     }
-  };
+  }  // while end
+  if(ID >= mtState::nMax_){
+    isFinished = true;
+  }
+}
 
-  /** \brief Final Post-Processing step for the image update.
-   *
-   *  Summary:
-   *  1. For each feature in the state: Extract patches and compute Shi-Tomasi Score.
-   *  2. Removal of bad features from the state.
-   *  3. Get new features and add them to the state.
-   *
-   *  @param filterState      - Filter state.
-   *  @param meas             - Update measurement.
-   */
-  void commonPostProcess(mtFilterState& filterState, const mtMeas& meas){
-    typename mtFilterState::mtState& state = filterState.state_;
-    MXD& cov = filterState.cov_;
+template<typename FILTERSTATE>
+void ImgUpdate<FILTERSTATE>::postProcess(mtFilterState& filterState, const mtMeas& meas, const mtOutlierDetection& outlierDetection, bool& isFinished){
+  int& ID = filterState.state_.aux().activeFeature_;  // Get the ID of the updated feature.
+  int& activeCamCounter = filterState.state_.aux().activeCameraCounter_;
+
+  if(isFinished){
+    commonPostProcess(filterState,meas);
+  } else {
+    FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[ID];
+    const int camID = f.mpCoordinates_->camID_;
+    const int activeCamID = (activeCamCounter + camID)%mtState::nCam_;
+
+    // Remove negative feature
+    if(removeNegativeFeatureAfterUpdate_){
+      for(unsigned int i=0;i<mtState::nMax_;i++){
+        if(filterState.fsm_.isValid_[i]){
+          if(filterState.state_.dep(i).getDistance() < 1e-8){
+            if(verbose_) std::cout << "    \033[33mRemoved feature " << filterState.fsm_.features_[i].idx_ << " with invalid distance parameter " << filterState.state_.dep(i).p_ << "!\033[0m" << std::endl;
+            filterState.removeFeature(i);
+          }
+        }
+      }
+    }
 
-    // Actualize camera extrinsics
-    state.updateMultiCameraExtrinsics(mpMultiCamera_);
+    if(filterState.fsm_.isValid_[ID]){
+      // Update status and visualization
+      transformFeatureOutputCT_.setFeatureID(ID);
+      transformFeatureOutputCT_.setOutputCameraID(activeCamID);
+      transformFeatureOutputCT_.transformState(filterState.state_,featureOutput_);
 
-    int countTracked = 0;
-    // For all features in the state.
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      if(filterState.fsm_.isValid_[i]){
-        FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[i];
-        const int camID = f.mpCoordinates_->camID_;
-        if(f.mpStatistics_->trackedInSomeFrame()){
-          countTracked++;
-        }
-        if(f.mpStatistics_->status_[camID] == TRACKED && filterState.t_ - f.mpStatistics_->lastPatchUpdate_ > minTimeBetweenPatchUpdate_){
-          tempCoordinates_ = *f.mpCoordinates_;
-          tempCoordinates_.set_warp_identity();
-          if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true)){
-            mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true);
-            mlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
-            if(mlpTemp1_.s_ >= static_cast<float>(minAbsoluteSTScore_) && mlpTemp1_.s_ >= static_cast<float>(minRelativeSTScore_)*(f.mpMultilevelPatch_->s_)){
-              *f.mpMultilevelPatch_ = mlpTemp1_;
-              f.mpCoordinates_->set_warp_identity();
-              f.mpStatistics_->lastPatchUpdate_ = filterState.t_;
-            }
+      // Refresh the cached distance parameters used for initializing new features (once, after the last camera of the feature)
+      const bool isLastActiveCamera = activeCamCounter == mtState::nCam_-1 || !useCrossCameraMeasurements_;
+      if(maxUncertaintyToDepthRatioForDepthInitialization_>0 && isLastActiveCamera){
+        filterState.updateMedianDepth(ID,maxUncertaintyToDepthRatioForDepthInitialization_);
+      }
+
+      // Draw information ellipse
+      bool doInformationGainVizualization = false;
+      if(doFrameVisualisation_ && doInformationGainVizualization){
+        MXD F(2,2);
+        F = A_red_;
+        F = F.transpose()*F*1.0/updateNoiseInt_;
+        featureOutput_.c().setPixelCov(F);
+        featureOutput_.c().drawEllipse(drawImg_, cv::Scalar(0,255,0), 10, false);
+        F.setIdentity();
+        F = F.transpose()*F*1.0/updateNoisePix_;
+        featureOutput_.c().setPixelCov(F);
+        featureOutput_.c().drawEllipse(drawImg_, cv::Scalar(0,0,255), 10, false);
+      }
+      filterState.mlpErrorLog_[ID] = alignment_.mlpError_;
+
+      if((filterState.mode_ == LWF::ModeIEKF && successfulUpdate_) || (filterState.mode_ == LWF::ModeEKF && !outlierDetection.isOutlier(0))){
+        if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[camID],featureOutput_.c(),startLevel_,false)){
+          f.mpStatistics_->status_[activeCamID] = TRACKED;
+          if(doFrameVisualisation_) mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,150+(activeCamID == camID)*105,0));
+        } else {
+          f.mpStatistics_->status_[activeCamID] = FAILED_TRACKING;
+          if(doFrameVisualisation_){
+            mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
+            featureOutput_.c().drawText(drawImg_,"NIF",cv::Scalar(0,0,150+(activeCamID == camID)*105));
           }
+          if(verbose_) std::cout << "    \033[31mNot in frame after update!\033[0m" << std::endl;
         }
-        // Visualize Quatlity
-        if(visualizePatches_){
-          for(int j=0;j<mtState::nCam_;j++){
-            // Local Quality
-            const double qLQ = f.mpStatistics_->getLocalQuality(j);
-            cv::line(filterState.patchDrawing_,cv::Point2i((2+2*j)*filterState.drawPS_+1,(i+1)*filterState.drawPS_-4),cv::Point2i((2+2*j)*filterState.drawPS_+1+(filterState.drawPS_-3)*qLQ,(i+1)*filterState.drawPS_-4),cv::Scalar(0,255*qLQ,255*(1-qLQ)),2,8,0);
+      } else {
+        f.mpStatistics_->status_[activeCamID] = FAILED_TRACKING;
+        if(outlierDetection.isOutlier(0)){
+          if(doFrameVisualisation_){
+            mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
+            featureOutput_.c().drawText(drawImg_,"MD: " + std::to_string(outlierDetection.getMahalDistance(0)),cv::Scalar(0,0,150+(activeCamID == camID)*105));
+          }
+          if(verbose_) std::cout << "    \033[31mRecognized as outlier by filter: " << outlierDetection.getMahalDistance(0) << "\033[0m" << std::endl;
+        } else if(!hasConverged_){
+          if(doFrameVisualisation_){
+            mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
+            featureOutput_.c().drawText(drawImg_,"INC",cv::Scalar(0,0,150+(activeCamID == camID)*105));
           }
-          const double qALQ = f.mpStatistics_->getAverageLocalQuality();
-          cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-10),cv::Point2i(1+(filterState.drawPS_-3)*qALQ,(i+1)*filterState.drawPS_-10),cv::Scalar(0,255*qALQ,255*(1-qALQ)),2,8,0);
-          const double qLV = f.mpStatistics_->getJointLocalVisibility();
-          cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-7),cv::Point2i(1+(filterState.drawPS_-3)*qLV,(i+1)*filterState.drawPS_-7),cv::Scalar(0,255*qLV,255*(1-qLV)),2,8,0);
-          const double qGQ = f.mpStatistics_->getGlobalQuality();
-          cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-4),cv::Point2i(1+(filterState.drawPS_-3)*qGQ,(i+1)*filterState.drawPS_-4),cv::Scalar(0,255*qGQ,255*(1-qALQ)),2,8,0);
+          if(verbose_) std::cout << "    \033[31mIterations not converged!\033[0m" << std::endl;
+        } else {
+          if(doFrameVisualisation_){
+            mlpTemp1_.drawMultilevelPatchBorder(drawImg_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
+            featureOutput_.c().drawText(drawImg_,"PE",cv::Scalar(0,0,150+(activeCamID == camID)*105));
+          }
+          if(verbose_) std::cout << "    \033[31mToo large pixel intesity error!\033[0m" << std::endl;
         }
       }
-    }
 
-    // Remove bad feature.
-    float averageScore = filterState.fsm_.getAverageScore(); // TODO: make the following dependent on the ST-score
-    if(verbose_) std::cout << "Removing features: ";
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      if(filterState.fsm_.isValid_[i]){
-        FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[i];
-        if(!f.mpStatistics_->isGoodFeature(trackingUpperBound_,trackingLowerBound_)){
-          if(verbose_) std::cout << filterState.fsm_.features_[i].idx_ << ", ";
-          filterState.fsm_.isValid_[i] = false;
-          filterState.resetFeatureCovariance(i,Eigen::Matrix3d::Identity());
+      // Visualize patch tracking
+      if(visualizePatches_){
+        if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],featureOutput_.c(),mtState::nLevels_-1,false)){
+          mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[activeCamID],featureOutput_.c(),mtState::nLevels_-1,false);
+          mlpTemp1_.drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(filterState.drawPB_+(2+2*activeCamID)*filterState.drawPS_,filterState.drawPB_+ID*filterState.drawPS_),1,false);
+        }
+        if(f.mpStatistics_->status_[activeCamID] == TRACKED){
+          cv::rectangle(filterState.patchDrawing_,cv::Point2i((2+2*activeCamID)*filterState.drawPS_,ID*filterState.drawPS_),cv::Point2i((3+2*activeCamID)*filterState.drawPS_-1,(ID+1)*filterState.drawPS_-1),cv::Scalar(0,255,0),1,8,0);
+        } else {
+          cv::rectangle(filterState.patchDrawing_,cv::Point2i((2+2*activeCamID)*filterState.drawPS_,ID*filterState.drawPS_),cv::Point2i((3+2*activeCamID)*filterState.drawPS_-1,(ID+1)*filterState.drawPS_-1),cv::Scalar(0,0,255),1,8,0);
         }
       }
     }
-    if(verbose_) std::cout << " | ";
-    // Check if enough free features, enforce removal
-    int requiredFreeFeature = mtState::nMax_*minTrackedAndFreeFeatures_-countTracked;
-    double factor = removalFactor_;
-    int featureIndex = 0;
-    while((int)(mtState::nMax_) - (int)(filterState.fsm_.getValidCount()) < requiredFreeFeature){
-      if(filterState.fsm_.isValid_[featureIndex]){
-        FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[featureIndex];
-        if(!f.mpStatistics_->trackedInSomeFrame() && !f.mpStatistics_->isGoodFeature(trackingUpperBound_*factor,trackingLowerBound_*factor)){
-          if(verbose_) std::cout << filterState.fsm_.features_[featureIndex].idx_ << ", ";
-          filterState.fsm_.isValid_[featureIndex] = false;
-          filterState.resetFeatureCovariance(featureIndex,Eigen::Matrix3d::Identity());
+    activeCamCounter++;
+    if(activeCamCounter == mtState::nCam_ || !useCrossCameraMeasurements_){
+      activeCamCounter = 0;
+      ID++;
+    }
+  }
+}
+
+template<typename FILTERSTATE>
+void ImgUpdate<FILTERSTATE>::commonPostProcess(mtFilterState& filterState, const mtMeas& meas){
+  typename mtFilterState::mtState& state = filterState.state_;
+  MXD& cov = filterState.cov_;
+
+  // Static frame: the feature management is skipped and the previous pyramid is kept as reference for the next static check
+  if(skipFeatureUpdates_){
+    performZeroVelocityUpdate(filterState);
+    maxNumIteration_ = configuredMaxNumIteration_;
+    budgetController_.endFrame();
+    return;
+  }
+
+  // Actualize camera extrinsics
+  state.updateMultiCameraExtrinsics(mpMultiCamera_);
+
+  int countTracked = 0;
+  // For all features in the state.
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    if(filterState.fsm_.isValid_[i]){
+      FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[i];
+      const int camID = f.mpCoordinates_->camID_;
+      if(f.mpStatistics_->trackedInSomeFrame()){
+        countTracked++;
+      }
+      if(f.mpStatistics_->status_[camID] == TRACKED && filterState.t_ - f.mpStatistics_->lastPatchUpdate_ > minTimeBetweenPatchUpdate_){
+        tempCoordinates_ = *f.mpCoordinates_;
+        tempCoordinates_.set_warp_identity();
+        if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true)){
+          mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true);
+          mlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
+          if(mlpTemp1_.s_ >= static_cast<float>(minAbsoluteSTScore_) && mlpTemp1_.s_ >= static_cast<float>(minRelativeSTScore_)*(f.mpMultilevelPatch_->s_)){
+            *f.mpMultilevelPatch_ = mlpTemp1_;
+            f.mpCoordinates_->set_warp_identity();
+            f.mpStatistics_->lastPatchUpdate_ = filterState.t_;
+          }
+        }
+      }
+      // Temporal two-view initialization: triangulate between the detection and the current view, retried every frame until the
+      // baseline makes the triangulation more certain than the filter. The depth is then replaced once and its cross-covariances are dropped.
+      if(filterState.isTemporalInitPending_[i] && f.mpStatistics_->status_[camID] == TRACKED){
+        FeatureDistance triangulatedDistance = *f.mpDistance_;
+        double depthParameterVariance;
+        const double sigmaAngle = FeatureTriangulation::pixelToAngleSigma(mpMultiCamera_->cameras_[camID],triangulationPixelSigma_);
+        if(triangulation_.triangulateFromPoses(*f.mpCoordinates_,filterState.temporalInitCoordinates_[i],state.WrWC(camID),state.qCW(camID),
+                                               filterState.temporalInitWrWC_[i],filterState.temporalInitqCW_[i],sigmaAngle,sigmaAngle,triangulatedDistance,depthParameterVariance)){
+          const int depthId = mtState::template getId<mtState::_fea>(i)+2;
+          if(depthParameterVariance < cov(depthId,depthId)){
+            filterState.isTemporalInitPending_[i] = false;
+            *f.mpDistance_ = triangulatedDistance;
+            cov.row(depthId).setZero();
+            cov.col(depthId).setZero();
+            cov(depthId,depthId) = depthParameterVariance;
+          }
         }
       }
-      featureIndex++;
-      if(featureIndex == mtState::nMax_){
-        featureIndex = 0;
-        factor = factor*removalFactor_;
+      // Visualize Quatlity
+      if(visualizePatches_){
+        for(int j=0;j<mtState::nCam_;j++){
+          // Local Quality
+          const double qLQ = f.mpStatistics_->getLocalQuality(j);
+          cv::line(filterState.patchDrawing_,cv::Point2i((2+2*j)*filterState.drawPS_+1,(i+1)*filterState.drawPS_-4),cv::Point2i((2+2*j)*filterState.drawPS_+1+(filterState.drawPS_-3)*qLQ,(i+1)*filterState.drawPS_-4),cv::Scalar(0,255*qLQ,255*(1-qLQ)),2,8,0);
+        }
+        const double qALQ = f.mpStatistics_->getAverageLocalQuality();
+        cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-10),cv::Point2i(1+(filterState.drawPS_-3)*qALQ,(i+1)*filterState.drawPS_-10),cv::Scalar(0,255*qALQ,255*(1-qALQ)),2,8,0);
+        const double qLV = f.mpStatistics_->getJointLocalVisibility();
+        cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-7),cv::Point2i(1+(filterState.drawPS_-3)*qLV,(i+1)*filterState.drawPS_-7),cv::Scalar(0,255*qLV,255*(1-qLV)),2,8,0);
+        const double qGQ = f.mpStatistics_->getGlobalQuality();
+        cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-4),cv::Point2i(1+(filterState.drawPS_-3)*qGQ,(i+1)*filterState.drawPS_-4),cv::Scalar(0,255*qGQ,255*(1-qALQ)),2,8,0);
       }
     }
-    if(verbose_) std::cout << std::endl;
-
-    // Get new features
-    if(filterState.fsm_.getValidCount() < startDetectionTh_*mtState::nMax_){
-      // Compute the median depth parameters for each camera, using the state features.
-      std::array<double, mtState::nCam_> medianDepthParameters;
-      if(maxUncertaintyToDepthRatioForDepthInitialization_>0){
-        filterState.getMedianDepthParameters(initDepth_, &medianDepthParameters,maxUncertaintyToDepthRatioForDepthInitialization_);
-      } else {
-        medianDepthParameters.fill(initDepth_);
+  }
+
+  // Remove bad feature.
+  float averageScore = filterState.fsm_.getAverageScore(); // TODO: make the following dependent on the ST-score
+  if(verbose_) std::cout << "Removing features: ";
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    if(filterState.fsm_.isValid_[i]){
+      FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[i];
+      if(!f.mpStatistics_->isGoodFeature(trackingUpperBound_,trackingLowerBound_)){
+        if(verbose_) std::cout << filterState.fsm_.features_[i].idx_ << ", ";
+        filterState.removeFeature(i);
       }
-      for(int camID = 0;camID<mtState::nCam_;camID++){
-        // Get Candidates
-        if(verbose_) std::cout << "Adding keypoints" << std::endl;
-        const double t1 = (double) cv::getTickCount();
-        candidates_.clear();
-        for(int l=endLevel_;l<=startLevel_;l++){
-          meas.aux().pyr_[camID].detectFastCorners(candidates_,l,fastDetectionThreshold_, mpMultiCamera_->cameras_[camID].valid_radius_);
+    }
+  }
+  if(verbose_) std::cout << " | ";
+  // Check if enough free features, enforce removal
+  int requiredFreeFeature = mtState::nMax_*minTrackedAndFreeFeatures_-countTracked;
+  double factor = removalFactor_;
+  int featureIndex = 0;
+  while((int)(mtState::nMax_) - (int)(filterState.fsm_.getValidCount()) < requiredFreeFeature){
+    if(filterState.fsm_.isValid_[featureIndex]){
+      FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[featureIndex];
+      if(!f.mpStatistics_->trackedInSomeFrame() && !f.mpStatistics_->isGoodFeature(trackingUpperBound_*factor,trackingLowerBound_*factor)){
+        if(verbose_) std::cout << filterState.fsm_.features_[featureIndex].idx_ << ", ";
+        filterState.removeFeature(featureIndex);
+      }
+    }
+    featureIndex++;
+    if(featureIndex == mtState::nMax_){
+      featureIndex = 0;
+      factor = factor*removalFactor_;
+    }
+  }
+  if(verbose_) std::cout << std::endl;
+
+  // Get new features (might be deferred if over budget)
+  if(filterState.fsm_.getValidCount() < startDetectionTh_*mtState::nMax_ && !budgetController_.deferDetection()){
+    // Compute the median depth parameters for each camera, using the state features.
+    std::array<double, mtState::nCam_> medianDepthParameters;
+    if(maxUncertaintyToDepthRatioForDepthInitialization_>0){
+      filterState.medianDepthEstimator_.getMedianDepthParameters(initDepth_,&medianDepthParameters,filterState.fsm_);
+    } else {
+      medianDepthParameters.fill(initDepth_);
+    }
+    for(int camID = 0;camID<mtState::nCam_;camID++){
+      // Get Candidates
+      if(verbose_) std::cout << "Adding keypoints" << std::endl;
+      const double t1 = (double) cv::getTickCount();
+      candidates_.clear();
+      for(int l=endLevel_;l<=startLevel_;l++){
+        meas.aux().pyr_[camID].detectFastCorners(candidates_,l,fastDetectionThreshold_, mpMultiCamera_->cameras_[camID].valid_radius_);
+      }
+      const double t2 = (double) cv::getTickCount();
+      if(verbose_) std::cout << "== Detected " << candidates_.size() << " on levels " << endLevel_ << "-" << startLevel_ << " (" << (t2-t1)/cv::getTickFrequency()*1000 << " ms)" << std::endl;
+      std::unordered_set<unsigned int> newSet = filterState.fsm_.addBestCandidates(candidates_,meas.aux().pyr_[camID],camID,filterState.t_,
+                                                                  endLevel_,startLevel_,(mtState::nMax_-filterState.fsm_.getValidCount())/(mtState::nCam_-camID),nDetectionBuckets_, scoreDetectionExponent_,
+                                                                  penaltyDistance_, zeroDistancePenalty_,false,minAbsoluteSTScore_);
+      const double t3 = (double) cv::getTickCount();
+      if(verbose_) std::cout << "== Got " << filterState.fsm_.getValidCount() << " after adding " << newSet.size() << " features in camera " << camID << " (" << (t3-t2)/cv::getTickFrequency()*1000 << " ms)" << std::endl;
+      for(auto it = newSet.begin();it != newSet.end();++it){
+        FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[*it];
+        f.mpStatistics_->resetStatistics(filterState.t_);
+        f.mpStatistics_->status_[camID] = TRACKED;
+        f.mpStatistics_->lastPatchUpdate_ = filterState.t_;
+        f.mpDistance_->p_ = medianDepthParameters[camID];
+        M3D initCov = initCovFeature_;
+        initCov(0,0) = initCovFeature_(0,0)*pow(f.mpDistance_->getParameterDerivative()*f.mpDistance_->getDistance(),2);
+        filterState.resetFeatureCovariance(*it,initCov);
+        filterState.isTemporalInitPending_[*it] = doTemporalInitialization_;
+        if(doTemporalInitialization_){
+          filterState.temporalInitCoordinates_[*it] = *f.mpCoordinates_;
+          filterState.temporalInitWrWC_[*it] = state.WrWC(camID);
+          filterState.temporalInitqCW_[*it] = state.qCW(camID);
+        }
+        if(doFrameVisualisation_){
+          f.mpCoordinates_->drawPoint(filterState.img_[camID], cv::Scalar(255,0,0));
+          f.mpCoordinates_->drawText(filterState.img_[camID],std::to_string(f.idx_),cv::Scalar(255,0,0));
         }
-        const double t2 = (double) cv::getTickCount();
-        if(verbose_) std::cout << "== Detected " << candidates_.size() << " on levels " << endLevel_ << "-" << startLevel_ << " (" << (t2-t1)/cv::getTickFrequency()*1000 << " ms)" << std::endl;
-        std::unordered_set<unsigned int> newSet = filterState.fsm_.addBestCandidates(candidates_,meas.aux().pyr_[camID],camID,filterState.t_,
-                                                                    endLevel_,startLevel_,(mtState::nMax_-filterState.fsm_.getValidCount())/(mtState::nCam_-camID),nDetectionBuckets_, scoreDetectionExponent_,
-                                                                    penaltyDistance_, zeroDistancePenalty_,false,minAbsoluteSTScore_);
-        const double t3 = (double) cv::getTickCount();
-        if(verbose_) std::cout << "== Got " << filterState.fsm_.getValidCount() << " after adding " << newSet.size() << " features in camera " << camID << " (" << (t3-t2)/cv::getTickFrequency()*1000 << " ms)" << std::endl;
-        for(auto it = newSet.begin();it != newSet.end();++it){
-          FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[*it];
-          f.mpStatistics_->resetStatistics(filterState.t_);
-          f.mpStatistics_->status_[camID] = TRACKED;
-          f.mpStatistics_->lastPatchUpdate_ = filterState.t_;
-          f.mpDistance_->p_ = medianDepthParameters[camID];
-          const float initRelDepthCovTemp_ = initCovFeature_(0,0);
-          initCovFeature_(0,0) = initRelDepthCovTemp_*pow(f.mpDistance_->getParameterDerivative()*f.mpDistance_->getDistance(),2);
-          filterState.resetFeatureCovariance(*it,initCovFeature_);
-          initCovFeature_(0,0) = initRelDepthCovTemp_;
-          if(doFrameVisualisation_){
-            f.mpCoordinates_->drawPoint(filterState.img_[camID], cv::Scalar(255,0,0));
-            f.mpCoordinates_->drawText(filterState.img_[camID],std::to_string(f.idx_),cv::Scalar(255,0,0));
-          }
 
-          if(mtState::nCam_>1 && doStereoInitialization_){
-            const int otherCam = (camID+1)%mtState::nCam_;
-            transformFeatureOutputCT_.setFeatureID(*it);
-            transformFeatureOutputCT_.setOutputCameraID(otherCam);
-            transformFeatureOutputCT_.transformState(filterState.state_,featureOutput_);
-            if(alignment_.align2DAdaptive(alignedCoordinates_,meas.aux().pyr_[otherCam],*f.mpMultilevelPatch_,featureOutput_.c(),startLevel_,endLevel_,
-                                            alignConvergencePixelRange_,alignCoverageRatio_,alignMaxUniSample_)){
-              bool valid = mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[otherCam],alignedCoordinates_,startLevel_,false);
-              if(valid && patchRejectionTh_ >= 0){
-                mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[otherCam],alignedCoordinates_,startLevel_,false);
-                const float avgError = mlpTemp1_.computeAverageDifference(*f.mpMultilevelPatch_,endLevel_,startLevel_);
-                if(avgError > patchRejectionTh_){
-                  valid = false;
-                }
+        if(mtState::nCam_>1 && doStereoInitialization_){
+          const int otherCam = (camID+1)%mtState::nCam_;
+          transformFeatureOutputCT_.setFeatureID(*it);
+          transformFeatureOutputCT_.setOutputCameraID(otherCam);
+          transformFeatureOutputCT_.transformState(filterState.state_,featureOutput_);
+          if(alignment_.align2DAdaptive(alignedCoordinates_,meas.aux().pyr_[otherCam],*f.mpMultilevelPatch_,featureOutput_.c(),startLevel_,endLevel_,
+                                          alignConvergencePixelRange_,alignCoverageRatio_,budgetController_.getAlignMaxUniSample())){
+            bool valid = mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[otherCam],alignedCoordinates_,startLevel_,false);
+            if(valid && patchRejectionTh_ >= 0){
+              mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[otherCam],alignedCoordinates_,startLevel_,false);
+              const float avgError = mlpTemp1_.computeAverageDifference(*f.mpMultilevelPatch_,endLevel_,startLevel_);
+              if(avgError > patchRejectionTh_){
+                valid = false;
               }
-              if(valid == true){
-                if(doFrameVisualisation_){
-                  alignedCoordinates_.drawPoint(filterState.img_[otherCam], cv::Scalar(150,0,0));
-                  alignedCoordinates_.drawText(filterState.img_[otherCam],std::to_string(f.idx_),cv::Scalar(150,0,0));
-                }
-                if(f.mpCoordinates_->getDepthFromTriangulation(alignedCoordinates_,state.qCM(otherCam).rotate(V3D(state.MrMC(camID)-state.MrMC(otherCam))),state.qCM(otherCam)*state.qCM(camID).inverted(), *f.mpDistance_, 0.01)){
-                  filterState.resetFeatureCovariance(*it,initCovFeature_); // TODO: improve
-                }
-              } else {
-                if(doFrameVisualisation_){
-                  alignedCoordinates_.drawPoint(filterState.img_[otherCam], cv::Scalar(0,0,150));
-                  alignedCoordinates_.drawText(filterState.img_[otherCam],std::to_string(f.idx_),cv::Scalar(0,0,150));
-                }
+            }
+            if(valid == true){
+              if(doFrameVisualisation_){
+                alignedCoordinates_.drawPoint(filterState.img_[otherCam], cv::Scalar(150,0,0));
+                alignedCoordinates_.drawText(filterState.img_[otherCam],std::to_string(f.idx_),cv::Scalar(150,0,0));
+              }
+              double depthParameterVariance;
+              if(triangulation_.triangulate(*f.mpCoordinates_,alignedCoordinates_,state.qCM(otherCam).rotate(V3D(state.MrMC(camID)-state.MrMC(otherCam))),state.qCM(otherCam)*state.qCM(camID).inverted(),
+                                            FeatureTriangulation::pixelToAngleSigma(mpMultiCamera_->cameras_[camID],triangulationPixelSigma_),
+                                            FeatureTriangulation::pixelToAngleSigma(mpMultiCamera_->cameras_[otherCam],triangulationPixelSigma_),
+                                            *f.mpDistance_,depthParameterVariance)){
+                M3D triangulatedCov = initCovFeature_;
+                triangulatedCov(0,0) = depthParameterVariance;
+                filterState.resetFeatureCovariance(*it,triangulatedCov);
+                filterState.isTemporalInitPending_[*it] = false;
               }
             } else {
               if(doFrameVisualisation_){
-                alignedCoordinates_.drawPoint(filterState.img_[otherCam], cv::Scalar(0,150,0));
-                alignedCoordinates_.drawText(filterState.img_[otherCam],std::to_string(f.idx_),cv::Scalar(0,150,0));
+                alignedCoordinates_.drawPoint(filterState.img_[otherCam], cv::Scalar(0,0,150));
+                alignedCoordinates_.drawText(filterState.img_[otherCam],std::to_string(f.idx_),cv::Scalar(0,0,150));
               }
             }
+          } else {
+            if(doFrameVisualisation_){
+              alignedCoordinates_.drawPoint(filterState.img_[otherCam], cv::Scalar(0,150,0));
+              alignedCoordinates_.drawText(filterState.img_[otherCam],std::to_string(f.idx_),cv::Scalar(0,150,0));
+            }
           }
         }
       }
     }
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      if(filterState.fsm_.isValid_[i]){
-        filterState.fsm_.features_[i].log_previous_ = *filterState.fsm_.features_[i].mpCoordinates_;
-      }
-    }
-    if (doFrameVisualisation_){
-      for(int i=0;i<mtState::nCam_;i++){
-        drawVirtualHorizon(filterState,i);
-      }
+  }
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    if(filterState.fsm_.isValid_[i]){
+      filterState.fsm_.features_[i].log_previous_ = *filterState.fsm_.features_[i].mpCoordinates_;
     }
-
-    if(verbose_){
-      for(int i=0;i<mtState::nCam_;i++){
-        std::cout << "Camera extrinsics: " << i << std::endl;
-        std::cout << "  " << filterState.state_.qCM(i) << std::endl;
-        std::cout << "  " << filterState.state_.MrMC(i).transpose() << std::endl;
-      }
+  }
+  if (doFrameVisualisation_){
+    for(int i=0;i<mtState::nCam_;i++){
+      drawVirtualHorizon(filterState,i);
     }
+  }
 
-    // Copy image pyramid to state
+  if(verbose_){
     for(int i=0;i<mtState::nCam_;i++){
-      filterState.prevPyr_[i] = meas.aux().pyr_[i];
+      std::cout << "Camera extrinsics: " << i << std::endl;
+      std::cout << "  " << filterState.state_.qCM(i) << std::endl;
+      std::cout << "  " << filterState.state_.MrMC(i).transpose() << std::endl;
     }
+  }
 
-    // Zero Velocity updates if appropriate
-    if(isZeroVelocityUpdateEnabled_
-        && doVisualMotionDetection_ && filterState.state_.aux().timeSinceLastImageMotion_ > minTimeForZeroVelocityUpdate_
-        && filterState.state_.aux().timeSinceLastInertialMotion_ > minTimeForZeroVelocityUpdate_){
-      cv::putText(filterState.img_[0],"Performing Zero Velocity Updates!",cv::Point2f(150,25),cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0,255,255));
-      zeroVelocityUpdate_.performUpdateEKF(filterState,ZeroVelocityUpdateMeas<mtState>());
-    }
+  // Copy image pyramid to state
+  for(int i=0;i<mtState::nCam_;i++){
+    filterState.prevPyr_[i] = meas.aux().pyr_[i];
   }
 
-  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  // Zero Velocity updates if appropriate
+  performZeroVelocityUpdate(filterState);
 
-  /** \brief Draws a virtual horizon into the current image of the camera with ID camID
-   *
-   *  @param filterState - Filter state.
-   *  @param camID       - ID of the camera, in which image the horizon should be drawn.
-   */
-  void drawVirtualHorizon(mtFilterState& filterState, const int camID = 0){
-    typename mtFilterState::mtState& state = filterState.state_;
-    cv::rectangle(filterState.img_[camID],cv::Point2f(0,0),cv::Point2f(82,92),cv::Scalar(50,50,50),-1,8,0);
-    cv::rectangle(filterState.img_[camID],cv::Point2f(0,0),cv::Point2f(80,90),cv::Scalar(100,100,100),-1,8,0);
-    cv::putText(filterState.img_[camID],std::to_string(filterState.imageCounter_),cv::Point2f(5,85),cv::FONT_HERSHEY_SIMPLEX, 0.4, cv::Scalar(255,0,0));
-    cv::Point2f rollCenter = cv::Point2f(40,40);
-    cv::Scalar rollColor1(50,50,50);
-    cv::Scalar rollColor2(200,200,200);
-    cv::Scalar rollColor3(120,120,120);
-    cv::circle(filterState.img_[camID],rollCenter,32,rollColor1,-1,8,0);
-    cv::circle(filterState.img_[camID],rollCenter,30,rollColor2,-1,8,0);
-    Eigen::Vector3d Vg = (state.qCM(camID)*state.qWM().inverted()).rotate(Eigen::Vector3d(0,0,-1));
-    double roll = atan2(Vg(1),Vg(0))-0.5*M_PI;
-    double pitch = acos(Vg.dot(Eigen::Vector3d(0,0,1)))-0.5*M_PI;
-    double pixelFor10Pitch = 5.0;
-    double pitchOffsetAngle = -asin(pitch/M_PI*180.0/10.0*pixelFor10Pitch/30.0);
-    cv::Point2f rollVector1 = 30*cv::Point2f(cos(roll),sin(roll));
-    cv::Point2f rollVector2 = cv::Point2f(25,0);
-    cv::Point2f rollVector3 = cv::Point2f(10,0);
-    std::vector<cv::Point> pts;
-    cv::ellipse2Poly(rollCenter,cv::Size(30,30),0,(roll-pitchOffsetAngle)/M_PI*180,(roll+pitchOffsetAngle)/M_PI*180+180,1,pts);
-    cv::Point *points;
-    points = &pts[0];
-    int nbtab = pts.size();
-    cv::fillPoly(filterState.img_[camID],(const cv::Point**)&points,&nbtab,1,rollColor3);
-    cv::line(filterState.img_[camID],rollCenter+rollVector2,rollCenter+rollVector3,rollColor1, 2);
-    cv::line(filterState.img_[camID],rollCenter-rollVector2,rollCenter-rollVector3,rollColor1, 2);
-    cv::ellipse(filterState.img_[camID],rollCenter,cv::Size(10,10),0,0,180,rollColor1,2,8,0);
-    cv::circle(filterState.img_[camID],rollCenter,2,rollColor1,-1,8,0);
-  }
-};
+  // Finish timing of frame
+  maxNumIteration_ = configuredMaxNumIteration_;
+  budgetController_.endFrame();
+  if(verbose_) budgetController_.metrics_.print();
+}
+
+template<typename FILTERSTATE>
+void ImgUpdate<FILTERSTATE>::drawVirtualHorizon(mtFilterState& filterState, const int camID){
+  typename mtFilterState::mtState& state = filterState.state_;
+  cv::rectangle(filterState.img_[camID],cv::Point2f(0,0),cv::Point2f(82,92),cv::Scalar(50,50,50),-1,8,0);
+  cv::rectangle(filterState.img_[camID],cv::Point2f(0,0),cv::Point2f(80,90),cv::Scalar(100,100,100),-1,8,0);
+  cv::putText(filterState.img_[camID],std::to_string(filterState.imageCounter_),cv::Point2f(5,85),cv::FONT_HERSHEY_SIMPLEX, 0.4, cv::Scalar(255,0,0));
+  cv::Point2f rollCenter = cv::Point2f(40,40);
+  cv::Scalar rollColor1(50,50,50);
+  cv::Scalar rollColor2(200,200,200);
+  cv::Scalar rollColor3(120,120,120);
+  cv::circle(filterState.img_[camID],rollCenter,32,rollColor1,-1,8,0);
+  cv::circle(filterState.img_[camID],rollCenter,30,rollColor2,-1,8,0);
+  Eigen::Vector3d Vg = (state.qCM(camID)*state.qWM().inverted()).rotate(Eigen::Vector3d(0,0,-1));
+  double roll = atan2(Vg(1),Vg(0))-0.5*M_PI;
+  double pitch = acos(Vg.dot(Eigen::Vector3d(0,0,1)))-0.5*M_PI;
+  double pixelFor10Pitch = 5.0;
+  double pitchOffsetAngle = -asin(pitch/M_PI*180.0/10.0*pixelFor10Pitch/30.0);
+  cv::Point2f rollVector1 = 30*cv::Point2f(cos(roll),sin(roll));
+  cv::Point2f rollVector2 = cv::Point2f(25,0);
+  cv::Point2f rollVector3 = cv::Point2f(10,0);
+  std::vector<cv::Point> pts;
+  cv::ellipse2Poly(rollCenter,cv::Size(30,30),0,(roll-pitchOffsetAngle)/M_PI*180,(roll+pitchOffsetAngle)/M_PI*180+180,1,pts);
+  cv::Point *points;
+  points = &pts[0];
+  int nbtab = pts.size();
+  cv::fillPoly(filterState.img_[camID],(const cv::Point**)&points,&nbtab,1,rollColor3);
+  cv::line(filterState.img_[camID],rollCenter+rollVector2,rollCenter+rollVector3,rollColor1, 2);
+  cv::line(filterState.img_[camID],rollCenter-rollVector2,rollCenter-rollVector3,rollColor1, 2);
+  cv::ellipse(filterState.img_[camID],rollCenter,cv::Size(10,10),0,0,180,rollColor1,2,8,0);
+  cv::circle(filterState.img_[camID],rollCenter,2,rollColor1,-1,8,0);
+}
 
 }
 
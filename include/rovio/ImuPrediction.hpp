@@ -33,6 +33,7 @@
 #include "lightweight_filtering/Prediction.hpp"
 #include "lightweight_filtering/State.hpp"
 #include "rovio/FilterStates.hpp"
+#include "rovio/FeaturePropagationBatch.hpp"
 
 namespace rovio {
 
@@ -56,238 +57,400 @@ class ImuPrediction: public LWF::Prediction<FILTERSTATE>{
   mutable FeatureCoordinates oldC_;
   mutable FeatureDistance oldD_;
   mutable Eigen::Matrix2d bearingVectorJac_;
-  ImuPrediction():g_(0,0,-9.81){
-    int ind;
-    inertialMotionRorTh_ = 0.1;
-    inertialMotionAccTh_ = 0.1;
-    doubleRegister_.registerScalar("MotionDetection.inertialMotionRorTh",inertialMotionRorTh_);
-    doubleRegister_.registerScalar("MotionDetection.inertialMotionAccTh",inertialMotionAccTh_);
-    for(int i=0;i<mtState::nMax_;i++){
-      ind = mtNoise::template getId<mtNoise::_fea>(i);
-      doubleRegister_.removeScalarByVar(prenoiP_(ind,ind));
-      doubleRegister_.removeScalarByVar(prenoiP_(ind+1,ind+1));
-      doubleRegister_.registerScalar("PredictionNoise.nor",prenoiP_(ind,ind));
-      doubleRegister_.registerScalar("PredictionNoise.nor",prenoiP_(ind+1,ind+1));
-      ind = mtNoise::template getId<mtNoise::_fea>(i)+2;
-      doubleRegister_.removeScalarByVar(prenoiP_(ind,ind));
-      doubleRegister_.registerScalar("PredictionNoise.dep",prenoiP_(ind,ind));
-    }
-    for(int camID=0;camID<mtState::nCam_;camID++){
-      for(int j=0;j<3;j++){
-        doubleRegister_.removeScalarByVar(prenoiP_(mtNoise::template getId<mtNoise::_vep>(camID)+j,mtNoise::template getId<mtNoise::_vep>(camID)+j));
-        doubleRegister_.removeScalarByVar(prenoiP_(mtNoise::template getId<mtNoise::_vea>(camID)+j,mtNoise::template getId<mtNoise::_vea>(camID)+j));
-        doubleRegister_.registerScalar("PredictionNoise.vep",prenoiP_(mtNoise::template getId<mtNoise::_vep>(camID)+j,mtNoise::template getId<mtNoise::_vep>(camID)+j));
-        doubleRegister_.registerScalar("PredictionNoise.vea",prenoiP_(mtNoise::template getId<mtNoise::_vea>(camID)+j,mtNoise::template getId<mtNoise::_vea>(camID)+j));
-      }
-    }
-    for(int i=0;i<mtState::nPose_;i++){
-      for(int j=0;j<3;j++){
-        doubleRegister_.removeScalarByVar(prenoiP_(mtNoise::template getId<mtNoise::_pop>(i)+j,mtNoise::template getId<mtNoise::_pop>(i)+j));
-        doubleRegister_.removeScalarByVar(prenoiP_(mtNoise::template getId<mtNoise::_poa>(i)+j,mtNoise::template getId<mtNoise::_poa>(i)+j));
-      }
-    }
-    disablePreAndPostProcessingWarning_ = true;
+
+  /** \brief Noise free prediction of a camera, shared by all its features.
+   */
+  struct CameraPrediction{
+    M3D C_CM_;  /**<Rotation matrix of qCM.*/
+    V3D CrMC_;  /**<qCM.rotate(MrMC).*/
+    V3D camRor_;  /**<Rotational rate in the camera frame.*/
+    V3D camVel_;  /**<Velocity in the camera frame.*/
+  };
+  /** \brief Noise free prediction of a feature together with the terms shared by its Jacobians.
+   */
+  struct FeaturePrediction{
+    bool isValid_;  /**<False if the feature has no valid camera.*/
+    V3D n_;  /**<Previous bearing vector.*/
+    double distance_;  /**<Previous distance.*/
+    double distanceDerivative_;  /**<Derivative of the distance w.r.t. the depth parameter.*/
+    double parameterDerivative_;  /**<Derivative of the depth parameter w.r.t. the distance.*/
+    double parameterDerivativeCombined_;  /**<Derivative of parameterDerivative_ w.r.t. the depth parameter.*/
+    V3D dm_;  /**<Rotation increment of the bearing vector.*/
+    LWF::NormalVectorElement nor_;  /**<Predicted bearing vector.*/
+    double depParameter_;  /**<Predicted depth parameter.*/
+    Eigen::Matrix2d norJac_;  /**<Derivative of the predicted w.r.t. the previous bearing vector (also used for the warping).*/
+    Eigen::Matrix<double,2,3> A_;  /**<nor_.getM()^T*gSM(nor_.getVec())*Lmat(dm_).*/
+    Eigen::Matrix<double,2,3> norGybJac_;  /**<Derivative of the bearing vector w.r.t. the gyroscope bias, divided by dt.*/
+    Eigen::Matrix<double,1,3> depGybJac_;  /**<Derivative of the depth parameter w.r.t. the gyroscope bias, divided by -dt.*/
   };
+  mutable CameraPrediction cameraPrediction_[mtState::nCam_];
+  mutable FeaturePrediction featurePrediction_[mtState::nMax_];
+  mutable FeaturePropagationBatch<mtState::nMax_> featureBatch_;  /**<Batched propagation of the bearing vectors and depth parameters.*/
+  const double expMapSign_;  /**<Sign convention of QPD::exponentialMap.*/
+  mutable const mtState* predictionCacheState_;  /**<State for which the cached feature predictions are valid (nullptr if invalid).*/
+  mutable double predictionCacheDt_;
+  mutable V3D predictionCacheGyr_;
+  mtNoise zeroNoise_;
+  mutable typename mtNoise::mtDifVec noiseDif_;
+
+  ImuPrediction();
 
   /** \brief Destructor
    */
   virtual ~ImuPrediction(){};
 
+  /** \brief Computes the noise free feature predictions and the terms shared with their Jacobians, in one pass over the features.
+   *
+   *  The result is cached for the given state, dt and gyroscope measurement, such that the subsequent calls of jacNoise
+   *  and of the in-place noise free evalPrediction of the EKF prediction step reuse it.
+   *
+   *  @param state - Previous state.
+   *  @param dt    - Time step.
+   *  @param force - Recompute even if the cache seems valid.
+   */
+  void computeFeaturePredictions(const mtState& state, double dt, bool force = false) const;
+
+  /** \brief Compares the batched feature propagation with the feature propagation of the noisy evaluation (without noise).
+   *
+   *  @param state - Previous state.
+   *  @param meas  - IMU measurement.
+   *  @param dt    - Time step.
+   *  @param th    - Threshold on the bearing vector and depth parameter differences.
+   *  @return true if all differences are below th.
+   */
+  bool testFeaturePropagation(const mtState& state, const mtMeas& meas, double dt, double th);
+
+  /** \brief Sets the input of the batched feature propagation, with the depth parametrization TYPE.
+   *
+   *  Features with another parametrization fall back to the runtime dispatch of FeatureDistance.
+   *
+   *  @param state - Previous state.
+   */
+  template<FeatureDistance::Type TYPE>
+  void setFeatureBatch(const mtState& state) const;
+
+  bool isFeaturePredictionCached(const mtState& state, double dt) const{
+    return predictionCacheState_ == &state && predictionCacheDt_ == dt && predictionCacheGyr_ == meas_.template get<mtMeas::_gyr>();
+  }
+
   /* /brief Evaluation of prediction
    *
-   * @todo implement without noise for speed
+   * The noise free in-place evaluation (EKF prediction) reuses the feature predictions of jacPreviousState.
    */
-  void evalPrediction(mtState& output, const mtState& state, const mtNoise& noise, double dt) const{
-    output.aux().MwWMmeas_ = meas_.template get<mtMeas::_gyr>();
-    output.aux().MwWMest_  = meas_.template get<mtMeas::_gyr>()-state.gyb();
-    const V3D imuRor = output.aux().MwWMest_+noise.template get<mtNoise::_att>()/sqrt(dt);
-    const V3D dOmega = dt*imuRor;
-    QPD dQ = dQ.exponentialMap(dOmega);
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      const int camID = state.CfP(i).camID_;
-      if(&output != &state){
-        output.CfP(i) = state.CfP(i);
-        output.dep(i) = state.dep(i);
-      }
-      if(camID >= 0 && camID < mtState::nCam_){
-        const V3D camRor = state.qCM(camID).rotate(imuRor);
-        const V3D camVel = state.qCM(camID).rotate(V3D(imuRor.cross(state.MrMC(camID))-state.MvM()));
-        oldC_ = state.CfP(i);
-        oldD_ = state.dep(i);
-        output.dep(i).p_ = oldD_.p_-dt*oldD_.getParameterDerivative()*oldC_.get_nor().getVec().transpose()*camVel + noise.template get<mtNoise::_fea>(i)(2)*sqrt(dt);
-        V3D dm = -dt*(gSM(oldC_.get_nor().getVec())*camVel/oldD_.getDistance()
-            + (M3D::Identity()-oldC_.get_nor().getVec()*oldC_.get_nor().getVec().transpose())*camRor)
-            + oldC_.get_nor().getN()*noise.template get<mtNoise::_fea>(i).template block<2,1>(0,0)*sqrt(dt);
-        QPD qm = qm.exponentialMap(dm);
-        output.CfP(i).set_nor(oldC_.get_nor().rotated(qm));
-        // WARP corners
-        if(state.CfP(i).trackWarping_){
-          bearingVectorJac_ = output.CfP(i).get_nor().getM().transpose()*(dt*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)*(
-                                  -1.0/oldD_.getDistance()*gSM(camVel)
-                                  - (M3D::Identity()*(oldC_.get_nor().getVec().dot(camRor))+oldC_.get_nor().getVec()*camRor.transpose()))
-                              +MPD(qm).matrix())*oldC_.get_nor().getM();
-          output.CfP(i).set_warp_nor(bearingVectorJac_*oldC_.get_warp_nor());
-        }
-      }
+  void evalPrediction(mtState& output, const mtState& state, const mtNoise& noise, double dt) const;
+  void noMeasCase(mtFilterState& filterState, mtMeas& meas_, double dt){
+    meas_.template get<mtMeas::_gyr>() = filterState.state_.gyb();
+    meas_.template get<mtMeas::_acc>() = filterState.state_.acb()-filterState.state_.qWM().inverseRotate(g_);
+  }
+  void jacPreviousState(MXD& F, const mtState& state, double dt) const;
+  void jacNoise(MXD& G, const mtState& state, double dt) const;
+  bool detectInertialMotion(const mtState& state, const mtMeas& meas) const{
+    const V3D imuRor = meas.template get<mtMeas::_gyr>()-state.gyb();
+    const V3D imuAcc = meas.template get<mtMeas::_acc>()-state.acb()+state.qWM().inverseRotate(g_);
+    return (imuRor.norm() > inertialMotionRorTh_) | (imuAcc.norm() > inertialMotionAccTh_);
+  }
+};
+
+template<typename FILTERSTATE>
+ImuPrediction<FILTERSTATE>::ImuPrediction():g_(0,0,-9.81), expMapSign_(FeaturePropagationBatch<mtState::nMax_>::expMapSign()){
+  int ind;
+  predictionCacheState_ = nullptr;
+  predictionCacheDt_ = 0.0;
+  predictionCacheGyr_.setZero();
+  zeroNoise_.setIdentity();
+  inertialMotionRorTh_ = 0.1;
+  inertialMotionAccTh_ = 0.1;
+  doubleRegister_.registerScalar("MotionDetection.inertialMotionRorTh",inertialMotionRorTh_);
+  doubleRegister_.registerScalar("MotionDetection.inertialMotionAccTh",inertialMotionAccTh_);
+  for(int i=0;i<mtState::nMax_;i++){
+    ind = mtNoise::template getId<mtNoise::_fea>(i);
+    doubleRegister_.removeScalarByVar(prenoiP_(ind,ind));
+    doubleRegister_.removeScalarByVar(prenoiP_(ind+1,ind+1));
+    doubleRegister_.registerScalar("PredictionNoise.nor",prenoiP_(ind,ind));
+    doubleRegister_.registerScalar("PredictionNoise.nor",prenoiP_(ind+1,ind+1));
+    ind = mtNoise::template getId<mtNoise::_fea>(i)+2;
+    doubleRegister_.removeScalarByVar(prenoiP_(ind,ind));
+    doubleRegister_.registerScalar("PredictionNoise.dep",prenoiP_(ind,ind));
+  }
+  for(int camID=0;camID<mtState::nCam_;camID++){
+    for(int j=0;j<3;j++){
+      doubleRegister_.removeScalarByVar(prenoiP_(mtNoise::template getId<mtNoise::_vep>(camID)+j,mtNoise::template getId<mtNoise::_vep>(camID)+j));
+      doubleRegister_.removeScalarByVar(prenoiP_(mtNoise::template getId<mtNoise::_vea>(camID)+j,mtNoise::template getId<mtNoise::_vea>(camID)+j));
+      doubleRegister_.registerScalar("PredictionNoise.vep",prenoiP_(mtNoise::template getId<mtNoise::_vep>(camID)+j,mtNoise::template getId<mtNoise::_vep>(camID)+j));
+      doubleRegister_.registerScalar("PredictionNoise.vea",prenoiP_(mtNoise::template getId<mtNoise::_vea>(camID)+j,mtNoise::template getId<mtNoise::_vea>(camID)+j));
     }
-    output.WrWM() = state.WrWM()-dt*(state.qWM().rotate(state.MvM())-noise.template get<mtNoise::_pos>()/sqrt(dt));
-    output.MvM() = (M3D::Identity()-gSM(dOmega))*state.MvM()-dt*(meas_.template get<mtMeas::_acc>()-state.acb()+state.qWM().inverseRotate(g_)-noise.template get<mtNoise::_vel>()/sqrt(dt));
-    output.acb() = state.acb()+noise.template get<mtNoise::_acb>()*sqrt(dt);
-    output.gyb() = state.gyb()+noise.template get<mtNoise::_gyb>()*sqrt(dt);
-    output.qWM() = state.qWM()*dQ;
-    for(unsigned int i=0;i<mtState::nCam_;i++){
-      output.MrMC(i) = state.MrMC(i)+noise.template get<mtNoise::_vep>(i)*sqrt(dt);
-      dQ = dQ.exponentialMap(noise.template get<mtNoise::_vea>(i)*sqrt(dt));
-      output.qCM(i) = dQ*state.qCM(i);
+  }
+  for(int i=0;i<mtState::nPose_;i++){
+    for(int j=0;j<3;j++){
+      doubleRegister_.removeScalarByVar(prenoiP_(mtNoise::template getId<mtNoise::_pop>(i)+j,mtNoise::template getId<mtNoise::_pop>(i)+j));
+      doubleRegister_.removeScalarByVar(prenoiP_(mtNoise::template getId<mtNoise::_poa>(i)+j,mtNoise::template getId<mtNoise::_poa>(i)+j));
     }
-    for(unsigned int i=0;i<mtState::nPose_;i++){
-      output.poseLin(i) = state.poseLin(i)+noise.template get<mtNoise::_pop>(i)*sqrt(dt);
-      dQ = dQ.exponentialMap(noise.template get<mtNoise::_poa>(i)*sqrt(dt));
-      output.poseRot(i) = dQ*state.poseRot(i);
+  }
+  disablePreAndPostProcessingWarning_ = true;
+}
+
+template<typename FILTERSTATE>
+void ImuPrediction<FILTERSTATE>::computeFeaturePredictions(const mtState& state, double dt, bool force) const{
+  if(!force && isFeaturePredictionCached(state,dt)) return;
+  const V3D imuRor = meas_.template get<mtMeas::_gyr>()-state.gyb();
+  for(unsigned int camID=0;camID<mtState::nCam_;camID++){
+    CameraPrediction& cp = cameraPrediction_[camID];
+    cp.C_CM_ = MPD(state.qCM(camID)).matrix();
+    cp.CrMC_ = cp.C_CM_*state.MrMC(camID);
+    cp.camRor_ = cp.C_CM_*imuRor;
+    cp.camVel_ = cp.C_CM_*V3D(imuRor.cross(state.MrMC(camID))-state.MvM());
+  }
+  // The depth parametrization is the same for all features of the filter, it is selected once for the whole loop
+  switch(state.dep(0).type_){
+    case FeatureDistance::INVERSE:
+      setFeatureBatch<FeatureDistance::INVERSE>(state);
+      break;
+    case FeatureDistance::LOG:
+      setFeatureBatch<FeatureDistance::LOG>(state);
+      break;
+    case FeatureDistance::HYPERBOLIC:
+      setFeatureBatch<FeatureDistance::HYPERBOLIC>(state);
+      break;
+    default:
+      setFeatureBatch<FeatureDistance::REGULAR>(state);
+      break;
+  }
+  featureBatch_.propagate(dt);
+  QPD qm;
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    FeaturePrediction& fp = featurePrediction_[i];
+    if(fp.isValid_){
+      const CameraPrediction& cp = cameraPrediction_[state.CfP(i).camID_];
+      const LWF::NormalVectorElement& nor = state.CfP(i).get_nor();
+      const double distance = fp.distance_;
+      const M3D Pn = M3D::Identity()-fp.n_*fp.n_.transpose();
+      fp.dm_ = featureBatch_.dm(i);
+      qm = featureBatch_.qm(i,expMapSign_);
+      fp.nor_ = nor.rotated(qm);
+      fp.depParameter_ = featureBatch_.depthParameter(i);
+      fp.A_ = fp.nor_.getM().transpose()*gSM(fp.nor_.getVec())*Lmat(fp.dm_);
+      fp.norJac_ = (dt*fp.A_*(-1.0/distance*gSM(cp.camVel_) - (M3D::Identity()*(fp.n_.dot(cp.camRor_))+fp.n_*cp.camRor_.transpose()))
+                    + fp.nor_.getM().transpose()*MPD(qm).matrix())*nor.getM();
+      fp.norGybJac_ = fp.A_*(-Pn + 1.0/distance*gSM(fp.n_)*gSM(cp.CrMC_))*cp.C_CM_;
+      fp.depGybJac_ = fp.parameterDerivative_*fp.n_.transpose()*gSM(cp.CrMC_)*cp.C_CM_;
     }
-    output.aux().wMeasCov_ = prenoiP_.template block<3,3>(mtNoise::template getId<mtNoise::_att>(),mtNoise::template getId<mtNoise::_att>())/dt;
-    output.fix();
-    if(detectInertialMotion(state,meas_)){
-      output.aux().timeSinceLastInertialMotion_ = 0;
-    } else {
-      output.aux().timeSinceLastInertialMotion_ = output.aux().timeSinceLastInertialMotion_ + dt;
+  }
+  predictionCacheState_ = &state;
+  predictionCacheDt_ = dt;
+  predictionCacheGyr_ = meas_.template get<mtMeas::_gyr>();
+}
+
+template<typename FILTERSTATE>
+bool ImuPrediction<FILTERSTATE>::testFeaturePropagation(const mtState& state, const mtMeas& meas, double dt, double th){
+  meas_ = meas;
+  mtState output = state;
+  evalPrediction(output,state,zeroNoise_,dt); // Out of place evaluation does not use the batch
+  computeFeaturePredictions(state,dt,true);
+  double error = 0.0;
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    if(featurePrediction_[i].isValid_){
+      error = std::max(error,(featurePrediction_[i].nor_.getVec()-output.CfP(i).get_nor().getVec()).norm());
+      error = std::max(error,std::fabs(featurePrediction_[i].depParameter_-output.dep(i).p_));
     }
-    output.aux().timeSinceLastImageMotion_ = output.aux().timeSinceLastImageMotion_ + dt;
   }
-  void noMeasCase(mtFilterState& filterState, mtMeas& meas_, double dt){
-    meas_.template get<mtMeas::_gyr>() = filterState.state_.gyb();
-    meas_.template get<mtMeas::_acc>() = filterState.state_.acb()-filterState.state_.qWM().inverseRotate(g_);
+  predictionCacheState_ = nullptr;
+  if(error > th){
+    std::cout << "\033[31m==== Batched feature propagation differs (" << error << ") ====\033[0m" << std::endl;
+    return false;
   }
-  void jacPreviousState(MXD& F, const mtState& state, double dt) const{
-    const V3D imuRor = meas_.template get<mtMeas::_gyr>()-state.gyb();
-    const V3D dOmega = dt*imuRor;
-    F.setZero();
-    F.template block<3,3>(mtState::template getId<mtState::_pos>(),mtState::template getId<mtState::_pos>()) = M3D::Identity();
-    F.template block<3,3>(mtState::template getId<mtState::_pos>(),mtState::template getId<mtState::_vel>()) = -dt*MPD(state.qWM()).matrix();
-    F.template block<3,3>(mtState::template getId<mtState::_pos>(),mtState::template getId<mtState::_att>()) = dt*gSM(state.qWM().rotate(state.MvM()));
-    F.template block<3,3>(mtState::template getId<mtState::_vel>(),mtState::template getId<mtState::_vel>()) = (M3D::Identity()-gSM(dOmega));
-    F.template block<3,3>(mtState::template getId<mtState::_vel>(),mtState::template getId<mtState::_acb>()) = dt*M3D::Identity();
-    F.template block<3,3>(mtState::template getId<mtState::_vel>(),mtState::template getId<mtState::_gyb>()) = -dt*gSM(state.MvM());
-    F.template block<3,3>(mtState::template getId<mtState::_vel>(),mtState::template getId<mtState::_att>()) = -dt*MPD(state.qWM()).matrix().transpose()*gSM(g_);
-    F.template block<3,3>(mtState::template getId<mtState::_acb>(),mtState::template getId<mtState::_acb>()) = M3D::Identity();
-    F.template block<3,3>(mtState::template getId<mtState::_gyb>(),mtState::template getId<mtState::_gyb>()) = M3D::Identity();
-    F.template block<3,3>(mtState::template getId<mtState::_att>(),mtState::template getId<mtState::_gyb>()) = -dt*MPD(state.qWM()).matrix()*Lmat(dOmega);
-    F.template block<3,3>(mtState::template getId<mtState::_att>(),mtState::template getId<mtState::_att>()) = M3D::Identity();
-    LWF::NormalVectorElement nOut;
-    QPD qm;
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      const int camID = state.CfP(i).camID_;
-      if(camID >= 0 && camID < mtState::nCam_){
-        const V3D camRor = state.qCM(camID).rotate(imuRor);
-        const V3D camVel = state.qCM(camID).rotate(V3D(imuRor.cross(state.MrMC(camID))-state.MvM()));
-        oldC_ = state.CfP(i);
-        oldD_ = state.dep(i);
-        V3D dm = -dt*(gSM(oldC_.get_nor().getVec())*camVel/oldD_.getDistance()
-            + (M3D::Identity()-oldC_.get_nor().getVec()*oldC_.get_nor().getVec().transpose())*camRor);
-        qm = qm.exponentialMap(dm);
-        nOut = oldC_.get_nor().rotated(qm);
-        F(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_fea>(i)+2) = 1.0 - dt*oldD_.getParameterDerivativeCombined()
-                *oldC_.get_nor().getVec().transpose()*camVel;
-        F.template block<1,3>(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_vel>()) =
-            dt*oldD_.getParameterDerivative()*oldC_.get_nor().getVec().transpose()*MPD(state.qCM(camID)).matrix();
-        F.template block<1,3>(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_gyb>()) =
-            -dt*oldD_.getParameterDerivative()*oldC_.get_nor().getVec().transpose()*gSM(state.qCM(camID).rotate(state.MrMC(camID)))*MPD(state.qCM(camID)).matrix();
-        F.template block<1,2>(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_fea>(i)) =
-            -dt*oldD_.getParameterDerivative()*camVel.transpose()*oldC_.get_nor().getM();
-        F.template block<2,2>(mtState::template getId<mtState::_fea>(i),mtState::template getId<mtState::_fea>(i)) =
-            nOut.getM().transpose()*(
-                    dt*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)*(
-                        -1.0/oldD_.getDistance()*gSM(camVel)
-                        - (M3D::Identity()*(oldC_.get_nor().getVec().dot(camRor))+oldC_.get_nor().getVec()*camRor.transpose()))
-                    +MPD(qm).matrix()
-            )*oldC_.get_nor().getM();
-        F.template block<2,1>(mtState::template getId<mtState::_fea>(i),mtState::template getId<mtState::_fea>(i)+2) =
-            -nOut.getM().transpose()*gSM(nOut.getVec())*Lmat(dm)
-                *dt*gSM(oldC_.get_nor().getVec())*camVel*(oldD_.getDistanceDerivative()/(oldD_.getDistance()*oldD_.getDistance()));
-        F.template block<2,3>(mtState::template getId<mtState::_fea>(i),mtState::template getId<mtState::_vel>()) =
-            -nOut.getM().transpose()*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)
-                *dt/oldD_.getDistance()*gSM(oldC_.get_nor().getVec())*MPD(state.qCM(camID)).matrix();
-        F.template block<2,3>(mtState::template getId<mtState::_fea>(i),mtState::template getId<mtState::_gyb>()) =
-            nOut.getM().transpose()*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)*(
-                - (M3D::Identity()-oldC_.get_nor().getVec()*oldC_.get_nor().getVec().transpose())
-                +1.0/oldD_.getDistance()*gSM(oldC_.get_nor().getVec())*gSM(state.qCM(camID).rotate(state.MrMC(camID)))
-            )*dt*MPD(state.qCM(camID)).matrix();
-        if(state.aux().doVECalibration_){
-          F.template block<1,3>(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_vea>(camID)) =
-              dt*oldD_.getParameterDerivative()*oldC_.get_nor().getVec().transpose()*gSM(camVel);
-          F.template block<1,3>(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_vep>(camID)) =
-              -dt*oldD_.getParameterDerivative()*oldC_.get_nor().getVec().transpose()*MPD(state.qCM(camID)).matrix()*gSM(imuRor);
+  std::cout << "\033[32m==== Batched feature propagation is consistent (" << error << ") ====\033[0m" << std::endl;
+  return true;
+}
 
-          F.template block<2,3>(mtState::template getId<mtState::_fea>(i),mtState::template getId<mtState::_vea>(camID)) =
-              -nOut.getM().transpose()*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)*(
-                  (M3D::Identity()-oldC_.get_nor().getVec()*oldC_.get_nor().getVec().transpose())
-              )*dt*gSM(camRor)
-              -nOut.getM().transpose()*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)
-                  *dt/oldD_.getDistance()*gSM(oldC_.get_nor().getVec())*gSM(camVel);
-          F.template block<2,3>(mtState::template getId<mtState::_fea>(i),mtState::template getId<mtState::_vep>(camID)) =
-              nOut.getM().transpose()*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)
-                  *dt/oldD_.getDistance()*gSM(oldC_.get_nor().getVec())*MPD(state.qCM(camID)).matrix()*gSM(imuRor);
-        }
+template<typename FILTERSTATE>
+template<FeatureDistance::Type TYPE>
+void ImuPrediction<FILTERSTATE>::setFeatureBatch(const mtState& state) const{
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    FeaturePrediction& fp = featurePrediction_[i];
+    const int camID = state.CfP(i).camID_;
+    fp.isValid_ = camID >= 0 && camID < mtState::nCam_;
+    if(fp.isValid_){
+      const FeatureDistance& dep = state.dep(i);
+      if(dep.type_ == TYPE){
+        fp.distance_ = FeatureDistancePolicy<TYPE>::getDistance(dep.p_);
+        fp.distanceDerivative_ = FeatureDistancePolicy<TYPE>::getDistanceDerivative(dep.p_);
+        fp.parameterDerivative_ = FeatureDistancePolicy<TYPE>::getParameterDerivative(dep.p_);
+        fp.parameterDerivativeCombined_ = FeatureDistancePolicy<TYPE>::getParameterDerivativeCombined(dep.p_);
+      } else {
+        fp.distance_ = dep.getDistance();
+        fp.distanceDerivative_ = dep.getDistanceDerivative();
+        fp.parameterDerivative_ = dep.getParameterDerivative();
+        fp.parameterDerivativeCombined_ = dep.getParameterDerivativeCombined();
       }
-    }
-    for(unsigned int i=0;i<mtState::nCam_;i++){
-      F.template block<3,3>(mtState::template getId<mtState::_vep>(i),mtState::template getId<mtState::_vep>(i)) = M3D::Identity();
-      F.template block<3,3>(mtState::template getId<mtState::_vea>(i),mtState::template getId<mtState::_vea>(i)) = M3D::Identity();
-    }
-    for(unsigned int i=0;i<mtState::nPose_;i++){
-      F.template block<3,3>(mtState::template getId<mtState::_pop>(i),mtState::template getId<mtState::_pop>(i)) = M3D::Identity();
-      F.template block<3,3>(mtState::template getId<mtState::_poa>(i),mtState::template getId<mtState::_poa>(i)) = M3D::Identity();
+      fp.n_ = state.CfP(i).get_nor().getVec();
+      const CameraPrediction& cp = cameraPrediction_[camID];
+      featureBatch_.setFeature(i,fp.n_,cp.camVel_,cp.camRor_,fp.distance_,fp.parameterDerivative_,dep.p_);
+    } else {
+      featureBatch_.setInvalid(i);
     }
   }
-  void jacNoise(MXD& G, const mtState& state, double dt) const{
-    const V3D imuRor = meas_.template get<mtMeas::_gyr>()-state.gyb();
-    const V3D dOmega = dt*imuRor;
-    G.setZero();
-    G.template block<3,3>(mtState::template getId<mtState::_pos>(),mtNoise::template getId<mtNoise::_pos>()) = M3D::Identity()*sqrt(dt);
-    G.template block<3,3>(mtState::template getId<mtState::_vel>(),mtNoise::template getId<mtNoise::_vel>()) = M3D::Identity()*sqrt(dt);
-    G.template block<3,3>(mtState::template getId<mtState::_vel>(),mtNoise::template getId<mtNoise::_att>()) = gSM(state.MvM())*sqrt(dt);
-    G.template block<3,3>(mtState::template getId<mtState::_acb>(),mtNoise::template getId<mtNoise::_acb>()) = M3D::Identity()*sqrt(dt);
-    G.template block<3,3>(mtState::template getId<mtState::_gyb>(),mtNoise::template getId<mtNoise::_gyb>()) = M3D::Identity()*sqrt(dt);
-    G.template block<3,3>(mtState::template getId<mtState::_att>(),mtNoise::template getId<mtNoise::_att>()) = MPD(state.qWM()).matrix()*Lmat(dOmega)*sqrt(dt);
-    for(unsigned int i=0;i<mtState::nCam_;i++){
-      G.template block<3,3>(mtState::template getId<mtState::_vep>(i),mtNoise::template getId<mtNoise::_vep>(i)) = M3D::Identity()*sqrt(dt);
-      G.template block<3,3>(mtState::template getId<mtState::_vea>(i),mtNoise::template getId<mtNoise::_vea>(i)) = M3D::Identity()*sqrt(dt);
+}
+
+template<typename FILTERSTATE>
+void ImuPrediction<FILTERSTATE>::evalPrediction(mtState& output, const mtState& state, const mtNoise& noise, double dt) const{
+  noise.boxMinus(zeroNoise_,noiseDif_);
+  const bool useCache = &output == &state && noiseDif_.isZero(0.0) && isFeaturePredictionCached(state,dt);
+  predictionCacheState_ = nullptr;
+  output.aux().MwWMmeas_ = meas_.template get<mtMeas::_gyr>();
+  output.aux().MwWMest_  = meas_.template get<mtMeas::_gyr>()-state.gyb();
+  const V3D imuRor = output.aux().MwWMest_+noise.template get<mtNoise::_att>()/sqrt(dt);
+  const V3D dOmega = dt*imuRor;
+  QPD dQ = dQ.exponentialMap(dOmega);
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    const int camID = state.CfP(i).camID_;
+    if(&output != &state){
+      output.CfP(i) = state.CfP(i);
+      output.dep(i) = state.dep(i);
     }
-    for(unsigned int i=0;i<mtState::nPose_;i++){
-      G.template block<3,3>(mtState::template getId<mtState::_pop>(i),mtNoise::template getId<mtNoise::_pop>(i)) = M3D::Identity()*sqrt(dt);
-      G.template block<3,3>(mtState::template getId<mtState::_poa>(i),mtNoise::template getId<mtNoise::_poa>(i)) = M3D::Identity()*sqrt(dt);
+    if(useCache){
+      const FeaturePrediction& fp = featurePrediction_[i];
+      if(fp.isValid_){
+        output.dep(i).p_ = fp.depParameter_;
+        if(state.CfP(i).trackWarping_){
+          bearingVectorJac_ = fp.norJac_*state.CfP(i).get_warp_nor();
+          output.CfP(i).set_nor(fp.nor_);
+          output.CfP(i).set_warp_nor(bearingVectorJac_);
+        } else {
+          output.CfP(i).set_nor(fp.nor_);
+        }
+      }
+    } else if(camID >= 0 && camID < mtState::nCam_){
+      const V3D camRor = state.qCM(camID).rotate(imuRor);
+      const V3D camVel = state.qCM(camID).rotate(V3D(imuRor.cross(state.MrMC(camID))-state.MvM()));
+      oldC_ = state.CfP(i);
+      oldD_ = state.dep(i);
+      output.dep(i).p_ = oldD_.p_-dt*oldD_.getParameterDerivative()*oldC_.get_nor().getVec().transpose()*camVel + noise.template get<mtNoise::_fea>(i)(2)*sqrt(dt);
+      V3D dm = -dt*(gSM(oldC_.get_nor().getVec())*camVel/oldD_.getDistance()
+          + (M3D::Identity()-oldC_.get_nor().getVec()*oldC_.get_nor().getVec().transpose())*camRor)
+          + oldC_.get_nor().getN()*noise.template get<mtNoise::_fea>(i).template block<2,1>(0,0)*sqrt(dt);
+      QPD qm = qm.exponentialMap(dm);
+      output.CfP(i).set_nor(oldC_.get_nor().rotated(qm));
+      // WARP corners
+      if(state.CfP(i).trackWarping_){
+        bearingVectorJac_ = output.CfP(i).get_nor().getM().transpose()*(dt*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)*(
+                                -1.0/oldD_.getDistance()*gSM(camVel)
+                                - (M3D::Identity()*(oldC_.get_nor().getVec().dot(camRor))+oldC_.get_nor().getVec()*camRor.transpose()))
+                            +MPD(qm).matrix())*oldC_.get_nor().getM();
+        output.CfP(i).set_warp_nor(bearingVectorJac_*oldC_.get_warp_nor());
+      }
     }
-    LWF::NormalVectorElement nOut;
-    for(unsigned int i=0;i<mtState::nMax_;i++){
+  }
+  output.WrWM() = state.WrWM()-dt*(state.qWM().rotate(state.MvM())-noise.template get<mtNoise::_pos>()/sqrt(dt));
+  output.MvM() = (M3D::Identity()-gSM(dOmega))*state.MvM()-dt*(meas_.template get<mtMeas::_acc>()-state.acb()+state.qWM().inverseRotate(g_)-noise.template get<mtNoise::_vel>()/sqrt(dt));
+  output.acb() = state.acb()+noise.template get<mtNoise::_acb>()*sqrt(dt);
+  output.gyb() = state.gyb()+noise.template get<mtNoise::_gyb>()*sqrt(dt);
+  output.qWM() = state.qWM()*dQ;
+  for(unsigned int i=0;i<mtState::nCam_;i++){
+    output.MrMC(i) = state.MrMC(i)+noise.template get<mtNoise::_vep>(i)*sqrt(dt);
+    dQ = dQ.exponentialMap(noise.template get<mtNoise::_vea>(i)*sqrt(dt));
+    output.qCM(i) = dQ*state.qCM(i);
+  }
+  for(unsigned int i=0;i<mtState::nPose_;i++){
+    output.poseLin(i) = state.poseLin(i)+noise.template get<mtNoise::_pop>(i)*sqrt(dt);
+    dQ = dQ.exponentialMap(noise.template get<mtNoise::_poa>(i)*sqrt(dt));
+    output.poseRot(i) = dQ*state.poseRot(i);
+  }
+  output.aux().wMeasCov_ = prenoiP_.template block<3,3>(mtNoise::template getId<mtNoise::_att>(),mtNoise::template getId<mtNoise::_att>())/dt;
+  output.fix();
+  if(detectInertialMotion(state,meas_)){
+    output.aux().timeSinceLastInertialMotion_ = 0;
+  } else {
+    output.aux().timeSinceLastInertialMotion_ = output.aux().timeSinceLastInertialMotion_ + dt;
+  }
+  output.aux().timeSinceLastImageMotion_ = output.aux().timeSinceLastImageMotion_ + dt;
+}
+
+template<typename FILTERSTATE>
+void ImuPrediction<FILTERSTATE>::jacPreviousState(MXD& F, const mtState& state, double dt) const{
+  const V3D imuRor = meas_.template get<mtMeas::_gyr>()-state.gyb();
+  const V3D dOmega = dt*imuRor;
+  F.setZero();
+  F.template block<3,3>(mtState::template getId<mtState::_pos>(),mtState::template getId<mtState::_pos>()) = M3D::Identity();
+  F.template block<3,3>(mtState::template getId<mtState::_pos>(),mtState::template getId<mtState::_vel>()) = -dt*MPD(state.qWM()).matrix();
+  F.template block<3,3>(mtState::template getId<mtState::_pos>(),mtState::template getId<mtState::_att>()) = dt*gSM(state.qWM().rotate(state.MvM()));
+  F.template block<3,3>(mtState::template getId<mtState::_vel>(),mtState::template getId<mtState::_vel>()) = (M3D::Identity()-gSM(dOmega));
+  F.template block<3,3>(mtState::template getId<mtState::_vel>(),mtState::template getId<mtState::_acb>()) = dt*M3D::Identity();
+  F.template block<3,3>(mtState::template getId<mtState::_vel>(),mtState::template getId<mtState::_gyb>()) = -dt*gSM(state.MvM());
+  F.template block<3,3>(mtState::template getId<mtState::_vel>(),mtState::template getId<mtState::_att>()) = -dt*MPD(state.qWM()).matrix().transpose()*gSM(g_);
+  F.template block<3,3>(mtState::template getId<mtState::_acb>(),mtState::template getId<mtState::_acb>()) = M3D::Identity();
+  F.template block<3,3>(mtState::template getId<mtState::_gyb>(),mtState::template getId<mtState::_gyb>()) = M3D::Identity();
+  F.template block<3,3>(mtState::template getId<mtState::_att>(),mtState::template getId<mtState::_gyb>()) = -dt*MPD(state.qWM()).matrix()*Lmat(dOmega);
+  F.template block<3,3>(mtState::template getId<mtState::_att>(),mtState::template getId<mtState::_att>()) = M3D::Identity();
+  computeFeaturePredictions(state,dt,true);
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    const FeaturePrediction& fp = featurePrediction_[i];
+    if(fp.isValid_){
       const int camID = state.CfP(i).camID_;
-      if(camID >= 0 && camID < mtState::nCam_){
-        oldC_ = state.CfP(i);
-        oldD_ = state.dep(i);
-        const V3D camRor = state.qCM(camID).rotate(imuRor);
-        const V3D camVel = state.qCM(camID).rotate(V3D(imuRor.cross(state.MrMC(camID))-state.MvM()));
-        V3D dm = -dt*(gSM(oldC_.get_nor().getVec())*camVel/oldD_.getDistance()
-            + (M3D::Identity()-oldC_.get_nor().getVec()*oldC_.get_nor().getVec().transpose())*camRor);
-        QPD qm = qm.exponentialMap(dm);
-        nOut = oldC_.get_nor().rotated(qm);
-        G(mtState::template getId<mtState::_fea>(i)+2,mtNoise::template getId<mtNoise::_fea>(i)+2) = sqrt(dt);
-        G.template block<1,3>(mtState::template getId<mtState::_fea>(i)+2,mtNoise::template getId<mtNoise::_att>()) =
-            sqrt(dt)*oldD_.getParameterDerivative()*oldC_.get_nor().getVec().transpose()*gSM(state.qCM(camID).rotate(state.MrMC(camID)))*MPD(state.qCM(camID)).matrix();
-        G.template block<2,2>(mtState::template getId<mtState::_fea>(i),mtNoise::template getId<mtNoise::_fea>(i)) =
-            -nOut.getM().transpose()*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)*oldC_.get_nor().getN()*sqrt(dt);
-        G.template block<2,3>(mtState::template getId<mtState::_fea>(i),mtNoise::template getId<mtNoise::_att>()) =
-            -nOut.getM().transpose()*gSM(qm.rotate(oldC_.get_nor().getVec()))*Lmat(dm)*(
-                - (M3D::Identity()-oldC_.get_nor().getVec()*oldC_.get_nor().getVec().transpose())
-                +1.0/oldD_.getDistance()*gSM(oldC_.get_nor().getVec())*gSM(state.qCM(camID).rotate(state.MrMC(camID)))
-             )*sqrt(dt)*MPD(state.qCM(camID)).matrix();
+      const CameraPrediction& cp = cameraPrediction_[camID];
+      const double distance = fp.distance_;
+      const int feaID = mtState::template getId<mtState::_fea>(i);
+      F(feaID+2,feaID+2) = 1.0 - dt*fp.parameterDerivativeCombined_*fp.n_.dot(cp.camVel_);
+      F.template block<1,3>(feaID+2,mtState::template getId<mtState::_vel>()) = dt*fp.parameterDerivative_*fp.n_.transpose()*cp.C_CM_;
+      F.template block<1,3>(feaID+2,mtState::template getId<mtState::_gyb>()) = -dt*fp.depGybJac_;
+      F.template block<1,2>(feaID+2,feaID) = -dt*fp.parameterDerivative_*cp.camVel_.transpose()*state.CfP(i).get_nor().getM();
+      F.template block<2,2>(feaID,feaID) = fp.norJac_;
+      F.template block<2,1>(feaID,feaID+2) = -fp.A_*dt*gSM(fp.n_)*cp.camVel_*(fp.distanceDerivative_/(distance*distance));
+      F.template block<2,3>(feaID,mtState::template getId<mtState::_vel>()) = -fp.A_*dt/distance*gSM(fp.n_)*cp.C_CM_;
+      F.template block<2,3>(feaID,mtState::template getId<mtState::_gyb>()) = dt*fp.norGybJac_;
+      if(state.aux().doVECalibration_){
+        F.template block<1,3>(feaID+2,mtState::template getId<mtState::_vea>(camID)) =
+            dt*fp.parameterDerivative_*fp.n_.transpose()*gSM(cp.camVel_);
+        F.template block<1,3>(feaID+2,mtState::template getId<mtState::_vep>(camID)) =
+            -dt*fp.parameterDerivative_*fp.n_.transpose()*cp.C_CM_*gSM(imuRor);
+        F.template block<2,3>(feaID,mtState::template getId<mtState::_vea>(camID)) =
+            -fp.A_*(M3D::Identity()-fp.n_*fp.n_.transpose())*dt*gSM(cp.camRor_)
+            -fp.A_*dt/distance*gSM(fp.n_)*gSM(cp.camVel_);
+        F.template block<2,3>(feaID,mtState::template getId<mtState::_vep>(camID)) =
+            fp.A_*dt/distance*gSM(fp.n_)*cp.C_CM_*gSM(imuRor);
       }
     }
   }
-  bool detectInertialMotion(const mtState& state, const mtMeas& meas) const{
-    const V3D imuRor = meas.template get<mtMeas::_gyr>()-state.gyb();
-    const V3D imuAcc = meas.template get<mtMeas::_acc>()-state.acb()+state.qWM().inverseRotate(g_);
-    return (imuRor.norm() > inertialMotionRorTh_) | (imuAcc.norm() > inertialMotionAccTh_);
+  for(unsigned int i=0;i<mtState::nCam_;i++){
+    F.template block<3,3>(mtState::template getId<mtState::_vep>(i),mtState::template getId<mtState::_vep>(i)) = M3D::Identity();
+    F.template block<3,3>(mtState::template getId<mtState::_vea>(i),mtState::template getId<mtState::_vea>(i)) = M3D::Identity();
   }
-};
+  for(unsigned int i=0;i<mtState::nPose_;i++){
+    F.template block<3,3>(mtState::template getId<mtState::_pop>(i),mtState::template getId<mtState::_pop>(i)) = M3D::Identity();
+    F.template block<3,3>(mtState::template getId<mtState::_poa>(i),mtState::template getId<mtState::_poa>(i)) = M3D::Identity();
+  }
+}
+
+template<typename FILTERSTATE>
+void ImuPrediction<FILTERSTATE>::jacNoise(MXD& G, const mtState& state, double dt) const{
+  const V3D imuRor = meas_.template get<mtMeas::_gyr>()-state.gyb();
+  const V3D dOmega = dt*imuRor;
+  G.setZero();
+  G.template block<3,3>(mtState::template getId<mtState::_pos>(),mtNoise::template getId<mtNoise::_pos>()) = M3D::Identity()*sqrt(dt);
+  G.template block<3,3>(mtState::template getId<mtState::_vel>(),mtNoise::template getId<mtNoise::_vel>()) = M3D::Identity()*sqrt(dt);
+  G.template block<3,3>(mtState::template getId<mtState::_vel>(),mtNoise::template getId<mtNoise::_att>()) = gSM(state.MvM())*sqrt(dt);
+  G.template block<3,3>(mtState::template getId<mtState::_acb>(),mtNoise::template getId<mtNoise::_acb>()) = M3D::Identity()*sqrt(dt);
+  G.template block<3,3>(mtState::template getId<mtState::_gyb>(),mtNoise::template getId<mtNoise::_gyb>()) = M3D::Identity()*sqrt(dt);
+  G.template block<3,3>(mtState::template getId<mtState::_att>(),mtNoise::template getId<mtNoise::_att>()) = MPD(state.qWM()).matrix()*Lmat(dOmega)*sqrt(dt);
+  for(unsigned int i=0;i<mtState::nCam_;i++){
+    G.template block<3,3>(mtState::template getId<mtState::_vep>(i),mtNoise::template getId<mtNoise::_vep>(i)) = M3D::Identity()*sqrt(dt);
+    G.template block<3,3>(mtState::template getId<mtState::_vea>(i),mtNoise::template getId<mtNoise::_vea>(i)) = M3D::Identity()*sqrt(dt);
+  }
+  for(unsigned int i=0;i<mtState::nPose_;i++){
+    G.template block<3,3>(mtState::template getId<mtState::_pop>(i),mtNoise::template getId<mtNoise::_pop>(i)) = M3D::Identity()*sqrt(dt);
+    G.template block<3,3>(mtState::template getId<mtState::_poa>(i),mtNoise::template getId<mtNoise::_poa>(i)) = M3D::Identity()*sqrt(dt);
+  }
+  computeFeaturePredictions(state,dt);
+  for(unsigned int i=0;i<mtState::nMax_;i++){
+    const FeaturePrediction& fp = featurePrediction_[i];
+    if(fp.isValid_){
+      const int feaID = mtState::template getId<mtState::_fea>(i);
+      G(feaID+2,mtNoise::template getId<mtNoise::_fea>(i)+2) = sqrt(dt);
+      G.template block<1,3>(feaID+2,mtNoise::template getId<mtNoise::_att>()) = sqrt(dt)*fp.depGybJac_;
+      G.template block<2,2>(feaID,mtNoise::template getId<mtNoise::_fea>(i)) = -fp.A_*state.CfP(i).get_nor().getN()*sqrt(dt);
+      G.template block<2,3>(feaID,mtNoise::template getId<mtNoise::_att>()) = -sqrt(dt)*fp.norGybJac_;
+    }
+  }
+}
 
 }
 
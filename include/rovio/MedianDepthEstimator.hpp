@@ -0,0 +1,129 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_MEDIANDEPTHESTIMATOR_HPP_
+#define ROVIO_MEDIANDEPTHESTIMATOR_HPP_
+
+#include <algorithm>
+#include <array>
+
+namespace rovio{
+
+/** \brief Incrementally maintained per-camera statistic of the feature distance parameters.
+ *
+ *  Holds one slot per feature and camera, which is refreshed (for all cameras) whenever the feature has been updated. The median is then computed
+ *  over at most nMax cached values, instead of re-transforming every feature (and its covariance) into every camera frame.
+ *  Each slot stores the feature ID it was written for, such that slots of removed or replaced features are ignored.
+ *
+ *  @tparam nMax - Maximal number of considered features in the filter state.
+ *  @tparam nCam - Used total number of cameras.
+ */
+template<unsigned int nMax, int nCam>
+class MedianDepthEstimator{
+ public:
+  double p_[nCam][nMax];  /**<Cached distance parameter of each feature in each camera frame.*/
+  int idx_[nCam][nMax];  /**<Feature ID for which the slot was written, -1 if empty.*/
+  mutable std::array<double,nMax> buffer_;  /**<Temporary for the median computation.*/
+
+  /** \brief Constructor
+   */
+  MedianDepthEstimator(){
+    reset();
+  }
+
+  /** \brief Destructor
+   */
+  virtual ~MedianDepthEstimator(){};
+
+  /** \brief Clears all slots.
+   */
+  void reset(){
+    for(int camID=0;camID<nCam;camID++){
+      std::fill(idx_[camID],idx_[camID]+nMax,-1);
+    }
+  }
+
+  /** \brief Sets the distance parameter of a feature in a given camera frame.
+   *
+   *  @param camID - Camera ID of the frame in which the distance parameter is expressed.
+   *  @param i     - Feature index in the state.
+   *  @param idx   - Feature ID (\ref FeatureManager::idx_).
+   *  @param p     - Distance parameter.
+   */
+  void update(const int camID, const unsigned int i, const int idx, const double p){
+    p_[camID][i] = p;
+    idx_[camID][i] = idx;
+  }
+
+  /** \brief Clears the slot of a feature in a given camera frame (e.g. if the feature is too uncertain).
+   *
+   *  @param camID - Camera ID.
+   *  @param i     - Feature index in the state.
+   */
+  void remove(const int camID, const unsigned int i){
+    idx_[camID][i] = -1;
+  }
+
+  /** \brief Clears the slots of a feature in all camera frames (e.g. if the feature has been removed).
+   *
+   *  @param i     - Feature index in the state.
+   */
+  void remove(const unsigned int i){
+    for(int camID=0;camID<nCam;camID++){
+      idx_[camID][i] = -1;
+    }
+  }
+
+  /** \brief Get the median distance parameter values for each camera.
+   *
+   *  @param initDistanceParameter    - Value which is set, if no median could be computed for a specific camera.
+   *  @param medianDistanceParameters - Array, containing the median distance parameter values for each camera.
+   *  @param fsm                      - Feature set manager, used for checking whether the cached slots are still up-to-date.
+   */
+  template<typename FSM>
+  void getMedianDepthParameters(double initDistanceParameter, std::array<double,nCam>* medianDistanceParameters, const FSM& fsm) const{
+    medianDistanceParameters->fill(initDistanceParameter);
+    for(int camID=0;camID<nCam;camID++){
+      int size = 0;
+      for(unsigned int i=0;i<nMax;i++){
+        if(idx_[camID][i] >= 0 && fsm.isValid_[i] && fsm.features_[i].idx_ == idx_[camID][i]){
+          buffer_[size++] = p_[camID][i];
+        }
+      }
+      if(size > 3) { // Require a minimum of three features
+        std::nth_element(buffer_.begin(), buffer_.begin() + size / 2, buffer_.begin() + size);
+        (*medianDistanceParameters)[camID] = buffer_[size/2];
+      }
+    }
+  }
+};
+
+}
+
+
+#endif /* ROVIO_MEDIANDEPTHESTIMATOR_HPP_ */
@@ -31,6 +31,7 @@
 
 #include "rovio/Patch.hpp"
 #include "rovio/FeatureCoordinates.hpp"
+#include "rovio/PixelCoordinates.hpp"
 #include "rovio/ImagePyramid.hpp"
 
 namespace rovio{
@@ -87,7 +88,7 @@ class MultilevelPatch{
     int count = 0;
     for(int i=l1;i<=l2;i++){
       if(isValidPatch_[i]){
-        H_ += pow(0.25,i)*patches_[i].getHessian();
+        H_ += LevelScales<nLevels>::squaredDown(i)*patches_[i].getHessian();
         count++;
       }
     }
@@ -128,8 +129,8 @@ class MultilevelPatch{
   void drawMultilevelPatch(cv::Mat& drawImg,const cv::Point2i& c,int stretch = 1,const bool withBorder = false) const{
     for(int l=nLevels_-1;l>=0;l--){
       if(isValidPatch_[l]){
-        cv::Point2i corner = cv::Point2i((patchSize/2+(int)withBorder)*(pow(2,nLevels_-1)-pow(2,l)),(patchSize/2+(int)withBorder)*(pow(2,nLevels_-1)-pow(2,l)));
-        patches_[l].drawPatch(drawImg,c+corner,stretch*pow(2,l),withBorder);
+        const int cornerOffset = (patchSize/2+(int)withBorder)*((1<<(nLevels_-1))-(1<<l));
+        patches_[l].drawPatch(drawImg,c+cv::Point2i(cornerOffset,cornerOffset),stretch*(1<<l),withBorder);
       }
     }
   }
@@ -141,7 +142,7 @@ class MultilevelPatch{
    * @param color       - Line color.
    */
   void drawMultilevelPatchBorder(cv::Mat& drawImg,const FeatureCoordinates& c,const float s, const cv::Scalar& color) const{
-    patches_[0].drawPatchBorder(drawImg,c,s*pow(2.0,nLevels-1),color);
+    patches_[0].drawPatchBorder(drawImg,c,s*LevelScales<nLevels>::up(nLevels-1),color);
   }
 
   /** \brief Computes the RMSE (Root Mean Squared Error) with respect to the patches of an other MultilevelPatch
@@ -170,7 +171,8 @@ class MultilevelPatch{
       const float* it_patch_in = mp.patches_[l].patch_;
       for(int y=0; y<patchSize; ++y){
         for(int x=0; x<patchSize; ++x, ++it_patch, ++it_patch_in){
-          error += std::pow(*it_patch - *it_patch_in - offset,2);
+          const float diff = *it_patch - *it_patch_in - offset;
+          error += diff*diff;
         }
       }
     }
@@ -188,8 +190,20 @@ class MultilevelPatch{
    *                      If false, the check is only executed with the general patch dimensions.
    */
   static bool isMultilevelPatchInFrame(const ImagePyramid<nLevels>& pyr,const FeatureCoordinates& c, const int l = nLevels-1,const bool withBorder = false){
-    if(!c.isInFront() || !c.com_warp_c()) return false;
-    const auto coorTemp = pyr.levelTranformCoordinates(c,0,l);
+    PixelCoordinates pc;
+    return pc.fromFeatureCoordinates(c) && isMultilevelPatchInFrame(pyr,pc,l,withBorder);
+  }
+
+  /** \brief Checks if the MultilevelPatchFeature's patches are fully located within the corresponding images.
+   *
+   * @param pyr         - Image pyramid, which should be checked to fully contain the patches.
+   * @param c           - Pixel coordinates and warping of the patch in the reference image (level 0).
+   * @param l           - Maximal pyramid level which should be checked (Note: The maximal level is the critical level.)
+   * @param withBorder  - If true, the check is executed with the expanded patch dimensions (incorporates the general patch dimensions).
+   *                      If false, the check is only executed with the general patch dimensions.
+   */
+  static bool isMultilevelPatchInFrame(const ImagePyramid<nLevels>& pyr,const PixelCoordinates& c, const int l = nLevels-1,const bool withBorder = false){
+    const PixelCoordinates coorTemp = pyr.levelTranformCoordinates(c,0,l);
     return Patch<patchSize>::isPatchInFrame(pyr.imgs_[l],coorTemp,withBorder);
   }
 
@@ -202,8 +216,25 @@ class MultilevelPatch{
    * @param withBorder  - If true, both, the general patches and the corresponding expanded patches are extracted.
    */
   void extractMultilevelPatchFromImage(const ImagePyramid<nLevels>& pyr,const FeatureCoordinates& c, const int l = nLevels-1,const bool withBorder = false){
+    PixelCoordinates pc;
+    pc.fromFeatureCoordinates(c);
+    extractMultilevelPatchFromImage(pyr,pc,l,withBorder);
+  }
+
+  /** \brief Extracts a multilevel patch from a given image pyramid.
+   *
+   * @param pyr         - Image pyramid from which the patch data should be extracted.
+   * @param c           - Pixel coordinates and warping of the patch in the reference image (level 0).
+   * @param l           - Patches are extracted from pyramid level 0 to l (levels below the base level of the pyramid are marked invalid).
+   * @param withBorder  - If true, both, the general patches and the corresponding expanded patches are extracted.
+   */
+  void extractMultilevelPatchFromImage(const ImagePyramid<nLevels>& pyr,const PixelCoordinates& c, const int l = nLevels-1,const bool withBorder = false){
     for(unsigned int i=0;i<=l;i++){
-      const auto coorTemp = pyr.levelTranformCoordinates(c,0,i);
+      if(pyr.imgs_[i].empty()){
+        isValidPatch_[i] = false;
+        continue;
+      }
+      const PixelCoordinates coorTemp = pyr.levelTranformCoordinates(c,0,i);
       isValidPatch_[i] = true;
       patches_[i].extractPatchFromImage(pyr.imgs_[i],coorTemp,withBorder);
     }
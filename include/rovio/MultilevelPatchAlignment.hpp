@@ -33,6 +33,7 @@
 #include "rovio/ImagePyramid.hpp"
 #include "rovio/MultilevelPatch.hpp"
 #include "rovio/FeatureCoordinates.hpp"
+#include "rovio/PixelCoordinates.hpp"
 
 namespace rovio{
 
@@ -48,7 +49,7 @@ class MultilevelPatchAlignment {
   mutable Eigen::MatrixXf b_;  /**<b matrix/vector of the linear system of equations, needed for the multilevel patch alignment.*/
   mutable Eigen::ColPivHouseholderQR<Eigen::MatrixXf> mColPivHouseholderQR_;  /**<QR decomposition module. Used for computiong reduces system of equations.*/
   mutable Eigen::JacobiSVD<Eigen::MatrixXf> svd_; /**<SVD module. Used for solving linear equation systems.*/
-  mutable FeatureCoordinates bestCoordinateMatch_; /**<Best current pixel coordinate match.*/
+  mutable PixelCoordinates bestCoordinateMatch_; /**<Best current pixel coordinate match.*/
   mutable double bestIntensityError_; /**<Intensity error for the match.*/
   mutable MultilevelPatch<nLevels,patch_size> mlpTemp_; /**<Temporary multilevel patch used for various computations.*/
   mutable MultilevelPatch<nLevels,patch_size> mlpError_;  /**<Multilevel patch containing errors and its gradient.*/
@@ -56,6 +57,7 @@ class MultilevelPatchAlignment {
   float huberNormThreshold_;  /**<Intensity error threshold for Huber norm.*/
   float w_[nLevels*patch_size*patch_size] __attribute__ ((aligned (16)));  /**<Weighting for patch intensity errors.*/
   bool useWeighting_; /**<Should weighting be performed for patch intensity errors.*/
+  float weightingSigma_;  /**<Width of the Gaussian weighting, identifies the weighting in the cached template statistics of the patches.*/
   bool useIntensityOffset_; /**<Should an intensity offset between the patches be considered.*/
   bool useIntensitySqew_; /**<Should an intensity sqewing between the patches be considered.*/
   float gradientExponent_;  /**<Exponent used for gradient based weighting of residuals.*/
@@ -77,6 +79,7 @@ class MultilevelPatchAlignment {
    */
   void computeWeightings(const float sigma){
     useWeighting_ = sigma > 0;
+    weightingSigma_ = sigma;
     if(useWeighting_){
       for(int l = 0; l < nLevels; l++){
         for(int y=0; y<patch_size; ++y){
@@ -107,91 +110,96 @@ class MultilevelPatchAlignment {
    * @param A           - Jacobian of the pixel intensities w.r.t. to pixel coordinates
    * @param b           - Intensity errors
    * @return true, if successful.
-   * @todo catch if warping too distorted
    */
   bool getLinearAlignEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& c, const int l1, const int l2,
                                Eigen::MatrixXf& A, Eigen::MatrixXf& b){
+    PixelCoordinates pc;
+    if(!pc.fromFeatureCoordinates(c)){
+      A.resize(0,0);
+      b.resize(0,0);
+      return false;
+    }
+    return getLinearAlignEquations(pyr,mp,pc,l1,l2,A,b);
+  }
+
+  /** \brief Get the raw linear align equations (A*x=b), given by the [(#pixel)x2] Matrix  A (float) and the [(#pixel)x1] vector b (float).
+   *
+   * @param pyr         - Considered image pyramid.
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param c           - Pixel coordinates and warping of the patch in the reference image.
+   * @param l1          - Start pyramid level (l1<l2)
+   * @param l2          - End pyramid level (l1<l2)
+   * @param A           - Jacobian of the pixel intensities w.r.t. to pixel coordinates
+   * @param b           - Intensity errors
+   * @return true, if successful.
+   * @todo catch if warping too distorted
+   */
+  bool getLinearAlignEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PixelCoordinates& c, const int l1, const int l2,
+                               Eigen::MatrixXf& A, Eigen::MatrixXf& b){
     A.resize(0,0);
     b.resize(0,0);
+    const bool isNearIdentityWarping = c.isNearIdentityWarping();
     Eigen::Matrix2f affInv;
-    if(!c.com_c() || !c.com_warp_c()){
-      return false;
+    if(!isNearIdentityWarping){
+      affInv = c.get_warp_c().inverse();
     }
-    affInv = c.get_warp_c().inverse();
     int numLevel = 0;
-    const int halfpatch_size = patch_size/2;
     float wTot = 0;
     float mean_x = 0;
     float mean_xx = 0;
     float mean_xy = 0;
-    float mean_xy_dx = 0;
-    float mean_xy_dy = 0;
     float mean_y = 0;
-    float mean_y_dx = 0;
-    float mean_y_dy = 0;
+    float sum_dx = 0;
+    float sum_dy = 0;
+    float sum_x_dx = 0;
+    float sum_x_dy = 0;
 
-    // Compute raw error and gradients, as well as mean
+    // Compute raw error and image-side sums, template-side sums are cached in the patches
     for(int l = 0; l < nLevels; l++){
       mlpError_.isValidPatch_[l] = false;
     }
+    const float weighting = useWeighting_ ? weightingSigma_ : 0.0f;
     for(int l = l1; l <= l2; l++){
-      const auto c_level = pyr.levelTranformCoordinates(c,0,l);
+      const PixelCoordinates c_level = pyr.levelTranformCoordinates(c,0,l);
       if(mp.isValidPatch_[l] && extractedPatches_[l].isPatchInFrame(pyr.imgs_[l],c_level,false)){
-        mp.patches_[l].computeGradientParameters();
+        const float* it_w = &w_[l*patch_size*patch_size];
+        mp.patches_[l].computeTemplateStatistics(useWeighting_ ? it_w : nullptr,weighting,-LevelScales<nLevels>::down(l));
         if(mp.patches_[l].validGradientParameters_){
           mlpError_.isValidPatch_[l] = true;
           numLevel++;
           extractedPatches_[l].extractPatchFromImage(pyr.imgs_[l],c_level,false);
           const float* it_patch_extracted = extractedPatches_[l].patch_;
           const float* it_patch = mp.patches_[l].patch_;
-          const float* it_dx = mp.patches_[l].dx_;
-          const float* it_dy = mp.patches_[l].dy_;
           float* it_error = mlpError_.patches_[l].patch_;
-          float* it_dx_error = mlpError_.patches_[l].dx_;
-          float* it_dy_error = mlpError_.patches_[l].dy_;
-          const float* it_w = &w_[l*patch_size*patch_size];
-          for(int y=0; y<patch_size; ++y){
-            for(int x=0; x<patch_size; ++x, ++it_patch, ++it_patch_extracted, ++it_dx, ++it_dy, ++it_error, ++it_dx_error, ++it_dy_error, ++it_w){
-              *it_error = *it_patch_extracted - *it_patch;
-              const float Jx = -pow(0.5,l)*(*it_dx); // TODO: make pre-computation in Patch
-              const float Jy = -pow(0.5,l)*(*it_dy);
-              if(c.isNearIdentityWarping()){
-                *it_dx_error = Jx;
-                *it_dy_error = Jy;
+          for(int i=0; i<patch_size*patch_size; ++i, ++it_patch, ++it_patch_extracted, ++it_error, ++it_w){
+            *it_error = *it_patch_extracted - *it_patch;
+            if(useIntensityOffset_ || useIntensitySqew_){
+              if(useWeighting_){
+                mean_y += (*it_w)*(*it_patch_extracted);
               } else {
-                *it_dx_error = Jx*affInv(0,0)+Jy*affInv(1,0);
-                *it_dy_error = Jx*affInv(0,1)+Jy*affInv(1,1);
-              }
-              if(useIntensityOffset_ || useIntensitySqew_){
-                if(useWeighting_){
-                  mean_x += (*it_w)*(*it_patch);
-                  mean_y += (*it_w)*(*it_patch_extracted);
-                  mean_y_dx += (*it_w)*(*it_dx_error);
-                  mean_y_dy += (*it_w)*(*it_dy_error);
-                  wTot += *it_w;
-                } else {
-                  mean_x += *it_patch;
-                  mean_y += *it_patch_extracted;
-                  mean_y_dx += *it_dx_error;
-                  mean_y_dy += *it_dy_error;
-                  wTot += 1.0;
-                }
+                mean_y += *it_patch_extracted;
               }
-              if(useIntensitySqew_){
-                if(useWeighting_){
-                  mean_xx += (*it_w)*(*it_patch)*(*it_patch);
-                  mean_xy += (*it_w)*(*it_patch)*(*it_patch_extracted);
-                  mean_xy_dx += (*it_w)*(*it_patch)*(*it_dx_error);
-                  mean_xy_dy += (*it_w)*(*it_patch)*(*it_dy_error);
-                } else {
-                  mean_xx += (*it_patch)*(*it_patch);
-                  mean_xy += (*it_patch)*(*it_patch_extracted);
-                  mean_xy_dx += (*it_patch)*(*it_dx_error);
-                  mean_xy_dy += (*it_patch)*(*it_dy_error);
-                }
+            }
+            if(useIntensitySqew_){
+              if(useWeighting_){
+                mean_xy += (*it_w)*(*it_patch)*(*it_patch_extracted);
+              } else {
+                mean_xy += (*it_patch)*(*it_patch_extracted);
               }
             }
           }
+          const typename Patch<patch_size>::TemplateStatistics& t = mp.patches_[l].templateStatistics_;
+          if(useIntensityOffset_ || useIntensitySqew_){
+            wTot += t.sumW_;
+            mean_x += t.sumX_;
+            sum_dx += t.sumDx_;
+            sum_dy += t.sumDy_;
+          }
+          if(useIntensitySqew_){
+            mean_xx += t.sumXX_;
+            sum_x_dx += t.sumXDx_;
+            sum_x_dy += t.sumXDy_;
+          }
         }
       }
     }
@@ -201,6 +209,19 @@ class MultilevelPatchAlignment {
 
     float reg_a, reg_a_dx, reg_a_dy, reg_b, reg_b_dx, reg_b_dy;
     if(useIntensityOffset_ || useIntensitySqew_){
+      // The warped gradients are linear in the scaled template gradients, hence so are their sums
+      float mean_y_dx, mean_y_dy, mean_xy_dx, mean_xy_dy;
+      if(isNearIdentityWarping){
+        mean_y_dx = sum_dx;
+        mean_y_dy = sum_dy;
+        mean_xy_dx = sum_x_dx;
+        mean_xy_dy = sum_x_dy;
+      } else {
+        mean_y_dx = sum_dx*affInv(0,0)+sum_dy*affInv(1,0);
+        mean_y_dy = sum_dx*affInv(0,1)+sum_dy*affInv(1,1);
+        mean_xy_dx = sum_x_dx*affInv(0,0)+sum_x_dy*affInv(1,0);
+        mean_xy_dy = sum_x_dx*affInv(0,1)+sum_x_dy*affInv(1,1);
+      }
       mean_x = mean_x/wTot;
       mean_xx = mean_xx/wTot;
       mean_xy = mean_xy/wTot;
@@ -244,12 +265,24 @@ class MultilevelPatchAlignment {
         b.conservativeResize(numLevel*patch_size*patch_size,1);
         const float* it_patch = mp.patches_[l].patch_;
         const float* it_patch_extracted = extractedPatches_[l].patch_;
+        const float* it_dx = mp.patches_[l].dx_;
+        const float* it_dy = mp.patches_[l].dy_;
+        const float levelScale = -LevelScales<nLevels>::down(l);
         float* it_error = mlpError_.patches_[l].patch_;
         float* it_dx_error = mlpError_.patches_[l].dx_;
         float* it_dy_error = mlpError_.patches_[l].dy_;
         const float* it_w = &w_[l*patch_size*patch_size];
         for(int y=0; y<patch_size; ++y){
-          for(int x=0; x<patch_size; ++x, ++it_patch, ++it_patch_extracted, ++it_error,  ++it_dx_error, ++it_dy_error, ++it_w){
+          for(int x=0; x<patch_size; ++x, ++it_patch, ++it_patch_extracted, ++it_dx, ++it_dy, ++it_error,  ++it_dx_error, ++it_dy_error, ++it_w){
+            const float Jx = levelScale*(*it_dx);
+            const float Jy = levelScale*(*it_dy);
+            if(isNearIdentityWarping){
+              *it_dx_error = Jx;
+              *it_dy_error = Jy;
+            } else {
+              *it_dx_error = Jx*affInv(0,0)+Jy*affInv(1,0);
+              *it_dy_error = Jx*affInv(0,1)+Jy*affInv(1,1);
+            }
             if(useIntensityOffset_ || useIntensitySqew_){
               *it_error = *it_patch_extracted - reg_a*(*it_patch) - reg_b;
               *it_dx_error = reg_a*(*it_dx_error - reg_a_dx*(*it_patch) - reg_b_dx);
@@ -307,6 +340,23 @@ class MultilevelPatchAlignment {
    */
   bool getLinearAlignEquationsReduced(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& c, const int l1, const int l2,
                                       Eigen::Matrix2f& A_red, Eigen::Vector2f& b_red){
+    PixelCoordinates pc;
+    return pc.fromFeatureCoordinates(c) && getLinearAlignEquationsReduced(pyr,mp,pc,l1,l2,A_red,b_red);
+  }
+
+  /** \brief Get the reduced (QR-decomposition) linear align equations (A*x=b) in __float__ precision, based on lightweight pixel coordinates.
+   *
+   * @param pyr         - Considered image pyramid.
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param c           - Pixel coordinates and warping of the patch in the reference image.
+   * @param l1          - Start pyramid level (l1<l2)
+   * @param l2          - End pyramid level (l1<l2)
+   * @param A_red       - Reduced Jacobian of the pixel intensities w.r.t. to pixel coordinates
+   * @param b_red       - Reduced intensity errors
+   * @return true, if successful.
+   */
+  bool getLinearAlignEquationsReduced(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PixelCoordinates& c, const int l1, const int l2,
+                                      Eigen::Matrix2f& A_red, Eigen::Vector2f& b_red){
     bool success = getLinearAlignEquations(pyr,mp,c,l1,l2,A_,b_);
     if(success){
       mColPivHouseholderQR_.compute(A_);
@@ -370,7 +420,7 @@ class MultilevelPatchAlignment {
     int numLevel = 0;
     FeatureCoordinates c_level;
     for(int l = l1; l <= l2; l++){
-      pyr.levelTranformCoordinates(cInit,c_level,0,l);
+      c_level = pyr.levelTranformCoordinates(cInit,0,l);
       if(mp.isValidPatch_[l] && mp.patches_[l].isPatchInFrame(pyr.imgs_[l],c_level,false)){
         mp.patches_[l].computeGradientParameters();
         if(mp.patches_[l].validGradientParameters_){
@@ -388,17 +438,19 @@ class MultilevelPatchAlignment {
     bool converged=false;
     Eigen::Matrix3f H; H.setZero();
     for(int l = l1; l <= l2; l++){
-      pyr.levelTranformCoordinates(cInit,c_level,0,l);
+      c_level = pyr.levelTranformCoordinates(cInit,0,l);
       if(mp.isValidPatch_[l] && mp.patches_[l].isPatchInFrame(pyr.imgs_[l],c_level,false)){
         mp.patches_[l].computeGradientParameters();
-        H(0,0) += pow(0.25,l)*mp.patches_[l].H_(0,0);
-        H(0,1) += pow(0.25,l)*mp.patches_[l].H_(0,1);
-        H(1,0) += pow(0.25,l)*mp.patches_[l].H_(1,0);
-        H(1,1) += pow(0.25,l)*mp.patches_[l].H_(1,1);
-        H(2,0) += pow(0.5,l)*mp.patches_[l].H_(2,0);
-        H(2,1) += pow(0.5,l)*mp.patches_[l].H_(2,1);
-        H(0,2) += pow(0.5,l)*mp.patches_[l].H_(0,2);
-        H(1,2) += pow(0.5,l)*mp.patches_[l].H_(1,2);
+        const float s = LevelScales<nLevels>::down(l);
+        const float s2 = LevelScales<nLevels>::squaredDown(l);
+        H(0,0) += s2*mp.patches_[l].H_(0,0);
+        H(0,1) += s2*mp.patches_[l].H_(0,1);
+        H(1,0) += s2*mp.patches_[l].H_(1,0);
+        H(1,1) += s2*mp.patches_[l].H_(1,1);
+        H(2,0) += s*mp.patches_[l].H_(2,0);
+        H(2,1) += s*mp.patches_[l].H_(2,1);
+        H(0,2) += s*mp.patches_[l].H_(0,2);
+        H(1,2) += s*mp.patches_[l].H_(1,2);
         H(2,2) += mp.patches_[l].H_(2,2);
       }
     }
@@ -417,13 +469,14 @@ class MultilevelPatchAlignment {
       Eigen::Vector3f Jres; Jres.setZero();
       int count = 0;
       for(int l = l1; l <= l2; l++){
-        pyr.levelTranformCoordinates(cOut,c_level,0,l);
+        c_level = pyr.levelTranformCoordinates(cOut,0,l);
         if(mp.isValidPatch_[l] && mp.patches_[l].isPatchInFrame(pyr.imgs_[l],c_level,false)){
           const int refStep = pyr.imgs_[l].step.p[0];
 
           const float* it_patch = mp.patches_[l].patch_;
           const float* it_dx = mp.patches_[l].dx_;
           const float* it_dy = mp.patches_[l].dy_;
+          const float levelScale = LevelScales<nLevels>::down(l);
           if(cInit.isNearIdentityWarping()){
             const int u_r = floor(c_level.get_c().x);
             const int v_r = floor(c_level.get_c().y);
@@ -444,8 +497,8 @@ class MultilevelPatchAlignment {
               for(int x=0; x<patch_size; ++x, ++it_img, ++it_patch, ++it_dx, ++it_dy){
                 const float intensity = wTL*it_img[0] + wTR*it_img[1] + wBL*it_img[refStep] + wBR*it_img[refStep+1];
                 const float res = intensity - *it_patch + mean_diff;
-                Jres[0] -= pow(0.5,l)*res*(*it_dx);
-                Jres[1] -= pow(0.5,l)*res*(*it_dy);
+                Jres[0] -= levelScale*res*(*it_dx);
+                Jres[1] -= levelScale*res*(*it_dy);
                 Jres[2] -= res;
               }
             }
@@ -472,8 +525,8 @@ class MultilevelPatchAlignment {
                 const uint8_t* pixel_data = (uint8_t*) pyr.imgs_[l].data + v_pixel_r*refStep + u_pixel_r;
                 const float pixel_intensity = pixel_wTL*pixel_data[0] + pixel_wTR*pixel_data[1] + pixel_wBL*pixel_data[refStep] + pixel_wBR*pixel_data[refStep+1];
                 const float res = pixel_intensity - *it_patch + mean_diff;
-                Jres[0] -= pow(0.5,l)*res*(*it_dx);
-                Jres[1] -= pow(0.5,l)*res*(*it_dy);
+                Jres[0] -= levelScale*res*(*it_dx);
+                Jres[1] -= levelScale*res*(*it_dy);
                 Jres[2] -= res;
               }
             }
@@ -514,6 +567,31 @@ class MultilevelPatchAlignment {
    */
   bool align2D(FeatureCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& cInit,
                const int l1, const int l2, const int maxIter = 10, const double minPixUpd = 0.03){
+    PixelCoordinates pc;
+    if(!pc.fromFeatureCoordinates(cInit)){
+      cOut = cInit;
+      return false;
+    }
+    const bool converged = align2D(pc,pyr,mp,pc,l1,l2,maxIter,minPixUpd);
+    cOut = cInit;
+    pc.toFeatureCoordinates(cOut);
+    return converged;
+  }
+
+  /** \brief 2D patch alignment on lightweight pixel coordinates. No guarantee that final coordinates are fully in the frame.
+   *
+   * @param cOut        - Estimated coordinates for the patch alignment (the warping of cInit is kept).
+   * @param pyr         - Considered image pyramid.
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param cInit       - Coordinates of the patch in the reference image, initial guess.
+   * @param l1          - Start pyramid level (l1<l2)
+   * @param l2          - End pyramid level (l1<l2)
+   * @param maxIter     - Maximal number of iterations
+   * @param minPixUpd   - Termination condition on absolute pixel update
+   * @return true, if alignment converged!
+   */
+  bool align2D(PixelCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PixelCoordinates& cInit,
+               const int l1, const int l2, const int maxIter = 10, const double minPixUpd = 0.03){
     // termination condition
     const float min_update_squared = minPixUpd*minPixUpd;
     cOut = cInit;
@@ -521,7 +599,7 @@ class MultilevelPatchAlignment {
     update.setZero();
     bool converged = false;
     for(int iter = 0; iter<maxIter; ++iter){
-      if(std::isnan(cOut.get_c().x) || std::isnan(cOut.get_c().y)){
+      if(std::isnan(cOut.x_) || std::isnan(cOut.y_)){
         assert(false);
         return false;
       }
@@ -533,7 +611,8 @@ class MultilevelPatchAlignment {
         return false;
       }
       update = svd_.solve(b_);
-      cOut.set_c(cv::Point2f(cOut.get_c().x + update[0],cOut.get_c().y + update[1]),false);
+      cOut.x_ += update[0];
+      cOut.y_ += update[1];
 
       if(update[0]*update[0]+update[1]*update[1] < min_update_squared){
         converged=true;
@@ -556,6 +635,19 @@ class MultilevelPatchAlignment {
     return align2D(cOut,pyr,mp,cInit,l,l);
   }
 
+  /** \brief Execute a 2D patch alignment using only one single pyramid level (lightweight pixel coordinates).
+   *
+   * @param cOut        - Estimated coordinates for the patch alignment.
+   * @param pyr         - Considered image pyramid.
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param cInit       - Coordinates of the patch in the reference image, initial guess.
+   * @param l           - Pyramid level which is used for the alignement
+   * @return true, if alignment converged!
+   */
+  bool align2DSingleLevel(PixelCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PixelCoordinates& cInit, const int l){
+    return align2D(cOut,pyr,mp,cInit,l,l);
+  }
+
   /** \brief Aligns a MultilevelPatchFeature to a given image pyramid, coarse to fine
    *
    * @param cOut          - Estimated coordinates for the patch alignment.
@@ -569,6 +661,30 @@ class MultilevelPatchAlignment {
    */
   bool align2DComposed(FeatureCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& cInit,
                        const int lowest_level,const int highest_level, const int start_level){
+    PixelCoordinates pc;
+    if(!pc.fromFeatureCoordinates(cInit)){
+      cOut = cInit;
+      return false;
+    }
+    const bool success = align2DComposed(pc,pyr,mp,pc,lowest_level,highest_level,start_level);
+    cOut = cInit;
+    pc.toFeatureCoordinates(cOut);
+    return success;
+  }
+
+  /** \brief Aligns a MultilevelPatchFeature to a given image pyramid, coarse to fine (lightweight pixel coordinates)
+   *
+   * @param cOut          - Estimated coordinates for the patch alignment.
+   * @param pyr           - Considered image pyramid.
+   * @param mp            - \ref MultilevelPatch, which contains the patches.
+   * @param cInit         - Coordinates of the patch in the reference image, initial guess.
+   * @param lowest_level  - Lowest pyramid level to be considered
+   * @param highest_level - Highest pyramid level to be considered (should be smaller than lowest_level)
+   * @param start_level   - Start pyramid level for the coarse to fine alignment  (should be SEQ than lowest_level and LEQ than highest_level)
+   * @return true, if alignment converged!
+   */
+  bool align2DComposed(PixelCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PixelCoordinates& cInit,
+                       const int lowest_level,const int highest_level, const int start_level){
     cOut = cInit;
     for(int l = start_level;l>=highest_level;--l){
       if(!align2D(cOut,pyr,mp,cOut,l,lowest_level)){
@@ -593,14 +709,46 @@ class MultilevelPatchAlignment {
    */
   bool align2DAdaptive(FeatureCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& cInit,
                        const int lowest_level = nLevels,const int highest_level = 0, const double convergencePixelRange = 1.0,  const double coverageRatio = 2.0, const int maxUniSample = 5){
-    bestIntensityError_ = -1;
+    PixelCoordinates pc;
+    if(!pc.fromFeatureCoordinates(cInit)){
+      bestIntensityError_ = -1;
+      cOut = cInit;
+      return false;
+    }
+    const bool success = align2DAdaptive(pc,pyr,mp,pc,cInit.eigenVector1_.cast<float>(),cInit.sigma1_,lowest_level,highest_level,convergencePixelRange,coverageRatio,maxUniSample);
     cOut = cInit;
-    const int n = std::min(std::max(static_cast<int>(ceil((cInit.sigma1_*coverageRatio)/(convergencePixelRange*pow(2.0,lowest_level+1))-0.5)),0),maxUniSample); // (n+0.5)*r*2^(l+1) > s*f
+    pc.toFeatureCoordinates(cOut);
+    return success;
+  }
+
+  /** \brief Aligns a MultilevelPatchFeature to a given image pyramid, adapts the algorithm to the uncertainty of the initial guess (lightweight pixel coordinates)
+   *
+   * @param cOut          - Estimated coordinates for the patch alignment.
+   * @param pyr           - Considered image pyramid.
+   * @param mp            - \ref MultilevelPatch, which contains the patches.
+   * @param cInit         - Coordinates of the patch in the reference image, initial guess.
+   * @param sampleDir     - Direction of the major uncertainty axis of cInit (unit length).
+   * @param sigma         - Standard deviation of cInit along sampleDir.
+   * @param lowest_level  - Lowest pyramid level to be considered
+   * @param highest_level - Highest pyramid level to be considered (should be smaller than lowest_level)
+   * @param convergencePixelRange - what is the expected converges range (one-sided, gets scaled by the patch level), 1 is a good value
+   * @param coverageRatio - How much of the uncertainty should be covered, 2 is a good value
+   * @param maxUniSample  - How many samples should maximally be evaluated, one-sided
+   * @return true, if alignment converged!
+   */
+  bool align2DAdaptive(PixelCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PixelCoordinates& cInit,
+                       const Eigen::Vector2f& sampleDir, const double sigma,
+                       const int lowest_level = nLevels,const int highest_level = 0, const double convergencePixelRange = 1.0,  const double coverageRatio = 2.0, const int maxUniSample = 5){
+    bestIntensityError_ = -1;
+    const PixelCoordinates cStart = cInit; // cOut and cInit may alias
+    cOut = cStart;
+    const double sampleStep = convergencePixelRange*2.0*LevelScales<nLevels>::up(lowest_level); // r*2^(l+1)
+    const int n = std::min(std::max(static_cast<int>(ceil((sigma*coverageRatio)/sampleStep-0.5)),0),maxUniSample); // (n+0.5)*r*2^(l+1) > s*f
     if(n==0){ // Catch simple case
-      return align2D(cOut,pyr,mp,cInit,highest_level,lowest_level);
+      return align2D(cOut,pyr,mp,cStart,highest_level,lowest_level);
     }
     for(int i = -n;i<=n;i++){ // i is the multiple of steps which should be taken along the directions
-      cOut.set_c(cInit.get_c() + vecToPoint2f(cInit.eigenVector1_.cast<float>()*i*convergencePixelRange*pow(2.0,lowest_level+1)),false);
+      cOut.set_c(cStart.get_c() + vecToPoint2f(sampleDir*(i*sampleStep)));
       if(align2D(cOut,pyr,mp,cOut,highest_level,lowest_level)){
         if(mlpTemp_.isMultilevelPatchInFrame(pyr,cOut,lowest_level,false)){
           mlpTemp_.extractMultilevelPatchFromImage(pyr,cOut,lowest_level,false);
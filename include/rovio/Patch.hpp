@@ -31,6 +31,7 @@
 
 #include "lightweight_filtering/common.hpp"
 #include "rovio/FeatureCoordinates.hpp"
+#include "rovio/PixelCoordinates.hpp"
 
 namespace rovio{
 
@@ -52,11 +53,31 @@ class Patch {
   mutable float e1_;  /**<Larger eigenvalue of H_.*/
   mutable bool validGradientParameters_;  /**<True, if the gradient parameters (patch gradient components dx_ dy_, Hessian H_, Shi-Thomasi Score s_) have been computed.
                                   \see computeGradientParameters()*/
+
+  /** \brief Template-only sums of the patch, needed for the intensity offset and skew estimation of the patch alignment.
+   */
+  struct TemplateStatistics{
+    float sumW_;  /**<Sum of the pixel weights.*/
+    float sumX_;  /**<Weighted sum of the intensities.*/
+    float sumXX_;  /**<Weighted sum of the squared intensities.*/
+    float sumDx_;  /**<Weighted sum of the scaled gradient components in x-direction.*/
+    float sumDy_;  /**<Weighted sum of the scaled gradient components in y-direction.*/
+    float sumXDx_;  /**<Weighted sum of the intensities times the scaled gradient components in x-direction.*/
+    float sumXDy_;  /**<Weighted sum of the intensities times the scaled gradient components in y-direction.*/
+  };
+  mutable TemplateStatistics templateStatistics_;  /**<Template-only sums of the patch. \see computeTemplateStatistics()*/
+  mutable float templateStatisticsWeighting_;  /**<Weighting identifier for which templateStatistics_ has been computed.*/
+  mutable float templateStatisticsScale_;  /**<Gradient scale for which templateStatistics_ has been computed.*/
+  mutable bool validTemplateStatistics_;  /**<True, if templateStatistics_ has been computed for the current patch data.
+                                  \see computeTemplateStatistics()*/
   /** \brief Constructor
    */
   Patch(){
     static_assert(patchSize%2==0,"Patch patchSize must be a multiple of 2");
     validGradientParameters_ = false;
+    validTemplateStatistics_ = false;
+    templateStatisticsWeighting_ = 0.0;
+    templateStatisticsScale_ = 0.0;
     s_ = 0.0;
     e0_ = 0.0;
     e1_ = 0.0;
@@ -97,6 +118,39 @@ class Patch {
       e1_ = 0.5 * (dXX + dYY + sqrtf((dXX + dYY) * (dXX + dYY) - 4 * (dXX * dYY - dXY * dXY)));
       s_ = e0_+e1_;
       validGradientParameters_ = true;
+      validTemplateStatistics_ = false;
+    }
+  }
+
+  /** \brief Computes the template-only sums templateStatistics_, which only depend on the patch and not on the image
+   *         it is aligned to. The results are kept until the patch data
+   *         changes (i.e. the gradient parameters are recomputed) or until the weighting or the scale changes.
+   *
+   *   @param w         - Pixel weights (patchSize*patchSize), nullptr for uniform weighting.
+   *   @param weighting - Identifier of the weights w (e.g. width of the Gaussian weighting), 0 for uniform weighting.
+   *   @param scale     - Factor applied to the gradient components (pyramid level scale).
+   */
+  void computeTemplateStatistics(const float* w, const float weighting, const float scale) const{
+    computeGradientParameters();
+    if(!validTemplateStatistics_ || templateStatisticsWeighting_ != weighting || templateStatisticsScale_ != scale){
+      TemplateStatistics& t = templateStatistics_;
+      t.sumW_ = 0.0; t.sumX_ = 0.0; t.sumXX_ = 0.0;
+      t.sumDx_ = 0.0; t.sumDy_ = 0.0; t.sumXDx_ = 0.0; t.sumXDy_ = 0.0;
+      for(int i=0; i<patchSize*patchSize; ++i){
+        const float wi = w != nullptr ? w[i] : 1.0f;
+        const float wx = wi*patch_[i];
+        t.sumW_ += wi;
+        t.sumX_ += wx;
+        t.sumXX_ += wx*patch_[i];
+        t.sumDx_ += wi*dx_[i];
+        t.sumDy_ += wi*dy_[i];
+        t.sumXDx_ += wx*dx_[i];
+        t.sumXDy_ += wx*dy_[i];
+      }
+      t.sumDx_ *= scale; t.sumDy_ *= scale; t.sumXDx_ *= scale; t.sumXDy_ *= scale;
+      templateStatisticsWeighting_ = weighting;
+      templateStatisticsScale_ = scale;
+      validTemplateStatistics_ = true;
     }
   }
 
@@ -198,34 +252,43 @@ class Patch {
    *   @return true, if the patch is completely located within the reference image.
    */
   static bool isPatchInFrame(const cv::Mat& img,const FeatureCoordinates& c,const bool withBorder = false){
-    if(c.isInFront() && c.com_warp_c()){
-      const int halfpatch_size = patchSize/2+(int)withBorder;
-      if(c.isNearIdentityWarping()){
-        if(c.get_c().x < halfpatch_size || c.get_c().y < halfpatch_size || c.get_c().x > img.cols-halfpatch_size || c.get_c().y > img.rows-halfpatch_size){
-          return false;
-        } else {
-          return true;
-        }
+    PixelCoordinates pc;
+    return pc.fromFeatureCoordinates(c) && isPatchInFrame(img,pc,withBorder);
+  }
+
+  /** \brief Checks if a patch at a specific image location is still within the reference image.
+   *
+   *   @param img        - Reference Image.
+   *   @param c          - Pixel coordinates and warping of the patch in the reference image.
+   *   @param withBorder - Check, using either the patch-patchSize of Patch::patch_ (withBorder = false) or the patch-patchSize
+   *                       of the expanded patch Patch::patchWithBorder_ (withBorder = true).
+   *   @return true, if the patch is completely located within the reference image.
+   */
+  static bool isPatchInFrame(const cv::Mat& img,const PixelCoordinates& c,const bool withBorder = false){
+    const int halfpatch_size = patchSize/2+(int)withBorder;
+    if(c.isNearIdentityWarping()){
+      if(c.x_ < halfpatch_size || c.y_ < halfpatch_size || c.x_ > img.cols-halfpatch_size || c.y_ > img.rows-halfpatch_size){
+        return false;
       } else {
-        for(int y=0; y<2*halfpatch_size; y += 2*halfpatch_size-1){
-          for(int x=0; x<2*halfpatch_size; x += 2*halfpatch_size-1){
-            const float dx = x - halfpatch_size + 0.5;
-            const float dy = y - halfpatch_size + 0.5;
-            const float wdx = c.get_warp_c()(0,0)*dx + c.get_warp_c()(0,1)*dy;
-            const float wdy = c.get_warp_c()(1,0)*dx + c.get_warp_c()(1,1)*dy;
-            const float c_x = c.get_c().x+wdx - 0.5;
-            const float c_y = c.get_c().y+wdy - 0.5;
-            const int u_r = floor(c_x);
-            const int v_r = floor(c_y);
-            if(u_r < 0 || v_r < 0 || u_r >= img.cols-1 || v_r >= img.rows-1){
-              return false;
-            }
-          }
-        }
         return true;
       }
     } else {
-      return false;
+      for(int y=0; y<2*halfpatch_size; y += 2*halfpatch_size-1){
+        for(int x=0; x<2*halfpatch_size; x += 2*halfpatch_size-1){
+          const float dx = x - halfpatch_size + 0.5;
+          const float dy = y - halfpatch_size + 0.5;
+          const float wdx = c.warp_[0]*dx + c.warp_[1]*dy;
+          const float wdy = c.warp_[2]*dx + c.warp_[3]*dy;
+          const float c_x = c.x_+wdx - 0.5;
+          const float c_y = c.y_+wdy - 0.5;
+          const int u_r = floor(c_x);
+          const int v_r = floor(c_y);
+          if(u_r < 0 || v_r < 0 || u_r >= img.cols-1 || v_r >= img.rows-1){
+            return false;
+          }
+        }
+      }
+      return true;
     }
   }
 
@@ -238,6 +301,20 @@ class Patch {
    *                       and the patch data of the expanded patch (Patch::patchWithBorder_).
    */
   void extractPatchFromImage(const cv::Mat& img,const FeatureCoordinates& c,const bool withBorder = false){
+    PixelCoordinates pc;
+    pc.fromFeatureCoordinates(c);
+    extractPatchFromImage(img,pc,withBorder);
+  }
+
+  /** \brief Extracts a patch from an image.
+   *
+   *   @param img        - Reference Image.
+   *   @param c          - Pixel coordinates and warping of the patch in the reference image (subpixel coordinates possible).
+   *   @param withBorder - If false, the patch object is only initialized with the patch data of the general patch (Patch::patch_).
+   *                       If true, the patch object is initialized with both, the patch data of the general patch (Patch::patch_)
+   *                       and the patch data of the expanded patch (Patch::patchWithBorder_).
+   */
+  void extractPatchFromImage(const cv::Mat& img,const PixelCoordinates& c,const bool withBorder = false){
     assert(isPatchInFrame(img,c,withBorder));
     const int halfpatch_size = patchSize/2+(int)withBorder;
     const int refStep = img.step.p[0];
@@ -252,12 +329,12 @@ class Patch {
     }
 
     if(c.isNearIdentityWarping()){
-      const int u_r = floor(c.get_c().x);
-      const int v_r = floor(c.get_c().y);
+      const int u_r = floor(c.x_);
+      const int v_r = floor(c.y_);
 
       // compute interpolation weights
-      const float subpix_x = c.get_c().x-u_r;
-      const float subpix_y = c.get_c().y-v_r;
+      const float subpix_x = c.x_-u_r;
+      const float subpix_y = c.y_-v_r;
       const float wTL = (1.0-subpix_x)*(1.0-subpix_y);
       const float wTR = subpix_x * (1.0-subpix_y);
       const float wBL = (1.0-subpix_x)*subpix_y;
@@ -277,10 +354,10 @@ class Patch {
         for(int x=0; x<2*halfpatch_size; ++x, ++patch_ptr){
           const float dx = x - halfpatch_size + 0.5;
           const float dy = y - halfpatch_size + 0.5;
-          const float wdx = c.get_warp_c()(0,0)*dx + c.get_warp_c()(0,1)*dy;
-          const float wdy = c.get_warp_c()(1,0)*dx + c.get_warp_c()(1,1)*dy;
-          const float u_pixel = c.get_c().x+wdx - 0.5;
-          const float v_pixel = c.get_c().y+wdy - 0.5;
+          const float wdx = c.warp_[0]*dx + c.warp_[1]*dy;
+          const float wdy = c.warp_[2]*dx + c.warp_[3]*dy;
+          const float u_pixel = c.x_+wdx - 0.5;
+          const float v_pixel = c.y_+wdy - 0.5;
           const int u_r = floor(u_pixel);
           const int v_r = floor(v_pixel);
           const float subpix_x = u_pixel-u_r;
@@ -0,0 +1,164 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_PIXELCOORDINATES_HPP_
+#define ROVIO_PIXELCOORDINATES_HPP_
+
+#include <type_traits>
+#include "rovio/FeatureCoordinates.hpp"
+
+namespace rovio{
+
+/** \brief Lightweight pixel coordinates with affine patch warping.
+ *
+ * Trivially copyable counterpart of \ref FeatureCoordinates, holding only what the patch extraction and
+ * alignment loops need: the pixel location and the pixel warping. It has no camera pointer, no lazily computed
+ * bearing vector and no uncertainty, so it can be copied and level-transformed at negligible cost.
+ * Use \ref fromFeatureCoordinates and \ref toFeatureCoordinates at the boundaries to the filter.
+ */
+struct PixelCoordinates{
+  float x_;  /**<Pixel x-coordinate.*/
+  float y_;  /**<Pixel y-coordinate.*/
+  float warp_[4];  /**<Pixel warping matrix (from patch to image), row-major.*/
+  bool isWarpIdentity_;  /**<Is the warping exactly identity.*/
+
+  /** \brief Sets the pixel coordinates, keeps the warping.
+   *
+   *  @param c - Pixel coordinates.
+   */
+  void set_c(const cv::Point2f& c){
+    x_ = c.x;
+    y_ = c.y;
+  }
+
+  /** \brief Get the pixel coordinates.
+   *
+   *  @return the pixel coordinates.
+   */
+  cv::Point2f get_c() const{
+    return cv::Point2f(x_,y_);
+  }
+
+  /** \brief Sets the warping to identity.
+   */
+  void set_warp_identity(){
+    warp_[0] = 1.0f;
+    warp_[1] = 0.0f;
+    warp_[2] = 0.0f;
+    warp_[3] = 1.0f;
+    isWarpIdentity_ = true;
+  }
+
+  /** \brief Sets the pixel warping.
+   *
+   *  @param warp - Pixel warping matrix.
+   */
+  void set_warp_c(const Eigen::Matrix2f& warp){
+    warp_[0] = warp(0,0);
+    warp_[1] = warp(0,1);
+    warp_[2] = warp(1,0);
+    warp_[3] = warp(1,1);
+    isWarpIdentity_ = false;
+  }
+
+  /** \brief Get the pixel warping.
+   *
+   *  @return the pixel warping matrix.
+   */
+  Eigen::Matrix2f get_warp_c() const{
+    Eigen::Matrix2f warp;
+    warp << warp_[0], warp_[1], warp_[2], warp_[3];
+    return warp;
+  }
+
+  /** \brief Checks if warping is near identity (same criterion as FeatureCoordinates::isNearIdentityWarping).
+   *
+   *  @return true, if the warping is near identity.
+   */
+  bool isNearIdentityWarping() const{
+    if(isWarpIdentity_) return true;
+    const float d0 = warp_[0]-1.0f;
+    const float d3 = warp_[3]-1.0f;
+    return d0*d0+warp_[1]*warp_[1]+warp_[2]*warp_[2]+d3*d3 < 1e-12;
+  }
+
+  /** \brief Sets pixel coordinates and warping from a FeatureCoordinates object.
+   *
+   *  Evaluates the lazy pixel and warping computation of c once.
+   *  @param c - Feature coordinates.
+   *  @return false, if c is not in front of the camera or has no valid pixel coordinates or warping.
+   */
+  bool fromFeatureCoordinates(const FeatureCoordinates& c){
+    if(!c.isInFront() || !c.com_c() || !c.com_warp_c()){
+      return false;
+    }
+    set_c(c.c_);
+    if(c.isWarpIdentity_){
+      set_warp_identity();
+    } else {
+      set_warp_c(c.warp_c_);
+    }
+    return true;
+  }
+
+  /** \brief Writes the pixel coordinates into a FeatureCoordinates object.
+   *
+   *  The bearing vector of c is invalidated, camera, camID and uncertainty are kept.
+   *  @param c         - Feature coordinates to be written.
+   *  @param withWarp  - If true, the warping is written as well, otherwise the warping of c is kept.
+   */
+  void toFeatureCoordinates(FeatureCoordinates& c, const bool withWarp = false) const{
+    c.set_c(get_c(),false);
+    if(withWarp){
+      if(isWarpIdentity_){
+        c.set_warp_identity();
+      } else {
+        c.set_warp_c(get_warp_c());
+      }
+    }
+  }
+
+  /** \brief Constructs pixel coordinates with identity warping.
+   *
+   *  @param c - Pixel coordinates.
+   *  @return the pixel coordinates.
+   */
+  static PixelCoordinates fromPixel(const cv::Point2f& c){
+    PixelCoordinates p;
+    p.set_c(c);
+    p.set_warp_identity();
+    return p;
+  }
+};
+
+static_assert(std::is_trivial<PixelCoordinates>::value,"PixelCoordinates must stay trivially copyable");
+
+}
+
+
+#endif /* ROVIO_PIXELCOORDINATES_HPP_ */
@@ -32,6 +32,7 @@
 #include "lightweight_filtering/common.hpp"
 #include "lightweight_filtering/Update.hpp"
 #include "lightweight_filtering/State.hpp"
+#include "rovio/SparseUpdate.hpp"
 
 namespace rovio {
 
@@ -155,6 +156,8 @@ class PoseUpdate: public LWF::Update<PoseInnovation,FILTERSTATE,PoseUpdateMeas,P
   bool doInertialAlignmentAtStart_;
   bool didAlignment_;
   bool useOdometryCov_;
+  bool useSparseUpdate_;  /**<Performs the EKF update only over the involved state blocks (see SparseUpdate).*/
+  SparseUpdate<FILTERSTATE,mtInnovation,mtNoise,18> sparseUpdate_;
   PoseUpdate() : defaultUpdnoiP_((int)(mtNoise::D_),(int)(mtNoise::D_)) {
     static_assert(mtState::nPose_>inertialPoseIndex_,"Please add enough poses to the filter state (templated).");
     static_assert(mtState::nPose_>bodyPoseIndex_,"Please add enough poses to the filter state (templated).");
@@ -170,6 +173,7 @@ class PoseUpdate: public LWF::Update<PoseInnovation,FILTERSTATE,PoseUpdateMeas,P
     doInertialAlignmentAtStart_ = true;
     didAlignment_ = false;
     useOdometryCov_ = false;
+    useSparseUpdate_ = true;
     doubleRegister_.registerVector("MrMV",MrMV_);
     doubleRegister_.registerQuaternion("qVM",qVM_);
     doubleRegister_.registerVector("IrIW",IrIW_);
@@ -185,6 +189,7 @@ class PoseUpdate: public LWF::Update<PoseInnovation,FILTERSTATE,PoseUpdateMeas,P
     boolRegister_.registerScalar("noFeedbackToRovio",noFeedbackToRovio_);
     boolRegister_.registerScalar("doInertialAlignmentAtStart",doInertialAlignmentAtStart_);
     boolRegister_.registerScalar("useOdometryCov",useOdometryCov_);
+    boolRegister_.registerScalar("useSparseUpdate",useSparseUpdate_);
 
     // Unregister configured covariance
     for (int i=0;i<6;i++) {
@@ -242,35 +247,42 @@ class PoseUpdate: public LWF::Update<PoseInnovation,FILTERSTATE,PoseUpdateMeas,P
   }
   void jacState(MXD& F, const mtState& state) const{
     F.setZero();
+    DenseJacobian J(F);
+    jacStateBlocks(J,state);
+  }
+  /** \brief Assembles the Jacobian w.r.t. the state block by block (see SparseUpdate).
+   */
+  template<typename JACOBIAN>
+  void jacStateBlocks(JACOBIAN& J, const mtState& state) const{
     if(enablePosition_){
       if(!noFeedbackToRovio_){
-        F.template block<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_pos>()) =
+        J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_pos>()) =
             MPD(get_qWI(state).inverted()).matrix();
-        F.template block<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_att>()) =
+        J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_att>()) =
             -MPD(get_qWI(state).inverted()).matrix()*gSM(state.qWM().rotate(get_MrMV(state)));
       }
       if(inertialPoseIndex_ >= 0){
-        F.template block<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_pop>(inertialPoseIndex_)) =
+        J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_pop>(inertialPoseIndex_)) =
             M3D::Identity();
-        F.template block<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_poa>(inertialPoseIndex_)) =
+        J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_poa>(inertialPoseIndex_)) =
             gSM(get_qWI(state).inverseRotate(V3D(state.WrWM()+state.qWM().rotate(get_MrMV(state)))))*MPD(get_qWI(state).inverted()).matrix();
       }
       if(bodyPoseIndex_ >= 0){
-        F.template block<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_pop>(bodyPoseIndex_)) =
+        J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_pos>(),mtState::template getId<mtState::_pop>(bodyPoseIndex_)) =
             MPD(get_qWI(state).inverted()*state.qWM()).matrix();
       }
     }
     if(enableAttitude_){
       if(!noFeedbackToRovio_){
-        F.template block<3,3>(mtInnovation::template getId<mtInnovation::_att>(),mtState::template getId<mtState::_att>()) =
+        J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_att>(),mtState::template getId<mtState::_att>()) =
             -MPD(get_qVM(state)*state.qWM().inverted()).matrix();
       }
       if(inertialPoseIndex_ >= 0){
-        F.template block<3,3>(mtInnovation::template getId<mtInnovation::_att>(),mtState::template getId<mtState::_poa>(inertialPoseIndex_)) =
+        J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_att>(),mtState::template getId<mtState::_poa>(inertialPoseIndex_)) =
             MPD(get_qVM(state)*state.qWM().inverted()).matrix();
       }
       if(bodyPoseIndex_ >= 0){
-        F.template block<3,3>(mtInnovation::template getId<mtInnovation::_att>(),mtState::template getId<mtState::_poa>(bodyPoseIndex_)) =
+        J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_att>(),mtState::template getId<mtState::_poa>(bodyPoseIndex_)) =
             M3D::Identity();
       }
     }
@@ -297,6 +309,27 @@ class PoseUpdate: public LWF::Update<PoseInnovation,FILTERSTATE,PoseUpdateMeas,P
       didAlignment_ = true;
     }
 
+    setUpdateNoise(meas);
+
+    // Sparse EKF update (also in IEKF mode, the pose update is applied in a single step), the dense update of the base class is then skipped
+    if(useSparseUpdate_){
+      meas_ = meas;
+      sparseUpdate_.performUpdate(filterstate,*this,updnoiP_,this->outlierDetection_);
+      isFinished = true;
+    }
+  }
+  /** \brief Prepares the update for a measurement which is applied in the past (see RovioFilter::applyDelayedUpdate).
+   *
+   *  @param meas - Pose measurement.
+   *  @return false if the measurement can not be applied delayed (inertial alignment not done yet).
+   */
+  bool prepareDelayedUpdate(const mtMeas& meas){
+    if(!didAlignment_ && doInertialAlignmentAtStart_) return false;
+    setUpdateNoise(meas);
+    meas_ = meas;
+    return true;
+  }
+  void setUpdateNoise(const mtMeas& meas){
     // When enabled, scale the configured position covariance by the values in the measurement
     if(useOdometryCov_){
       updnoiP_ = defaultUpdnoiP_;
@@ -0,0 +1,343 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_QUANTIZEDPATCH_HPP_
+#define ROVIO_QUANTIZEDPATCH_HPP_
+
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "lightweight_filtering/common.hpp"
+#include "rovio/Patch.hpp"
+#include "rovio/MultilevelPatch.hpp"
+#include "rovio/PixelCoordinates.hpp"
+
+namespace rovio{
+
+/** \brief Integer kernels operating on fixed-point patch data.
+ *
+ *  The inputs are expected to be fixed-point intensities of \ref QuantizedPatch (0 to 255*16), such that the
+ *  differences fit into int16. Squared differences are accumulated in 64bit.
+ */
+namespace quantized_kernels{
+
+/** \brief Sum of differences and sum of squared differences between two int16 arrays.
+ *
+ *   @param a       - First array (16 byte aligned).
+ *   @param b       - Second array (16 byte aligned).
+ *   @param n       - Number of elements.
+ *   @param sumDiff - Sum of (a-b).
+ *   @return the sum of (a-b)^2.
+ */
+inline int64_t sumSquaredDifference(const int16_t* a, const int16_t* b, const int n, int64_t& sumDiff){
+  int64_t sum = 0;
+  int64_t sumSq = 0;
+  int i = 0;
+#ifdef __SSE2__
+  __m128i accSq = _mm_setzero_si128();
+  __m128i acc = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i zero = _mm_setzero_si128();
+  for(; i+8<=n; i+=8){
+    const __m128i d = _mm_sub_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(a+i)),_mm_load_si128(reinterpret_cast<const __m128i*>(b+i)));
+    const __m128i sq = _mm_madd_epi16(d,d); // Non-negative, at most 2*(255*16)^2 per lane
+    accSq = _mm_add_epi64(accSq,_mm_unpacklo_epi32(sq,zero));
+    accSq = _mm_add_epi64(accSq,_mm_unpackhi_epi32(sq,zero));
+    acc = _mm_add_epi32(acc,_mm_madd_epi16(d,ones));
+  }
+  int64_t lanesSq[2] __attribute__ ((aligned (16)));
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanesSq),accSq);
+  sumSq = lanesSq[0]+lanesSq[1];
+  int32_t lanes[4] __attribute__ ((aligned (16)));
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes),acc);
+  sum = static_cast<int64_t>(lanes[0])+lanes[1]+lanes[2]+lanes[3];
+#endif
+  for(; i<n; ++i){
+    const int32_t d = static_cast<int32_t>(a[i])-b[i];
+    sum += d;
+    sumSq += static_cast<int64_t>(d)*d;
+  }
+  sumDiff = sum;
+  return sumSq;
+}
+
+}
+
+/** \brief Compact fixed-point version of the intensities of a \ref Patch.
+ *
+ *   Intensities are stored as int16 with \ref fractionalBits_ fractional bits. For 8x8 patches this takes 128 bytes,
+ *   compared to about 1.2 kB for a float \ref Patch (intensities, expanded patch and gradients).
+ *
+ *   @tparam patchSize - Edge length of the patch in pixels. Value must be a multiple of 2!
+ */
+template<int patchSize>
+class QuantizedPatch{
+ public:
+  static const int fractionalBits_ = 4;  /**<Number of fractional bits of the intensity values.*/
+  static const int nPixel_ = patchSize*patchSize;  /**<Number of pixels.*/
+  int16_t patch_[nPixel_] __attribute__ ((aligned (16)));  /**<Intensity values (fixed point).*/
+
+  /** \brief Constructor
+   */
+  QuantizedPatch(){
+    static_assert(patchSize%2==0,"Patch patchSize must be a multiple of 2");
+  }
+
+  /** \brief Converts a float intensity to fixed point (clamped to the 8bit intensity range).
+   */
+  static int16_t toFixed(const float v){
+    const int i = static_cast<int>(v*(1 << fractionalBits_)+0.5f);
+    return static_cast<int16_t>(std::max(std::min(i,255 << fractionalBits_),0));
+  }
+
+  /** \brief Quantizes the intensities of a float patch.
+   *
+   *   @param p - %Patch to be quantized.
+   */
+  void quantize(const Patch<patchSize>& p){
+    for(int i=0;i<nPixel_;i++){
+      patch_[i] = toFixed(p.patch_[i]);
+    }
+  }
+
+  /** \brief Writes the dequantized intensities into a float patch.
+   *
+   *   @param p - %Patch whose Patch::patch_ is overwritten. The gradient parameters are invalidated.
+   */
+  void dequantize(Patch<patchSize>& p) const{
+    const float scale = 1.0f/(1 << fractionalBits_);
+    for(int i=0;i<nPixel_;i++){
+      p.patch_[i] = scale*patch_[i];
+    }
+    p.validGradientParameters_ = false;
+  }
+
+  /** \brief Accumulates the structure tensor (sum of the outer products of the intensity gradients) of the patch.
+   *
+   *   The gradients are computed on demand by central differences within the patch (one-sided differences on the
+   *   outermost pixels) and carry \ref fractionalBits_+1 fractional bits.
+   *
+   *   @param sXX - Sum of the squared x-gradients.
+   *   @param sYY - Sum of the squared y-gradients.
+   *   @param sXY - Sum of the products of the x- and y-gradients.
+   */
+  void computeStructureTensor(int64_t& sXX, int64_t& sYY, int64_t& sXY) const{
+    sXX = 0; sYY = 0; sXY = 0;
+    for(int y=0; y<patchSize; ++y){
+      for(int x=0; x<patchSize; ++x){
+        const int16_t* it = patch_ + y*patchSize + x;
+        const int32_t dx = x == 0 ? 2*(it[1]-it[0]) : (x == patchSize-1 ? 2*(it[0]-it[-1]) : it[1]-it[-1]);
+        const int32_t dy = y == 0 ? 2*(it[patchSize]-it[0]) : (y == patchSize-1 ? 2*(it[0]-it[-patchSize]) : it[patchSize]-it[-patchSize]);
+        sXX += dx*dx;
+        sYY += dy*dy;
+        sXY += dx*dy;
+      }
+    }
+  }
+
+  /** \brief Extracts a fixed-point patch from an image (bilinear interpolation, without gradients).
+   *
+   *   @param img - Reference Image.
+   *   @param c   - Pixel coordinates and warping of the patch in the reference image.
+   */
+  void extractPatchFromImage(const cv::Mat& img,const PixelCoordinates& c){
+    assert(Patch<patchSize>::isPatchInFrame(img,c,false));
+    const int halfpatch_size = patchSize/2;
+    const int refStep = img.step.p[0];
+    const int shift = 16-fractionalBits_;
+    const int32_t rounding = 1 << (shift-1);
+    int16_t* patch_ptr = patch_;
+    if(c.isNearIdentityWarping()){
+      const int u_r = floor(c.x_);
+      const int v_r = floor(c.y_);
+      const int32_t wx = static_cast<int32_t>((c.x_-u_r)*256.0f+0.5f);
+      const int32_t wy = static_cast<int32_t>((c.y_-v_r)*256.0f+0.5f);
+      const int32_t wTL = (256-wx)*(256-wy);
+      const int32_t wTR = wx*(256-wy);
+      const int32_t wBL = (256-wx)*wy;
+      const int32_t wBR = wx*wy;
+      const uint8_t* img_ptr;
+      for(int y=0; y<patchSize; ++y){
+        img_ptr = (uint8_t*) img.data + (v_r+y-halfpatch_size)*refStep + u_r-halfpatch_size;
+        for(int x=0; x<patchSize; ++x, ++img_ptr, ++patch_ptr){
+          int32_t v = wTL*img_ptr[0];
+          if(wx > 0) v += wTR*img_ptr[1];
+          if(wy > 0) v += wBL*img_ptr[refStep];
+          if(wx > 0 && wy > 0) v += wBR*img_ptr[refStep+1];
+          *patch_ptr = static_cast<int16_t>((v+rounding) >> shift);
+        }
+      }
+    } else {
+      for(int y=0; y<patchSize; ++y){
+        for(int x=0; x<patchSize; ++x, ++patch_ptr){
+          const float dx = x - halfpatch_size + 0.5;
+          const float dy = y - halfpatch_size + 0.5;
+          const float u_pixel = c.x_ + c.warp_[0]*dx + c.warp_[1]*dy - 0.5;
+          const float v_pixel = c.y_ + c.warp_[2]*dx + c.warp_[3]*dy - 0.5;
+          const int u_r = floor(u_pixel);
+          const int v_r = floor(v_pixel);
+          const int32_t wx = static_cast<int32_t>((u_pixel-u_r)*256.0f+0.5f);
+          const int32_t wy = static_cast<int32_t>((v_pixel-v_r)*256.0f+0.5f);
+          const uint8_t* img_ptr = (uint8_t*) img.data + v_r*refStep + u_r;
+          int32_t v = (256-wx)*(256-wy)*img_ptr[0];
+          if(wx > 0) v += wx*(256-wy)*img_ptr[1];
+          if(wy > 0) v += (256-wx)*wy*img_ptr[refStep];
+          if(wx > 0 && wy > 0) v += wx*wy*img_ptr[refStep+1];
+          *patch_ptr = static_cast<int16_t>((v+rounding) >> shift);
+        }
+      }
+    }
+  }
+};
+
+/** \brief Compact fixed-point version of a \ref MultilevelPatch.
+ *
+ *    @tparam nLevels   - Number of pyramid levels on which the feature is defined.
+ *    @tparam patchSize - Edge length of the patches in pixels. Value must be a multiple of 2!.
+ */
+template<int nLevels,int patchSize>
+class QuantizedMultilevelPatch{
+ public:
+  static const int nLevels_ = nLevels;  /**<Number of pyramid levels on which the feature is defined.*/
+  QuantizedPatch<patchSize> patches_[nLevels_];  /**<Array, holding the quantized patches on each pyramid level.*/
+  bool isValidPatch_[nLevels_];  /**<Array, specifying if there is a valid patch stored at the corresponding location in \ref patches_.*/
+  mutable float e0_;  /**<Smaller eigenvalue of the averaged structure tensor (see computeMultilevelShiTomasiScore()).*/
+  mutable float e1_;  /**<Larger eigenvalue of the averaged structure tensor (see computeMultilevelShiTomasiScore()).*/
+
+  /** Constructor
+   */
+  QuantizedMultilevelPatch(){
+    reset();
+  }
+
+  /** \brief Resets the QuantizedMultilevelPatch.
+   */
+  void reset(){
+    for(unsigned int i = 0;i<nLevels_;i++){
+      isValidPatch_[i] = false;
+    }
+    e0_ = 0;
+    e1_ = 0;
+  }
+
+  /** \brief Quantizes all valid patches of a \ref MultilevelPatch.
+   *
+   * @param mp - Multilevel patch.
+   */
+  void quantize(const MultilevelPatch<nLevels,patchSize>& mp){
+    for(unsigned int i = 0;i<nLevels_;i++){
+      isValidPatch_[i] = mp.isValidPatch_[i];
+      if(isValidPatch_[i]){
+        patches_[i].quantize(mp.patches_[i]);
+      }
+    }
+  }
+
+  /** \brief Extracts the fixed-point patches from a given image pyramid.
+   *
+   * @param pyr - Image pyramid from which the patch data should be extracted.
+   * @param c   - Pixel coordinates and warping of the patch in the reference image (level 0).
+   * @param l   - Patches are extracted from pyramid level 0 to l (levels below the base level of the pyramid are marked invalid).
+   */
+  void extractMultilevelPatchFromImage(const ImagePyramid<nLevels>& pyr,const PixelCoordinates& c, const int l = nLevels-1){
+    for(int i=0;i<=l;i++){
+      if(pyr.imgs_[i].empty()){
+        isValidPatch_[i] = false;
+        continue;
+      }
+      const PixelCoordinates coorTemp = pyr.levelTranformCoordinates(c,0,i);
+      isValidPatch_[i] = true;
+      patches_[i].extractPatchFromImage(pyr.imgs_[i],coorTemp);
+    }
+  }
+
+  /** \brief Computes the eigenvalues \ref e0_ and \ref e1_ of the averaged, level-scaled structure tensor of the valid
+   *         patches in a pyramid level interval (fixed-point version of MultilevelPatch::computeMultilevelShiTomasiScore,
+   *         without the need for float patches with border).
+   *
+   * @param l1 - Start pyramid level (l1<l2)
+   * @param l2 - End pyramid level (l1<l2)
+   */
+  void computeMultilevelShiTomasiScore(const int l1 = 0, const int l2 = nLevels_-1) const{
+    double dXX = 0.0;
+    double dYY = 0.0;
+    double dXY = 0.0;
+    int count = 0;
+    for(int l=l1;l<=l2;l++){
+      if(isValidPatch_[l]){
+        int64_t sXX, sYY, sXY;
+        patches_[l].computeStructureTensor(sXX,sYY,sXY);
+        const double scale = LevelScales<nLevels>::squaredDown(l);
+        dXX += scale*sXX;
+        dYY += scale*sYY;
+        dXY += scale*sXY;
+        count++;
+      }
+    }
+    if(count > 0){
+      const double normalization = 1.0/(count*patchSize*patchSize*(1 << 2*(QuantizedPatch<patchSize>::fractionalBits_+1)));
+      dXX *= normalization;
+      dYY *= normalization;
+      dXY *= normalization;
+      const double root = std::sqrt(std::max((dXX + dYY) * (dXX + dYY) - 4 * (dXX * dYY - dXY * dXY),0.0));
+      e0_ = 0.5 * (dXX + dYY - root);
+      e1_ = 0.5 * (dXX + dYY + root);
+    } else {
+      e0_ = 0;
+      e1_ = 0;
+    }
+  }
+
+  /** \brief Computes the offset compensated RMSE with respect to the patches of an other QuantizedMultilevelPatch
+   *         for an specific pyramid level interval (integer version of MultilevelPatch::computeAverageDifference).
+   *
+   * @param mp        - \ref QuantizedMultilevelPatch, which patches should be used for the RMSE computation.
+   * @param l1        - Start pyramid level (l1<l2)
+   * @param l2        - End pyramid level (l1<l2)
+   * @return the RMSE value (in intensity units) for the patches in the set pyramid level interval.
+   */
+  float computeAverageDifference(const QuantizedMultilevelPatch<nLevels,patchSize>& mp, const int l1, const int l2) const{
+    int64_t sumDiff = 0;
+    int64_t sumSq = 0;
+    for(int l = l1; l <= l2; l++){
+      int64_t levelSumDiff;
+      sumSq += quantized_kernels::sumSquaredDifference(patches_[l].patch_,mp.patches_[l].patch_,patchSize*patchSize,levelSumDiff);
+      sumDiff += levelSumDiff;
+    }
+    const double N = patchSize*patchSize*(l2-l1+1);
+    const double offset = sumDiff/N;
+    const double error = std::max(sumSq/N - offset*offset,0.0);
+    return std::sqrt(error)/(1 << QuantizedPatch<patchSize>::fractionalBits_);
+  }
+};
+
+}
+
+
+#endif /* ROVIO_QUANTIZEDPATCH_HPP_ */
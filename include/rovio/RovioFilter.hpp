@@ -29,6 +29,9 @@
 #ifndef ROVIO_ROVIO_FILTER_HPP_
 #define ROVIO_ROVIO_FILTER_HPP_
 
+#include <memory>
+#include <vector>
+
 #include "lightweight_filtering/common.hpp"
 #include "lightweight_filtering/FilterBase.hpp"
 #include "rovio/FilterStates.hpp"
@@ -37,6 +40,9 @@
 #include "rovio/VelocityUpdate.hpp"
 #include "rovio/ImuPrediction.hpp"
 #include "rovio/MultiCamera.hpp"
+#include "rovio/RovioSceneSnapshot.hpp"
+#include "rovio/SnapshotBuffer.hpp"
+#include "rovio/StateHistory.hpp"
 
 namespace rovio {
 /** \brief Class, defining the Rovio Filter.
@@ -70,125 +76,22 @@ class RovioFilter:public LWF::FilterBase<ImuPrediction<FILTERSTATE>,
   typedef typename Base::mtFilterState mtFilterState;
   typedef typename Base::mtPrediction mtPrediction;
   typedef typename Base::mtState mtState;
+  typedef typename Base::mtUpdates mtUpdates;
+  typedef typename mtPrediction::mtMeas mtPredictionMeas;
   rovio::MultiCamera<mtState::nCam_> multiCamera_;
   std::string cameraCalibrationFile_[mtState::nCam_];
   int depthTypeInt_;
+  SnapshotBuffer<RovioSceneSnapshot<mtFilterState>> sceneSnapshot_;  /**<Snapshots of the safe state for the visualization, filled by the node.*/
+  bool publishSceneSnapshot_;  /**<Whether snapshots should be published (set by the RovioScene).*/
+  StateHistory<mtState,mtPredictionMeas> stateHistory_;  /**<Past safe estimates and IMU measurements for applying delayed measurements.*/
 
   /** \brief Constructor. Initializes the filter.
    */
-  RovioFilter(){
-    updateToUpdateMeasOnly_ = true;
-    std::get<0>(mUpdates_).setCamera(&multiCamera_);
-    init_.setCamera(&multiCamera_);
-    depthTypeInt_ = 1;
-    subHandlers_.erase("Update0");
-    subHandlers_["ImgUpdate"] = &std::get<0>(mUpdates_);
-    subHandlers_.erase("Update1");
-    subHandlers_["PoseUpdate"] = &std::get<1>(mUpdates_);
-    subHandlers_.erase("Update2");
-    subHandlers_["VelocityUpdate"] = &std::get<2>(mUpdates_);
-    boolRegister_.registerScalar("Common.doVECalibration",init_.state_.aux().doVECalibration_);
-    intRegister_.registerScalar("Common.depthType",depthTypeInt_);
-    for(int camID=0;camID<mtState::nCam_;camID++){
-      cameraCalibrationFile_[camID] = "";
-      stringRegister_.registerScalar("Camera" + std::to_string(camID) + ".CalibrationFile",cameraCalibrationFile_[camID]);
-      doubleRegister_.registerVector("Camera" + std::to_string(camID) + ".MrMC",init_.state_.aux().MrMC_[camID]);
-      doubleRegister_.registerQuaternion("Camera" + std::to_string(camID) + ".qCM",init_.state_.aux().qCM_[camID]);
-      doubleRegister_.removeScalarByVar(init_.state_.MrMC(camID)(0));
-      doubleRegister_.removeScalarByVar(init_.state_.MrMC(camID)(1));
-      doubleRegister_.removeScalarByVar(init_.state_.MrMC(camID)(2));
-      doubleRegister_.removeScalarByVar(init_.state_.qCM(camID).toImplementation().w());
-      doubleRegister_.removeScalarByVar(init_.state_.qCM(camID).toImplementation().x());
-      doubleRegister_.removeScalarByVar(init_.state_.qCM(camID).toImplementation().y());
-      doubleRegister_.removeScalarByVar(init_.state_.qCM(camID).toImplementation().z());
-      for(int j=0;j<3;j++){
-        doubleRegister_.removeScalarByVar(init_.cov_(mtState::template getId<mtState::_vep>(camID)+j,mtState::template getId<mtState::_vep>(camID)+j));
-        doubleRegister_.removeScalarByVar(init_.cov_(mtState::template getId<mtState::_vea>(camID)+j,mtState::template getId<mtState::_vea>(camID)+j));
-        doubleRegister_.registerScalar("Init.Covariance.vep",init_.cov_(mtState::template getId<mtState::_vep>(camID)+j,mtState::template getId<mtState::_vep>(camID)+j));
-        doubleRegister_.registerScalar("Init.Covariance.vea",init_.cov_(mtState::template getId<mtState::_vea>(camID)+j,mtState::template getId<mtState::_vea>(camID)+j));
-      }
-      doubleRegister_.registerVector("Camera" + std::to_string(camID) + ".MrMC",init_.state_.MrMC(camID));
-      doubleRegister_.registerQuaternion("Camera" + std::to_string(camID) + ".qCM",init_.state_.qCM(camID));
-    }
-    for(int i=0;i<mtState::nPose_;i++){
-      doubleRegister_.removeScalarByVar(init_.state_.poseLin(i)(0));
-      doubleRegister_.removeScalarByVar(init_.state_.poseLin(i)(1));
-      doubleRegister_.removeScalarByVar(init_.state_.poseLin(i)(2));
-      doubleRegister_.removeScalarByVar(init_.state_.poseRot(i).toImplementation().w());
-      doubleRegister_.removeScalarByVar(init_.state_.poseRot(i).toImplementation().x());
-      doubleRegister_.removeScalarByVar(init_.state_.poseRot(i).toImplementation().y());
-      doubleRegister_.removeScalarByVar(init_.state_.poseRot(i).toImplementation().z());
-      for(int j=0;j<3;j++){
-        doubleRegister_.removeScalarByVar(init_.cov_(mtState::template getId<mtState::_pop>(i)+j,mtState::template getId<mtState::_pop>(i)+j));
-        doubleRegister_.removeScalarByVar(init_.cov_(mtState::template getId<mtState::_poa>(i)+j,mtState::template getId<mtState::_poa>(i)+j));
-      }
-    }
-    if(std::get<1>(mUpdates_).inertialPoseIndex_>=0){
-      std::get<1>(mUpdates_).doubleRegister_.registerVector("IrIW",init_.state_.poseLin(std::get<1>(mUpdates_).inertialPoseIndex_));
-      std::get<1>(mUpdates_).doubleRegister_.registerQuaternion("qWI",init_.state_.poseRot(std::get<1>(mUpdates_).inertialPoseIndex_));
-      for(int j=0;j<3;j++){
-        std::get<1>(mUpdates_).doubleRegister_.registerScalar("init_cov_IrIW",init_.cov_(mtState::template getId<mtState::_pop>(std::get<1>(mUpdates_).inertialPoseIndex_)+j,mtState::template getId<mtState::_pop>(std::get<1>(mUpdates_).inertialPoseIndex_)+j));
-        std::get<1>(mUpdates_).doubleRegister_.registerScalar("init_cov_qWI",init_.cov_(mtState::template getId<mtState::_poa>(std::get<1>(mUpdates_).inertialPoseIndex_)+j,mtState::template getId<mtState::_poa>(std::get<1>(mUpdates_).inertialPoseIndex_)+j));
-        std::get<1>(mUpdates_).doubleRegister_.registerScalar("pre_cov_IrIW",mPrediction_.prenoiP_(mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_pop>(std::get<1>(mUpdates_).inertialPoseIndex_)+j,mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_pop>(std::get<1>(mUpdates_).inertialPoseIndex_)+j));
-        std::get<1>(mUpdates_).doubleRegister_.registerScalar("pre_cov_qWI",mPrediction_.prenoiP_(mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_poa>(std::get<1>(mUpdates_).inertialPoseIndex_)+j,mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_poa>(std::get<1>(mUpdates_).inertialPoseIndex_)+j));
-      }
-    }
-    if(std::get<1>(mUpdates_).bodyPoseIndex_>=0){
-      std::get<1>(mUpdates_).doubleRegister_.registerVector("MrMV",init_.state_.poseLin(std::get<1>(mUpdates_).bodyPoseIndex_));
-      std::get<1>(mUpdates_).doubleRegister_.registerQuaternion("qVM",init_.state_.poseRot(std::get<1>(mUpdates_).bodyPoseIndex_));
-      for(int j=0;j<3;j++){
-        std::get<1>(mUpdates_).doubleRegister_.registerScalar("init_cov_MrMV",init_.cov_(mtState::template getId<mtState::_pop>(std::get<1>(mUpdates_).bodyPoseIndex_)+j,mtState::template getId<mtState::_pop>(std::get<1>(mUpdates_).bodyPoseIndex_)+j));
-        std::get<1>(mUpdates_).doubleRegister_.registerScalar("init_cov_qVM",init_.cov_(mtState::template getId<mtState::_poa>(std::get<1>(mUpdates_).bodyPoseIndex_)+j,mtState::template getId<mtState::_poa>(std::get<1>(mUpdates_).bodyPoseIndex_)+j));
-        std::get<1>(mUpdates_).doubleRegister_.registerScalar("pre_cov_MrMV",mPrediction_.prenoiP_(mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_pop>(std::get<1>(mUpdates_).bodyPoseIndex_)+j,mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_pop>(std::get<1>(mUpdates_).bodyPoseIndex_)+j));
-        std::get<1>(mUpdates_).doubleRegister_.registerScalar("pre_cov_qVM",mPrediction_.prenoiP_(mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_poa>(std::get<1>(mUpdates_).bodyPoseIndex_)+j,mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_poa>(std::get<1>(mUpdates_).bodyPoseIndex_)+j));
-      }
-    }
-    int ind;
-    for(int i=0;i<FILTERSTATE::mtState::nMax_;i++){
-      ind = mtState::template getId<mtState::_fea>(i);
-      doubleRegister_.removeScalarByVar(init_.cov_(ind,ind));
-      doubleRegister_.removeScalarByVar(init_.cov_(ind+1,ind+1));
-      ind = mtState::template getId<mtState::_fea>(i)+2;
-      doubleRegister_.removeScalarByVar(init_.cov_(ind,ind));
-      doubleRegister_.removeScalarByVar(init_.state_.dep(i).p_);
-      doubleRegister_.removeScalarByVar(init_.state_.CfP(i).nor_.q_.toImplementation().w());
-      doubleRegister_.removeScalarByVar(init_.state_.CfP(i).nor_.q_.toImplementation().x());
-      doubleRegister_.removeScalarByVar(init_.state_.CfP(i).nor_.q_.toImplementation().y());
-      doubleRegister_.removeScalarByVar(init_.state_.CfP(i).nor_.q_.toImplementation().z());
-      std::get<0>(mUpdates_).intRegister_.registerScalar("statLocalQualityRange",init_.fsm_.features_[i].mpStatistics_->localQualityRange_);
-      std::get<0>(mUpdates_).intRegister_.registerScalar("statLocalVisibilityRange",init_.fsm_.features_[i].mpStatistics_->localVisibilityRange_);
-      std::get<0>(mUpdates_).intRegister_.registerScalar("statMinGlobalQualityRange",init_.fsm_.features_[i].mpStatistics_->minGlobalQualityRange_);
-      std::get<0>(mUpdates_).boolRegister_.registerScalar("doPatchWarping",init_.state_.CfP(i).trackWarping_);
-    }
-    std::get<0>(mUpdates_).doubleRegister_.removeScalarByVar(std::get<0>(mUpdates_).outlierDetection_.getMahalTh(0));
-    std::get<0>(mUpdates_).doubleRegister_.registerScalar("MahalanobisTh",std::get<0>(mUpdates_).outlierDetection_.getMahalTh(0));
-    std::get<0>(mUpdates_).outlierDetection_.setEnabledAll(true);
-    std::get<1>(mUpdates_).outlierDetection_.setEnabledAll(true);
-    boolRegister_.registerScalar("Common.verbose",std::get<0>(mUpdates_).verbose_);
-    mPrediction_.doubleRegister_.removeScalarByStr("alpha");
-    mPrediction_.doubleRegister_.removeScalarByStr("beta");
-    mPrediction_.doubleRegister_.removeScalarByStr("kappa");
-    boolRegister_.registerScalar("PoseUpdate.doVisualization",init_.plotPoseMeas_);
-    reset(0.0);
-  }
+  RovioFilter();
 
   /** \brief Reloads the camera calibration for all cameras and resets the depth map type.
    */
-  void refreshProperties(){
-    if(std::get<0>(mUpdates_).useDirectMethod_){
-      init_.mode_ = LWF::ModeIEKF;
-    } else {
-      init_.mode_ = LWF::ModeEKF;
-    }
-    for(int camID = 0;camID<mtState::nCam_;camID++){
-      if (!cameraCalibrationFile_[camID].empty()) {
-        multiCamera_.cameras_[camID].load(cameraCalibrationFile_[camID]);
-      }
-    }
-    for(int i=0;i<FILTERSTATE::mtState::nMax_;i++){
-      init_.state_.dep(i).setType(depthTypeInt_);
-    }
-  };
+  void refreshProperties();
 
   /** \brief Destructor
    */
@@ -206,6 +109,9 @@ class RovioFilter:public LWF::FilterBase<ImuPrediction<FILTERSTATE>,
   void resetWithAccelerometer(const V3D& fMeasInit, double t = 0.0){
     init_.initWithAccelerometer(fMeasInit);
     reset(t);
+    stateHistory_.clear();
+    safe_.medianDepthEstimator_.reset();
+    front_.medianDepthEstimator_.reset();
   }
 
   /** \brief Resets the filter with an external pose.
@@ -217,6 +123,9 @@ class RovioFilter:public LWF::FilterBase<ImuPrediction<FILTERSTATE>,
   void resetWithPose(V3D WrWM, QPD qMW, double t = 0.0) {
     init_.initWithImuPose(WrWM, qMW);
     reset(t);
+    stateHistory_.clear();
+    safe_.medianDepthEstimator_.reset();
+    front_.medianDepthEstimator_.reset();
   }
 
   /** \brief Sets the transformation between IMU and Camera.
@@ -230,8 +139,303 @@ class RovioFilter:public LWF::FilterBase<ImuPrediction<FILTERSTATE>,
     init_.state_.aux().qCM_[camID] = QPD(R);
     init_.state_.aux().MrMC_[camID] = -init_.state_.aux().qCM_[camID].inverseRotate(CrCM);
   }
+
+  /** \brief Applies a pose or velocity measurement whose timestamp is older than the safe state.
+   *
+   *  The estimate at the measurement time is restored from the closest older entry of the state history by
+   *  integrating the stored IMU measurements. The EKF correction computed there is propagated to the safe state
+   *  with the linearized IMU dynamics and applied to it and to all newer history entries. Image updates performed in
+   *  between are only accounted for through the stored estimates, i.e. their gain is not recomputed. Subtracting the
+   *  propagated covariance reduction is therefore not guaranteed to keep the covariances positive definite: the
+   *  measurement is rejected if any corrected variance would become negative, and the corrected covariances are
+   *  symmetrized. Finally the postProcess of the update is called on the safe state.
+   *
+   *  @tparam i    - Index of the update (1: pose, 2: velocity).
+   *  @param meas  - Measurement.
+   *  @param t     - Time of the measurement.
+   *  @return false if the measurement could not be applied (history disabled, too old, or not in the past).
+   */
+  template<int i>
+  bool applyDelayedUpdate(const typename std::tuple_element<i,mtUpdates>::type::mtMeas& meas, const double t){
+    typename std::tuple_element<i,mtUpdates>::type& update = std::get<i>(mUpdates_);
+    if(!stateHistory_.isEnabled() || t > safe_.t_) return false;
+    const int h = stateHistory_.find(t);
+    if(h < 0 || !update.prepareDelayedUpdate(meas)) return false;
+
+    // Estimate at the measurement time
+    delayedState_ = stateHistory_[h].state_;
+    delayedCov_ = stateHistory_[h].cov_;
+    double tCur = stateHistory_[h].t_;
+    if(!integrateDelayed(tCur,t,true)) return false;
+
+    // Correction at the measurement time, P+ = P - U*U^T
+    update.sparseUpdate_.computeCorrection(delayedState_,delayedCov_,update,update.updnoiP_,update.outlierDetection_);
+    delayedDx_ = update.sparseUpdate_.getCorrection();
+    update.sparseUpdate_.getCovarianceFactor(delayedU_);
+
+    // Propagate the correction to the newer history entries and to the safe state, nothing is applied before all
+    // corrected variances are known to be non-negative
+    const int n = stateHistory_.size()-h;
+    delayedDxs_.resize(n);
+    delayedUs_.resize(n);
+    for(int e=h+1;e<=stateHistory_.size();e++){
+      const bool isSafe = e == stateHistory_.size();
+      if(!integrateDelayed(tCur,isSafe ? safe_.t_ : stateHistory_[e].t_,false)) return false;
+      const MXD& cov = isSafe ? safe_.cov_ : stateHistory_[e].cov_;
+      if(((cov.diagonal()-delayedU_.rowwise().squaredNorm()).array() < 0.0).any()){
+        std::cout << "\033[31mWARNING: Delayed measurement rejected, the corrected covariance would have negative variances!\033[0m" << std::endl;
+        return false;
+      }
+      delayedDxs_[e-h-1] = delayedDx_;
+      delayedUs_[e-h-1] = delayedU_;
+    }
+    for(int e=h+1;e<=stateHistory_.size();e++){
+      const bool isSafe = e == stateHistory_.size();
+      mtState& state = isSafe ? safe_.state_ : stateHistory_[e].state_;
+      MXD& cov = isSafe ? safe_.cov_ : stateHistory_[e].cov_;
+      state.boxPlus(delayedDxs_[e-h-1],state);
+      cov.noalias() -= delayedUs_[e-h-1]*delayedUs_[e-h-1].transpose();
+      delayedCov_ = 0.5*(cov+cov.transpose());
+      cov = delayedCov_;
+    }
+    bool isFinished = true;
+    update.postProcess(safe_,meas,update.outlierDetection_,isFinished);
+    return true;
+  }
+
+  /** \brief Compares a delayed velocity measurement with the same measurement applied in time.
+   *
+   *  Starting from state and cov at time 0, the measurement is once applied before integrating the IMU measurement
+   *  up to dt, and once with applyDelayedUpdate after the integration. The measurement is chosen close to the predicted
+   *  one, such that both results only differ by the linearization error of the propagated correction. The safe state
+   *  and the state history are restored afterwards.
+   *
+   *  @param state - State at time 0.
+   *  @param cov   - Covariance at time 0.
+   *  @param imu   - IMU measurement, used for the whole interval.
+   *  @param dt    - Length of the interval.
+   *  @param th    - Threshold on the largest absolute difference of the state and of the covariance.
+   *  @return true if both differences are below th.
+   */
+  bool testDelayedUpdate(const mtState& state, const MXD& cov, const mtPredictionMeas& imu, const double dt, const double th);
+
+ private:
+  /** \brief Integrates delayedState_ with the IMU measurements of the state history.
+   *
+   *  @param tCur    - Current time of delayedState_, set to tEnd.
+   *  @param tEnd    - Target time.
+   *  @param withCov - If true the covariance delayedCov_ is propagated, otherwise the correction delayedDx_ and its
+   *                   covariance factor delayedU_.
+   *  @return false if there are no IMU measurements.
+   */
+  bool integrateDelayed(double& tCur, const double tEnd, const bool withCov);
+
+  mtState delayedState_;
+  MXD delayedCov_;
+  MXD delayedF_;
+  MXD delayedG_;
+  MXD delayedU_;
+  typename mtState::mtDifVec delayedDx_;
+  typename mtPrediction::mtNoise delayedNoise_;
+  std::vector<typename mtState::mtDifVec,Eigen::aligned_allocator<typename mtState::mtDifVec>> delayedDxs_;
+  std::vector<MXD> delayedUs_;
 };
 
+template<typename FILTERSTATE>
+RovioFilter<FILTERSTATE>::RovioFilter(){
+  updateToUpdateMeasOnly_ = true;
+  std::get<0>(mUpdates_).setCamera(&multiCamera_);
+  init_.setCamera(&multiCamera_);
+  depthTypeInt_ = 1;
+  publishSceneSnapshot_ = false;
+  delayedCov_.resize(mtState::D_,mtState::D_);
+  delayedF_.resize(mtState::D_,mtState::D_);
+  delayedG_.resize(mtState::D_,mtPrediction::mtNoise::D_);
+  delayedNoise_.setIdentity();
+  subHandlers_.erase("Update0");
+  subHandlers_["ImgUpdate"] = &std::get<0>(mUpdates_);
+  subHandlers_.erase("Update1");
+  subHandlers_["PoseUpdate"] = &std::get<1>(mUpdates_);
+  subHandlers_.erase("Update2");
+  subHandlers_["VelocityUpdate"] = &std::get<2>(mUpdates_);
+  boolRegister_.registerScalar("Common.doVECalibration",init_.state_.aux().doVECalibration_);
+  intRegister_.registerScalar("Common.depthType",depthTypeInt_);
+  doubleRegister_.registerScalar("Common.delayedMeasurementWindow",stateHistory_.window_);
+  for(int camID=0;camID<mtState::nCam_;camID++){
+    cameraCalibrationFile_[camID] = "";
+    stringRegister_.registerScalar("Camera" + std::to_string(camID) + ".CalibrationFile",cameraCalibrationFile_[camID]);
+    doubleRegister_.registerVector("Camera" + std::to_string(camID) + ".MrMC",init_.state_.aux().MrMC_[camID]);
+    doubleRegister_.registerQuaternion("Camera" + std::to_string(camID) + ".qCM",init_.state_.aux().qCM_[camID]);
+    doubleRegister_.removeScalarByVar(init_.state_.MrMC(camID)(0));
+    doubleRegister_.removeScalarByVar(init_.state_.MrMC(camID)(1));
+    doubleRegister_.removeScalarByVar(init_.state_.MrMC(camID)(2));
+    doubleRegister_.removeScalarByVar(init_.state_.qCM(camID).toImplementation().w());
+    doubleRegister_.removeScalarByVar(init_.state_.qCM(camID).toImplementation().x());
+    doubleRegister_.removeScalarByVar(init_.state_.qCM(camID).toImplementation().y());
+    doubleRegister_.removeScalarByVar(init_.state_.qCM(camID).toImplementation().z());
+    for(int j=0;j<3;j++){
+      doubleRegister_.removeScalarByVar(init_.cov_(mtState::template getId<mtState::_vep>(camID)+j,mtState::template getId<mtState::_vep>(camID)+j));
+      doubleRegister_.removeScalarByVar(init_.cov_(mtState::template getId<mtState::_vea>(camID)+j,mtState::template getId<mtState::_vea>(camID)+j));
+      doubleRegister_.registerScalar("Init.Covariance.vep",init_.cov_(mtState::template getId<mtState::_vep>(camID)+j,mtState::template getId<mtState::_vep>(camID)+j));
+      doubleRegister_.registerScalar("Init.Covariance.vea",init_.cov_(mtState::template getId<mtState::_vea>(camID)+j,mtState::template getId<mtState::_vea>(camID)+j));
+    }
+    doubleRegister_.registerVector("Camera" + std::to_string(camID) + ".MrMC",init_.state_.MrMC(camID));
+    doubleRegister_.registerQuaternion("Camera" + std::to_string(camID) + ".qCM",init_.state_.qCM(camID));
+  }
+  for(int i=0;i<mtState::nPose_;i++){
+    doubleRegister_.removeScalarByVar(init_.state_.poseLin(i)(0));
+    doubleRegister_.removeScalarByVar(init_.state_.poseLin(i)(1));
+    doubleRegister_.removeScalarByVar(init_.state_.poseLin(i)(2));
+    doubleRegister_.removeScalarByVar(init_.state_.poseRot(i).toImplementation().w());
+    doubleRegister_.removeScalarByVar(init_.state_.poseRot(i).toImplementation().x());
+    doubleRegister_.removeScalarByVar(init_.state_.poseRot(i).toImplementation().y());
+    doubleRegister_.removeScalarByVar(init_.state_.poseRot(i).toImplementation().z());
+    for(int j=0;j<3;j++){
+      doubleRegister_.removeScalarByVar(init_.cov_(mtState::template getId<mtState::_pop>(i)+j,mtState::template getId<mtState::_pop>(i)+j));
+      doubleRegister_.removeScalarByVar(init_.cov_(mtState::template getId<mtState::_poa>(i)+j,mtState::template getId<mtState::_poa>(i)+j));
+    }
+  }
+  if(std::get<1>(mUpdates_).inertialPoseIndex_>=0){
+    std::get<1>(mUpdates_).doubleRegister_.registerVector("IrIW",init_.state_.poseLin(std::get<1>(mUpdates_).inertialPoseIndex_));
+    std::get<1>(mUpdates_).doubleRegister_.registerQuaternion("qWI",init_.state_.poseRot(std::get<1>(mUpdates_).inertialPoseIndex_));
+    for(int j=0;j<3;j++){
+      std::get<1>(mUpdates_).doubleRegister_.registerScalar("init_cov_IrIW",init_.cov_(mtState::template getId<mtState::_pop>(std::get<1>(mUpdates_).inertialPoseIndex_)+j,mtState::template getId<mtState::_pop>(std::get<1>(mUpdates_).inertialPoseIndex_)+j));
+      std::get<1>(mUpdates_).doubleRegister_.registerScalar("init_cov_qWI",init_.cov_(mtState::template getId<mtState::_poa>(std::get<1>(mUpdates_).inertialPoseIndex_)+j,mtState::template getId<mtState::_poa>(std::get<1>(mUpdates_).inertialPoseIndex_)+j));
+      std::get<1>(mUpdates_).doubleRegister_.registerScalar("pre_cov_IrIW",mPrediction_.prenoiP_(mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_pop>(std::get<1>(mUpdates_).inertialPoseIndex_)+j,mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_pop>(std::get<1>(mUpdates_).inertialPoseIndex_)+j));
+      std::get<1>(mUpdates_).doubleRegister_.registerScalar("pre_cov_qWI",mPrediction_.prenoiP_(mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_poa>(std::get<1>(mUpdates_).inertialPoseIndex_)+j,mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_poa>(std::get<1>(mUpdates_).inertialPoseIndex_)+j));
+    }
+  }
+  if(std::get<1>(mUpdates_).bodyPoseIndex_>=0){
+    std::get<1>(mUpdates_).doubleRegister_.registerVector("MrMV",init_.state_.poseLin(std::get<1>(mUpdates_).bodyPoseIndex_));
+    std::get<1>(mUpdates_).doubleRegister_.registerQuaternion("qVM",init_.state_.poseRot(std::get<1>(mUpdates_).bodyPoseIndex_));
+    for(int j=0;j<3;j++){
+      std::get<1>(mUpdates_).doubleRegister_.registerScalar("init_cov_MrMV",init_.cov_(mtState::template getId<mtState::_pop>(std::get<1>(mUpdates_).bodyPoseIndex_)+j,mtState::template getId<mtState::_pop>(std::get<1>(mUpdates_).bodyPoseIndex_)+j));
+      std::get<1>(mUpdates_).doubleRegister_.registerScalar("init_cov_qVM",init_.cov_(mtState::template getId<mtState::_poa>(std::get<1>(mUpdates_).bodyPoseIndex_)+j,mtState::template getId<mtState::_poa>(std::get<1>(mUpdates_).bodyPoseIndex_)+j));
+      std::get<1>(mUpdates_).doubleRegister_.registerScalar("pre_cov_MrMV",mPrediction_.prenoiP_(mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_pop>(std::get<1>(mUpdates_).bodyPoseIndex_)+j,mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_pop>(std::get<1>(mUpdates_).bodyPoseIndex_)+j));
+      std::get<1>(mUpdates_).doubleRegister_.registerScalar("pre_cov_qVM",mPrediction_.prenoiP_(mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_poa>(std::get<1>(mUpdates_).bodyPoseIndex_)+j,mtPrediction::mtNoise::template getId<mtPrediction::mtNoise::_poa>(std::get<1>(mUpdates_).bodyPoseIndex_)+j));
+    }
+  }
+  int ind;
+  for(int i=0;i<FILTERSTATE::mtState::nMax_;i++){
+    ind = mtState::template getId<mtState::_fea>(i);
+    doubleRegister_.removeScalarByVar(init_.cov_(ind,ind));
+    doubleRegister_.removeScalarByVar(init_.cov_(ind+1,ind+1));
+    ind = mtState::template getId<mtState::_fea>(i)+2;
+    doubleRegister_.removeScalarByVar(init_.cov_(ind,ind));
+    doubleRegister_.removeScalarByVar(init_.state_.dep(i).p_);
+    doubleRegister_.removeScalarByVar(init_.state_.CfP(i).nor_.q_.toImplementation().w());
+    doubleRegister_.removeScalarByVar(init_.state_.CfP(i).nor_.q_.toImplementation().x());
+    doubleRegister_.removeScalarByVar(init_.state_.CfP(i).nor_.q_.toImplementation().y());
+    doubleRegister_.removeScalarByVar(init_.state_.CfP(i).nor_.q_.toImplementation().z());
+    std::get<0>(mUpdates_).intRegister_.registerScalar("statLocalQualityRange",init_.fsm_.features_[i].mpStatistics_->localQualityRange_);
+    std::get<0>(mUpdates_).intRegister_.registerScalar("statLocalVisibilityRange",init_.fsm_.features_[i].mpStatistics_->localVisibilityRange_);
+    std::get<0>(mUpdates_).intRegister_.registerScalar("statMinGlobalQualityRange",init_.fsm_.features_[i].mpStatistics_->minGlobalQualityRange_);
+    std::get<0>(mUpdates_).boolRegister_.registerScalar("doPatchWarping",init_.state_.CfP(i).trackWarping_);
+  }
+  std::get<0>(mUpdates_).doubleRegister_.removeScalarByVar(std::get<0>(mUpdates_).outlierDetection_.getMahalTh(0));
+  std::get<0>(mUpdates_).doubleRegister_.registerScalar("MahalanobisTh",std::get<0>(mUpdates_).outlierDetection_.getMahalTh(0));
+  std::get<0>(mUpdates_).outlierDetection_.setEnabledAll(true);
+  std::get<1>(mUpdates_).outlierDetection_.setEnabledAll(true);
+  boolRegister_.registerScalar("Common.verbose",std::get<0>(mUpdates_).verbose_);
+  mPrediction_.doubleRegister_.removeScalarByStr("alpha");
+  mPrediction_.doubleRegister_.removeScalarByStr("beta");
+  mPrediction_.doubleRegister_.removeScalarByStr("kappa");
+  boolRegister_.registerScalar("PoseUpdate.doVisualization",init_.plotPoseMeas_);
+  reset(0.0);
+}
+
+template<typename FILTERSTATE>
+void RovioFilter<FILTERSTATE>::refreshProperties(){
+  if(std::get<0>(mUpdates_).useDirectMethod_){
+    init_.mode_ = LWF::ModeIEKF;
+  } else {
+    init_.mode_ = LWF::ModeEKF;
+  }
+  for(int camID = 0;camID<mtState::nCam_;camID++){
+    if (!cameraCalibrationFile_[camID].empty()) {
+      multiCamera_.cameras_[camID].load(cameraCalibrationFile_[camID]);
+    }
+  }
+  for(int i=0;i<FILTERSTATE::mtState::nMax_;i++){
+    init_.state_.dep(i).setType(depthTypeInt_);
+  }
+}
+
+template<typename FILTERSTATE>
+bool RovioFilter<FILTERSTATE>::testDelayedUpdate(const mtState& state, const MXD& cov, const mtPredictionMeas& imu, const double dt, const double th){
+  typename std::tuple_element<2,mtUpdates>::type& update = std::get<2>(mUpdates_);
+  std::unique_ptr<mtFilterState> mpSavedSafe(new mtFilterState());
+  *mpSavedSafe = safe_;
+  const StateHistory<mtState,mtPredictionMeas> savedHistory = stateHistory_;
+  typename std::tuple_element<2,mtUpdates>::type::mtMeas meas;
+  meas.vel() = V3D(1e-6,-2e-6,1e-6)-update.qAM_.rotate(state.MvM());
+  update.prepareDelayedUpdate(meas);
+
+  // History with the estimate at time 0 and the IMU measurements
+  const int nImu = 10;
+  stateHistory_.clear();
+  stateHistory_.window_ = dt+1.0;
+  stateHistory_.addState(0.0,state,cov);
+  for(int k=1;k<=nImu;k++){
+    stateHistory_.addImu(k*dt/nImu,imu);
+  }
+
+  // Update at time 0, then integration
+  update.sparseUpdate_.computeCorrection(state,cov,update,update.updnoiP_,update.outlierDetection_);
+  update.sparseUpdate_.getCovarianceFactor(delayedU_);
+  state.boxPlus(update.sparseUpdate_.getCorrection(),delayedState_);
+  delayedCov_ = cov-delayedU_*delayedU_.transpose();
+  double tCur = 0.0;
+  integrateDelayed(tCur,dt,true);
+  std::unique_ptr<mtState> mpInTimeState(new mtState(delayedState_));
+  const MXD inTimeCov = delayedCov_;
+
+  // Integration, then delayed update at time 0
+  delayedState_ = state;
+  delayedCov_ = cov;
+  tCur = 0.0;
+  integrateDelayed(tCur,dt,true);
+  safe_.state_ = delayedState_;
+  safe_.cov_ = delayedCov_;
+  safe_.t_ = dt;
+  const bool applied = applyDelayedUpdate<2>(meas,0.0);
+  typename mtState::mtDifVec dif;
+  safe_.state_.boxMinus(*mpInTimeState,dif);
+  const double stateError = dif.array().abs().maxCoeff();
+  const double covError = (safe_.cov_-inTimeCov).array().abs().maxCoeff();
+
+  safe_ = *mpSavedSafe;
+  stateHistory_ = savedHistory;
+  if(!applied || stateError > th || covError > th){
+    std::cout << "\033[31m==== Delayed update differs from update in time (applied " << applied << ", state " << stateError << ", covariance " << covError << ") ====\033[0m" << std::endl;
+    return false;
+  }
+  std::cout << "\033[32m==== Delayed update is consistent (state " << stateError << ", covariance " << covError << ") ====\033[0m" << std::endl;
+  return true;
+}
+
+template<typename FILTERSTATE>
+bool RovioFilter<FILTERSTATE>::integrateDelayed(double& tCur, const double tEnd, const bool withCov){
+  double tMeas;
+  while(tCur < tEnd){
+    const mtPredictionMeas* imu = stateHistory_.getImu(tCur,tMeas);
+    if(imu == nullptr) return false;
+    const double dt = std::min(tMeas,tEnd)-tCur;
+    mPrediction_.meas_ = *imu;
+    mPrediction_.jacPreviousState(delayedF_,delayedState_,dt);
+    if(withCov){
+      mPrediction_.jacNoise(delayedG_,delayedState_,dt);
+      delayedCov_ = delayedF_*delayedCov_*delayedF_.transpose() + delayedG_*mPrediction_.prenoiP_*delayedG_.transpose();
+    } else {
+      delayedDx_ = delayedF_*delayedDx_;
+      delayedU_ = delayedF_*delayedU_;
+    }
+    mPrediction_.evalPrediction(delayedState_,delayedState_,delayedNoise_,dt);
+    tCur += dt;
+  }
+  return true;
+}
+
 }
 
 
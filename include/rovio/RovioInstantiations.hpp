@@ -0,0 +1,72 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_ROVIOINSTANTIATIONS_HPP_
+#define ROVIO_ROVIOINSTANTIATIONS_HPP_
+
+#include "rovio/RovioFilter.hpp"
+#include "rovio/RovioVariants.hpp"
+
+namespace rovio{
+namespace instantiation{
+
+/** \brief Types of the default filter configuration (CMake cache variables ROVIO_NMAXFEATURE, ...).
+ *
+ *  The templates below are explicitly instantiated once in the library (src/RovioInstantiations.cpp). Translation
+ *  units compiled with ROVIO_USE_EXTERN_TEMPLATES only see the extern declarations and therefore do not instantiate
+ *  (and optimize) the heavy filter code again. This only applies to members defined outside of the class bodies, the
+ *  heavy members of ImgUpdate, ImuPrediction and RovioFilter are therefore defined out of line. Additional variants from
+ *  ROVIO_VARIANTS and the ROS dependent RovioNode are instantiated implicitly in the executables.
+ */
+typedef FilterState<ROVIO_NMAXFEATURE,ROVIO_NLEVELS,ROVIO_PATCHSIZE,ROVIO_NCAM,ROVIO_NPOSE> mtFilterState;
+typedef RovioFilter<mtFilterState> mtFilter;
+
+}
+}
+
+/** \brief Expands to the explicit instantiations of the default filter configuration.
+ *
+ *  @param PREFIX - Either empty (instantiation definition) or extern (instantiation declaration).
+ */
+#define ROVIO_TEMPLATE_INSTANTIATIONS(PREFIX) \
+  PREFIX template class rovio::ImagePyramid<ROVIO_NLEVELS>; \
+  PREFIX template class rovio::MultilevelPatch<ROVIO_NLEVELS,ROVIO_PATCHSIZE>; \
+  PREFIX template class rovio::MultilevelPatchAlignment<ROVIO_NLEVELS,ROVIO_PATCHSIZE>; \
+  PREFIX template class rovio::FeatureSetManager<ROVIO_NLEVELS,ROVIO_PATCHSIZE,ROVIO_NCAM,ROVIO_NMAXFEATURE>; \
+  PREFIX template class rovio::FilterState<ROVIO_NMAXFEATURE,ROVIO_NLEVELS,ROVIO_PATCHSIZE,ROVIO_NCAM,ROVIO_NPOSE>; \
+  PREFIX template class rovio::ImuPrediction<rovio::instantiation::mtFilterState>; \
+  PREFIX template class rovio::ImgUpdate<rovio::instantiation::mtFilterState>; \
+  PREFIX template class rovio::PoseUpdate<rovio::instantiation::mtFilterState,(int)(ROVIO_NPOSE>0)-1,(int)(ROVIO_NPOSE>1)*2-1>; \
+  PREFIX template class rovio::VelocityUpdate<rovio::instantiation::mtFilterState>; \
+  PREFIX template class rovio::RovioFilter<rovio::instantiation::mtFilterState>;
+
+#ifdef ROVIO_USE_EXTERN_TEMPLATES
+ROVIO_TEMPLATE_INSTANTIATIONS(extern)
+#endif
+
+#endif /* ROVIO_ROVIOINSTANTIATIONS_HPP_ */
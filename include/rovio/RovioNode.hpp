@@ -29,9 +29,16 @@
 #ifndef ROVIO_ROVIONODE_HPP_
 #define ROVIO_ROVIONODE_HPP_
 
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <sstream>
+#include <sys/stat.h>
 
 #include <cv_bridge/cv_bridge.h>
 #include <geometry_msgs/Pose.h>
@@ -49,7 +56,10 @@
 #include <visualization_msgs/Marker.h>
 
 #include <rovio/SrvResetToPose.h>
+#include "rovio/BuildId.hpp"
 #include "rovio/RovioFilter.hpp"
+#include "rovio/ImageIngestionPolicy.hpp"
+#include "rovio/FeaturePointCloud.hpp"
 #include "rovio/CoordinateTransform/RovioOutput.hpp"
 #include "rovio/CoordinateTransform/FeatureOutput.hpp"
 #include "rovio/CoordinateTransform/FeatureOutputReadable.hpp"
@@ -124,7 +134,14 @@ class RovioNode{
   bool forceMarkersPublishing_;
   bool forcePatchPublishing_;
   bool gotFirstMessages_;
+  double lastUpdateDuration_;  /**<Duration of the last filter update in milliseconds.*/
+  int lastUpdateImageCount_;  /**<Number of images processed by the last filter update.*/
   std::mutex m_filter_;
+  ImageIngestionPolicy ingestionPolicy_;  /**<Bounds the number of queued images if the filter falls behind.*/
+  bool dropCurrentFrame_;  /**<True if the frame with the current image time was dropped by the ingestion policy.*/
+  int imageQueueSize_;  /**<Queue size of the image subscribers.*/
+  std::string selfTestMode_;  /**<Startup self-test of the Jacobians: "always", "once" (once per library build and configuration) or "never".*/
+  std::string selfTestCacheDir_;  /**<Directory in which the passed self-tests are recorded (mode "once").*/
 
   // Nodes, Subscriber, Publishers
   ros::NodeHandle nh_;
@@ -157,6 +174,7 @@ class RovioNode{
   geometry_msgs::PoseWithCovarianceStamped estimatedPoseWithCovarianceStampedMsg_;
   geometry_msgs::PoseWithCovarianceStamped extrinsicsMsg_[mtState::nCam_];
   sensor_msgs::PointCloud2 pclMsg_;
+  FeaturePointCloud featurePointCloud_;  /**<Writes the features into pclMsg_.*/
   sensor_msgs::PointCloud2 patchMsg_;
   visualization_msgs::Marker markerMsg_;
   sensor_msgs::Imu imuBiasMsg_;
@@ -206,12 +224,33 @@ class RovioNode{
     forceMarkersPublishing_ = false;
     forcePatchPublishing_ = false;
     gotFirstMessages_ = false;
+    lastUpdateDuration_ = 0.0;
+    lastUpdateImageCount_ = 0;
 	imgCallStart = ros::Time::now();
 
+    // Image ingestion policy
+    dropCurrentFrame_ = false;
+    imageQueueSize_ = 1000;
+    std::string imageDropPolicy = "oldest";
+    nh_private_.param("image_queue_size", imageQueueSize_, imageQueueSize_);
+    nh_private_.param("max_image_queue_depth", ingestionPolicy_.maxQueueDepth_, ingestionPolicy_.maxQueueDepth_);
+    nh_private_.param("image_drop_policy", imageDropPolicy, imageDropPolicy);
+    nh_private_.param("image_drop_every_nth", ingestionPolicy_.dropEveryNth_, ingestionPolicy_.dropEveryNth_);
+    nh_private_.param("skip_image_updates", ingestionPolicy_.skipImageUpdates_, ingestionPolicy_.skipImageUpdates_);
+    ingestionPolicy_.setDropPolicy(imageDropPolicy);
+
+    // Startup self-test
+    selfTestMode_ = "once";
+    const char* rosHome = std::getenv("ROS_HOME");
+    const char* home = std::getenv("HOME");
+    selfTestCacheDir_ = rosHome != nullptr ? std::string(rosHome) : (home != nullptr ? std::string(home) + "/.ros" : std::string("/tmp"));
+    nh_private_.param("self_test", selfTestMode_, selfTestMode_);
+    nh_private_.param("self_test_cache_dir", selfTestCacheDir_, selfTestCacheDir_);
+
     // Subscribe topics
     subImu_ = nh_.subscribe("imu0", 1000, &RovioNode::imuCallback,this);
-    subImg0_ = nh_.subscribe("cam0/image_raw", 1000, &RovioNode::imgCallback0,this);
-    subImg1_ = nh_.subscribe("cam1/image_raw", 1000, &RovioNode::imgCallback1,this);
+    subImg0_ = nh_.subscribe("cam0/image_raw", imageQueueSize_, &RovioNode::imgCallback0,this);
+    subImg1_ = nh_.subscribe("cam1/image_raw", imageQueueSize_, &RovioNode::imgCallback1,this);
     subGroundtruth_ = nh_.subscribe("pose", 1000, &RovioNode::groundtruthCallback,this);
     subGroundtruthOdometry_ = nh_.subscribe("odometry", 1000, &RovioNode::groundtruthOdometryCallback, this);
     subVelocity_ = nh_.subscribe("abss/twist", 1000, &RovioNode::velocityCallback,this);
@@ -268,29 +307,7 @@ class RovioNode{
 
     // PointCloud message.
     pclMsg_.header.frame_id = imu_frame_;
-    pclMsg_.height = 1;               // Unordered point cloud.
-    pclMsg_.width  = mtState::nMax_;  // Number of features/points.
-    const int nFieldsPcl = 18;
-    std::string namePcl[nFieldsPcl] = {"id","camId","rgb","status","x","y","z","b_x","b_y","b_z","d","c_00","c_01","c_02","c_11","c_12","c_22","c_d"};
-    int sizePcl[nFieldsPcl] = {4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4};
-    int countPcl[nFieldsPcl] = {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1};
-    int datatypePcl[nFieldsPcl] = {sensor_msgs::PointField::INT32,sensor_msgs::PointField::INT32,sensor_msgs::PointField::UINT32,sensor_msgs::PointField::UINT32,
-        sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,
-        sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,
-        sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32};
-    pclMsg_.fields.resize(nFieldsPcl);
-    int byteCounter = 0;
-    for(int i=0;i<nFieldsPcl;i++){
-      pclMsg_.fields[i].name     = namePcl[i];
-      pclMsg_.fields[i].offset   = byteCounter;
-      pclMsg_.fields[i].count    = countPcl[i];
-      pclMsg_.fields[i].datatype = datatypePcl[i];
-      byteCounter += sizePcl[i]*countPcl[i];
-    }
-    pclMsg_.point_step = byteCounter;
-    pclMsg_.row_step = pclMsg_.point_step * pclMsg_.width;
-    pclMsg_.data.resize(pclMsg_.row_step * pclMsg_.height);
-    pclMsg_.is_dense = false;
+    FeaturePointCloud::initMessage(pclMsg_,mtState::nMax_);
 
     // PointCloud message.
     patchMsg_.header.frame_id = "";
@@ -302,7 +319,7 @@ class RovioNode{
     int countPatch[nFieldsPatch] = {1,mtState::nLevels_*mtState::patchSize_*mtState::patchSize_,mtState::nLevels_*mtState::patchSize_*mtState::patchSize_,mtState::nLevels_*mtState::patchSize_*mtState::patchSize_,mtState::nLevels_*mtState::patchSize_*mtState::patchSize_};
     int datatypePatch[nFieldsPatch] = {sensor_msgs::PointField::INT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32,sensor_msgs::PointField::FLOAT32};
     patchMsg_.fields.resize(nFieldsPatch);
-    byteCounter = 0;
+    int byteCounter = 0;
     for(int i=0;i<nFieldsPatch;i++){
       patchMsg_.fields[i].name     = namePatch[i];
       patchMsg_.fields[i].offset   = byteCounter;
@@ -334,16 +351,20 @@ class RovioNode{
     markerMsg_.color.b = 0.0;
   }
 
-  /** \brief Destructor
+  /** \brief Destructor, prints the image ingestion counters.
    */
-  virtual ~RovioNode(){}
+  virtual ~RovioNode(){
+    if(ingestionPolicy_.receivedCount_ > 0){
+      ingestionPolicy_.print();
+    }
+  }
 
   /** \brief Tests the functionality of the rovio node.
    *
    *  @todo debug with   doVECalibration = false and depthType = 0
    */
   void makeTest(){
-    mtFilterState* mpTestFilterState = new mtFilterState();
+    std::unique_ptr<mtFilterState> mpTestFilterState(new mtFilterState());
     *mpTestFilterState = mpFilter_->init_;
     mpTestFilterState->setCamera(&mpFilter_->multiCamera_);
     mtState& testState = mpTestFilterState->state_;
@@ -375,6 +396,7 @@ class RovioNode{
     // Prediction
     std::cout << "Testing Prediction" << std::endl;
     mpFilter_->mPrediction_.testPredictionJacs(testState,predictionMeas_,1e-8,1e-6,0.1);
+    mpFilter_->mPrediction_.testFeaturePropagation(testState,predictionMeas_,0.1,1e-10);
 
     // Update
     if(!mpImgUpdate_->useDirectMethod_){
@@ -390,9 +412,47 @@ class RovioNode{
 
     // Testing CameraOutputCF and CameraOutputCF
     std::cout << "Testing cameraOutputCF" << std::endl;
-    cameraOutputCT_.testTransformJac(testState,1e-8,1e-6);
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      cameraOutputCT_.camID_ = camID;
+      cameraOutputCT_.testTransformJac(testState,1e-8,1e-6);
+    }
+    cameraOutputCT_.camID_ = 0;
     std::cout << "Testing imuOutputCF" << std::endl;
     imuOutputCT_.testTransformJac(testState,1e-8,1e-6);
+    std::cout << "Testing median depth" << std::endl;
+    for(int i=0;i<mtState::nMax_;i++){
+      mpTestFilterState->fsm_.isValid_[i] = true;
+      mpTestFilterState->fsm_.features_[i].idx_ = i;
+    }
+    mpTestFilterState->testMedianDepthParameters(mpImgUpdate_->initDepth_,0.5);
+    std::cout << "Testing sparse output covariances" << std::endl;
+    MXD testCov = MXD::Random((int)(mtState::D_),(int)(mtState::D_));
+    testCov = testCov*testCov.transpose();
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      cameraOutputCT_.camID_ = camID;
+      testSparseCovMat(cameraOutputCT_,testState,testCov,1e-8);
+    }
+    cameraOutputCT_.camID_ = 0;
+    testSparseCovMat(imuOutputCT_,testState,testCov,1e-8);
+    transformFeatureOutputCT_.setFeatureID(0);
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      transformFeatureOutputCT_.setOutputCameraID(camID);
+      testSparseCovMat(transformFeatureOutputCT_,testState,testCov,1e-8);
+    }
+    std::cout << "Testing sparse updates" << std::endl;
+    std::unique_ptr<mtFilterState> mpSparseFilterState(new mtFilterState());
+    std::unique_ptr<mtFilterState> mpDenseFilterState(new mtFilterState());
+    if(!mpPoseUpdate_->noFeedbackToRovio_){
+      *mpSparseFilterState = *mpTestFilterState;
+      *mpDenseFilterState = *mpTestFilterState;
+      mpPoseUpdate_->sparseUpdate_.testUpdate(*mpPoseUpdate_,*mpSparseFilterState,*mpDenseFilterState,1e-8);
+    }
+    mtVelocityUpdate& velocityUpdate = std::get<2>(mpFilter_->mUpdates_);
+    *mpSparseFilterState = *mpTestFilterState;
+    *mpDenseFilterState = *mpTestFilterState;
+    velocityUpdate.sparseUpdate_.testUpdate(velocityUpdate,*mpSparseFilterState,*mpDenseFilterState,1e-8);
+    std::cout << "Testing delayed updates" << std::endl;
+    mpFilter_->testDelayedUpdate(testState,mpTestFilterState->cov_,predictionMeas_,0.05,1e-6);
     std::cout << "Testing attitudeToYprCF" << std::endl;
     rovio::AttitudeToYprCT attitudeToYprCF;
     attitudeToYprCF.testTransformJac(1e-8,1e-6);
@@ -436,8 +496,81 @@ class RovioNode{
       std::cout << "Testing pose update" << std::endl;
       mpPoseUpdate_->testUpdateJacs(1e-8,1e-5);
     }
+  }
 
-    delete mpTestFilterState;
+  /** \brief Computes a hash identifying the library build and the configuration the self-test was run with.
+   *
+   *  The hash covers the build id of librovio, the template configuration of the filter and the contents of the filter
+   *  and camera configuration files.
+   *
+   *  @param filterConfigFile - Path to the filter configuration (.info) file.
+   */
+  std::size_t getSelfTestHash(const std::string& filterConfigFile) const{
+    std::ostringstream ss;
+    ss << getLibraryBuildId() << " " << (int)mtState::nMax_ << " " << (int)mtState::nLevels_ << " " << (int)mtState::patchSize_ << " " << (int)mtState::nCam_ << " " << (int)mtState::nPose_;
+    std::ifstream filterConfig(filterConfigFile);
+    if(filterConfig.good()) ss << filterConfig.rdbuf();
+    ss.clear();  // Inserting an empty file sets the failbit
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      std::ifstream cameraConfig(mpFilter_->cameraCalibrationFile_[camID]);
+      if(cameraConfig.good()) ss << " " << cameraConfig.rdbuf();
+      ss.clear();
+    }
+    return std::hash<std::string>()(ss.str());
+  }
+
+  /** \brief Creates a directory and all its missing parents.
+   *
+   *  @param path - Directory path.
+   *  @return true if the directory exists afterwards.
+   */
+  static bool makeDirectories(const std::string& path){
+    std::size_t pos = 0;
+    do{
+      pos = path.find('/',pos+1);
+      const std::string dir = path.substr(0,pos);
+      if(!dir.empty() && mkdir(dir.c_str(),0755) != 0 && errno != EEXIST){
+        std::cout << "\033[31mERROR: Could not create directory " << dir << ": " << std::strerror(errno) << "!\033[0m" << std::endl;
+        return false;
+      }
+    } while(pos != std::string::npos);
+    struct stat info;
+    return stat(path.c_str(),&info) == 0 && S_ISDIR(info.st_mode);
+  }
+
+  /** \brief Runs the self-test (makeTest()) according to selfTestMode_.
+   *
+   *  In mode "once" the test is skipped if it was already run for the same library build and configuration (see getSelfTestHash()).
+   *  @param filterConfigFile - Path to the filter configuration (.info) file.
+   */
+  void makeStartupTest(const std::string& filterConfigFile){
+    if(selfTestMode_ == "never"){
+      return;
+    }
+    if(selfTestMode_ != "once"){
+      if(selfTestMode_ != "always"){
+        std::cout << "\033[31mERROR: Unknown self_test mode " << selfTestMode_ << ", using always!\033[0m" << std::endl;
+      }
+      makeTest();
+      return;
+    }
+    std::ostringstream cacheFile;
+    cacheFile << selfTestCacheDir_ << "/rovio_self_test_" << std::hex << getSelfTestHash(filterConfigFile);
+    if(std::ifstream(cacheFile.str()).good()){
+      ROS_INFO_STREAM("Skipping self-test, already run for this build and configuration (" << cacheFile.str() << ")");
+      return;
+    }
+    makeTest();
+    if(!makeDirectories(selfTestCacheDir_)){
+      std::cout << "\033[31mERROR: Could not create self-test cache directory " << selfTestCacheDir_ << ", the self-test will be run again!\033[0m" << std::endl;
+      return;
+    }
+    std::ofstream cache(cacheFile.str());
+    if(cache.good()){
+      cache << filterConfigFile << std::endl;
+    } else {
+      std::cout << "\033[31mERROR: Could not write self-test cache file " << cacheFile.str() << "!\033[0m" << std::endl;
+    }
   }
 
   /** \brief Callback for IMU-Messages. Adds IMU measurements (as prediction measurements) to the filter.
@@ -448,6 +581,7 @@ class RovioNode{
     predictionMeas_.template get<mtPredictionMeas::_gyr>() = Eigen::Vector3d(imu_msg->angular_velocity.x,imu_msg->angular_velocity.y,imu_msg->angular_velocity.z);
     if(init_state_.isInitialized()){
       mpFilter_->addPredictionMeas(predictionMeas_,imu_msg->header.stamp.toSec());
+      mpFilter_->stateHistory_.addImu(imu_msg->header.stamp.toSec(),predictionMeas_);
       updateAndPublish();
     } else if (imgCallBackOnce){
       switch(init_state_.state_) {
@@ -502,6 +636,19 @@ class RovioNode{
    *   @param camID - Camera ID.
    */
   void imgCallback(const sensor_msgs::ImageConstPtr & img, const int camID = 0){
+    // Apply the ingestion policy once per frame, before converting the image and computing its pyramid
+    if(init_state_.isInitialized()){
+      const double msgTime = img->header.stamp.toSec();
+      if(msgTime != imgUpdateMeas_.template get<mtImgMeas::_aux>().imgTime_){
+        dropCurrentFrame_ = !ingestionPolicy_.acceptFrame(std::get<0>(mpFilter_->updateTimelineTuple_));
+        if(dropCurrentFrame_){
+          imgUpdateMeas_.template get<mtImgMeas::_aux>().reset(msgTime);
+          ROS_WARN_STREAM_THROTTLE(1.0,"Dropped image at t = " << msgTime << " (" << ingestionPolicy_.getDroppedCount() << " of " << ingestionPolicy_.receivedCount_ << " frames not processed)");
+        }
+      }
+      if(dropCurrentFrame_) return;
+    }
+
     // Get image from msg
     cv_bridge::CvImagePtr cv_ptr;
     try {
@@ -522,7 +669,7 @@ class RovioNode{
         }
         imgUpdateMeas_.template get<mtImgMeas::_aux>().reset(msgTime);
       }
-      imgUpdateMeas_.template get<mtImgMeas::_aux>().pyr_[camID].computeFromImage(cv_img,true);
+      mpImgUpdate_->computePyramid(imgUpdateMeas_.template get<mtImgMeas::_aux>().pyr_[camID],cv_img);
       imgUpdateMeas_.template get<mtImgMeas::_aux>().isValidPyr_[camID] = true;
 
       if(imgUpdateMeas_.template get<mtImgMeas::_aux>().areAllValid()){
@@ -544,7 +691,10 @@ class RovioNode{
       poseUpdateMeas_.pos() = JrJV;
       QPD qJV(transform->transform.rotation.w,transform->transform.rotation.x,transform->transform.rotation.y,transform->transform.rotation.z);
       poseUpdateMeas_.att() = qJV.inverted();
-      mpFilter_->template addUpdateMeas<1>(poseUpdateMeas_,transform->header.stamp.toSec()+mpPoseUpdate_->timeOffset_);
+      const double t = transform->header.stamp.toSec()+mpPoseUpdate_->timeOffset_;
+      if(!mpFilter_->template applyDelayedUpdate<1>(poseUpdateMeas_,t)){
+        mpFilter_->template addUpdateMeas<1>(poseUpdateMeas_,t);
+      }
       updateAndPublish();
     }
   }
@@ -565,7 +715,10 @@ class RovioNode{
       const Eigen::Matrix<double,6,6> measuredCov = Eigen::Map<const Eigen::Matrix<double,6,6,Eigen::RowMajor>>(odometry->pose.covariance.data());
       poseUpdateMeas_.measuredCov() = measuredCov;
 
-      mpFilter_->template addUpdateMeas<1>(poseUpdateMeas_,odometry->header.stamp.toSec()+mpPoseUpdate_->timeOffset_);
+      const double t = odometry->header.stamp.toSec()+mpPoseUpdate_->timeOffset_;
+      if(!mpFilter_->template applyDelayedUpdate<1>(poseUpdateMeas_,t)){
+        mpFilter_->template addUpdateMeas<1>(poseUpdateMeas_,t);
+      }
       updateAndPublish();
     }
   }
@@ -579,7 +732,9 @@ class RovioNode{
     if(init_state_.isInitialized()){
       Eigen::Vector3d AvM(velocity->twist.linear.x,velocity->twist.linear.y,velocity->twist.linear.z);
       velocityUpdateMeas_.vel() = AvM;
-      mpFilter_->template addUpdateMeas<2>(velocityUpdateMeas_,velocity->header.stamp.toSec());
+      if(!mpFilter_->template applyDelayedUpdate<2>(velocityUpdateMeas_,velocity->header.stamp.toSec())){
+        mpFilter_->template addUpdateMeas<2>(velocityUpdateMeas_,velocity->header.stamp.toSec());
+      }
       updateAndPublish();
     }
   }
@@ -647,16 +802,21 @@ class RovioNode{
       double lastImageTime;
       if(std::get<0>(mpFilter_->updateTimelineTuple_).getLastTime(lastImageTime)){
         mpFilter_->updateSafe(&lastImageTime);
+      } else if(ingestionPolicy_.skipImageUpdates_ && mpFilter_->predictionTimeline_.getLastTime(lastImageTime)){
+        mpFilter_->updateSafe(&lastImageTime); // IMU-only integration
       }
       const double t2 = (double) cv::getTickCount();
       int c2 = std::get<0>(mpFilter_->updateTimelineTuple_).measMap_.size();
-      timing_T += (t2-t1)/cv::getTickFrequency()*1000;
-      timing_C += c1-c2;
+      lastUpdateDuration_ = (t2-t1)/cv::getTickFrequency()*1000;
+      lastUpdateImageCount_ = c1-c2;
+      timing_T += lastUpdateDuration_;
+      timing_C += lastUpdateImageCount_;
       bool plotTiming = false;
       if(plotTiming){
         ROS_INFO_STREAM(" == Filter Update: " << (t2-t1)/cv::getTickFrequency()*1000 << " ms for processing " << c1-c2 << " images, average: " << timing_T/timing_C);
       }
       if(mpFilter_->safe_.t_ > oldSafeTime){ // Publish only if something changed
+        mpFilter_->stateHistory_.addState(mpFilter_->safe_.t_,mpFilter_->safe_.state_,mpFilter_->safe_.cov_);
         for(int i=0;i<mtState::nCam_;i++){
           if(!mpFilter_->safe_.img_[i].empty() && mpImgUpdate_->doFrameVisualisation_){
             cv::imshow("Tracker" + std::to_string(i), mpFilter_->safe_.img_[i]);
@@ -672,8 +832,13 @@ class RovioNode{
         mtFilterState& filterState = mpFilter_->safe_;
 	mtState& state = mpFilter_->safe_.state_;
         state.updateMultiCameraExtrinsics(&mpFilter_->multiCamera_);
+        if(mpFilter_->publishSceneSnapshot_){
+          mpFilter_->sceneSnapshot_.getWriteBuffer().fromFilterState(filterState);
+          mpFilter_->sceneSnapshot_.publish();
+        }
         MXD& cov = mpFilter_->safe_.cov_;
         imuOutputCT_.transformState(state,imuOutput_);
+        bool imuOutputCovValid = false;
 
         // Cout verbose for pose measurements
         if(mpImgUpdate_->verbose_){
@@ -725,7 +890,10 @@ class RovioNode{
         // Publish Odometry
         if(pubOdometry_.getNumSubscribers() > 0 || forceOdometryPublishing_){
           // Compute covariance of output
-          imuOutputCT_.transformCovMat(state,cov,imuOutputCov_);
+          if(!imuOutputCovValid){
+            imuOutputCT_.transformCovMatSparse(state,cov,imuOutputCov_);
+            imuOutputCovValid = true;
+          }
 
           odometryMsg_.header.seq = msgSeq_;
           odometryMsg_.header.stamp = ros::Time(mpFilter_->safe_.t_);
@@ -770,7 +938,10 @@ class RovioNode{
 
         if(pubPoseWithCovStamped_.getNumSubscribers() > 0 || forcePoseWithCovariancePublishing_){
           // Compute covariance of output
-          imuOutputCT_.transformCovMat(state,cov,imuOutputCov_);
+          if(!imuOutputCovValid){
+            imuOutputCT_.transformCovMatSparse(state,cov,imuOutputCov_);
+            imuOutputCovValid = true;
+          }
 
           estimatedPoseWithCovarianceStampedMsg_.header.seq = msgSeq_;
           estimatedPoseWithCovarianceStampedMsg_.header.stamp = ros::Time(mpFilter_->safe_.t_);
@@ -876,112 +1047,16 @@ class RovioNode{
         }
 
         // PointCloud message.
-        if(pubPcl_.getNumSubscribers() > 0 || pubMarkers_.getNumSubscribers() > 0 || forcePclPublishing_ || forceMarkersPublishing_){
+        const bool publishPcl = pubPcl_.getNumSubscribers() > 0 || forcePclPublishing_;
+        const bool publishMarkers = pubMarkers_.getNumSubscribers() > 0 || forceMarkersPublishing_;
+        if(publishPcl || publishMarkers){
           pclMsg_.header.seq = msgSeq_;
           pclMsg_.header.stamp = ros::Time(mpFilter_->safe_.t_);
           markerMsg_.header.seq = msgSeq_;
           markerMsg_.header.stamp = ros::Time(mpFilter_->safe_.t_);
-          markerMsg_.points.clear();
-          float badPoint = std::numeric_limits<float>::quiet_NaN();  // Invalid point.
-          int offset = 0;
-
-          FeatureDistance distance;
-          double d,d_minus,d_plus;
-          const double stretchFactor = 3;
-          for (unsigned int i=0;i<mtState::nMax_; i++, offset += pclMsg_.point_step) {
-            if(filterState.fsm_.isValid_[i]){
-              // Get 3D feature coordinates.
-              int camID = filterState.fsm_.features_[i].mpCoordinates_->camID_;
-              distance = state.dep(i);
-              d = distance.getDistance();
-              const double sigma = sqrt(cov(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_fea>(i)+2));
-              distance.p_ -= stretchFactor*sigma;
-              d_minus = distance.getDistance();
-              if(d_minus > 1000) d_minus = 1000;
-              if(d_minus < 0) d_minus = 0;
-              distance.p_ += 2*stretchFactor*sigma;
-              d_plus = distance.getDistance();
-              if(d_plus > 1000) d_plus = 1000;
-              if(d_plus < 0) d_plus = 0;
-              Eigen::Vector3d bearingVector = filterState.state_.CfP(i).get_nor().getVec();
-              const Eigen::Vector3d CrCPm = bearingVector*d_minus;
-              const Eigen::Vector3d CrCPp = bearingVector*d_plus;
-              const Eigen::Vector3f MrMPm = V3D(mpFilter_->multiCamera_.BrBC_[camID] + mpFilter_->multiCamera_.qCB_[camID].inverseRotate(CrCPm)).cast<float>();
-              const Eigen::Vector3f MrMPp = V3D(mpFilter_->multiCamera_.BrBC_[camID] + mpFilter_->multiCamera_.qCB_[camID].inverseRotate(CrCPp)).cast<float>();
-
-              // Get human readable output
-              transformFeatureOutputCT_.setFeatureID(i);
-              transformFeatureOutputCT_.setOutputCameraID(filterState.fsm_.features_[i].mpCoordinates_->camID_);
-              transformFeatureOutputCT_.transformState(state,featureOutput_);
-              transformFeatureOutputCT_.transformCovMat(state,cov,featureOutputCov_);
-              featureOutputReadableCT_.transformState(featureOutput_,featureOutputReadable_);
-              featureOutputReadableCT_.transformCovMat(featureOutput_,featureOutputCov_,featureOutputReadableCov_);
-
-              // Get landmark output
-              landmarkOutputImuCT_.setFeatureID(i);
-              landmarkOutputImuCT_.transformState(state,landmarkOutput_);
-              landmarkOutputImuCT_.transformCovMat(state,cov,landmarkOutputCov_);
-              const Eigen::Vector3f MrMP = landmarkOutput_.get<LandmarkOutput::_lmk>().template cast<float>();
-
-              // Write feature id, camera id, and rgb
-              uint8_t gray = 255;
-              uint32_t rgb = (gray << 16) | (gray << 8) | gray;
-              uint32_t status = filterState.fsm_.features_[i].mpStatistics_->status_[0];
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[0].offset], &filterState.fsm_.features_[i].idx_, sizeof(int));  // id
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[1].offset], &camID, sizeof(int));  // cam id
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[2].offset], &rgb, sizeof(uint32_t));  // rgb
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[3].offset], &status, sizeof(int));  // status
-
-              // Write coordinates to pcl message.
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[4].offset], &MrMP[0], sizeof(float));  // x
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[5].offset], &MrMP[1], sizeof(float));  // y
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[6].offset], &MrMP[2], sizeof(float));  // z
-
-              // Add feature bearing vector and distance
-              const Eigen::Vector3f bearing = featureOutputReadable_.bea().template cast<float>();
-              const float distance = static_cast<float>(featureOutputReadable_.dis());
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[7].offset], &bearing[0], sizeof(float));  // x
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[8].offset], &bearing[1], sizeof(float));  // y
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[9].offset], &bearing[2], sizeof(float));  // z
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[10].offset], &distance, sizeof(float)); // d
-
-              // Add the corresponding covariance (upper triangular)
-              Eigen::Matrix3f cov_MrMP = landmarkOutputCov_.cast<float>();
-              int mCounter = 11;
-              for(int row=0;row<3;row++){
-                for(int col=row;col<3;col++){
-                  memcpy(&pclMsg_.data[offset + pclMsg_.fields[mCounter].offset], &cov_MrMP(row,col), sizeof(float));
-                  mCounter++;
-                }
-              }
-
-              // Add distance uncertainty
-              const float distance_cov = static_cast<float>(featureOutputReadableCov_(3,3));
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[mCounter].offset], &distance_cov, sizeof(float));
-
-              // Line markers (Uncertainty rays).
-              geometry_msgs::Point point_near_msg;
-              geometry_msgs::Point point_far_msg;
-              point_near_msg.x = float(CrCPp[0]);
-              point_near_msg.y = float(CrCPp[1]);
-              point_near_msg.z = float(CrCPp[2]);
-              point_far_msg.x = float(CrCPm[0]);
-              point_far_msg.y = float(CrCPm[1]);
-              point_far_msg.z = float(CrCPm[2]);
-              markerMsg_.points.push_back(point_near_msg);
-              markerMsg_.points.push_back(point_far_msg);
-            }
-            else {
-              // If current feature is not valid copy NaN
-              int id = -1;
-              memcpy(&pclMsg_.data[offset + pclMsg_.fields[0].offset], &id, sizeof(int));  // id
-              for(int j=1;j<pclMsg_.fields.size();j++){
-                memcpy(&pclMsg_.data[offset + pclMsg_.fields[j].offset], &badPoint, sizeof(float));
-              }
-            }
-          }
-          pubPcl_.publish(pclMsg_);
-          pubMarkers_.publish(markerMsg_);
+          featurePointCloud_.write(pclMsg_,publishMarkers ? &markerMsg_.points : nullptr,filterState,mpFilter_->multiCamera_);
+          if(publishPcl) pubPcl_.publish(pclMsg_);
+          if(publishMarkers) pubMarkers_.publish(markerMsg_);
         }
         if(pubPatch_.getNumSubscribers() > 0 || forcePatchPublishing_){
           patchMsg_.header.seq = msgSeq_;
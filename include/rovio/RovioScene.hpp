@@ -31,7 +31,12 @@
 
 #include "lightweight_filtering/common.hpp"
 #include "rovio/Scene.hpp"
+#include "rovio/RovioSceneSnapshot.hpp"
+#include "rovio/FrameWriter.hpp"
+#include <atomic>
+#include <limits>
 #include <memory>
+#include <thread>
 
 namespace rovio {
 
@@ -40,19 +45,25 @@ class RovioScene{
  public:
   typedef typename FILTER::mtFilterState mtFilterState;
   typedef typename mtFilterState::mtState mtState;
+  typedef RovioSceneSnapshot<mtFilterState> mtSnapshot;
   std::shared_ptr<FILTER> mpFilter_;
+  mtSnapshot snapshot_;  /**<Snapshot used when drawing directly from a filter state.*/
 
   rovio::Scene mScene;
-  cv::Mat patch_;
   std::shared_ptr<SceneObject> mpSensor_[mtState::nCam_];
   std::shared_ptr<SceneObject> mpGroundtruth_;
   std::shared_ptr<SceneObject> mpLines_[mtState::nCam_];
   std::shared_ptr<SceneObject> mpDepthVar_[mtState::nCam_];
-  std::shared_ptr<SceneObject> mpPatches_[mtState::nMax_];
+  std::shared_ptr<SceneObject> mpPatches_[mtState::nCam_];  /**<Instanced patches of all features of a camera, textured from a common atlas.*/
+  std::thread offscreenThread_;  /**<Thread owning the offscreen context, renders and queues the frames.*/
+  std::atomic<bool> stopOffscreen_;
+  FrameWriter frameWriter_;  /**<Writes the offscreen frames.*/
   RovioScene(){
-    patch_ = cv::Mat::zeros(mtState::patchSize_*pow(2,mtState::nLevels_-1),mtState::patchSize_*pow(2,mtState::nLevels_-1),CV_8UC1);
+    stopOffscreen_ = false;
   }
-  virtual ~RovioScene(){};
+  virtual ~RovioScene(){
+    stopOffscreen();
+  };
   void addKeyboardCB(unsigned char Key, std::function<void()> f){
     mScene.addKeyboardCB(Key,f);
   }
@@ -62,7 +73,75 @@ class RovioScene{
   void initScene(int argc, char** argv, const std::string& mVSFileName,const std::string& mFSFileName,std::shared_ptr<FILTER> mpFilter){
     initGlut(argc,argv,mScene);
     mScene.init(argc, argv,mVSFileName,mFSFileName);
+    initSceneObjects(mpFilter);
+  }
+
+  /** \brief Starts headless rendering into an image sequence or raw video file (see \ref FrameWriter).
+   *
+   *  A separate thread owns the offscreen context, fetches the snapshots published by the filter and renders a frame
+   *  whenever the filter time advanced by at least period. Neither the filter nor the renderer wait for the disk.
+   *
+   *  @param mVSFileName - Vertex shader file.
+   *  @param mFSFileName - Fragment shader file.
+   *  @param mpFilter    - Filter.
+   *  @param filename    - Image sequence pattern (e.g. "frame_%06d.png") or raw video file.
+   *  @param width       - Frame width.
+   *  @param height      - Frame height.
+   *  @param period      - Minimal filter time between two frames [s].
+   *  @return true, if the output could be opened (the rendering context is created asynchronously).
+   */
+  bool startOffscreen(const std::string& mVSFileName,const std::string& mFSFileName,std::shared_ptr<FILTER> mpFilter,
+                      const std::string& filename, const int width, const int height, const double period){
+    stopOffscreen();
+    if(!frameWriter_.open(filename)){
+      return false;
+    }
+    mpFilter_ = mpFilter;
+    mpFilter_->publishSceneSnapshot_ = true;
+    stopOffscreen_ = false;
+    offscreenThread_ = std::thread([this,mVSFileName,mFSFileName,width,height,period](){
+      if(mScene.initOffscreen(width,height) != 0 || mScene.init(0,nullptr,mVSFileName,mFSFileName) != 0){
+        mScene.releaseOffscreen();
+        return;
+      }
+      initSceneObjects(mpFilter_);
+      cv::Mat frame;
+      double lastFrameTime = -std::numeric_limits<double>::max();
+      while(!stopOffscreen_){
+        if(!mpFilter_->sceneSnapshot_.update()){
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          continue;
+        }
+        const mtSnapshot& snapshot = mpFilter_->sceneSnapshot_.getReadBuffer();
+        if(snapshot.t_ < lastFrameTime + period){
+          continue;
+        }
+        lastFrameTime = snapshot.t_;
+        drawScene(snapshot);
+        mScene.RenderSceneCB();
+        mScene.readFrame(frame);
+        frameWriter_.push(frame);
+      }
+      mScene.releaseOffscreen();
+    });
+    return true;
+  }
+
+  /** \brief Stops headless rendering and writes the pending frames.
+   */
+  void stopOffscreen(){
+    if(offscreenThread_.joinable()){
+      stopOffscreen_ = true;
+      offscreenThread_.join();
+    }
+    frameWriter_.close();
+  }
+
+  /** \brief Creates the scene objects, requires a current rendering context.
+   */
+  void initSceneObjects(std::shared_ptr<FILTER> mpFilter){
     mpFilter_ = mpFilter;
+    mpFilter_->publishSceneSnapshot_ = true;
 
     std::shared_ptr<SceneObject> mpGroundplane1(mScene.addSceneObject());
     mpGroundplane1->makeGroundPlaneMesh(0.25,40);
@@ -100,9 +179,9 @@ class RovioScene{
       mpGroundtruth_->vertices_[i*2+1].color_.fromEigen(color);
     }
     mpGroundtruth_->allocateBuffer();
-    for(int i=0;i<mtState::nMax_;i++){
-      mpPatches_[i] = mScene.addSceneObject();
-      mpPatches_[i]->initTexture(mtState::patchSize_*pow(2,mtState::nLevels_-1),mtState::patchSize_*pow(2,mtState::nLevels_-1));
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      mpPatches_[camID] = mScene.addSceneObject();
+      mpPatches_[camID]->initPatchAtlas(mtState::patchSize_*pow(2,mtState::nLevels_-1),mtState::nMax_);
     }
 
     mScene.setView(Eigen::Vector3f(-5.0f,-5.0f,5.0f),Eigen::Vector3f(0.0f,0.0f,0.0f));
@@ -111,111 +190,79 @@ class RovioScene{
   void setIdleFunction(void (*idleFunc)()){
     mScene.setIdleFunction(idleFunc);
   }
+  /** \brief Draws the scene directly from a filter state.
+   *
+   *  Must not be used while the estimator modifies the filter state, prefer drawSnapshot().
+   */
   void drawScene(mtFilterState& filterState){
-    const mtState& state = filterState.state_;
-    const MXD& cov = filterState.cov_;
+    snapshot_.fromFilterState(filterState);
+    drawScene(snapshot_);
+  }
+
+  /** \brief Fetches the latest snapshot published by the filter and draws it.
+   *
+   *  @return true, if a new snapshot was available (and the scene has been updated).
+   */
+  bool drawSnapshot(){
+    if(!mpFilter_->sceneSnapshot_.update()){
+      return false;
+    }
+    drawScene(mpFilter_->sceneSnapshot_.getReadBuffer());
+    return true;
+  }
 
-    if(filterState.plotPoseMeas_){
-      mpGroundtruth_->q_BW_ = filterState.state_.qCW_ext();
-      mpGroundtruth_->W_r_WB_ = filterState.state_.WrWC_ext().template cast<float>();
+  /** \brief Updates the scene objects from a snapshot.
+   */
+  void drawScene(const mtSnapshot& snapshot){
+    if(snapshot.plotPoseMeas_){
+      mpGroundtruth_->q_BW_ = snapshot.qCW_ext_;
+      mpGroundtruth_->W_r_WB_ = snapshot.WrWC_ext_;
       mpGroundtruth_->draw_ = true;
     } else {
       mpGroundtruth_->draw_ = false;
     }
 
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      mpPatches_[i]->draw_ = false;
-    }
-
+    const Eigen::Vector4f colors[3] = {Eigen::Vector4f(0.5f,0.5f,0.5f,1.0f),Eigen::Vector4f(1.0f,0.0f,0.0f,1.0f),Eigen::Vector4f(0.0f,1.0f,0.0f,1.0f)};
     for(unsigned int camID=0;camID<mtState::nCam_;camID++){
-      mpSensor_[camID]->W_r_WB_ = state.WrWC(camID).template cast<float>();
-      mpSensor_[camID]->q_BW_ = state.qCW(camID);
+      mpSensor_[camID]->W_r_WB_ = snapshot.WrWC_[camID];
+      mpSensor_[camID]->q_BW_ = snapshot.qCW_[camID];
 
-      std::vector<Eigen::Vector3f> points;
-      std::vector<Eigen::Vector3f> lines;
       mpLines_[camID]->clear();
       mpDepthVar_[camID]->clear();
-      FeatureDistance d;
-      double d_far,d_near;
-      const float s = pow(2.0,mtState::nLevels_-1)*0.5*mtState::patchSize_;
+      mpPatches_[camID]->clearInstances();
       for(unsigned int i=0;i<mtState::nMax_;i++){
-        if(filterState.fsm_.isValid_[i] && filterState.fsm_.features_[i].mpCoordinates_->camID_ == camID){
-          mpPatches_[i]->draw_ = true;
-          d = state.dep(i);
-          const double sigma = cov(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_fea>(i)+2);
-          d.p_ -= sigma;
-          d_far = d.getDistance();
-          if(d.getType() == FeatureDistance::INVERSE && (d_far > 1000 || d_far <= 0.0)) d_far = 1000;
-          d.p_ += 2*sigma;
-          d_near = d.getDistance();
-          const LWF::NormalVectorElement middle = state.CfP(i).get_nor();
-          Eigen::Vector3d cornerVec[4];
-          const double s = mtState::patchSize_*std::pow(2.0,mtState::nLevels_-2);
-          if(!filterState.fsm_.features_[i].mpCoordinates_->com_warp_nor()){
-            mpPatches_[i]->draw_ = false;
-            continue;
-          }
-          for(int x=0;x<2;x++){
-            for(int y=0;y<2;y++){
-              cornerVec[y*2+x] = filterState.fsm_.features_[i].mpCoordinates_->get_patchCorner(s*(2*x-1),s*(2*y-1)).get_nor().getVec()*state.dep(i).getDistance();
-            }
-          }
-          const Eigen::Vector3d pos = middle.getVec()*state.dep(i).getDistance();
-          const Eigen::Vector3d pos_far = middle.getVec()*d_far;
-          const Eigen::Vector3d pos_near = middle.getVec()*d_near;
-
-          mpLines_[camID]->prolonge(cornerVec[0].cast<float>());
-          mpLines_[camID]->prolonge(cornerVec[1].cast<float>());
-          mpLines_[camID]->prolonge(cornerVec[1].cast<float>());
-          mpLines_[camID]->prolonge(cornerVec[3].cast<float>());
-          mpLines_[camID]->prolonge(cornerVec[3].cast<float>());
-          mpLines_[camID]->prolonge(cornerVec[2].cast<float>());
-          mpLines_[camID]->prolonge(cornerVec[2].cast<float>());
-          mpLines_[camID]->prolonge(cornerVec[0].cast<float>());
-
-          mpDepthVar_[camID]->prolonge(pos_far.cast<float>());
-          mpDepthVar_[camID]->prolonge(pos_near.cast<float>());
-          if(filterState.fsm_.features_[i].mpStatistics_->trackedInSomeFrame()){
-            std::next(mpDepthVar_[camID]->vertices_.rbegin())->color_.fromEigen(Eigen::Vector4f(0.0f,1.0f,0.0f,1.0f));
-            mpDepthVar_[camID]->vertices_.rbegin()->color_.fromEigen(Eigen::Vector4f(0.0f,1.0f,0.0f,1.0f));
-            for(int j=0;j<8;j++){
-              std::next(mpLines_[camID]->vertices_.rbegin(),j)->color_.fromEigen(Eigen::Vector4f(0.0f,1.0f,0.0f,1.0f));
-            }
-          } else if(filterState.fsm_.features_[i].mpStatistics_->inSomeFrame()){
-            std::next( mpDepthVar_[camID]->vertices_.rbegin())->color_.fromEigen(Eigen::Vector4f(1.0f,0.0f,0.0f,1.0f));
-            mpDepthVar_[camID]->vertices_.rbegin()->color_.fromEigen(Eigen::Vector4f(1.0f,0.0f,0.0f,1.0f));
-            for(int j=0;j<8;j++){
-              std::next(mpLines_[camID]->vertices_.rbegin(),j)->color_.fromEigen(Eigen::Vector4f(1.0f,0.0f,0.0f,1.0f));
-            }
-          } else {
-            std::next( mpDepthVar_[camID]->vertices_.rbegin())->color_.fromEigen(Eigen::Vector4f(0.5f,0.5f,0.5f,1.0f));
-            mpDepthVar_[camID]->vertices_.rbegin()->color_.fromEigen(Eigen::Vector4f(0.5f,0.5f,0.5f,1.0f));
-            for(int j=0;j<8;j++){
-              std::next(mpLines_[camID]->vertices_.rbegin(),j)->color_.fromEigen(Eigen::Vector4f(0.5f,0.5f,0.5f,1.0f));
-            }
-          }
+        const typename mtSnapshot::Feature& f = snapshot.features_[i];
+        if(f.valid_ && f.camID_ == camID){
+          mpLines_[camID]->prolonge(f.corners_[0]);
+          mpLines_[camID]->prolonge(f.corners_[1]);
+          mpLines_[camID]->prolonge(f.corners_[1]);
+          mpLines_[camID]->prolonge(f.corners_[3]);
+          mpLines_[camID]->prolonge(f.corners_[3]);
+          mpLines_[camID]->prolonge(f.corners_[2]);
+          mpLines_[camID]->prolonge(f.corners_[2]);
+          mpLines_[camID]->prolonge(f.corners_[0]);
 
-          mpPatches_[i]->clear();
-          mpPatches_[i]->makeTexturedRectangle(1.0f,1.0f);
-          filterState.fsm_.features_[i].mpMultilevelPatch_->drawMultilevelPatch(patch_,cv::Point2i(0,0),1,false);
-          mpPatches_[i]->setTexture(patch_);
-          for(int x=0;x<2;x++){
-            for(int y=0;y<2;y++){
-              mpPatches_[i]->vertices_[y*2+x].pos_.fromEigen(cornerVec[y*2+x].cast<float>());
-            }
+          mpDepthVar_[camID]->prolonge(f.posFar_);
+          mpDepthVar_[camID]->prolonge(f.posNear_);
+          const Eigen::Vector4f& color = colors[f.status_];
+          std::next(mpDepthVar_[camID]->vertices_.rbegin())->color_.fromEigen(color);
+          mpDepthVar_[camID]->vertices_.rbegin()->color_.fromEigen(color);
+          for(int j=0;j<8;j++){
+            std::next(mpLines_[camID]->vertices_.rbegin(),j)->color_.fromEigen(color);
           }
-          mpPatches_[i]->allocateBuffer();
-          mpPatches_[i]->W_r_WB_ = mpSensor_[camID]->W_r_WB_;
-          mpPatches_[i]->q_BW_ = mpSensor_[camID]->q_BW_;
+
+          mpPatches_[camID]->setAtlasTile(i,snapshot.patches_[i]);
+          mpPatches_[camID]->addPatchInstance(f.corners_,i);
         }
-        mpLines_[camID]->W_r_WB_ = mpSensor_[camID]->W_r_WB_;
-        mpLines_[camID]->q_BW_ = mpSensor_[camID]->q_BW_;
-        mpLines_[camID]->allocateBuffer();
-        mpDepthVar_[camID]->W_r_WB_ = mpSensor_[camID]->W_r_WB_;
-        mpDepthVar_[camID]->q_BW_ = mpSensor_[camID]->q_BW_;
-        mpDepthVar_[camID]->allocateBuffer();
       }
+      mpPatches_[camID]->W_r_WB_ = mpSensor_[camID]->W_r_WB_;
+      mpPatches_[camID]->q_BW_ = mpSensor_[camID]->q_BW_;
+      mpLines_[camID]->W_r_WB_ = mpSensor_[camID]->W_r_WB_;
+      mpLines_[camID]->q_BW_ = mpSensor_[camID]->q_BW_;
+      mpDepthVar_[camID]->W_r_WB_ = mpSensor_[camID]->W_r_WB_;
+      mpDepthVar_[camID]->q_BW_ = mpSensor_[camID]->q_BW_;
     }
+    mScene.requestRedraw();
   }
 };
 
@@ -0,0 +1,157 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_ROVIOSCENESNAPSHOT_HPP_
+#define ROVIO_ROVIOSCENESNAPSHOT_HPP_
+
+#include "lightweight_filtering/common.hpp"
+#include "rovio/FeatureDistance.hpp"
+#include <opencv2/core/core.hpp>
+
+namespace rovio{
+
+/** \brief Self-contained copy of the filter data visualized by the RovioScene.
+ *
+ *  Is filled by the estimator after each update of the safe filter state and handed to the renderer through a
+ *  \ref SnapshotBuffer, such that the renderer never accesses the filter state itself.
+ *
+ *  @tparam FILTERSTATE - \ref rovio::FilterState
+ */
+template<typename FILTERSTATE>
+class RovioSceneSnapshot{
+ public:
+  typedef FILTERSTATE mtFilterState;
+  typedef typename mtFilterState::mtState mtState;
+
+  /** \brief Tracking status of a feature, used for coloring.
+   */
+  enum FeatureStatus{
+    NOT_IN_FRAME,
+    IN_FRAME,
+    TRACKED
+  };
+
+  /** \brief Visualized data of a single feature, expressed in the camera frame.
+   */
+  struct Feature{
+    bool valid_;  /**<Whether the feature is visualized.*/
+    int camID_;  /**<Camera in which the feature is expressed.*/
+    Eigen::Vector3f corners_[4];  /**<Corners of the patch at the estimated distance.*/
+    Eigen::Vector3f posFar_;  /**<Feature position at the distance minus one sigma.*/
+    Eigen::Vector3f posNear_;  /**<Feature position at the distance plus one sigma.*/
+    FeatureStatus status_;  /**<Tracking status.*/
+  };
+
+  double t_;  /**<Time of the filter state.*/
+  bool plotPoseMeas_;  /**<Should the pose measurement be plotted.*/
+  Eigen::Vector3f WrWC_ext_;  /**<Position of the external pose measurement.*/
+  QPD qCW_ext_;  /**<Attitude of the external pose measurement.*/
+  Eigen::Vector3f WrWC_[mtState::nCam_];  /**<Position of the cameras.*/
+  QPD qCW_[mtState::nCam_];  /**<Attitude of the cameras.*/
+  Feature features_[mtState::nMax_];  /**<Feature data.*/
+  cv::Mat patches_[mtState::nMax_];  /**<Drawn multilevel patches of the features.*/
+
+  /** \brief Constructor
+   */
+  RovioSceneSnapshot(){
+    t_ = 0.0;
+    plotPoseMeas_ = false;
+    for(unsigned int i=0;i<mtState::nMax_;i++){
+      features_[i].valid_ = false;
+    }
+  }
+
+  /** \brief Destructor
+   */
+  virtual ~RovioSceneSnapshot(){};
+
+  /** \brief Copies the visualized data from a filter state.
+   *
+   *  @param filterState - Filter state (typically the safe state of the filter).
+   */
+  void fromFilterState(const mtFilterState& filterState){
+    const mtState& state = filterState.state_;
+    const MXD& cov = filterState.cov_;
+    t_ = filterState.t_;
+    plotPoseMeas_ = filterState.plotPoseMeas_;
+    if(plotPoseMeas_){
+      WrWC_ext_ = state.WrWC_ext().template cast<float>();
+      qCW_ext_ = state.qCW_ext();
+    }
+    for(unsigned int camID=0;camID<mtState::nCam_;camID++){
+      WrWC_[camID] = state.WrWC(camID).template cast<float>();
+      qCW_[camID] = state.qCW(camID);
+    }
+
+    FeatureDistance d;
+    double d_far,d_near;
+    const double s = mtState::patchSize_*std::pow(2.0,mtState::nLevels_-2);
+    const int patchDrawSize = mtState::patchSize_*pow(2,mtState::nLevels_-1);
+    for(unsigned int i=0;i<mtState::nMax_;i++){
+      Feature& f = features_[i];
+      f.valid_ = false;
+      if(!filterState.fsm_.isValid_[i] || !filterState.fsm_.features_[i].mpCoordinates_->com_warp_nor()){
+        continue;
+      }
+      f.valid_ = true;
+      f.camID_ = filterState.fsm_.features_[i].mpCoordinates_->camID_;
+      d = state.dep(i);
+      const double sigma = cov(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_fea>(i)+2);
+      d.p_ -= sigma;
+      d_far = d.getDistance();
+      if(d.getType() == FeatureDistance::INVERSE && (d_far > 1000 || d_far <= 0.0)) d_far = 1000;
+      d.p_ += 2*sigma;
+      d_near = d.getDistance();
+      const double distance = state.dep(i).getDistance();
+      for(int x=0;x<2;x++){
+        for(int y=0;y<2;y++){
+          f.corners_[y*2+x] = (filterState.fsm_.features_[i].mpCoordinates_->get_patchCorner(s*(2*x-1),s*(2*y-1)).get_nor().getVec()*distance).template cast<float>();
+        }
+      }
+      const V3D middle = state.CfP(i).get_nor().getVec();
+      f.posFar_ = (middle*d_far).template cast<float>();
+      f.posNear_ = (middle*d_near).template cast<float>();
+      if(filterState.fsm_.features_[i].mpStatistics_->trackedInSomeFrame()){
+        f.status_ = TRACKED;
+      } else if(filterState.fsm_.features_[i].mpStatistics_->inSomeFrame()){
+        f.status_ = IN_FRAME;
+      } else {
+        f.status_ = NOT_IN_FRAME;
+      }
+      if(patches_[i].empty()){
+        patches_[i] = cv::Mat::zeros(patchDrawSize,patchDrawSize,CV_8UC1);
+      }
+      filterState.fsm_.features_[i].mpMultilevelPatch_->drawMultilevelPatch(patches_[i],cv::Point2i(0,0),1,false);
+    }
+  }
+};
+
+}
+
+
+#endif /* ROVIO_ROVIOSCENESNAPSHOT_HPP_ */
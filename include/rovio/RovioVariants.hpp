@@ -0,0 +1,166 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_ROVIOVARIANTS_HPP_
+#define ROVIO_ROVIOVARIANTS_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "rovio/RovioFilter.hpp"
+
+#ifndef ROVIO_NMAXFEATURE
+#define ROVIO_NMAXFEATURE 25
+#endif
+#ifndef ROVIO_NLEVELS
+#define ROVIO_NLEVELS 4
+#endif
+#ifndef ROVIO_PATCHSIZE
+#define ROVIO_PATCHSIZE 6
+#endif
+#ifndef ROVIO_NCAM
+#define ROVIO_NCAM 1
+#endif
+#ifndef ROVIO_NPOSE
+#define ROVIO_NPOSE 0
+#endif
+
+namespace rovio{
+
+/** \brief Runtime description of the template parameters of a filter instantiation.
+ */
+struct RovioConfiguration{
+  int nMax_;  /**<Maximal number of considered features in the filter state.*/
+  int nLevels_;  /**<Total number of pyramid levels considered.*/
+  int patchSize_;  /**<Edge length of the patches (in pixel).*/
+  int nCam_;  /**<Used total number of cameras.*/
+  int nPose_;  /**<Additional pose states.*/
+
+  /** \brief Constructor, initializes with the default instantiation (CMake cache variables).
+   */
+  RovioConfiguration(): nMax_(ROVIO_NMAXFEATURE), nLevels_(ROVIO_NLEVELS), patchSize_(ROVIO_PATCHSIZE), nCam_(ROVIO_NCAM), nPose_(ROVIO_NPOSE){};
+
+  /** \brief Constructor
+   */
+  RovioConfiguration(int nMax, int nLevels, int patchSize, int nCam, int nPose): nMax_(nMax), nLevels_(nLevels), patchSize_(patchSize), nCam_(nCam), nPose_(nPose){};
+
+  bool operator==(const RovioConfiguration& other) const{
+    return nMax_ == other.nMax_ && nLevels_ == other.nLevels_ && patchSize_ == other.patchSize_ && nCam_ == other.nCam_ && nPose_ == other.nPose_;
+  }
+
+  /** \brief Returns a string of the form nMax_nLevels_patchSize_nCam_nPose.
+   */
+  std::string toString() const{
+    return std::to_string(nMax_) + "_" + std::to_string(nLevels_) + "_" + std::to_string(patchSize_) + "_" + std::to_string(nCam_) + "_" + std::to_string(nPose_);
+  }
+};
+
+/** \brief Precompiled filter instantiation.
+ */
+template<int nMax, int nLevels, int patchSize, int nCam, int nPose>
+struct RovioVariant{
+  typedef RovioFilter<FilterState<nMax,nLevels,patchSize,nCam,nPose>> mtFilter;
+
+  /** \brief Returns the runtime description of the variant.
+   */
+  static RovioConfiguration getConfiguration(){
+    return RovioConfiguration(nMax,nLevels,patchSize,nCam,nPose);
+  }
+};
+
+/** \brief List of precompiled filter instantiations, dispatches a runtime configuration to the matching instantiation.
+ *
+ *  The runner must provide a member function template<typename FILTER> int run(), which is instantiated for every variant of the list.
+ */
+template<typename... Variants>
+struct RovioVariantList;
+
+template<>
+struct RovioVariantList<>{
+  template<typename RUNNER>
+  static bool run(const RovioConfiguration& configuration, RUNNER& runner, int& returnValue){
+    return false;
+  }
+  static void getConfigurations(std::vector<RovioConfiguration>& configurations){}
+};
+
+template<typename Variant, typename... Variants>
+struct RovioVariantList<Variant,Variants...>{
+  /** \brief Runs the runner with the filter type of the variant matching the configuration.
+   *
+   *  @param configuration - Requested configuration.
+   *  @param runner        - Runner.
+   *  @param returnValue   - Return value of the runner.
+   *  @return false, if no matching variant is available.
+   */
+  template<typename RUNNER>
+  static bool run(const RovioConfiguration& configuration, RUNNER& runner, int& returnValue){
+    if(Variant::getConfiguration() == configuration){
+      returnValue = runner.template run<typename Variant::mtFilter>();
+      return true;
+    }
+    return RovioVariantList<Variants...>::run(configuration,runner,returnValue);
+  }
+
+  /** \brief Lists the configurations of all variants.
+   */
+  static void getConfigurations(std::vector<RovioConfiguration>& configurations){
+    configurations.push_back(Variant::getConfiguration());
+    RovioVariantList<Variants...>::getConfigurations(configurations);
+  }
+};
+
+#ifndef ROVIO_VARIANT_LIST
+#define ROVIO_VARIANT_LIST rovio::RovioVariant<ROVIO_NMAXFEATURE,ROVIO_NLEVELS,ROVIO_PATCHSIZE,ROVIO_NCAM,ROVIO_NPOSE>
+#endif
+
+typedef RovioVariantList<ROVIO_VARIANT_LIST> RovioVariants;  /**<Variants compiled into the executables (set with the CMake variable ROVIO_VARIANTS).*/
+
+/** \brief Runs the runner with the precompiled variant matching the configuration, prints the available variants otherwise.
+ *
+ *  @param configuration - Requested configuration.
+ *  @param runner        - Runner.
+ *  @return the return value of the runner, or -1 if no matching variant is available.
+ */
+template<typename RUNNER>
+int runRovioVariant(const RovioConfiguration& configuration, RUNNER& runner){
+  int returnValue = -1;
+  if(!RovioVariants::run(configuration,runner,returnValue)){
+    std::vector<RovioConfiguration> configurations;
+    RovioVariants::getConfigurations(configurations);
+    std::cout << "\033[31mERROR: No precompiled filter variant for configuration " << configuration.toString() << "! Available (nMax_nLevels_patchSize_nCam_nPose):";
+    for(const auto& c : configurations) std::cout << " " << c.toString();
+    std::cout << "\033[0m" << std::endl;
+  }
+  return returnValue;
+}
+
+}
+
+
+#endif /* ROVIO_ROVIOVARIANTS_HPP_ */
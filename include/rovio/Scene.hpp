@@ -33,9 +33,11 @@
 #include <opencv2/features2d/features2d.hpp>
 #include "GL/glew.h"
 #include <GL/freeglut.h>
+#include <chrono>
 #include <memory>
 #include <fstream>
 #include <functional>
+#include <thread>
 
 namespace rovio{
 
@@ -143,6 +145,14 @@ struct Vertex
   Arrayf<4> color_;
 };
 
+/** \brief Per-instance data of an instanced textured patch (see SceneObject::initPatchAtlas).
+ */
+struct PatchInstance
+{
+  Arrayf<3> corners_[4];  /**<Corners of the patch (ordered as the vertices of a textured rectangle).*/
+  Arrayf<2> tile_;  /**<Texture coordinate offset of the atlas tile.*/
+};
+
 class SceneObject{
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -152,6 +162,12 @@ class SceneObject{
   void setTexture(const int& cols, const int& rows, const float* ptr);
   void setTexture(const cv::Mat& img);
   void allocateBuffer();
+  void initPatchAtlas(const int& tileSize, const int& nTiles);
+  void setAtlasTile(const int& tile, const cv::Mat& img);
+  void clearInstances();
+  void addPatchInstance(const Eigen::Vector3f* corners, const int& tile);
+  void allocateInstanceBuffer();
+  void updateBuffers();
   void makeCubeFull(const float& l);
   void makeTetrahedron(const float& l);
   void makeCubeMesh(const float& l);
@@ -177,7 +193,18 @@ class SceneObject{
   std::vector<unsigned int> indices_;
   GLuint VBO_;
   GLuint IBO_;
+  GLuint instanceVBO_;
   GLuint textureID_;
+  size_t vboCapacity_;  /**<Number of vertices the vertex buffer can hold.*/
+  size_t iboCapacity_;  /**<Number of indices the index buffer can hold.*/
+  size_t instanceCapacity_;  /**<Number of instances the instance buffer can hold.*/
+  bool bufferDirty_;  /**<Whether the vertices/indices have changed since the last upload.*/
+  bool instancesDirty_;  /**<Whether the instances/atlas have changed since the last upload.*/
+  std::vector<PatchInstance> instances_;
+  cv::Mat atlas_;  /**<Texture atlas holding all patches (CPU copy).*/
+  int tileSize_;
+  int atlasCols_;  /**<Number of tiles per atlas row.*/
+  bool useInstancing_;
   GLenum mode_;
   bool mbCullFace_;
   float lineWidth_;
@@ -193,6 +220,9 @@ class Scene{
   Scene();
   virtual ~Scene();
   int init(int argc, char** argv, const std::string& mVSFileName,const std::string& mFSFileName);
+  int initOffscreen(const int& width, const int& height);
+  void releaseOffscreen();
+  void readFrame(cv::Mat& img);
   std::shared_ptr<SceneObject> addSceneObject();
   void makeTestScene();
   void RenderSceneCB();
@@ -207,7 +237,10 @@ class Scene{
   void AddShader(GLuint ShaderProgram, const char* pShaderText, GLenum ShaderType);
   void CompileShaders(const std::string& mVSFileName,const std::string& mFSFileName);
   void setIdleFunction(void (*idleFunc)());
+  void requestRedraw();
   void (*mIdleFunc)();
+  bool redraw_;  /**<Whether the scene has changed since the last rendering.*/
+  bool offscreen_;  /**<Whether the scene is rendered into a framebuffer object instead of a GLUT window.*/
  private:
   float stepScale_;
 
@@ -221,6 +254,8 @@ class Scene{
   GLuint lightDirection_location_;
   GLuint useTexture_location_;
   GLuint sampler_location_;
+  GLuint useInstancing_location_;
+  GLuint atlasScale_location_;
 
   PersProjInfo mPersProjInfo_;
   DirectionalLight mDirectionalLight_;
@@ -235,6 +270,14 @@ class Scene{
 
   Eigen::Vector2i mMousePos_;
   bool enableMouseMotion_;
+
+  int offscreenWidth_;
+  int offscreenHeight_;
+  GLuint framebuffer_;
+  GLuint colorRenderbuffer_;
+  GLuint depthRenderbuffer_;
+  void* eglDisplay_;  /**<EGLDisplay of the offscreen context.*/
+  void* eglContext_;  /**<EGLContext of the offscreen context.*/
 };
 
 static Scene* mpScene = nullptr;
@@ -252,7 +295,11 @@ static void initGlut(int argc, char** argv, Scene& scene){
     if(mpScene->mIdleFunc != nullptr){
       mpScene->mIdleFunc();
     }
-    mpScene->RenderSceneCB();
+    if(mpScene->redraw_){
+      mpScene->RenderSceneCB();
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Nothing changed, do not spin
+    }
   });
   glutSpecialFunc([](int Key, int x, int y){mpScene->SpecialKeyboardCB(Key,x,y);});
   glutMotionFunc([](int x, int y){mpScene->MotionCB(x,y);});
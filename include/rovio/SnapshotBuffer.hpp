@@ -0,0 +1,109 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_SNAPSHOTBUFFER_HPP_
+#define ROVIO_SNAPSHOTBUFFER_HPP_
+
+#include <atomic>
+
+namespace rovio{
+
+/** \brief Lock-free triple buffer for handing snapshots from a single producer to a single consumer.
+ *
+ *  The producer fills getWriteBuffer() and calls publish(), the consumer calls update() and reads getReadBuffer().
+ *  Neither side ever blocks or waits for the other, the consumer always gets the most recently published snapshot.
+ *  Snapshots which are published while the consumer is reading are overwritten (i.e. skipped).
+ *
+ *  @tparam T - Snapshot type.
+ */
+template<typename T>
+class SnapshotBuffer{
+ public:
+  /** \brief Constructor
+   */
+  SnapshotBuffer(): middle_(1), writeIndex_(0), readIndex_(2), version_(0), readVersion_(0){};
+
+  /** \brief Destructor
+   */
+  virtual ~SnapshotBuffer(){};
+
+  /** \brief Returns the buffer to be filled by the producer.
+   */
+  T& getWriteBuffer(){
+    return buffers_[writeIndex_];
+  }
+
+  /** \brief Hands the write buffer over to the consumer (producer side).
+   */
+  void publish(){
+    ++version_;
+    versions_[writeIndex_] = version_;
+    writeIndex_ = middle_.exchange(writeIndex_ | freshFlag_, std::memory_order_acq_rel) & indexMask_;
+  }
+
+  /** \brief Fetches the most recently published snapshot (consumer side).
+   *
+   *  @return true, if a new snapshot is available in getReadBuffer().
+   */
+  bool update(){
+    if((middle_.load(std::memory_order_relaxed) & freshFlag_) == 0){
+      return false;
+    }
+    readIndex_ = middle_.exchange(readIndex_, std::memory_order_acq_rel) & indexMask_;
+    readVersion_ = versions_[readIndex_];
+    return true;
+  }
+
+  /** \brief Returns the snapshot obtained by the last successful update() (consumer side).
+   */
+  const T& getReadBuffer() const{
+    return buffers_[readIndex_];
+  }
+
+  /** \brief Returns the version of the snapshot in getReadBuffer(), 0 if none has been received yet (consumer side).
+   */
+  unsigned long getReadVersion() const{
+    return readVersion_;
+  }
+
+ private:
+  static constexpr unsigned int indexMask_ = 3;  /**<Bits of middle_ holding the buffer index.*/
+  static constexpr unsigned int freshFlag_ = 4;  /**<Bit of middle_, set if the middle buffer has not been fetched yet.*/
+  T buffers_[3];  /**<Write, middle and read buffer.*/
+  unsigned long versions_[3] = {0,0,0};  /**<Version of the snapshot in each buffer.*/
+  std::atomic<unsigned int> middle_;  /**<Index of the middle buffer and fresh flag.*/
+  unsigned int writeIndex_;  /**<Index of the buffer owned by the producer.*/
+  unsigned int readIndex_;  /**<Index of the buffer owned by the consumer.*/
+  unsigned long version_;  /**<Number of published snapshots (producer side).*/
+  unsigned long readVersion_;  /**<Version of the snapshot owned by the consumer.*/
+};
+
+}
+
+
+#endif /* ROVIO_SNAPSHOTBUFFER_HPP_ */
@@ -0,0 +1,184 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_SPARSEUPDATE_HPP_
+#define ROVIO_SPARSEUPDATE_HPP_
+
+#include "lightweight_filtering/common.hpp"
+#include "rovio/CoordinateTransform/SparseCovariance.hpp"
+
+namespace rovio {
+
+/** \brief EKF update for measurements which only depend on a few blocks of the state.
+ *
+ *  The Jacobian w.r.t. the state is assembled in compact form (see SparseCovariance). The cross covariance P*H^T is
+ *  then computed from the involved columns of P only, and the covariance is corrected by a symmetric rank-m update.
+ *  Equivalent to the dense EKF update of LWF::Update, but without products involving the full D x D covariance
+ *  and the full m x D Jacobian.
+ *
+ *  The update has to provide evalInnovation, jacNoise and jacStateBlocks. The latter assembles the Jacobian w.r.t. the
+ *  state through a block interface, such that the same code can fill a dense (DenseJacobian) or a compact
+ *  (SparseCovariance) Jacobian.
+ *
+ *  @tparam FILTERSTATE - Filter state.
+ *  @tparam INNOVATION  - Innovation of the update.
+ *  @tparam NOISE       - Noise of the update.
+ *  @tparam nColsMax    - Maximal number of state coordinates the innovation depends on.
+ */
+template<typename FILTERSTATE, typename INNOVATION, typename NOISE, int nColsMax>
+class SparseUpdate{
+ public:
+  typedef typename FILTERSTATE::mtState mtState;
+  static constexpr int nInn_ = INNOVATION::D_;
+  SparseCovariance<nInn_,nColsMax> H_;  /**<Jacobian of the innovation w.r.t. the state.*/
+
+  SparseUpdate(): G_((int)nInn_,(int)(NOISE::D_)), R_((int)nInn_,(int)nInn_), Py_((int)nInn_,(int)nInn_), Pyinv_((int)nInn_,(int)nInn_),
+      Hc_((int)nInn_,0), PHt_((int)(mtState::D_),(int)nInn_), K_((int)(mtState::D_),(int)nInn_){
+    yIdentity_.setIdentity();
+    noise_.setIdentity();
+  }
+
+  /** \brief Performs the EKF update.
+   *
+   *  @param filterState      - Filter state.
+   *  @param update           - Update providing evalInnovation, jacNoise and jacStateBlocks.
+   *  @param updnoiP          - Update noise covariance.
+   *  @param outlierDetection - Outlier detection of the update.
+   */
+  template<typename UPDATE, typename OUTLIERDETECTION>
+  void performUpdate(FILTERSTATE& filterState, const UPDATE& update, const MXD& updnoiP, OUTLIERDETECTION& outlierDetection){
+    computeCorrection(filterState.state_,filterState.cov_,update,updnoiP,outlierDetection);
+    filterState.cov_.noalias() -= K_*PHt_.transpose();
+    filterState.state_.boxPlus(dx_,filterState.state_);
+  }
+
+  /** \brief Computes the EKF correction without applying it.
+   *
+   *  Afterwards, getCorrection() returns the state correction and getCovarianceFactor() a D x m matrix U, such that
+   *  the corrected covariance is P - U*U^T.
+   *
+   *  @param state            - State at which the update is linearized.
+   *  @param cov              - Covariance of the state.
+   *  @param update           - Update providing evalInnovation, jacNoise and jacStateBlocks.
+   *  @param updnoiP          - Update noise covariance.
+   *  @param outlierDetection - Outlier detection of the update.
+   */
+  template<typename UPDATE, typename OUTLIERDETECTION>
+  void computeCorrection(const mtState& state, const MXD& cov, const UPDATE& update, const MXD& updnoiP, OUTLIERDETECTION& outlierDetection){
+    H_.reset();
+    update.jacStateBlocks(H_,state);
+    update.jacNoise(G_,state);
+    R_.noalias() = G_*updnoiP*G_.transpose();
+    update.evalInnovation(y_,state,noise_);
+    y_.boxMinus(yIdentity_,innVector_);
+
+    const int k = H_.cols();
+    Hc_ = H_.jacobian().leftCols(k);
+    Pkk_.resize(k,k);
+    for(int r=0;r<k;r++){
+      for(int c=0;c<k;c++){
+        Pkk_(r,c) = cov(H_.stateId(r),H_.stateId(c));
+      }
+    }
+    Py_ = Hc_*Pkk_*Hc_.transpose() + R_;
+    outlierDetection.doOutlierDetection(innVector_,Py_,Hc_);
+    llt_.compute(Py_);
+    Pyinv_.setIdentity();
+    llt_.solveInPlace(Pyinv_);
+
+    // Cross covariance P*H^T from the involved columns of P
+    PHt_.setZero();
+    for(int c=0;c<k;c++){
+      PHt_.noalias() += cov.col(H_.stateId(c))*Hc_.col(c).transpose();
+    }
+    K_.noalias() = PHt_*Pyinv_;
+    dx_ = -K_*innVector_;
+  }
+
+  /** \brief Compares the sparse update with the dense EKF update of the base class (LWF::Update::performUpdateEKF).
+   *
+   *  The measurement meas_ and the noise updnoiP_ of the update have to be set.
+   *
+   *  @param update           - Update providing evalInnovation, jacNoise, jacStateBlocks and performUpdateEKF.
+   *  @param sparseFilterState - Filter state which is updated by the sparse update.
+   *  @param denseFilterState  - Filter state which is updated by the dense update, must equal sparseFilterState.
+   *  @param th               - Threshold on the largest absolute difference of the state and of the covariance.
+   *  @return true if both differences are below th.
+   */
+  template<typename UPDATE>
+  bool testUpdate(UPDATE& update, FILTERSTATE& sparseFilterState, FILTERSTATE& denseFilterState, const double th){
+    const typename UPDATE::mtMeas meas = update.meas_;
+    performUpdate(sparseFilterState,update,update.updnoiP_,update.outlierDetection_);
+    update.performUpdateEKF(denseFilterState,meas);
+    typename mtState::mtDifVec dif;
+    sparseFilterState.state_.boxMinus(denseFilterState.state_,dif);
+    const double stateError = dif.array().abs().maxCoeff();
+    const double covError = (sparseFilterState.cov_-denseFilterState.cov_).array().abs().maxCoeff();
+    if(stateError > th || covError > th){
+      std::cout << "\033[31m==== Sparse update differs from dense update (state " << stateError << ", covariance " << covError << ") ====\033[0m" << std::endl;
+      return false;
+    }
+    std::cout << "\033[32m==== Sparse update is consistent (state " << stateError << ", covariance " << covError << ") ====\033[0m" << std::endl;
+    return true;
+  }
+
+  /** \brief Returns the state correction of the last computeCorrection().
+   */
+  const typename mtState::mtDifVec& getCorrection() const{
+    return dx_;
+  }
+
+  /** \brief Computes U = P*H^T*L^-T (Py = L*L^T) of the last computeCorrection(), such that K*Py*K^T = U*U^T.
+   *
+   *  @param U - Covariance factor (D x m).
+   */
+  void getCovarianceFactor(MXD& U) const{
+    U = llt_.matrixL().solve(PHt_.transpose()).transpose();
+  }
+
+ private:
+  INNOVATION y_;  /**<Innovation.*/
+  INNOVATION yIdentity_;  /**<Identity innovation.*/
+  NOISE noise_;  /**<Zero noise.*/
+  MXD G_;  /**<Jacobian w.r.t. the noise.*/
+  MXD R_;  /**<Innovation noise covariance.*/
+  MXD Py_;  /**<Innovation covariance.*/
+  Eigen::LLT<MXD> llt_;  /**<Cholesky decomposition of Py_.*/
+  MXD Pyinv_;  /**<Inverse innovation covariance.*/
+  MXD Hc_;  /**<Compact Jacobian (nInn x involved coordinates).*/
+  MXD Pkk_;  /**<Covariance of the involved coordinates.*/
+  MXD PHt_;  /**<Cross covariance P*H^T.*/
+  MXD K_;  /**<Kalman gain.*/
+  typename INNOVATION::mtDifVec innVector_;  /**<Innovation vector.*/
+  typename mtState::mtDifVec dx_;  /**<State correction.*/
+};
+
+}
+
+
+#endif /* ROVIO_SPARSEUPDATE_HPP_ */
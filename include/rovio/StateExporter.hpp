@@ -0,0 +1,200 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_STATEEXPORTER_HPP_
+#define ROVIO_STATEEXPORTER_HPP_
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include "lightweight_filtering/common.hpp"
+#include "rovio/ColumnarWriter.hpp"
+
+namespace rovio{
+
+/** \brief Exports the estimated state, the covariance diagonal, the update timing and the feature tracks to a
+ *         columnar file (see ColumnarWriter).
+ *
+ *  Table "state" has one row per filter update: t, update_ms, n_images, n_features, pos_*, att_*, vel_*, acb_*,
+ *  gyb_*, vep<camID>_*, vea<camID>_* and the corresponding covariance diagonal var_* (attitudes as rotation vectors).
+ *  Table "feature" has one row per valid feature and update: t, id, cam, status, u, v, bea_*, d, var_d.
+ */
+template<typename FILTERSTATE>
+class StateExporter{
+ public:
+  typedef typename FILTERSTATE::mtState mtState;
+
+  /** \brief Constructor, sets up the tables.
+   */
+  StateExporter(){
+    std::vector<std::string> columns = {"t","update_ms","n_images","n_features"};
+    std::vector<ColumnarWriter::ColumnType> types(columns.size(),ColumnarWriter::FLOAT64);
+    types[2] = ColumnarWriter::INT32;
+    types[3] = ColumnarWriter::INT32;
+    std::vector<std::string> blocks = {"pos","att","vel","acb","gyb"};
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      blocks.push_back("vep" + std::to_string(camID));
+      blocks.push_back("vea" + std::to_string(camID));
+    }
+    for(const std::string& block : blocks){
+      if(block.compare(0,3,"att") == 0 || block.compare(0,3,"vea") == 0){
+        columns.push_back(block + "_w");
+      }
+      columns.push_back(block + "_x");
+      columns.push_back(block + "_y");
+      columns.push_back(block + "_z");
+    }
+    for(const std::string& block : blocks){
+      columns.push_back("var_" + block + "_x");
+      columns.push_back("var_" + block + "_y");
+      columns.push_back("var_" + block + "_z");
+    }
+    types.resize(columns.size(),ColumnarWriter::FLOAT64);
+    stateTable_ = writer_.addTable("state",columns,types);
+    stateRow_.resize(columns.size());
+
+    columns = {"t","id","cam","status","u","v","bea_x","bea_y","bea_z","d","var_d"};
+    types.assign(columns.size(),ColumnarWriter::FLOAT64);
+    types[1] = ColumnarWriter::INT32;
+    types[2] = ColumnarWriter::INT32;
+    types[3] = ColumnarWriter::INT32;
+    featureTable_ = writer_.addTable("feature",columns,types);
+    featureRow_.resize(columns.size());
+  }
+  virtual ~StateExporter(){};
+
+  /** \brief Opens the output file and starts the writer thread.
+   *
+   *  @param filename - Output file.
+   *  @return true, if successful.
+   */
+  bool open(const std::string& filename){
+    return writer_.open(filename);
+  }
+
+  /** \brief Writes the pending rows and closes the file.
+   */
+  void close(){
+    writer_.close();
+  }
+
+  /** \brief Appends the current estimate.
+   *
+   *  @param filterState - Filter state.
+   *  @param updateMs    - Duration of the filter update in milliseconds.
+   *  @param nImages     - Number of images processed by the update.
+   */
+  void write(const FILTERSTATE& filterState, const double updateMs, const int nImages){
+    if(!writer_.isOpen()) return;
+    const mtState& state = filterState.state_;
+    const MXD& cov = filterState.cov_;
+    int nFeatures = 0;
+    for(unsigned int i=0;i<mtState::nMax_;i++){
+      if(filterState.fsm_.isValid_[i]) nFeatures++;
+    }
+    int c = 0;
+    stateRow_[c++] = filterState.t_;
+    stateRow_[c++] = updateMs;
+    stateRow_[c++] = nImages;
+    stateRow_[c++] = nFeatures;
+    addVector(c,state.WrWM());
+    addQuaternion(c,state.qWM());
+    addVector(c,state.MvM());
+    addVector(c,state.acb());
+    addVector(c,state.gyb());
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      addVector(c,state.MrMC(camID));
+      addQuaternion(c,state.qCM(camID));
+    }
+    addVariances(c,cov,mtState::template getId<mtState::_pos>());
+    addVariances(c,cov,mtState::template getId<mtState::_att>());
+    addVariances(c,cov,mtState::template getId<mtState::_vel>());
+    addVariances(c,cov,mtState::template getId<mtState::_acb>());
+    addVariances(c,cov,mtState::template getId<mtState::_gyb>());
+    for(int camID=0;camID<mtState::nCam_;camID++){
+      addVariances(c,cov,mtState::template getId<mtState::_vep>(camID));
+      addVariances(c,cov,mtState::template getId<mtState::_vea>(camID));
+    }
+    writer_.appendRow(stateTable_,stateRow_.data());
+
+    for(unsigned int i=0;i<mtState::nMax_;i++){
+      if(!filterState.fsm_.isValid_[i]) continue;
+      const int camID = filterState.fsm_.features_[i].mpCoordinates_->camID_;
+      const V3D bearing = state.CfP(i).get_nor().getVec();
+      const int feaId = mtState::template getId<mtState::_fea>(i);
+      c = 0;
+      featureRow_[c++] = filterState.t_;
+      featureRow_[c++] = filterState.fsm_.features_[i].idx_;
+      featureRow_[c++] = camID;
+      featureRow_[c++] = filterState.fsm_.features_[i].mpStatistics_->status_[camID];
+      if(state.CfP(i).com_c()){
+        featureRow_[c++] = state.CfP(i).get_c().x;
+        featureRow_[c++] = state.CfP(i).get_c().y;
+      } else {
+        featureRow_[c++] = std::numeric_limits<double>::quiet_NaN();
+        featureRow_[c++] = std::numeric_limits<double>::quiet_NaN();
+      }
+      featureRow_[c++] = bearing(0);
+      featureRow_[c++] = bearing(1);
+      featureRow_[c++] = bearing(2);
+      featureRow_[c++] = state.dep(i).getDistance();
+      featureRow_[c++] = pow(state.dep(i).getDistanceDerivative(),2)*cov(feaId+2,feaId+2);
+      writer_.appendRow(featureTable_,featureRow_.data());
+    }
+  }
+
+ private:
+  void addVector(int& c, const V3D& v){
+    stateRow_[c++] = v(0);
+    stateRow_[c++] = v(1);
+    stateRow_[c++] = v(2);
+  }
+  void addQuaternion(int& c, const QPD& q){
+    stateRow_[c++] = q.w();
+    stateRow_[c++] = q.x();
+    stateRow_[c++] = q.y();
+    stateRow_[c++] = q.z();
+  }
+  void addVariances(int& c, const MXD& cov, const int id){
+    stateRow_[c++] = cov(id,id);
+    stateRow_[c++] = cov(id+1,id+1);
+    stateRow_[c++] = cov(id+2,id+2);
+  }
+
+  ColumnarWriter writer_;
+  int stateTable_;
+  int featureTable_;
+  std::vector<double> stateRow_;
+  std::vector<double> featureRow_;
+};
+
+}
+
+
+#endif /* ROVIO_STATEEXPORTER_HPP_ */
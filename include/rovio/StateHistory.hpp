@@ -0,0 +1,149 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_STATEHISTORY_HPP_
+#define ROVIO_STATEHISTORY_HPP_
+
+#include <deque>
+#include <limits>
+#include <map>
+#include "lightweight_filtering/common.hpp"
+
+namespace rovio {
+
+/** \brief Bounded history of past filter states, covariances and IMU measurements.
+ *
+ *  Used to apply measurements which arrive after the filter has already been updated past their timestamp (see
+ *  RovioFilter::applyDelayedUpdate).
+ *
+ *  @tparam STATE          - Filter state type (mtState).
+ *  @tparam PREDICTIONMEAS - IMU measurement type.
+ */
+template<typename STATE, typename PREDICTIONMEAS>
+class StateHistory{
+ public:
+  /** \brief Estimate at a given time.
+   */
+  struct Entry{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    double t_;
+    STATE state_;
+    MXD cov_;
+  };
+  typedef std::map<double,PREDICTIONMEAS> mtImuMap;
+  double window_;  /**<Length of the history in seconds, 0 disables the history.*/
+
+  StateHistory(): window_(0.0){};
+  virtual ~StateHistory(){};
+
+  bool isEnabled() const{
+    return window_ > 0.0;
+  }
+
+  void clear(){
+    entries_.clear();
+    imu_.clear();
+  }
+
+  /** \brief Appends an estimate and removes everything older than the window (the storage of removed entries is reused).
+   *
+   *  @param t     - Time of the estimate.
+   *  @param state - State.
+   *  @param cov   - Covariance.
+   */
+  void addState(const double t, const STATE& state, const MXD& cov){
+    if(!isEnabled() || (!entries_.empty() && t <= entries_.back().t_)) return;
+    if(!entries_.empty() && entries_.front().t_ < t-window_){
+      entries_.push_back(std::move(entries_.front()));
+      entries_.pop_front();
+    } else {
+      entries_.emplace_back();
+    }
+    Entry& entry = entries_.back();
+    entry.t_ = t;
+    entry.state_ = state;
+    entry.cov_ = cov;
+    while(entries_.size() > 1 && entries_.front().t_ < t-window_){
+      entries_.pop_front();
+    }
+    imu_.erase(imu_.begin(),imu_.upper_bound(entries_.front().t_));
+  }
+
+  /** \brief Stores an IMU measurement.
+   *
+   *  @param t    - Time of the measurement.
+   *  @param meas - IMU measurement.
+   */
+  void addImu(const double t, const PREDICTIONMEAS& meas){
+    if(!isEnabled()) return;
+    imu_[t] = meas;
+  }
+
+  /** \brief Returns the index of the latest estimate at or before t, -1 if t is older than the history.
+   */
+  int find(const double t) const{
+    for(int i=entries_.size()-1;i>=0;i--){
+      if(entries_[i].t_ <= t) return i;
+    }
+    return -1;
+  }
+
+  int size() const{
+    return entries_.size();
+  }
+
+  Entry& operator[](const int i){
+    return entries_[i];
+  }
+
+  /** \brief Returns the IMU measurement used for integrating from t on (the first one after t, or the last one).
+   *
+   *  @param t    - Start time of the integration step.
+   *  @param tEnd - End time of the measurement interval (infinity if there is no measurement after t).
+   *  @return pointer to the measurement, nullptr if there are no IMU measurements.
+   */
+  const PREDICTIONMEAS* getImu(const double t, double& tEnd) const{
+    if(imu_.empty()) return nullptr;
+    typename mtImuMap::const_iterator it = imu_.upper_bound(t);
+    if(it == imu_.end()){
+      tEnd = std::numeric_limits<double>::infinity();
+      return &imu_.rbegin()->second;
+    }
+    tEnd = it->first;
+    return &it->second;
+  }
+
+ private:
+  std::deque<Entry,Eigen::aligned_allocator<Entry>> entries_;
+  mtImuMap imu_;
+};
+
+}
+
+
+#endif /* ROVIO_STATEHISTORY_HPP_ */
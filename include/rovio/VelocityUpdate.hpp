@@ -33,6 +33,7 @@
 #include "lightweight_filtering/Update.hpp"
 #include "lightweight_filtering/State.hpp"
 #include "rovio/FilterStates.hpp"
+#include "rovio/SparseUpdate.hpp"
 
 namespace rovio {
 
@@ -127,7 +128,9 @@ class VelocityUpdate: public LWF::Update<VelocityInnovation,FILTERSTATE,Velocity
                       VelocityUpdateNoise,VelocityOutlierDetection,false> Base;
   using Base::doubleRegister_;
   using Base::intRegister_;
+  using Base::boolRegister_;
   using Base::meas_;
+  using Base::updnoiP_;
   typedef typename Base::mtState mtState;
   typedef typename Base::mtFilterState mtFilterState;
   typedef typename Base::mtInnovation mtInnovation;
@@ -136,6 +139,8 @@ class VelocityUpdate: public LWF::Update<VelocityInnovation,FILTERSTATE,Velocity
   typedef typename Base::mtOutlierDetection mtOutlierDetection;
 
   QPD qAM_; // Rotation between IMU (M) and coordinate frame where the velocity is expressed in (A)
+  bool useSparseUpdate_;  /**<Performs the EKF update only over the velocity block (see SparseUpdate).*/
+  SparseUpdate<FILTERSTATE,mtInnovation,mtNoise,3> sparseUpdate_;
 
   /** \brief Constructor.
    *
@@ -143,12 +148,14 @@ class VelocityUpdate: public LWF::Update<VelocityInnovation,FILTERSTATE,Velocity
    */
   VelocityUpdate(){
     qAM_.setIdentity();
+    useSparseUpdate_ = true;
     intRegister_.removeScalarByStr("maxNumIteration");
     doubleRegister_.removeScalarByStr("alpha");
     doubleRegister_.removeScalarByStr("beta");
     doubleRegister_.removeScalarByStr("kappa");
     doubleRegister_.removeScalarByStr("updateVecNormTermination");
     doubleRegister_.registerQuaternion("qAM",qAM_);
+    boolRegister_.registerScalar("useSparseUpdate",useSparseUpdate_);
   };
 
   /** \brief Destructor
@@ -176,7 +183,18 @@ class VelocityUpdate: public LWF::Update<VelocityInnovation,FILTERSTATE,Velocity
    */
   void jacState(MXD& F, const mtState& state) const{
     F.setZero();
-    F.template block<3,3>(mtInnovation::template getId<mtInnovation::_vel>(),mtState::template getId<mtState::_vel>()) = MPD(qAM_).matrix();
+    DenseJacobian J(F);
+    jacStateBlocks(J,state);
+  }
+
+  /** \brief Assembles the Jacobian w.r.t. the state block by block (see SparseUpdate).
+   *
+   *  @param J     - Dense or compact Jacobian.
+   *  @param state - Filter state.
+   */
+  template<typename JACOBIAN>
+  void jacStateBlocks(JACOBIAN& J, const mtState& state) const{
+    J.template jac<3,3>(mtInnovation::template getId<mtInnovation::_vel>(),mtState::template getId<mtState::_vel>()) = MPD(qAM_).matrix();
   }
 
   /** \brief Computes the Jacobian for the update step of the filter w.r.t. to the noise variables
@@ -190,6 +208,31 @@ class VelocityUpdate: public LWF::Update<VelocityInnovation,FILTERSTATE,Velocity
     G.setZero();
     G.template block<3,3>(mtInnovation::template getId<mtInnovation::_vel>(),mtNoise::template getId<mtNoise::_vel>()) = Eigen::Matrix3d::Identity();
   }
+
+  /** \brief Performs the sparse EKF update if enabled, the dense update of the base class is then skipped.
+   *
+   *  @param filterState - Filter state.
+   *  @param meas        - Velocity measurement.
+   *  @param isFinished  - Set to true if the update was already performed.
+   */
+  void preProcess(mtFilterState& filterState, const mtMeas& meas, bool& isFinished){
+    isFinished = false;
+    if(useSparseUpdate_){
+      meas_ = meas;
+      sparseUpdate_.performUpdate(filterState,*this,updnoiP_,this->outlierDetection_);
+      isFinished = true;
+    }
+  }
+
+  /** \brief Prepares the update for a measurement which is applied in the past (see RovioFilter::applyDelayedUpdate).
+   *
+   *  @param meas - Velocity measurement.
+   *  @return true.
+   */
+  bool prepareDelayedUpdate(const mtMeas& meas){
+    meas_ = meas;
+    return true;
+  }
 };
 
 }
@@ -5,9 +5,16 @@ precision highp float;
 layout (location = 0) in vec3 Position;
 layout (location = 1) in vec3 Normal;
 layout (location = 2) in vec4 Color;
+layout (location = 3) in vec3 Corner0;
+layout (location = 4) in vec3 Corner1;
+layout (location = 5) in vec3 Corner2;
+layout (location = 6) in vec3 Corner3;
+layout (location = 7) in vec2 Tile;
 
 uniform mat4 V_TF_B;
 uniform mat4 W_TF_B;
+uniform bool useInstancing;
+uniform vec2 atlasScale;
 
 out vec4 Color0;
 out vec3 Normal0;
@@ -15,8 +22,16 @@ out vec2 TexCoord0;
 
 void main()
 {
-    gl_Position = V_TF_B * vec4(Position, 1.0f);
+    if(useInstancing){
+        // Textured unit rectangle, stretched onto the corners of the instance
+        vec3 InstancePosition = mix(mix(Corner0, Corner1, Color.x), mix(Corner2, Corner3, Color.x), Color.y);
+        gl_Position = V_TF_B * vec4(InstancePosition, 1.0f);
+        TexCoord0 = Tile + Color.xy * atlasScale;
+    }
+    else {
+        gl_Position = V_TF_B * vec4(Position, 1.0f);
+        TexCoord0 = Color.xy;
+    }
     Color0 = Color;
     Normal0 = (W_TF_B * vec4(Normal, 0.0)).xyz;
-    TexCoord0 = Color.xy;
 }
@@ -0,0 +1,17 @@
+#include "rovio/BuildId.hpp"
+
+#define ROVIO_STRINGIFY_(X) #X
+#define ROVIO_STRINGIFY(X) ROVIO_STRINGIFY_(X)
+
+namespace rovio {
+
+  const char* getLibraryBuildId(){
+    return __DATE__ " " __TIME__
+        " nMax=" ROVIO_STRINGIFY(ROVIO_NMAXFEATURE)
+        " nLevels=" ROVIO_STRINGIFY(ROVIO_NLEVELS)
+        " patchSize=" ROVIO_STRINGIFY(ROVIO_PATCHSIZE)
+        " nCam=" ROVIO_STRINGIFY(ROVIO_NCAM)
+        " nPose=" ROVIO_STRINGIFY(ROVIO_NPOSE);
+  }
+
+}
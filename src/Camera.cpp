@@ -74,8 +74,29 @@ namespace rovio{
     } else if(distortionModel == "ds"){
       type_ = DS;
       loadDoubleSphere(filename);
+    } else if(distortionModel == "none"){
+      type_ = PINHOLE;
+      loadCameraMatrix(filename);
     } else {
-      std::cout << "ERROR: no camera Model detected!";
+      std::cout << "ERROR: no camera Model detected (unknown distortion_model " << distortionModel << ")!" << std::endl;
+      return;
+    }
+    if(type_ != PINHOLE && hasZeroDistortion()){
+      std::cout << "Distortion parameters are zero, using undistorted pinhole model" << std::endl;
+      type_ = PINHOLE;
+    }
+  }
+
+  bool Camera::hasZeroDistortion() const{
+    switch(type_){
+      case RADTAN:
+        return k1_ == 0.0 && k2_ == 0.0 && k3_ == 0.0 && p1_ == 0.0 && p2_ == 0.0;
+      case EQUIDIST:
+        return false; // Still maps the radius through atan with zero coefficients
+      case DS:
+        return k1_ == 0.0 && k2_ == 0.0; // xi and alpha
+      default:
+        return true;
     }
   }
 
@@ -220,6 +241,9 @@ namespace rovio{
       case DS:
         distortDoubleSphere(in,out);
         break;
+      case PINHOLE:
+        out = in;
+        break;
       default:
         distortRadtan(in,out);
         break;
@@ -237,6 +261,10 @@ namespace rovio{
       case DS:
         distortDoubleSphere(in,out,J);
         break;
+      case PINHOLE:
+        out = in;
+        J.setIdentity();
+        break;
       default:
         distortRadtan(in,out,J);
         break;
@@ -246,6 +274,11 @@ namespace rovio{
   bool Camera::bearingToPixel(const Eigen::Vector3d& vec, cv::Point2f& c) const{
     // Project
     if(vec(2)<=0) return false;
+    if(type_ == PINHOLE){ // Closed form, no distortion
+      c.x = static_cast<float>(K_(0, 0)*vec(0)/vec(2) + K_(0, 2));
+      c.y = static_cast<float>(K_(1, 1)*vec(1)/vec(2) + K_(1, 2));
+      return true;
+    }
     const Eigen::Vector2d undistorted = Eigen::Vector2d(vec(0)/vec(2),vec(1)/vec(2));
 
     // Distort
@@ -261,6 +294,18 @@ namespace rovio{
   bool Camera::bearingToPixel(const Eigen::Vector3d& vec, cv::Point2f& c, Eigen::Matrix<double,2,3>& J) const{
     // Project
     if(vec(2)<=0) return false;
+    if(type_ == PINHOLE){ // Closed form, no distortion
+      const double invZ = 1.0/vec(2);
+      c.x = static_cast<float>(K_(0, 0)*vec(0)*invZ + K_(0, 2));
+      c.y = static_cast<float>(K_(1, 1)*vec(1)*invZ + K_(1, 2));
+      J(0,0) = K_(0, 0)*invZ;
+      J(0,1) = 0.0;
+      J(0,2) = -K_(0, 0)*vec(0)*invZ*invZ;
+      J(1,0) = 0.0;
+      J(1,1) = K_(1, 1)*invZ;
+      J(1,2) = -K_(1, 1)*vec(1)*invZ*invZ;
+      return true;
+    }
     const Eigen::Vector2d undistorted = Eigen::Vector2d(vec(0)/vec(2),vec(1)/vec(2));
     Eigen::Matrix<double,2,3> J1; J1.setZero();
     J1(0,0) = 1.0/vec(2);
@@ -303,6 +348,10 @@ namespace rovio{
     Eigen::Vector2d y;
     y(0) = (static_cast<double>(c.x) - K_(0, 2)) / K_(0, 0);
     y(1) = (static_cast<double>(c.y) - K_(1, 2)) / K_(1, 1);
+    if(type_ == PINHOLE){ // Nothing to undistort
+      vec = Eigen::Vector3d(y(0),y(1),1.0).normalized();
+      return true;
+    }
 
     // Undistort by optimizing
     const int max_iter = 100;
@@ -337,7 +386,7 @@ namespace rovio{
     return success;
   }
 
-  void Camera::testCameraModel(){
+  bool Camera::testCameraModel(){
     double d = 1e-4;
     LWF::NormalVectorElement b_s;
     LWF::NormalVectorElement b_s1;
@@ -390,5 +439,35 @@ namespace rovio{
       std::cout << J2 << std::endl;
       std::cout << J2_FD << std::endl;
     }
+
+    // The closed form pinhole model must match the radtan model with zero coefficients
+    const ModelType type = type_;
+    const double k1 = k1_, k2 = k2_, k3 = k3_, p1 = p1_, p2 = p2_;
+    k1_ = 0.0; k2_ = 0.0; k3_ = 0.0; p1_ = 0.0; p2_ = 0.0;
+    Eigen::Matrix<double,2,3> J2_radtan;
+    double maxPixelError = 0.0, maxJacobianError = 0.0, maxBearingError = 0.0;
+    for(unsigned int s = 1; s<10;){
+      b_s.setRandom(s);
+      if(b_s.getVec()(2)<0) b_s = b_s.inverted();
+      v_s = b_s.getVec();
+      type_ = PINHOLE;
+      bearingToPixel(v_s,p_s,J2);
+      pixelToBearing(p_s,v_s1);
+      type_ = RADTAN;
+      bearingToPixel(v_s,p_s1,J2_radtan);
+      pixelToBearing(p_s,v_s2);
+      maxPixelError = std::max(maxPixelError,static_cast<double>(cv::norm(p_s-p_s1)));
+      maxJacobianError = std::max(maxJacobianError,(J2-J2_radtan).cwiseAbs().maxCoeff());
+      maxBearingError = std::max(maxBearingError,(v_s1.normalized()-v_s2.normalized()).norm());
+    }
+    type_ = type;
+    k1_ = k1; k2_ = k2; k3_ = k3; p1_ = p1; p2_ = p2;
+    if(maxPixelError > 1e-3 || maxJacobianError > 1e-6 || maxBearingError > 1e-6){
+      std::cout << "\033[31m==== Pinhole model differs from radtan with zero coefficients (pixel error " << maxPixelError
+          << ", Jacobian error " << maxJacobianError << ", bearing error " << maxBearingError << ") ====\033[0m" << std::endl;
+      return false;
+    }
+    std::cout << "\033[32m==== Pinhole model is consistent with radtan with zero coefficients ====\033[0m" << std::endl;
+    return true;
   }
 }
@@ -1,5 +1,4 @@
 #include "rovio/FeatureDistance.hpp"
-#include <complex>
 #include <iostream>
 
 namespace rovio {
@@ -60,66 +59,6 @@ namespace rovio {
     }
   }
 
-  double FeatureDistance::getDistance() const{
-    switch(type_){
-      case REGULAR:
-        return getDistanceRegular();
-      case INVERSE:
-        return getDistanceInverse();
-      case LOG:
-        return getDistanceLog();
-      case HYPERBOLIC:
-        return getDistanceHyperbolic();
-      default:
-        return getDistanceRegular();
-    }
-  }
-
-  double FeatureDistance::getDistanceDerivative() const{
-    switch(type_){
-      case REGULAR:
-        return getDistanceDerivativeRegular();
-      case INVERSE:
-        return getDistanceDerivativeInverse();
-      case LOG:
-        return getDistanceDerivativeLog();
-      case HYPERBOLIC:
-        return getDistanceDerivativeHyperbolic();
-      default:
-        return getDistanceDerivativeRegular();
-    }
-  }
-
-  double FeatureDistance::getParameterDerivative() const{
-    switch(type_){
-      case REGULAR:
-        return getParameterDerivativeRegular();
-      case INVERSE:
-        return getParameterDerivativeInverse();
-      case LOG:
-        return getParameterDerivativeLog();
-      case HYPERBOLIC:
-        return getParameterDerivativeHyperbolic();
-      default:
-        return getParameterDerivativeRegular();
-    }
-  }
-
-  double FeatureDistance::getParameterDerivativeCombined() const{
-    switch(type_){
-      case REGULAR:
-        return getParameterDerivativeCombinedRegular();
-      case INVERSE:
-        return getParameterDerivativeCombinedInverse();
-      case LOG:
-        return getParameterDerivativeCombinedLog();
-      case HYPERBOLIC:
-        return getParameterDerivativeCombinedHyperbolic();
-      default:
-        return getParameterDerivativeCombinedRegular();
-    }
-  }
-
   void FeatureDistance::getParameterDerivativeCombined(FeatureDistance other){
     setParameter(other.getDistance());
   }
@@ -127,103 +66,92 @@ namespace rovio {
   ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
   void FeatureDistance::setParameterRegular(const double& d){
-    p_ = d;
+    p_ = FeatureDistancePolicy<REGULAR>::getParameter(d);
   }
 
   double FeatureDistance::getDistanceRegular() const{
-    return p_;
+    return FeatureDistancePolicy<REGULAR>::getDistance(p_);
   }
 
   double FeatureDistance::getDistanceDerivativeRegular() const{
-    return 1.0;
+    return FeatureDistancePolicy<REGULAR>::getDistanceDerivative(p_);
   }
 
   double FeatureDistance::getParameterDerivativeRegular() const{
-    return 1.0;
+    return FeatureDistancePolicy<REGULAR>::getParameterDerivative(p_);
   }
 
   double FeatureDistance::getParameterDerivativeCombinedRegular() const{
-    return 0.0;
+    return FeatureDistancePolicy<REGULAR>::getParameterDerivativeCombined(p_);
   }
 
   ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
   double FeatureDistance::makeNonZero(const double& p) const{
-    if(p < 1e-6){
-      if(p >= 0){
-        return 1e-6;
-      } else if (p > -1e-6){
-        return -1e-6;
-      }
-    }
-    return p;
+    return FeatureDistancePolicy<INVERSE>::makeNonZero(p);
   }
 
   void FeatureDistance::setParameterInverse(const double& d){
-    p_ = 1/makeNonZero(d);
+    p_ = FeatureDistancePolicy<INVERSE>::getParameter(d);
   }
 
   double FeatureDistance::getDistanceInverse() const{
-    const double p_temp = makeNonZero(p_);
-    return 1/p_temp;
+    return FeatureDistancePolicy<INVERSE>::getDistance(p_);
   }
 
   double FeatureDistance::getDistanceDerivativeInverse() const{
-    const double p_temp = makeNonZero(p_);
-    return -1.0/(p_temp*p_temp);
+    return FeatureDistancePolicy<INVERSE>::getDistanceDerivative(p_);
   }
 
   double FeatureDistance::getParameterDerivativeInverse() const{
-    const double p_temp = makeNonZero(p_);
-    return -p_temp*p_temp;
+    return FeatureDistancePolicy<INVERSE>::getParameterDerivative(p_);
   }
 
   double FeatureDistance::getParameterDerivativeCombinedInverse() const{
-    const double p_temp = makeNonZero(p_);
-    return -2*p_temp;
+    return FeatureDistancePolicy<INVERSE>::getParameterDerivativeCombined(p_);
   }
 
   ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
   void FeatureDistance::setParameterLog(const double& d){
-    p_ = std::log(d);
+    p_ = FeatureDistancePolicy<LOG>::getParameter(d);
   }
 
   double FeatureDistance::getDistanceLog() const{
-    return std::exp(p_);
+    return FeatureDistancePolicy<LOG>::getDistance(p_);
   }
 
   double FeatureDistance::getDistanceDerivativeLog() const{
-    return std::exp(p_);
+    return FeatureDistancePolicy<LOG>::getDistanceDerivative(p_);
   }
 
   double FeatureDistance::getParameterDerivativeLog() const{
-    return std::exp(-p_);
+    return FeatureDistancePolicy<LOG>::getParameterDerivative(p_);
   }
 
   double FeatureDistance::getParameterDerivativeCombinedLog() const{
-    return -std::exp(-p_);
+    return FeatureDistancePolicy<LOG>::getParameterDerivativeCombined(p_);
   }
 
   ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
   void FeatureDistance::setParameterHyperbolic(const double& d){
-    p_ = std::asinh(d);
+    p_ = FeatureDistancePolicy<HYPERBOLIC>::getParameter(d);
   }
 
   double FeatureDistance::getDistanceHyperbolic() const{
-    return std::sinh(p_);
+    return FeatureDistancePolicy<HYPERBOLIC>::getDistance(p_);
   }
 
   double FeatureDistance::getDistanceDerivativeHyperbolic() const{
-    return std::cosh(p_);
+    return FeatureDistancePolicy<HYPERBOLIC>::getDistanceDerivative(p_);
   }
 
   double FeatureDistance::getParameterDerivativeHyperbolic() const{
-    return 1/std::sqrt(std::pow(std::sinh(p_),2)+1); // p = asinh(d)
+    return FeatureDistancePolicy<HYPERBOLIC>::getParameterDerivative(p_);
   }
 
   double FeatureDistance::getParameterDerivativeCombinedHyperbolic() const{
-    return -std::sinh(p_)/std::pow(std::pow(std::sinh(p_),2)+1,1.5)*std::cosh(p_);
+    return FeatureDistancePolicy<HYPERBOLIC>::getParameterDerivativeCombined(p_);
   }
 }
@@ -0,0 +1,3 @@
+#include "rovio/RovioInstantiations.hpp"
+
+ROVIO_TEMPLATE_INSTANTIATIONS()
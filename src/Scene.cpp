@@ -1,10 +1,22 @@
 #include <rovio/Scene.hpp>
+#ifdef ROVIO_HAVE_EGL
+#include <EGL/egl.h>
+#endif
 
 namespace rovio{
 
   SceneObject::SceneObject(){
     glGenBuffers(1, &VBO_);
     glGenBuffers(1, &IBO_);
+    glGenBuffers(1, &instanceVBO_);
+    vboCapacity_ = 0;
+    iboCapacity_ = 0;
+    instanceCapacity_ = 0;
+    bufferDirty_ = false;
+    instancesDirty_ = false;
+    tileSize_ = 0;
+    atlasCols_ = 0;
+    useInstancing_ = false;
     glGenTextures(1, &textureID_);
     glBindTexture(GL_TEXTURE_2D, textureID_);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -33,10 +45,58 @@ namespace rovio{
     glTexSubImage2D(GL_TEXTURE_2D,0,0,0,img.cols,img.rows,GL_LUMINANCE,GL_UNSIGNED_BYTE,img.data);
   }
   void SceneObject::allocateBuffer(){
+    // The buffers only grow, re-specifying them with nullptr orphans the old storage such that the upload does not
+    // have to wait for pending draw calls.
+    vboCapacity_ = std::max(vertices_.size(),vboCapacity_);
+    iboCapacity_ = std::max(indices_.size(),iboCapacity_);
     glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*vertices_.size(), vertices_.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*vboCapacity_, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex)*vertices_.size(), vertices_.data());
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*indices_.size(), indices_.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*iboCapacity_, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(unsigned int)*indices_.size(), indices_.data());
+    bufferDirty_ = false;
+  }
+  void SceneObject::initPatchAtlas(const int& tileSize, const int& nTiles){
+    makeTexturedRectangle(1.0f,1.0f);
+    tileSize_ = tileSize;
+    atlasCols_ = std::max((int)std::ceil(std::sqrt((double)nTiles)),1);
+    const int atlasRows = (nTiles+atlasCols_-1)/atlasCols_;
+    atlas_ = cv::Mat::zeros(std::max(atlasRows,1)*tileSize_,atlasCols_*tileSize_,CV_8UC1);
+    initTexture(atlas_.cols,atlas_.rows);
+    useInstancing_ = true;
+    instances_.reserve(nTiles);
+    clearInstances();
+  }
+  void SceneObject::setAtlasTile(const int& tile, const cv::Mat& img){
+    img.copyTo(atlas_(cv::Rect((tile%atlasCols_)*tileSize_,(tile/atlasCols_)*tileSize_,tileSize_,tileSize_)));
+    instancesDirty_ = true;
+  }
+  void SceneObject::clearInstances(){
+    instances_.clear();
+    instancesDirty_ = true;
+  }
+  void SceneObject::addPatchInstance(const Eigen::Vector3f* corners, const int& tile){
+    instances_.emplace_back();
+    for(int i=0;i<4;i++){
+      instances_.back().corners_[i].fromEigen(corners[i]);
+    }
+    instances_.back().tile_.fromEigen(Eigen::Vector2f((float)((tile%atlasCols_)*tileSize_)/atlas_.cols,(float)((tile/atlasCols_)*tileSize_)/atlas_.rows));
+    instancesDirty_ = true;
+  }
+  void SceneObject::allocateInstanceBuffer(){
+    instanceCapacity_ = std::max(instances_.size(),instanceCapacity_);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(PatchInstance)*instanceCapacity_, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(PatchInstance)*instances_.size(), instances_.data());
+    glBindTexture(GL_TEXTURE_2D, textureID_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D,0,0,0,atlas_.cols,atlas_.rows,GL_LUMINANCE,GL_UNSIGNED_BYTE,atlas_.data);
+    instancesDirty_ = false;
+  }
+  void SceneObject::updateBuffers(){
+    if(bufferDirty_) allocateBuffer();
+    if(useInstancing_ && instancesDirty_) allocateInstanceBuffer();
   }
   void SceneObject::makeCubeFull(const float& l){
     clear();
@@ -148,11 +208,12 @@ namespace rovio{
       vertices_.push_back(points[i]);
       indices_.push_back(s+i);
     }
-    allocateBuffer();
+    bufferDirty_ = true; // Uploaded before the next rendering
   }
   void SceneObject::clear(){
     vertices_.clear();
     indices_.clear();
+    bufferDirty_ = true;
   }
   void SceneObject::makeCoordinateFrame(const float& l){
     clear();
@@ -308,6 +369,15 @@ namespace rovio{
     mDirectionalLight_.direction_ = Eigen::Vector3f(0.5f, -1.0f, 0.0f);
     mDirectionalLight_.direction_.normalize();
     mIdleFunc = nullptr;
+    redraw_ = true;
+    offscreen_ = false;
+    offscreenWidth_ = 1280;
+    offscreenHeight_ = 960;
+    framebuffer_ = 0;
+    colorRenderbuffer_ = 0;
+    depthRenderbuffer_ = 0;
+    eglDisplay_ = nullptr;
+    eglContext_ = nullptr;
     addKeyboardCB('q',glutLeaveMainLoop);
     addSpecialKeyboardCB(101,[&]() mutable {W_r_WC_ -= (q_CW_.inverseRotate(Eigen::Vector3f(0.0,0.0,1.0)) * stepScale_);}); // UP
     addSpecialKeyboardCB(103,[&]() mutable {W_r_WC_ += (q_CW_.inverseRotate(Eigen::Vector3f(0.0,0.0,1.0)) * stepScale_);}); // DOWN
@@ -316,15 +386,49 @@ namespace rovio{
     addSpecialKeyboardCB(104,[&]() mutable {W_r_WC_ += (q_CW_.inverseRotate(Eigen::Vector3f(0.0,1.0,0.0)) * stepScale_);}); // PAGE_UP
     addSpecialKeyboardCB(105,[&]() mutable {W_r_WC_ -= (q_CW_.inverseRotate(Eigen::Vector3f(0.0,1.0,0.0)) * stepScale_);}); // PAGE_DOWN
   };
-  Scene::~Scene(){};
+  Scene::~Scene(){
+    releaseOffscreen();
+  };
+  void Scene::releaseOffscreen(){
+#ifdef ROVIO_HAVE_EGL
+    if(eglContext_ != nullptr){
+      eglMakeCurrent(eglDisplay_,EGL_NO_SURFACE,EGL_NO_SURFACE,EGL_NO_CONTEXT);
+      eglDestroyContext(eglDisplay_,eglContext_);
+      eglTerminate(eglDisplay_);
+      eglContext_ = nullptr;
+      eglDisplay_ = nullptr;
+    }
+#endif
+  }
   int Scene::init(int argc, char** argv, const std::string& mVSFileName,const std::string& mFSFileName){
-    // Must be done after glut is initialized!
+    // Must be done after glut (or the offscreen context) is initialized!
     GLenum res = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if(offscreen_ && res == GLEW_ERROR_NO_GLX_DISPLAY) res = GLEW_OK; // GL entry points are loaded, only GLX is missing
+#endif
     if (res != GLEW_OK) {
       fprintf(stderr, "Error: '%s'\n", glewGetErrorString(res));
       return 1;
     }
 
+    if(offscreen_){
+      glGenFramebuffers(1, &framebuffer_);
+      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+      glGenRenderbuffers(1, &colorRenderbuffer_);
+      glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer_);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, offscreenWidth_, offscreenHeight_);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer_);
+      glGenRenderbuffers(1, &depthRenderbuffer_);
+      glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer_);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, offscreenWidth_, offscreenHeight_);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer_);
+      if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+        fprintf(stderr, "Error: offscreen framebuffer incomplete\n");
+        return 1;
+      }
+      glViewport(0, 0, offscreenWidth_, offscreenHeight_);
+    }
+
     glClearColor(0.9f, 1.0f, 0.8f, 0.0f);
     glFrontFace(GL_CW);
     glCullFace(GL_BACK);
@@ -335,13 +439,63 @@ namespace rovio{
     CompileShaders(mVSFileName,mFSFileName);
 
     mPersProjInfo_.FOV_ = M_PI/2;
-    mPersProjInfo_.width_ = 1280;
-    mPersProjInfo_.height_ = 960;
+    mPersProjInfo_.width_ = offscreenWidth_;
+    mPersProjInfo_.height_ = offscreenHeight_;
     mPersProjInfo_.zNear_ = -0.1f;
     mPersProjInfo_.zFar_ = -100.0f;
 
     return 0;
   }
+  int Scene::initOffscreen(const int& width, const int& height){
+#ifdef ROVIO_HAVE_EGL
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)){
+      fprintf(stderr, "Error: could not initialize EGL\n");
+      return 1;
+    }
+    const EGLint configAttribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_NONE};
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if(!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs < 1 || !eglBindAPI(EGL_OPENGL_API)){
+      fprintf(stderr, "Error: no suitable EGL configuration\n");
+      eglTerminate(display);
+      return 1;
+    }
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if(context == EGL_NO_CONTEXT){
+      fprintf(stderr, "Error: could not create EGL context\n");
+      eglTerminate(display);
+      return 1;
+    }
+    // Everything is rendered into a framebuffer object, use a dummy pbuffer if surfaceless contexts are not supported
+    if(!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)){
+      const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+      EGLSurface surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+      if(surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context)){
+        fprintf(stderr, "Error: could not make EGL context current\n");
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return 1;
+      }
+    }
+    eglDisplay_ = display;
+    eglContext_ = context;
+    offscreen_ = true;
+    offscreenWidth_ = width;
+    offscreenHeight_ = height;
+    return 0;
+#else
+    fprintf(stderr, "Error: offscreen rendering requires EGL, which was not found at build time\n");
+    return 1;
+#endif
+  }
+  void Scene::readFrame(cv::Mat& img){
+    img.create(offscreenHeight_, offscreenWidth_, CV_8UC3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, offscreenWidth_, offscreenHeight_, GL_BGR, GL_UNSIGNED_BYTE, img.data);
+    cv::flip(img, img, 0); // OpenGL rows start at the bottom
+  }
   std::shared_ptr<SceneObject> Scene::addSceneObject(){
     std::shared_ptr<SceneObject> sp(new SceneObject());
     mSceneObjects_.push_back(sp);
@@ -386,6 +540,7 @@ namespace rovio{
   }
   void Scene::RenderSceneCB()
   {
+    redraw_ = false;
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glUniform3f(lightColor_location_, mDirectionalLight_.color_(0), mDirectionalLight_.color_(1), mDirectionalLight_.color_(2));
@@ -397,10 +552,15 @@ namespace rovio{
     C_TF_W_ = InitTransform(W_r_WC_,q_CW_);
 
     for(int i=0;i<mSceneObjects_.size();i++){
-      if(mSceneObjects_[i]->draw_){
+      if(mSceneObjects_[i]->draw_ && !(mSceneObjects_[i]->useInstancing_ && mSceneObjects_[i]->instances_.empty())){
+        mSceneObjects_[i]->updateBuffers();
         mSceneObjects_[i]->loadOptions();
 
         glUniform1i(useTexture_location_,mSceneObjects_[i]->useTexture_);
+        glUniform1i(useInstancing_location_,mSceneObjects_[i]->useInstancing_);
+        if(mSceneObjects_[i]->useInstancing_){
+          glUniform2f(atlasScale_location_,(float)mSceneObjects_[i]->tileSize_/mSceneObjects_[i]->atlas_.cols,(float)mSceneObjects_[i]->tileSize_/mSceneObjects_[i]->atlas_.rows);
+        }
         if(mSceneObjects_[i]->useTexture_){
           glActiveTexture(GL_TEXTURE0);
           glBindTexture(GL_TEXTURE_2D,mSceneObjects_[i]->textureID_);
@@ -421,13 +581,30 @@ namespace rovio{
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)12);
         glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)24);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mSceneObjects_[i]->IBO_);
-        glDrawElements(mSceneObjects_[i]->mode_, mSceneObjects_[i]->indices_.size(), GL_UNSIGNED_INT, 0);
+        if(mSceneObjects_[i]->useInstancing_){
+          // All patches in a single draw call, corners and atlas tile are per-instance attributes (locations 3-7)
+          glBindBuffer(GL_ARRAY_BUFFER, mSceneObjects_[i]->instanceVBO_);
+          for(int j=0;j<5;j++){
+            glEnableVertexAttribArray(3+j);
+            glVertexAttribPointer(3+j, j<4 ? 3 : 2, GL_FLOAT, GL_FALSE, sizeof(PatchInstance), (const GLvoid*)(size_t)(12*j));
+            glVertexAttribDivisor(3+j, 1);
+          }
+          glDrawElementsInstanced(mSceneObjects_[i]->mode_, mSceneObjects_[i]->indices_.size(), GL_UNSIGNED_INT, 0, mSceneObjects_[i]->instances_.size());
+          for(int j=0;j<5;j++){
+            glVertexAttribDivisor(3+j, 0);
+            glDisableVertexAttribArray(3+j);
+          }
+        } else {
+          glDrawElements(mSceneObjects_[i]->mode_, mSceneObjects_[i]->indices_.size(), GL_UNSIGNED_INT, 0);
+        }
         glDisableVertexAttribArray(0);
         glDisableVertexAttribArray(1);
         glDisableVertexAttribArray(2);
       }
     }
-    glutSwapBuffers();
+    if(!offscreen_){
+      glutSwapBuffers();
+    }
   }
   void Scene::setView(const Eigen::Vector3f& pos, const Eigen::Vector3f& target){
     W_r_WC_ = pos;
@@ -452,6 +629,7 @@ namespace rovio{
   {
     if (specialKeyboardCallbacks_.count(Key)>0){
       specialKeyboardCallbacks_[Key]();
+      redraw_ = true;
     }
   }
   void Scene::addSpecialKeyboardCB(int Key, std::function<void()> f){
@@ -461,6 +639,7 @@ namespace rovio{
   {
     if (keyboardCallbacks_.count(Key)>0){
       keyboardCallbacks_[Key]();
+      redraw_ = true;
     }
   }
   void Scene::addKeyboardCB(unsigned char Key, std::function<void()> f){
@@ -482,6 +661,7 @@ namespace rovio{
 
       q_CW_ = q_CW_.boxPlus(vec);
       q_CW_.fix();
+      redraw_ = true;
     }
   }
   void Scene::MouseCB(int button, int state, int x, int y)
@@ -568,15 +748,22 @@ namespace rovio{
     lightDirection_location_ = glGetUniformLocation(ShaderProgram, "gDirectionalLight.Direction");
     useTexture_location_ = glGetUniformLocation(ShaderProgram, "useTexture");
     sampler_location_ = glGetUniformLocation(ShaderProgram, "gSampler");
+    useInstancing_location_ = glGetUniformLocation(ShaderProgram, "useInstancing");
+    atlasScale_location_ = glGetUniformLocation(ShaderProgram, "atlasScale");
     assert(lightColor_location_ != 0xFFFFFFFF);
     assert(lightAmbientIntensity_location_ != 0xFFFFFFFF);
     assert(lightDiffuseIntensity_location_ != 0xFFFFFFFF);
     assert(lightDirection_location_ != 0xFFFFFFFF);
     assert(useTexture_location_ != 0xFFFFFFFF);
     assert(sampler_location_ != 0xFFFFFFFF);
+    assert(useInstancing_location_ != 0xFFFFFFFF);
+    assert(atlasScale_location_ != 0xFFFFFFFF);
   }
   void Scene::setIdleFunction(void (*idleFunc)()){
     mIdleFunc = idleFunc;
   }
+  void Scene::requestRedraw(){
+    redraw_ = true;
+  }
 
 }
@@ -26,7 +26,6 @@
 *
 */
 
-
 #include <memory>
 
 #include <Eigen/StdVector>
@@ -40,50 +39,89 @@
 
 #include "rovio/RovioFilter.hpp"
 #include "rovio/RovioNode.hpp"
+#include "rovio/RovioVariants.hpp"
+#include "rovio/RovioInstantiations.hpp"
 #ifdef MAKE_SCENE
 #include "rovio/RovioScene.hpp"
 #endif
 
-#ifdef ROVIO_NMAXFEATURE
-static constexpr int nMax_ = ROVIO_NMAXFEATURE;
-#else
-static constexpr int nMax_ = 25; // Maximal number of considered features in the filter state.
-#endif
-
-#ifdef ROVIO_NLEVELS
-static constexpr int nLevels_ = ROVIO_NLEVELS;
-#else
-static constexpr int nLevels_ = 4; // // Total number of pyramid levels considered.
-#endif
-
-#ifdef ROVIO_PATCHSIZE
-static constexpr int patchSize_ = ROVIO_PATCHSIZE;
-#else
-static constexpr int patchSize_ = 6; // Edge length of the patches (in pixel). Must be a multiple of 2!
-#endif
-
-#ifdef ROVIO_NCAM
-static constexpr int nCam_ = ROVIO_NCAM;
-#else
-static constexpr int nCam_ = 1; // Used total number of cameras.
+#ifdef MAKE_SCENE
+/** \brief Holds the scene of a filter variant (glut requires a plain idle function).
+ */
+template<typename FILTER>
+struct SceneHolder{
+  static rovio::RovioScene<FILTER> mRovioScene;
+  static void idleFunc(){
+    ros::spinOnce();
+    mRovioScene.drawSnapshot();
+  }
+};
+template<typename FILTER> rovio::RovioScene<FILTER> SceneHolder<FILTER>::mRovioScene;
 #endif
 
-#ifdef ROVIO_NPOSE
-static constexpr int nPose_ = ROVIO_NPOSE;
-#else
-static constexpr int nPose_ = 0; // Additional pose states.
-#endif
+/** \brief Sets up and runs the filter and node for a given filter variant.
+ */
+struct RovioNodeRunner{
+  int argc_;
+  char** argv_;
+  ros::NodeHandle& nh_;
+  ros::NodeHandle& nh_private_;
+  std::string rootdir_;
+  std::string filter_config_;
+
+  RovioNodeRunner(int argc, char** argv, ros::NodeHandle& nh, ros::NodeHandle& nh_private, const std::string& rootdir, const std::string& filter_config):
+    argc_(argc), argv_(argv), nh_(nh), nh_private_(nh_private), rootdir_(rootdir), filter_config_(filter_config){};
+
+  template<typename FILTER>
+  int run(){
+    typedef FILTER mtFilter;
+    static constexpr int nCam_ = mtFilter::mtState::nCam_;
+
+    // Filter
+    std::shared_ptr<mtFilter> mpFilter(new mtFilter);
+    mpFilter->readFromInfo(filter_config_);
+
+    // Force the camera calibration paths to the ones from ROS parameters.
+    for (unsigned int camID = 0; camID < nCam_; ++camID) {
+      std::string camera_config;
+      if (nh_private_.getParam("camera" + std::to_string(camID)
+                              + "_config", camera_config)) {
+        mpFilter->cameraCalibrationFile_[camID] = camera_config;
+      }
+    }
+    mpFilter->refreshProperties();
 
-typedef rovio::RovioFilter<rovio::FilterState<nMax_,nLevels_,patchSize_,nCam_,nPose_>> mtFilter;
+    // Node
+    rovio::RovioNode<mtFilter> rovioNode(nh_, nh_private_, mpFilter);
+    rovioNode.makeStartupTest(filter_config_);
 
 #ifdef MAKE_SCENE
-static rovio::RovioScene<mtFilter> mRovioScene;
-
-void idleFunc(){
-  ros::spinOnce();
-  mRovioScene.drawScene(mRovioScene.mpFilter_->safe_);
-}
+    // Scene
+    std::string mVSFileName = rootdir_ + "/shaders/shader.vs";
+    std::string mFSFileName = rootdir_ + "/shaders/shader.fs";
+    std::string offscreenOutput = "";
+    nh_private_.param("scene_offscreen_output", offscreenOutput, offscreenOutput);
+    if(!offscreenOutput.empty()){ // Headless
+      int width = 1280, height = 960;
+      double period = 0.1;
+      nh_private_.param("scene_offscreen_width", width, width);
+      nh_private_.param("scene_offscreen_height", height, height);
+      nh_private_.param("scene_offscreen_period", period, period);
+      SceneHolder<mtFilter>::mRovioScene.startOffscreen(mVSFileName,mFSFileName,mpFilter,offscreenOutput,width,height,period);
+      ros::spin();
+      SceneHolder<mtFilter>::mRovioScene.stopOffscreen();
+      return 0;
+    }
+    SceneHolder<mtFilter>::mRovioScene.initScene(argc_,argv_,mVSFileName,mFSFileName,mpFilter);
+    SceneHolder<mtFilter>::mRovioScene.setIdleFunction(SceneHolder<mtFilter>::idleFunc);
+    SceneHolder<mtFilter>::mRovioScene.addKeyboardCB('r',[&rovioNode]() mutable {rovioNode.requestReset();});
+    glutMainLoop();
+#else
+    ros::spin();
 #endif
+    return 0;
+  }
+};
 
 int main(int argc, char** argv){
   ros::init(argc, argv, "rovio");
@@ -95,34 +133,14 @@ int main(int argc, char** argv){
 
   nh_private.param("filter_config", filter_config, filter_config);
 
-  // Filter
-  std::shared_ptr<mtFilter> mpFilter(new mtFilter);
-  mpFilter->readFromInfo(filter_config);
+  // Select the precompiled filter variant
+  rovio::RovioConfiguration configuration;
+  nh_private.param("n_max", configuration.nMax_, configuration.nMax_);
+  nh_private.param("n_levels", configuration.nLevels_, configuration.nLevels_);
+  nh_private.param("patch_size", configuration.patchSize_, configuration.patchSize_);
+  nh_private.param("n_cam", configuration.nCam_, configuration.nCam_);
+  nh_private.param("n_pose", configuration.nPose_, configuration.nPose_);
 
-  // Force the camera calibration paths to the ones from ROS parameters.
-  for (unsigned int camID = 0; camID < nCam_; ++camID) {
-    std::string camera_config;
-    if (nh_private.getParam("camera" + std::to_string(camID)
-                            + "_config", camera_config)) {
-      mpFilter->cameraCalibrationFile_[camID] = camera_config;
-    }
-  }
-  mpFilter->refreshProperties();
-
-  // Node
-  rovio::RovioNode<mtFilter> rovioNode(nh, nh_private, mpFilter);
-  rovioNode.makeTest();
-
-#ifdef MAKE_SCENE
-  // Scene
-  std::string mVSFileName = rootdir + "/shaders/shader.vs";
-  std::string mFSFileName = rootdir + "/shaders/shader.fs";
-  mRovioScene.initScene(argc,argv,mVSFileName,mFSFileName,mpFilter);
-  mRovioScene.setIdleFunction(idleFunc);
-  mRovioScene.addKeyboardCB('r',[&rovioNode]() mutable {rovioNode.requestReset();});
-  glutMainLoop();
-#else
-  ros::spin();
-#endif
-  return 0;
+  RovioNodeRunner runner(argc, argv, nh, nh_private, rootdir, filter_config);
+  return rovio::runRovioVariant(configuration, runner);
 }
@@ -36,193 +36,226 @@
 #include <Eigen/StdVector>
 #include "rovio/RovioFilter.hpp"
 #include "rovio/RovioNode.hpp"
+#include "rovio/RovioVariants.hpp"
+#include "rovio/RovioInstantiations.hpp"
+#include "rovio/StateExporter.hpp"
+#ifdef MAKE_SCENE
+#include "rovio/RovioScene.hpp"
+#endif
 #include <boost/foreach.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/posix_time/posix_time_io.hpp>
 #define foreach BOOST_FOREACH
 
-#ifdef ROVIO_NMAXFEATURE
-static constexpr int nMax_ = ROVIO_NMAXFEATURE;
-#else
-static constexpr int nMax_ = 25; // Maximal number of considered features in the filter state.
-#endif
+/** \brief Sets up the filter and node for a given filter variant and processes the rosbag.
+ */
+struct RosbagLoaderRunner{
+  ros::NodeHandle& nh_;
+  ros::NodeHandle& nh_private_;
+  std::string rootdir_;
+  std::string filter_config_;
 
-#ifdef ROVIO_NLEVELS
-static constexpr int nLevels_ = ROVIO_NLEVELS;
-#else
-static constexpr int nLevels_ = 4; // // Total number of pyramid levels considered.
-#endif
+  RosbagLoaderRunner(ros::NodeHandle& nh, ros::NodeHandle& nh_private, const std::string& rootdir, const std::string& filter_config):
+    nh_(nh), nh_private_(nh_private), rootdir_(rootdir), filter_config_(filter_config){};
 
-#ifdef ROVIO_PATCHSIZE
-static constexpr int patchSize_ = ROVIO_PATCHSIZE;
-#else
-static constexpr int patchSize_ = 8; // Edge length of the patches (in pixel). Must be a multiple of 2!
-#endif
+  template<typename FILTER>
+  int run(){
+    typedef FILTER mtFilter;
+    static constexpr int nCam_ = mtFilter::mtState::nCam_;
 
-#ifdef ROVIO_NCAM
-static constexpr int nCam_ = ROVIO_NCAM;
-#else
-static constexpr int nCam_ = 1; // Used total number of cameras.
-#endif
+    // Filter
+    std::shared_ptr<mtFilter> mpFilter(new mtFilter);
+    mpFilter->readFromInfo(filter_config_);
 
-#ifdef ROVIO_NPOSE
-static constexpr int nPose_ = ROVIO_NPOSE;
-#else
-static constexpr int nPose_ = 0; // Additional pose states.
-#endif
+    // Force the camera calibration paths to the ones from ROS parameters.
+    for (unsigned int camID = 0; camID < nCam_; ++camID) {
+      std::string camera_config;
+      if (nh_private_.getParam("camera" + std::to_string(camID)
+                              + "_config", camera_config)) {
+        mpFilter->cameraCalibrationFile_[camID] = camera_config;
+      }
+    }
+    mpFilter->refreshProperties();
 
-typedef rovio::RovioFilter<rovio::FilterState<nMax_,nLevels_,patchSize_,nCam_,nPose_>> mtFilter;
+    // Node
+    rovio::RovioNode<mtFilter> rovioNode(nh_, nh_private_, mpFilter);
+    rovioNode.makeStartupTest(filter_config_);
+    double resetTrigger = 0.0;
+    bool recordColumnar = false;
+    nh_private_.param("record_odometry", rovioNode.forceOdometryPublishing_, rovioNode.forceOdometryPublishing_);
+    nh_private_.param("record_pose_with_covariance_stamped", rovioNode.forcePoseWithCovariancePublishing_, rovioNode.forcePoseWithCovariancePublishing_);
+    nh_private_.param("record_transform", rovioNode.forceTransformPublishing_, rovioNode.forceTransformPublishing_);
+    nh_private_.param("record_extrinsics", rovioNode.forceExtrinsicsPublishing_, rovioNode.forceExtrinsicsPublishing_);
+    nh_private_.param("record_imu_bias", rovioNode.forceImuBiasPublishing_, rovioNode.forceImuBiasPublishing_);
+    nh_private_.param("record_pcl", rovioNode.forcePclPublishing_, rovioNode.forcePclPublishing_);
+    nh_private_.param("record_markers", rovioNode.forceMarkersPublishing_, rovioNode.forceMarkersPublishing_);
+    nh_private_.param("record_patch", rovioNode.forcePatchPublishing_, rovioNode.forcePatchPublishing_);
+    nh_private_.param("reset_trigger", resetTrigger, resetTrigger);
+    nh_private_.param("record_columnar", recordColumnar, recordColumnar);
 
-int main(int argc, char** argv){
-  ros::init(argc, argv, "rovio");
-  ros::NodeHandle nh;
-  ros::NodeHandle nh_private("~");
+    std::cout << "Recording";
+    if(rovioNode.forceOdometryPublishing_) std::cout << ", odometry";
+    if(rovioNode.forceTransformPublishing_) std::cout << ", transform";
+    if(rovioNode.forceExtrinsicsPublishing_) std::cout << ", extrinsics";
+    if(rovioNode.forceImuBiasPublishing_) std::cout << ", imu biases";
+    if(rovioNode.forcePclPublishing_) std::cout << ", point cloud";
+    if(rovioNode.forceMarkersPublishing_) std::cout << ", markers";
+    if(rovioNode.forcePatchPublishing_) std::cout << ", patch data";
+    if(recordColumnar) std::cout << ", columnar state and feature export";
+    std::cout << std::endl;
 
-  std::string rootdir = ros::package::getPath("rovio"); // Leaks memory
-  std::string filter_config = rootdir + "/cfg/rovio.info";
+    rosbag::Bag bagIn;
+    std::string rosbag_filename = "dataset.bag";
+    nh_private_.param("rosbag_filename", rosbag_filename, rosbag_filename);
+    bagIn.open(rosbag_filename, rosbag::bagmode::Read);
 
-  nh_private.param("filter_config", filter_config, filter_config);
+    rosbag::Bag bagOut;
+    std::size_t found = rosbag_filename.find_last_of("/");
+    std::string file_path = rosbag_filename.substr(0,found);
+    std::string file_name = rosbag_filename.substr(found+1);
+    if(file_path==rosbag_filename){
+      file_path = ".";
+      file_name = rosbag_filename;
+    }
 
-  // Filter
-  std::shared_ptr<mtFilter> mpFilter(new mtFilter);
-  mpFilter->readFromInfo(filter_config);
+    std::stringstream stream;
+    boost::posix_time::time_facet* facet = new boost::posix_time::time_facet();
+    facet->format("%Y-%m-%d-%H-%M-%S");
+    stream.imbue(std::locale(std::locale::classic(), facet));
+    stream << ros::Time::now().toBoost() << "_" << mtFilter::mtState::nMax_ << "_" << mtFilter::mtState::nLevels_ << "_" << mtFilter::mtState::patchSize_ << "_" << mtFilter::mtState::nCam_  << "_" << mtFilter::mtState::nPose_;
+    std::string filename_out = file_path + "/rovio/" + stream.str();
+    nh_private_.param("filename_out", filename_out, filename_out);
+    std::string rosbag_filename_out = filename_out + ".bag";
+    std::string info_filename_out = filename_out + ".info";
+    std::cout << "Storing output to: " << rosbag_filename_out << std::endl;
+    bagOut.open(rosbag_filename_out, rosbag::bagmode::Write);
 
-  // Force the camera calibration paths to the ones from ROS parameters.
-  for (unsigned int camID = 0; camID < nCam_; ++camID) {
-    std::string camera_config;
-    if (nh_private.getParam("camera" + std::to_string(camID)
-                            + "_config", camera_config)) {
-      mpFilter->cameraCalibrationFile_[camID] = camera_config;
-    }
-  }
-  mpFilter->refreshProperties();
-
-  // Node
-  rovio::RovioNode<mtFilter> rovioNode(nh, nh_private, mpFilter);
-  rovioNode.makeTest();
-  double resetTrigger = 0.0;
-  nh_private.param("record_odometry", rovioNode.forceOdometryPublishing_, rovioNode.forceOdometryPublishing_);
-  nh_private.param("record_pose_with_covariance_stamped", rovioNode.forcePoseWithCovariancePublishing_, rovioNode.forcePoseWithCovariancePublishing_);
-  nh_private.param("record_transform", rovioNode.forceTransformPublishing_, rovioNode.forceTransformPublishing_);
-  nh_private.param("record_extrinsics", rovioNode.forceExtrinsicsPublishing_, rovioNode.forceExtrinsicsPublishing_);
-  nh_private.param("record_imu_bias", rovioNode.forceImuBiasPublishing_, rovioNode.forceImuBiasPublishing_);
-  nh_private.param("record_pcl", rovioNode.forcePclPublishing_, rovioNode.forcePclPublishing_);
-  nh_private.param("record_markers", rovioNode.forceMarkersPublishing_, rovioNode.forceMarkersPublishing_);
-  nh_private.param("record_patch", rovioNode.forcePatchPublishing_, rovioNode.forcePatchPublishing_);
-  nh_private.param("reset_trigger", resetTrigger, resetTrigger);
-
-  std::cout << "Recording";
-  if(rovioNode.forceOdometryPublishing_) std::cout << ", odometry";
-  if(rovioNode.forceTransformPublishing_) std::cout << ", transform";
-  if(rovioNode.forceExtrinsicsPublishing_) std::cout << ", extrinsics";
-  if(rovioNode.forceImuBiasPublishing_) std::cout << ", imu biases";
-  if(rovioNode.forcePclPublishing_) std::cout << ", point cloud";
-  if(rovioNode.forceMarkersPublishing_) std::cout << ", markers";
-  if(rovioNode.forcePatchPublishing_) std::cout << ", patch data";
-  std::cout << std::endl;
-
-  rosbag::Bag bagIn;
-  std::string rosbag_filename = "dataset.bag";
-  nh_private.param("rosbag_filename", rosbag_filename, rosbag_filename);
-  bagIn.open(rosbag_filename, rosbag::bagmode::Read);
-
-  rosbag::Bag bagOut;
-  std::size_t found = rosbag_filename.find_last_of("/");
-  std::string file_path = rosbag_filename.substr(0,found);
-  std::string file_name = rosbag_filename.substr(found+1);
-  if(file_path==rosbag_filename){
-    file_path = ".";
-    file_name = rosbag_filename;
-  }
+    // Copy info
+    std::ifstream  src(filter_config_, std::ios::binary);
+    std::ofstream  dst(info_filename_out,   std::ios::binary);
+    dst << src.rdbuf();
 
-  std::stringstream stream;
-  boost::posix_time::time_facet* facet = new boost::posix_time::time_facet();
-  facet->format("%Y-%m-%d-%H-%M-%S");
-  stream.imbue(std::locale(std::locale::classic(), facet));
-  stream << ros::Time::now().toBoost() << "_" << nMax_ << "_" << nLevels_ << "_" << patchSize_ << "_" << nCam_  << "_" << nPose_;
-  std::string filename_out = file_path + "/rovio/" + stream.str();
-  nh_private.param("filename_out", filename_out, filename_out);
-  std::string rosbag_filename_out = filename_out + ".bag";
-  std::string info_filename_out = filename_out + ".info";
-  std::cout << "Storing output to: " << rosbag_filename_out << std::endl;
-  bagOut.open(rosbag_filename_out, rosbag::bagmode::Write);
-
-  // Copy info
-  std::ifstream  src(filter_config, std::ios::binary);
-  std::ofstream  dst(info_filename_out,   std::ios::binary);
-  dst << src.rdbuf();
-
-  std::vector<std::string> topics;
-  std::string imu_topic_name = "/imu0";
-  nh_private.param("imu_topic_name", imu_topic_name, imu_topic_name);
-  std::string cam0_topic_name = "/cam0/image_raw";
-  nh_private.param("cam0_topic_name", cam0_topic_name, cam0_topic_name);
-  std::string cam1_topic_name = "/cam1/image_raw";
-  nh_private.param("cam1_topic_name", cam1_topic_name, cam1_topic_name);
-  std::string odometry_topic_name = rovioNode.pubOdometry_.getTopic();
-  std::string transform_topic_name = rovioNode.pubTransform_.getTopic();
-  std::string extrinsics_topic_name[mtFilter::mtState::nCam_];
-  for(int camID=0;camID<mtFilter::mtState::nCam_;camID++){
-    extrinsics_topic_name[camID] = rovioNode.pubExtrinsics_[camID].getTopic();
-  }
-  std::string imu_bias_topic_name = rovioNode.pubImuBias_.getTopic();
-  std::string pcl_topic_name = rovioNode.pubPcl_.getTopic();
-  std::string u_rays_topic_name = rovioNode.pubMarkers_.getTopic();
-  std::string patch_topic_name = rovioNode.pubPatch_.getTopic();
-
-  topics.push_back(std::string(imu_topic_name));
-  topics.push_back(std::string(cam0_topic_name));
-  topics.push_back(std::string(cam1_topic_name));
-  rosbag::View view(bagIn, rosbag::TopicQuery(topics));
-
-
-  bool isTriggerInitialized = false;
-  double lastTriggerTime = 0.0;
-  for(rosbag::View::iterator it = view.begin();it != view.end() && ros::ok();it++){
-    if(it->getTopic() == imu_topic_name){
-      sensor_msgs::Imu::ConstPtr imuMsg = it->instantiate<sensor_msgs::Imu>();
-      if (imuMsg != NULL) rovioNode.imuCallback(imuMsg);
+    // Columnar export of state, covariance diagonal, timing and feature tracks
+    rovio::StateExporter<typename mtFilter::mtFilterState> exporter;
+    if(recordColumnar){
+      std::string columnar_filename_out = filename_out + ".columnar";
+      std::cout << "Storing columnar export to: " << columnar_filename_out << std::endl;
+      exporter.open(columnar_filename_out);
     }
-    if(it->getTopic() == cam0_topic_name){
-      sensor_msgs::ImageConstPtr imgMsg = it->instantiate<sensor_msgs::Image>();
-      if (imgMsg != NULL) rovioNode.imgCallback0(imgMsg);
+
+    std::vector<std::string> topics;
+    std::string imu_topic_name = "/imu0";
+    nh_private_.param("imu_topic_name", imu_topic_name, imu_topic_name);
+    std::string cam0_topic_name = "/cam0/image_raw";
+    nh_private_.param("cam0_topic_name", cam0_topic_name, cam0_topic_name);
+    std::string cam1_topic_name = "/cam1/image_raw";
+    nh_private_.param("cam1_topic_name", cam1_topic_name, cam1_topic_name);
+    std::string odometry_topic_name = rovioNode.pubOdometry_.getTopic();
+    std::string transform_topic_name = rovioNode.pubTransform_.getTopic();
+    std::string extrinsics_topic_name[mtFilter::mtState::nCam_];
+    for(int camID=0;camID<mtFilter::mtState::nCam_;camID++){
+      extrinsics_topic_name[camID] = rovioNode.pubExtrinsics_[camID].getTopic();
     }
-    if(it->getTopic() == cam1_topic_name){
-      sensor_msgs::ImageConstPtr imgMsg = it->instantiate<sensor_msgs::Image>();
-      if (imgMsg != NULL) rovioNode.imgCallback1(imgMsg);
+    std::string imu_bias_topic_name = rovioNode.pubImuBias_.getTopic();
+    std::string pcl_topic_name = rovioNode.pubPcl_.getTopic();
+    std::string u_rays_topic_name = rovioNode.pubMarkers_.getTopic();
+    std::string patch_topic_name = rovioNode.pubPatch_.getTopic();
+
+    topics.push_back(std::string(imu_topic_name));
+    topics.push_back(std::string(cam0_topic_name));
+    topics.push_back(std::string(cam1_topic_name));
+    rosbag::View view(bagIn, rosbag::TopicQuery(topics));
+
+
+#ifdef MAKE_SCENE
+    // Optional headless rendering of the scene
+    rovio::RovioScene<mtFilter> scene;
+    std::string offscreenOutput = "";
+    nh_private_.param("scene_offscreen_output", offscreenOutput, offscreenOutput);
+    if(!offscreenOutput.empty()){
+      int width = 1280, height = 960;
+      double period = 0.1;
+      nh_private_.param("scene_offscreen_width", width, width);
+      nh_private_.param("scene_offscreen_height", height, height);
+      nh_private_.param("scene_offscreen_period", period, period);
+      scene.startOffscreen(rootdir_ + "/shaders/shader.vs",rootdir_ + "/shaders/shader.fs",mpFilter,offscreenOutput,width,height,period);
     }
-    ros::spinOnce();
-
-    if(rovioNode.gotFirstMessages_){
-      static double lastSafeTime = rovioNode.mpFilter_->safe_.t_;
-      if(rovioNode.mpFilter_->safe_.t_ > lastSafeTime){
-        if(rovioNode.forceOdometryPublishing_) bagOut.write(odometry_topic_name,ros::Time::now(),rovioNode.odometryMsg_);
-        if(rovioNode.forceTransformPublishing_) bagOut.write(transform_topic_name,ros::Time::now(),rovioNode.transformMsg_);
-        for(int camID=0;camID<mtFilter::mtState::nCam_;camID++){
-          if(rovioNode.forceExtrinsicsPublishing_) bagOut.write(extrinsics_topic_name[camID],ros::Time::now(),rovioNode.extrinsicsMsg_[camID]);
-        }
-        if(rovioNode.forceImuBiasPublishing_) bagOut.write(imu_bias_topic_name,ros::Time::now(),rovioNode.imuBiasMsg_);
-        if(rovioNode.forcePclPublishing_) bagOut.write(pcl_topic_name,ros::Time::now(),rovioNode.pclMsg_);
-        if(rovioNode.forceMarkersPublishing_) bagOut.write(u_rays_topic_name,ros::Time::now(),rovioNode.markerMsg_);
-        if(rovioNode.forcePatchPublishing_) bagOut.write(patch_topic_name,ros::Time::now(),rovioNode.patchMsg_);
-        lastSafeTime = rovioNode.mpFilter_->safe_.t_;
+#endif
+
+    bool isTriggerInitialized = false;
+    double lastTriggerTime = 0.0;
+    for(rosbag::View::iterator it = view.begin();it != view.end() && ros::ok();it++){
+      if(it->getTopic() == imu_topic_name){
+        sensor_msgs::Imu::ConstPtr imuMsg = it->instantiate<sensor_msgs::Imu>();
+        if (imuMsg != NULL) rovioNode.imuCallback(imuMsg);
       }
-      if(!isTriggerInitialized){
-        lastTriggerTime = lastSafeTime;
-        isTriggerInitialized = true;
+      if(it->getTopic() == cam0_topic_name){
+        sensor_msgs::ImageConstPtr imgMsg = it->instantiate<sensor_msgs::Image>();
+        if (imgMsg != NULL) rovioNode.imgCallback0(imgMsg);
       }
-      if(resetTrigger>0.0 && lastSafeTime - lastTriggerTime > resetTrigger){
-        rovioNode.requestReset();
-        rovioNode.mpFilter_->init_.state_.WrWM() = rovioNode.mpFilter_->safe_.state_.WrWM();
-        rovioNode.mpFilter_->init_.state_.qWM() = rovioNode.mpFilter_->safe_.state_.qWM();
-        lastTriggerTime = lastSafeTime;
+      if(it->getTopic() == cam1_topic_name){
+        sensor_msgs::ImageConstPtr imgMsg = it->instantiate<sensor_msgs::Image>();
+        if (imgMsg != NULL) rovioNode.imgCallback1(imgMsg);
+      }
+      ros::spinOnce();
+
+      if(rovioNode.gotFirstMessages_){
+        static double lastSafeTime = rovioNode.mpFilter_->safe_.t_;
+        if(rovioNode.mpFilter_->safe_.t_ > lastSafeTime){
+          if(rovioNode.forceOdometryPublishing_) bagOut.write(odometry_topic_name,ros::Time::now(),rovioNode.odometryMsg_);
+          if(rovioNode.forceTransformPublishing_) bagOut.write(transform_topic_name,ros::Time::now(),rovioNode.transformMsg_);
+          for(int camID=0;camID<mtFilter::mtState::nCam_;camID++){
+            if(rovioNode.forceExtrinsicsPublishing_) bagOut.write(extrinsics_topic_name[camID],ros::Time::now(),rovioNode.extrinsicsMsg_[camID]);
+          }
+          if(rovioNode.forceImuBiasPublishing_) bagOut.write(imu_bias_topic_name,ros::Time::now(),rovioNode.imuBiasMsg_);
+          if(rovioNode.forcePclPublishing_) bagOut.write(pcl_topic_name,ros::Time::now(),rovioNode.pclMsg_);
+          if(rovioNode.forceMarkersPublishing_) bagOut.write(u_rays_topic_name,ros::Time::now(),rovioNode.markerMsg_);
+          if(rovioNode.forcePatchPublishing_) bagOut.write(patch_topic_name,ros::Time::now(),rovioNode.patchMsg_);
+          if(recordColumnar) exporter.write(rovioNode.mpFilter_->safe_,rovioNode.lastUpdateDuration_,rovioNode.lastUpdateImageCount_);
+          lastSafeTime = rovioNode.mpFilter_->safe_.t_;
+        }
+        if(!isTriggerInitialized){
+          lastTriggerTime = lastSafeTime;
+          isTriggerInitialized = true;
+        }
+        if(resetTrigger>0.0 && lastSafeTime - lastTriggerTime > resetTrigger){
+          rovioNode.requestReset();
+          rovioNode.mpFilter_->init_.state_.WrWM() = rovioNode.mpFilter_->safe_.state_.WrWM();
+          rovioNode.mpFilter_->init_.state_.qWM() = rovioNode.mpFilter_->safe_.state_.qWM();
+          lastTriggerTime = lastSafeTime;
+        }
       }
     }
+
+#ifdef MAKE_SCENE
+    scene.stopOffscreen();
+#endif
+    exporter.close();
+    bagOut.close();
+    bagIn.close();
+
+    return 0;
   }
+};
 
-  bagOut.close();
-  bagIn.close();
+int main(int argc, char** argv){
+  ros::init(argc, argv, "rovio");
+  ros::NodeHandle nh;
+  ros::NodeHandle nh_private("~");
+
+  std::string rootdir = ros::package::getPath("rovio"); // Leaks memory
+  std::string filter_config = rootdir + "/cfg/rovio.info";
+
+  nh_private.param("filter_config", filter_config, filter_config);
 
+  // Select the precompiled filter variant
+  rovio::RovioConfiguration configuration;
+  nh_private.param("n_max", configuration.nMax_, configuration.nMax_);
+  nh_private.param("n_levels", configuration.nLevels_, configuration.nLevels_);
+  nh_private.param("patch_size", configuration.patchSize_, configuration.patchSize_);
+  nh_private.param("n_cam", configuration.nCam_, configuration.nCam_);
+  nh_private.param("n_pose", configuration.nPose_, configuration.nPose_);
 
-  return 0;
+  RosbagLoaderRunner runner(nh, nh_private, rootdir, filter_config);
+  return rovio::runRovioVariant(configuration, runner);
 }
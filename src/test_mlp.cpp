@@ -1,10 +1,14 @@
 #include "rovio/Camera.hpp"
 #include "gtest/gtest.h"
 #include <assert.h>
+#include <cstdio>
+#include <fstream>
 
 #include "../include/rovio/ImagePyramid.hpp"
 #include "../include/rovio/FeatureManager.hpp"
 #include "../include/rovio/MultilevelPatchAlignment.hpp"
+#include "../include/rovio/QuantizedPatch.hpp"
+#include "../include/rovio/FeatureTriangulation.hpp"
 
 using namespace rovio;
 
@@ -330,6 +334,91 @@ TEST_F(MLPTesting, getLinearAlignEquations) {
   }
 }
 
+// Test fixed-point against float patch comparison
+TEST_F(MLPTesting, quantizedComputeAverageDifference) {
+  MultilevelPatch<nLevels_,patchSize_> mp2;
+  QuantizedMultilevelPatch<nLevels_,patchSize_> qmp1;
+  QuantizedMultilevelPatch<nLevels_,patchSize_> qmp2;
+  PixelCoordinates pc;
+  c_.set_warp_identity();
+  for(int k=0;k<3;k++){
+    c_.set_c(cv::Point2f(imgSize_/2+0.3*k,imgSize_/2-0.2*k));
+    mp_.extractMultilevelPatchFromImage(pyr1_,c_,nLevels_-1,false);
+    mp2.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,false);
+    qmp1.quantize(mp_);
+    pc.fromFeatureCoordinates(c_);
+    qmp2.extractMultilevelPatchFromImage(pyr2_,pc,nLevels_-1);
+    for(int l=0;l<nLevels_;l++){
+      ASSERT_EQ(qmp2.isValidPatch_[l],true);
+    }
+    ASSERT_NEAR(qmp1.computeAverageDifference(qmp2,0,nLevels_-1),mp_.computeAverageDifference(mp2,0,nLevels_-1),0.5);
+    ASSERT_NEAR(qmp1.computeAverageDifference(qmp2,1,1),mp_.computeAverageDifference(mp2,1,1),0.5);
+  }
+}
+
+// Test fixed-point against float Shi-Tomasi eigenvalues (constant image gradient)
+TEST_F(MLPTesting, quantizedShiTomasiScore) {
+  QuantizedMultilevelPatch<nLevels_,patchSize_> qmp;
+  PixelCoordinates pc;
+  c_.set_warp_identity();
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  mp_.extractMultilevelPatchFromImage(pyr1_,c_,nLevels_-1,true);
+  pc.fromFeatureCoordinates(c_);
+  qmp.extractMultilevelPatchFromImage(pyr1_,pc,nLevels_-1);
+  for(int l1=0;l1<nLevels_;l1++){
+    for(int l2=l1;l2<nLevels_;l2++){
+      mp_.computeMultilevelShiTomasiScore(l1,l2);
+      qmp.computeMultilevelShiTomasiScore(l1,l2);
+      ASSERT_NEAR(qmp.e0_,mp_.e0_,1e-2*mp_.e1_+1e-3);
+      ASSERT_NEAR(qmp.e1_,mp_.e1_,1e-2*mp_.e1_+1e-3);
+    }
+  }
+}
+
+// Test two-view triangulation and its depth variance on a synthetic setup
+TEST_F(MLPTesting, triangulation) {
+  FeatureTriangulation triangulation;
+  const double distance = 3.0;
+  const V3D C1fP = V3D(0.2,-0.1,1.0).normalized();
+  const QPD qC2C1(cos(0.05),0.0,sin(0.05),0.0);
+  const V3D C2rC2C1(0.3,0.05,-0.1);
+  const V3D C2fP = (C2rC2C1 + qC2C1.rotate(V3D(distance*C1fP))).normalized();
+  const double sigma = 1e-3;
+  double d, dVar;
+  ASSERT_EQ(triangulation.triangulate(C1fP,C2fP,C2rC2C1,qC2C1,sigma,sigma,d,dVar),true);
+  ASSERT_NEAR(d,distance,1e-9);
+
+  // Numerical derivatives w.r.t. in-plane rotations of both bearing vectors (the rays stay coplanar)
+  const double eps = 1e-6;
+  const V3D C2v1 = qC2C1.rotate(C1fP);
+  const V3D n = C2v1.cross(C2fP).normalized();
+  const V3D C1fP_pert = qC2C1.inverseRotate(V3D(Eigen::AngleAxisd(eps,n)*C2v1));
+  const V3D C2fP_pert = Eigen::AngleAxisd(eps,n)*C2fP;
+  double d1, d2, dVarTemp;
+  ASSERT_EQ(triangulation.triangulate(C1fP_pert,C2fP,C2rC2C1,qC2C1,sigma,sigma,d1,dVarTemp),true);
+  ASSERT_EQ(triangulation.triangulate(C1fP,C2fP_pert,C2rC2C1,qC2C1,sigma,sigma,d2,dVarTemp),true);
+  const double dVarNumeric = pow((d1-d)/eps*sigma,2) + pow((d2-d)/eps*sigma,2);
+  ASSERT_NEAR(dVar,dVarNumeric,1e-4*dVarNumeric);
+
+  // No parallax
+  ASSERT_EQ(triangulation.triangulate(C1fP,qC2C1.rotate(C1fP),C2rC2C1,qC2C1,sigma,sigma,d,dVar),false);
+
+  // Same setup expressed through the world poses of both views (temporal initialization)
+  const QPD qC2W(cos(0.3),0.2*sin(0.3),-0.4*sin(0.3),sqrt(0.8)*sin(0.3));
+  const V3D WrWC2(1.0,-2.0,0.5);
+  const QPD qC1W = qC2C1.inverted()*qC2W;
+  const V3D WrWC1 = WrWC2 + qC2W.inverseRotate(C2rC2C1);
+  FeatureCoordinates c1(&camera_);
+  FeatureCoordinates c2(&camera_);
+  c1.set_nor(LWF::NormalVectorElement(C1fP));
+  c2.set_nor(LWF::NormalVectorElement(C2fP));
+  FeatureDistance distance(FeatureDistance::REGULAR);
+  double pVar;
+  ASSERT_EQ(triangulation.triangulateFromPoses(c1,c2,WrWC1,qC1W,WrWC2,qC2W,sigma,sigma,distance,pVar),true);
+  ASSERT_NEAR(distance.getDistance(),d,1e-9);
+  ASSERT_NEAR(pVar,dVar*pow(distance.getParameterDerivative(),2),1e-9*pVar);
+}
+
 // Test levelTranformCoordinates and computation of pyramid centers
 TEST_F(MLPTesting, levelTranformCoordinates) {
   const int nLevels = 4;
@@ -506,6 +595,25 @@ TEST_F(MLPTesting, align2D) {
   ASSERT_NEAR(c1.y,c2.y,1e-6);
 }
 
+// Test the selection of the pinhole model for zero distortion coefficients
+TEST_F(MLPTesting, cameraModelSelection) {
+  const std::string filename = "test_mlp_camera.yaml";
+  const std::string models[3] = {"plumb_bob","equidistant","ds"};
+  const std::string coefficients[3] = {"[0.0, 0.0, 0.0, 0.0, 0.0]","[0.0, 0.0, 0.0, 0.0]","[0.0, 0.0]"};
+  const Camera::ModelType expectedTypes[3] = {Camera::PINHOLE,Camera::EQUIDIST,Camera::PINHOLE};
+  for(int i=0;i<3;i++){
+    std::ofstream file(filename);
+    file << "camera_matrix:\n  data: [400.0, 0.0, 320.0, 0.0, 410.0, 240.0, 0.0, 0.0, 1.0]\n"
+         << "distortion_model: " << models[i] << "\n"
+         << "distortion_coefficients:\n  data: " << coefficients[i] << "\n";
+    file.close();
+    Camera camera;
+    camera.load(filename);
+    ASSERT_EQ(camera.type_,expectedTypes[i]);
+  }
+  std::remove(filename.c_str());
+  ASSERT_EQ(camera_.testCameraModel(),true);
+}
 
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
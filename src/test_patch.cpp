@@ -1,7 +1,10 @@
 #include "gtest/gtest.h"
 #include <assert.h>
+#include <cmath>
 
+#include "rovio/ImagePyramid.hpp"
 #include "rovio/Patch.hpp"
+#include "rovio/QuantizedPatch.hpp"
 
 using namespace rovio;
 
@@ -202,6 +205,68 @@ TEST_F(PatchTesting, extractWarpedPatchFromImage) {
   }
 }
 
+// Test lightweight PixelCoordinates against FeatureCoordinates
+TEST_F(PatchTesting, pixelCoordinates) {
+  Eigen::Matrix2f aff;
+  aff << cos(M_PI/6.0), -sin(M_PI/6.0), sin(M_PI/6.0), cos(M_PI/6.0);
+  c_.set_warp_c(aff);
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  PixelCoordinates pc;
+  ASSERT_EQ(pc.fromFeatureCoordinates(c_),true);
+  ASSERT_EQ(pc.isNearIdentityWarping(),false);
+  ASSERT_EQ(p_.isPatchInFrame(img1_,pc,true),p_.isPatchInFrame(img1_,c_,true));
+  Patch<patchSize_> p;
+  p.extractPatchFromImage(img1_,pc,true);
+  p_.extractPatchFromImage(img1_,c_,true);
+  for(int i=0;i<(patchSize_+2)*(patchSize_+2);i++){
+    ASSERT_EQ(p.patchWithBorder_[i],p_.patchWithBorder_[i]);
+  }
+  pc.set_c(cv::Point2f(1.5,2.5));
+  pc.toFeatureCoordinates(c_);
+  ASSERT_EQ(c_.get_c().x,1.5f);
+  ASSERT_EQ(c_.get_c().y,2.5f);
+  ASSERT_NEAR((c_.get_warp_c()-aff).norm(),0.0,1e-6);
+}
+
+// Test QuantizedPatch
+TEST_F(PatchTesting, quantizedPatch) {
+  c_.set_c(cv::Point2f(patchSize_/2+1.25,patchSize_/2+1.5));
+  c_.set_warp_identity();
+  p_.extractPatchFromImage(img1_,c_,true);
+  QuantizedPatch<patchSize_> q;
+  q.quantize(p_);
+  Patch<patchSize_> p;
+  q.dequantize(p);
+  for(int i=0;i<patchSize_*patchSize_;i++){
+    ASSERT_NEAR(p.patch_[i],p_.patch_[i],0.5/16);
+  }
+  PixelCoordinates pc;
+  pc.fromFeatureCoordinates(c_);
+  QuantizedPatch<patchSize_> qExtracted;
+  qExtracted.extractPatchFromImage(img1_,pc);
+  for(int i=0;i<patchSize_*patchSize_;i++){
+    ASSERT_NEAR(qExtracted.patch_[i],q.patch_[i],1);
+  }
+}
+
+// Test the fixed-point squared difference kernel at full intensity range (exceeds 32bit for 16x16 patches)
+TEST_F(PatchTesting, quantizedSumSquaredDifference) {
+  const int n = 16*16;
+  int16_t a[n] __attribute__ ((aligned (16)));
+  int16_t b[n] __attribute__ ((aligned (16)));
+  for(int i=0;i<n;i++){
+    a[i] = i%2 == 0 ? QuantizedPatch<patchSize_>::toFixed(255) : 0;
+    b[i] = i%2 == 0 ? 0 : QuantizedPatch<patchSize_>::toFixed(255);
+  }
+  int64_t sumDiff;
+  const int64_t sumSq = quantized_kernels::sumSquaredDifference(a,b,n,sumDiff);
+  ASSERT_EQ(sumSq,static_cast<int64_t>(n)*4080*4080);
+  ASSERT_EQ(sumDiff,0);
+  const int64_t sumSqTail = quantized_kernels::sumSquaredDifference(a,b,n-3,sumDiff);
+  ASSERT_EQ(sumSqTail,static_cast<int64_t>(n-3)*4080*4080);
+  ASSERT_EQ(sumDiff,4080);
+}
+
 // Test extractPatchFromPatchWithBorder
 TEST_F(PatchTesting, extractPatchFromPatchWithBorder) {
   c_.set_c(cv::Point2f(patchSize_/2+1,patchSize_/2+1));
@@ -250,6 +315,70 @@ TEST_F(PatchTesting, computeGradientParameters) {
   ASSERT_EQ(p_.s_,s);
 }
 
+// Test computeTemplateStatistics
+TEST_F(PatchTesting, computeTemplateStatistics) {
+  c_.set_c(cv::Point2f(patchSize_/2+1,patchSize_/2+1+0.5));
+  c_.set_warp_identity();
+  p_.extractPatchFromImage(img1_,c_,true);
+  float w[patchSize_*patchSize_];
+  for(int i=0;i<patchSize_*patchSize_;i++){
+    w[i] = 0.5*(i+1);
+  }
+  for(int k=0;k<2;k++){
+    const float* it_w = k==0 ? nullptr : w;
+    p_.computeTemplateStatistics(it_w,k,-0.5);
+    ASSERT_EQ(p_.validTemplateStatistics_,true);
+    float sumW = 0, sumX = 0, sumXX = 0, sumDx = 0, sumDy = 0, sumXDx = 0, sumXDy = 0;
+    for(int i=0;i<patchSize_*patchSize_;i++){
+      const float wi = it_w == nullptr ? 1.0f : it_w[i];
+      sumW += wi;
+      sumX += wi*p_.patch_[i];
+      sumXX += wi*p_.patch_[i]*p_.patch_[i];
+      sumDx += wi*(-0.5f*p_.dx_[i]);
+      sumDy += wi*(-0.5f*p_.dy_[i]);
+      sumXDx += wi*p_.patch_[i]*(-0.5f*p_.dx_[i]);
+      sumXDy += wi*p_.patch_[i]*(-0.5f*p_.dy_[i]);
+    }
+    ASSERT_NEAR(p_.templateStatistics_.sumW_,sumW,1e-4*std::fabs(sumW)+1e-3);
+    ASSERT_NEAR(p_.templateStatistics_.sumX_,sumX,1e-4*std::fabs(sumX)+1e-3);
+    ASSERT_NEAR(p_.templateStatistics_.sumXX_,sumXX,1e-4*std::fabs(sumXX)+1e-3);
+    ASSERT_NEAR(p_.templateStatistics_.sumDx_,sumDx,1e-4*std::fabs(sumDx)+1e-3);
+    ASSERT_NEAR(p_.templateStatistics_.sumDy_,sumDy,1e-4*std::fabs(sumDy)+1e-3);
+    ASSERT_NEAR(p_.templateStatistics_.sumXDx_,sumXDx,1e-4*std::fabs(sumXDx)+1e-3);
+    ASSERT_NEAR(p_.templateStatistics_.sumXDy_,sumXDy,1e-4*std::fabs(sumXDy)+1e-3);
+  }
+
+  // Re-extraction invalidates the statistics
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  p_.extractPatchFromImage(img2_,c_,true);
+  ASSERT_EQ(p_.validGradientParameters_,false);
+  p_.computeTemplateStatistics(nullptr,0,1.0);
+  float sumX = 0, sumDx = 0;
+  for(int i=0;i<patchSize_*patchSize_;i++){
+    sumX += p_.patch_[i];
+    sumDx += p_.dx_[i];
+  }
+  ASSERT_NEAR(p_.templateStatistics_.sumX_,sumX,1e-4*std::fabs(sumX)+1e-3);
+  ASSERT_NEAR(p_.templateStatistics_.sumDx_,sumDx,1e-4*std::fabs(sumDx)+1e-3);
+}
+
+// Test the compile-time level scale tables
+TEST_F(PatchTesting, levelScales) {
+  const int nLevels = 6;
+  for(int l=0;l<=nLevels;l++){
+    ASSERT_EQ(LevelScales<nLevels>::down(l),static_cast<float>(std::pow(0.5,l)));
+    ASSERT_EQ(LevelScales<nLevels>::up(l),static_cast<float>(std::pow(2.0,l)));
+    ASSERT_EQ(LevelScales<nLevels>::squaredDown(l),static_cast<float>(std::pow(0.5,2*l)));
+  }
+  for(int l1=0;l1<=nLevels;l1++){
+    for(int l2=0;l2<=nLevels;l2++){
+      ASSERT_EQ(LevelScales<nLevels>::transform(l1,l2),static_cast<float>(std::pow(0.5,l2-l1)));
+    }
+  }
+  static_assert(levelScaleDown(3) == 0.125f,"Wrong compile-time level scale");
+  static_assert(levelScaleUp(3) == 8.0f,"Wrong compile-time level scale");
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();